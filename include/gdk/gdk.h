@@ -49,6 +49,8 @@ gchar*	  gdk_set_locale	   	(void);
  */
 void      gdk_error_trap_push           (void);
 gint      gdk_error_trap_pop            (void);
+void      gdk_error_trap_pop_async      (GdkErrorTrapFunc func,
+					 gpointer         data);
 
 
 gboolean  gdk_events_pending	 	(void);
@@ -111,6 +113,7 @@ gint gdk_screen_width_mm  (void);
 gint gdk_screen_height_mm (void);
 
 void gdk_flush (void);
+void gdk_flush_output (void);
 void gdk_beep (void);
 
 void gdk_key_repeat_disable (void);
@@ -247,6 +250,14 @@ gboolean gdk_window_is_viewable    (GdkWindow *window);
  */
 gboolean gdk_window_set_static_gravities (GdkWindow *window,
 					  gboolean   use_static);   
+
+/* Position, size and origin queries are answered from a cache kept
+ * up to date by ConfigureNotify and our own requests. Turn tracking
+ * off for windows that are moved or resized behind GDK's back; their
+ * children are then always looked up on the server as well.
+ */
+void	 gdk_window_set_geometry_tracking (GdkWindow *window,
+					   gboolean   track);
 /*
  * The following function adds a global filter for all client
  * messages of type message_type
@@ -611,6 +622,14 @@ gint	 gdk_char_width	    (GdkFont        *font,
 			     gchar           character);
 gint	 gdk_char_width_wc  (GdkFont        *font,
 			     GdkWChar        character);
+gint	 gdk_text_widths    (GdkFont        *font,
+			     const gchar    *text,
+			     gint            text_length,
+			     gint           *widths);
+gint	 gdk_text_widths_wc (GdkFont        *font,
+			     const GdkWChar *text,
+			     gint            text_length,
+			     gint           *widths);
 gint	 gdk_string_measure (GdkFont        *font,
 			     const gchar    *string);
 gint	 gdk_text_measure   (GdkFont        *font,
@@ -652,6 +671,17 @@ void     gdk_string_extents (GdkFont     *font,
 
 /* Drawing
  */
+
+/* Between gdk_draw_batch_begin() and gdk_draw_batch_end(), which nest,
+ * consecutive points, lines or rectangles with the same drawable and
+ * GC are sent as one request, if batching is enabled. Code drawing
+ * with Xlib directly has to get the GC with GDK_GC_XGC(), which sends
+ * any pending batch first.
+ */
+void gdk_draw_set_batching (gboolean	batching);
+void gdk_draw_batch_begin  (void);
+void gdk_draw_batch_end	   (void);
+
 void gdk_draw_point	 (GdkDrawable  *drawable,
 			  GdkGC	       *gc,
 			  gint		x,
@@ -771,6 +801,12 @@ void	   gdk_free_compound_text	  (guchar *ctext);
  */
 GdkAtom  gdk_atom_intern     (const gchar  *atom_name,
                               gint          only_if_exists);
+void     gdk_atom_intern_list (const gchar **atom_names,
+			       gint          n_atoms,
+			       gint          only_if_exists,
+			       GdkAtom      *atoms);
+void     gdk_atom_prefetch   (const gchar **atom_names,
+			      gint          n_atoms);
 gchar*   gdk_atom_name       (GdkAtom       atom);
 gboolean gdk_property_get    (GdkWindow    *window,
                               GdkAtom       property,
@@ -986,6 +1022,18 @@ extern GMutex *gdk_threads_mutex;
 void     gdk_threads_enter                (void);
 void     gdk_threads_leave                (void);
 
+/* Queue a call of func to be made from the main loop, holding the GDK
+ * lock. This may be called from any thread, and never blocks. Calls
+ * are made in the order they were posted; at most usecs microseconds
+ * per main loop iteration are spent making them (at least one call is
+ * always made), so that events keep being handled while the queue is
+ * long. notify is called for data after func.
+ */
+void     gdk_threads_post                 (GdkThreadsFunc  func,
+					   gpointer        data,
+					   GDestroyNotify  notify);
+void     gdk_threads_set_post_budget      (guint           usecs);
+
 #ifdef	G_THREADS_ENABLED
 #  define GDK_THREADS_ENTER()	G_STMT_START {	\
       if (gdk_threads_mutex)                 	\
@@ -1000,6 +1048,34 @@ void     gdk_threads_leave                (void);
 #  define GDK_THREADS_LEAVE()
 #endif	/* !G_THREADS_ENABLED */
 
+/* Recording the input events, and putting them back on the queue.
+ * When paced is FALSE the events are replayed as fast as possible.
+ */
+gboolean gdk_event_record_start           (const gchar *filename);
+void     gdk_event_record_stop            (void);
+gboolean gdk_event_replay                 (const gchar *filename,
+					   gboolean     paced);
+
+/* Tracing
+ */
+
+extern gboolean gdk_trace_enabled;
+
+void     gdk_trace_begin                  (const gchar *category,
+					   const gchar *name,
+					   const gchar *detail);
+void     gdk_trace_end                    (void);
+gboolean gdk_trace_dump                   (const gchar *filename);
+
+#define GDK_TRACE_BEGIN(category, name, detail)	G_STMT_START {	\
+      if (gdk_trace_enabled)					\
+        gdk_trace_begin ((category), (name), (detail));		\
+   } G_STMT_END
+#define GDK_TRACE_END()				G_STMT_START {	\
+      if (gdk_trace_enabled)					\
+        gdk_trace_end ();					\
+   } G_STMT_END
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
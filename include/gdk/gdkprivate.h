@@ -79,6 +79,22 @@ struct _GdkWindowPrivate
   GList *filters;
   GdkColormap *colormap;
   GList *children;
+
+  guint32 serial;	/* Creation order, for recording events */
+
+  /* Client side geometry cache. For toplevels, root_x/root_y hold
+   * the origin in root coordinates as last reported by the server;
+   * child windows are located by adding up the tracked positions of
+   * their ancestors. Events older than geometry_serial predate one of
+   * our own requests and are ignored.
+   */
+  gint16 root_x;
+  gint16 root_y;
+  guint8 depth;
+  guint origin_valid : 1;
+  guint reparented : 1;
+  guint untracked : 1;
+  gulong geometry_serial;
 };
 
 struct _GdkImagePrivate
@@ -99,12 +115,39 @@ struct _GdkImagePrivate
 		     gint	  height);
 };
 
+typedef enum {
+  GDK_GC_CLIP_NONE,
+  GDK_GC_CLIP_RECTANGLE,
+  GDK_GC_CLIP_PIXMAP,
+  GDK_GC_CLIP_UNKNOWN
+} GdkGCClipType;
+
 struct _GdkGCPrivate
 {
   GdkGC gc;
   GC xgc;
   Display *xdisplay;
   guint ref_count;
+
+  /* Client side shadow of the GC state. Setters only record the new
+   * values here; components in dirty_mask are sent in a single
+   * XChangeGC by _gdk_gc_flush() right before the next drawing request.
+   */
+  XGCValues values;
+  unsigned long known_mask;
+  unsigned long dirty_mask;
+
+  /* The clip is tracked separately since rectangles can't be sent
+   * through XChangeGC. clip_* is the requested state, server_clip_*
+   * what the server currently has.
+   */
+  GdkRectangle clip_rect;
+  GdkRectangle server_clip_rect;
+  Pixmap clip_pixmap;
+  Pixmap server_clip_pixmap;
+  guint8 clip_type;
+  guint8 server_clip_type;
+  guint clip_dirty : 1;
 };
 
 typedef enum {
@@ -148,6 +191,9 @@ struct _GdkFontPrivate
   guint ref_count;
 
   GSList *names;
+
+  /* Glyph metrics cache, see gdkfont.c */
+  gpointer metrics;
 };
 
 struct _GdkCursorPrivate
@@ -227,10 +273,16 @@ typedef enum {
   GDK_DEBUG_EVENTS        = 1 << 1,
   GDK_DEBUG_DND           = 1 << 2,
   GDK_DEBUG_COLOR_CONTEXT = 1 << 3,
-  GDK_DEBUG_XIM           = 1 << 4
+  GDK_DEBUG_XIM           = 1 << 4,
+  GDK_DEBUG_SYNC          = 1 << 5
 } GdkDebugFlag;
 
 void gdk_events_init (void);
+void gdk_trace_init (void);
+void gdk_trace_exit (void);
+void gdk_record_init (void);
+void gdk_record_exit (void);
+void gdk_atoms_init (void);
 void gdk_window_init (void);
 void gdk_visual_init (void);
 void gdk_dnd_init    (void);
@@ -243,6 +295,11 @@ GdkVisual*   gdk_visual_lookup	 (Visual   *xvisual);
 
 void gdk_window_add_colormap_windows (GdkWindow *window);
 void gdk_window_destroy_notify	     (GdkWindow *window);
+void gdk_window_origin_changed	     (GdkWindow *window,
+				      gboolean   known,
+				      gint       x,
+				      gint       y,
+				      gulong     serial);
 
 void	 gdk_xid_table_insert (XID	*xid,
 			       gpointer	 data);
@@ -252,6 +309,36 @@ gpointer gdk_xid_table_lookup (XID	 xid);
 gint gdk_send_xevent (Window window, gboolean propagate, glong event_mask,
 		      XEvent *event_send);
 
+/* Reports the results of asynchronous error traps whose requests
+ * the server has processed.
+ */
+void _gdk_error_traps_dispatch (void);
+
+/* Called for each request that waits for a reply from the server;
+ * counts them in gdk_round_trips.
+ */
+void _gdk_round_trip (void);
+
+/* Bracket an initialisation step for the GDK_STARTUP_REPORT report.
+ * Phases nest; both are no-ops unless the report is enabled.
+ */
+void _gdk_startup_phase_begin (const gchar *name);
+void _gdk_startup_phase_end   (void);
+
+/* Sends any pending GC changes to the server and returns the X GC.
+ * Must be called before every X drawing request using the GC.
+ */
+GC   _gdk_gc_flush   (GdkGC *gc);
+
+/* Sends the pending batch of drawing primitives, see gdkdraw.c. Must
+ * be called before any request that has to come after them; the _gc
+ * variant before changing @gc, which only matters if it is batched.
+ * Discarding drops a batch for a drawable about to be destroyed.
+ */
+void _gdk_draw_batch_flush	(void);
+void _gdk_draw_batch_flush_gc	(GdkGC	     *gc);
+void _gdk_draw_batch_discard	(GdkDrawable *drawable);
+
 /* If you pass x = y = -1, it queries the pointer
    to find out where it currently is.
    If you pass x = y = -2, it does anything necessary
@@ -291,6 +378,25 @@ extern GList            *gdk_default_filters;
 extern const int         gdk_nevent_masks;
 extern const int         gdk_event_mask_table[];
 
+/* GC request statistics. gdk_gc_requests_issued counts the requests
+ * the GC setters would have made without the client side shadow,
+ * gdk_gc_requests_sent those actually made. The difference is the
+ * number of requests saved.
+ */
+extern guint             gdk_gc_requests_issued;
+extern guint             gdk_gc_requests_sent;
+
+/* Drawing request statistics for points, lines and rectangles: the
+ * primitives drawn and the requests they took, fewer when batched.
+ */
+extern guint             gdk_draw_requests_issued;
+extern guint             gdk_draw_requests_sent;
+
+/* Number of round trips to the server; with GDK_DEBUG=sync the rate
+ * is reported once a second.
+ */
+extern guint             gdk_round_trips;
+
 extern GdkWindowPrivate *gdk_xgrab_window;  /* Window that currently holds the
 					     * x pointer grab
 					     */
@@ -321,6 +427,13 @@ extern GdkWindow *gdk_xim_window;	        /* currently using Window */
 
 extern guint gdk_debug_flags;
 
+/* Event recording and replay, see gdkrecord.c */
+void gdk_record_window_new	 (GdkWindow *window);
+void gdk_record_window_free	 (GdkWindow *window);
+void gdk_record_event		 (GdkEvent  *event);
+void gdk_replay_event_dispatched (GdkEvent  *event);
+void gdk_event_put_replayed	 (GdkEvent  *event);
+
 
 gboolean _gdk_font_wc_to_glyphs (GdkFont         *font,
 				 const GdkWChar  *text,
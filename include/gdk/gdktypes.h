@@ -96,6 +96,9 @@ typedef struct _GdkTimeCoord	    GdkTimeCoord;
 typedef struct _GdkRegion	    GdkRegion;
 typedef void (*GdkEventFunc) (GdkEvent *event,
 			      gpointer	data);
+typedef void (*GdkErrorTrapFunc) (gint     error_code,
+				  gpointer data);
+typedef void (*GdkThreadsFunc) (gpointer data);
 
 typedef struct _GdkIC               GdkIC;
 typedef struct _GdkICAttr	    GdkICAttr;
@@ -173,6 +173,10 @@ void	gtk_item_factory_dump_rc	(const gchar		*file_name,
 					 gboolean		 modified_only);
 void	gtk_item_factory_print_func	(gpointer		 FILE_pointer,
 					 gchar			*string);
+/* Entries of submenus are only recorded until the submenu first pops
+ * up or one of their accelerators is used; gtk_item_factory_get_widget()
+ * and friends create the widgets on demand.
+ */
 void	gtk_item_factory_create_item	(GtkItemFactory		*ifactory,
 					 GtkItemFactoryEntry	*entry,
 					 gpointer		 callback_data,
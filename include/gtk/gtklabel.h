@@ -61,6 +61,12 @@ struct _GtkLabel
   guint	  max_width : 16;
   guint   jtype : 2;
   gboolean wrap;
+
+  /* Cached wrapping results, valid as long as words is set */
+  gint wrap_longest;
+  gint wrap_natural;
+  gint wrap_width;
+  gint wrap_height;
 };
 
 struct _GtkLabelClass
@@ -70,6 +70,23 @@ struct _GtkLayout {
   gint scroll_y;
 
   guint freeze_count;
+
+  /* Children are indexed in a grid of fixed size cells, so scrolling
+   * only needs to look at the children near the viewport. The active
+   * children are the ones inside the active region; all others are
+   * unmapped and flagged as offscreen.
+   */
+  GHashTable *child_cells;
+  GList *large_children;
+  GList *active_children;
+  gint active_x;
+  gint active_y;
+  gint active_width;
+  gint active_height;
+  guint child_serial;
+  guint query_serial;
+
+  guint unrealize_offscreen : 1;
 };
 
 struct _GtkLayoutClass {
@@ -104,6 +121,13 @@ void           gtk_layout_set_hadjustment (GtkLayout     *layout,
 void           gtk_layout_set_vadjustment (GtkLayout     *layout,
 					   GtkAdjustment *adjustment);
 
+/* Children scrolled far away from the viewport are always unmapped.
+ * If this is set, they are unrealized as well, releasing their
+ * windows until they are scrolled back into view.
+ */
+void           gtk_layout_set_unrealize_offscreen (GtkLayout *layout,
+						   gboolean   unrealize);
+
 /* These disable and enable moving and repainting the scrolling window
  * of the GtkLayout, respectively.  If you want to update the layout's
  * offsets but do not want it to repaint itself, you should use these
@@ -159,6 +159,13 @@ void       gtk_menu_reorder_child         (GtkMenu             *menu,
                                            GtkWidget           *child,
                                            gint                position);
 
+/* The populate function is called once, right before the menu is
+ * first popped up or torn off, so its items can be created on demand.
+ */
+void       gtk_menu_set_populate_func     (GtkMenu             *menu,
+					   GtkCallback          func,
+					   gpointer             data);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
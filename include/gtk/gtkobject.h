@@ -264,6 +264,27 @@ void	gtk_object_setv		(GtkObject	*object,
 				 guint		n_args,
 				 GtkArg		*args);
 
+/* gtk_object_arg_resolve() looks up the argument `arg_name' (in any of
+ * the forms gtk_object_set() accepts) for objects of `object_type' once,
+ * returning a handle that stays valid for the lifetime of the program,
+ * or NULL if there is no such argument.
+ * The handles can be passed to gtk_object_setv_by_info() and
+ * gtk_object_getv_by_info() together with an array of values, to set
+ * or get arguments of any object of that type without name lookups.
+ * Like for gtk_object_setv(), the types of the set values need to match
+ * the argument types; the getter fills in names, types and values.
+ */
+GtkArgInfo* gtk_object_arg_resolve  (GtkType	   object_type,
+				     const gchar  *arg_name);
+void	gtk_object_setv_by_info	(GtkObject	*object,
+				 guint		n_args,
+				 GtkArgInfo	**infos,
+				 GtkArg		*args);
+void	gtk_object_getv_by_info	(GtkObject	*object,
+				 guint		n_args,
+				 GtkArgInfo	**infos,
+				 GtkArg		*args);
+
 /* Allocate a GtkArg array of size nargs that hold the
  * names and types of the args that can be used with
  * gtk_object_set/gtk_object_get. if (arg_flags!=NULL),
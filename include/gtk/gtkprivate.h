@@ -49,7 +49,8 @@ typedef enum
   PRIVATE_GTK_HAS_SHAPE_MASK	= 1 <<  5,
   PRIVATE_GTK_IN_REPARENT       = 1 <<  6,
   PRIVATE_GTK_IS_OFFSCREEN      = 1 <<  7,
-  PRIVATE_GTK_FULLDRAW_PENDING  = 1 <<  8
+  PRIVATE_GTK_FULLDRAW_PENDING  = 1 <<  8,
+  PRIVATE_GTK_HAS_CHILD_INDEX   = 1 <<  9
 } GtkPrivateFlags;
 
 /* Macros for extracting a widgets private_flags from GtkWidget.
@@ -64,6 +65,7 @@ typedef enum
 #define GTK_WIDGET_IN_REPARENT(obj)	  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_IN_REPARENT) != 0)
 #define GTK_WIDGET_IS_OFFSCREEN(obj)	  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_IS_OFFSCREEN) != 0)
 #define GTK_WIDGET_FULLDRAW_PENDING(obj)  ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_FULLDRAW_PENDING) != 0)
+#define GTK_WIDGET_HAS_CHILD_INDEX(obj)   ((GTK_PRIVATE_FLAGS (obj) & PRIVATE_GTK_HAS_CHILD_INDEX) != 0)
 
 /* Macros for setting and clearing private widget flags.
  * we use a preprocessor string concatenation here for a clear
@@ -72,6 +74,16 @@ typedef enum
 #define GTK_PRIVATE_SET_FLAG(wid,flag)    G_STMT_START{ (GTK_PRIVATE_FLAGS (wid) |= (PRIVATE_ ## flag)); }G_STMT_END
 #define GTK_PRIVATE_UNSET_FLAG(wid,flag)  G_STMT_START{ (GTK_PRIVATE_FLAGS (wid) &= ~(PRIVATE_ ## flag)); }G_STMT_END
 
+/* Hooks run by gtk_accel_group_activate() when an accelerator has no
+ * entry, so that the entry can be added on demand; a hook returns
+ * whether it added one. Used by GtkItemFactory for lazy menus.
+ */
+typedef gboolean (*GtkAccelGroupMissFunc) (GtkAccelGroup   *accel_group,
+					   guint            accel_key,
+					   GdkModifierType  accel_mods);
+void	gtk_accel_group_add_miss_func		(GtkAccelGroupMissFunc func);
+void	gtk_accel_group_remove_miss_func	(GtkAccelGroupMissFunc func);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
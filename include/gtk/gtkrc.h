@@ -67,6 +67,10 @@ gchar**   gtk_rc_get_default_files      (void);
 void	  gtk_rc_parse			(const gchar *filename);
 void	  gtk_rc_parse_string		(const gchar *rc_string);
 gboolean  gtk_rc_reparse_all		(void);
+/* Makes gtk_rc_init() parse the default rc files and rewrite the rc
+ * cache even if it is up to date, as --gtk-rc-cache-rebuild does.
+ */
+void	  gtk_rc_cache_rebuild		(void);
 GtkStyle* gtk_rc_get_style		(GtkWidget   *widget);
 void	  gtk_rc_add_widget_name_style	(GtkRcStyle  *rc_style,
 					 const gchar *pattern);
@@ -38,6 +38,15 @@ extern "C" {
 
 typedef struct _GtkSelectionData GtkSelectioData;
 typedef struct _GtkTargetList    GtkTargetList;
+
+/* Fills buffer with at most length bytes of the next portion of a
+ * streamed selection; returns the number of bytes stored, 0 at the
+ * end of the data.
+ */
+typedef gint (*GtkSelectionStreamFunc) (GtkSelectionData *selection_data,
+					guchar           *buffer,
+					gint              length,
+					gpointer          data);
 typedef struct _GtkTargetEntry   GtkTargetEntry;
 
 struct _GtkTargetEntry {
@@ -105,6 +114,13 @@ void gtk_selection_data_set (GtkSelectionData *selection_data,
 			     gint              format,
 			     const guchar     *data,
 			     gint              length);
+void gtk_selection_data_set_stream (GtkSelectionData       *selection_data,
+				    GdkAtom                 type,
+				    gint                    format,
+				    gint                    length_hint,
+				    GtkSelectionStreamFunc  func,
+				    gpointer                data,
+				    GtkDestroyNotify        destroy);
 
 /* Called when a widget is destroyed */
 
@@ -103,6 +103,8 @@ struct _GtkText
   guint first_onscreen_hor_pixel;
   /* First visible vertical pixel. */
   guint first_onscreen_ver_pixel;
+  /* Pixel heights of all logical lines, for scrolling. */
+  gpointer line_index;
 
 			     /* FLAGS */
 
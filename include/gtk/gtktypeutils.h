@@ -333,6 +333,13 @@ struct _GtkTypeQuery
   const gchar		*type_name;
   guint			 object_size;
   guint			 class_size;
+
+  /* instances currently allocated, the most allocated at any time and
+   * all allocations made through gtk_type_new()
+   */
+  guint			 n_instances;
+  guint			 n_peak_instances;
+  guint			 n_allocations;
 };
 
 struct _GtkEnumValue
@@ -360,6 +367,9 @@ void		gtk_type_free			(GtkType	 type,
 void		gtk_type_describe_heritage	(GtkType	 type);
 void		gtk_type_describe_tree		(GtkType	 type,
 						 gboolean	 show_size);
+/* Reports the instance statistics of @type and its descendants
+ */
+void		gtk_type_describe_allocations	(GtkType	 type);
 gboolean	gtk_type_is_a			(GtkType	 type,
 						 GtkType	 is_a_type);
 GtkTypeObject*	gtk_type_check_object_cast	(GtkTypeObject	*type_object,
@@ -602,6 +602,11 @@ gchar* gtk_widget_get_composite_name	(GtkWidget	*widget);
 /* Descend recursively and set rc-style on all widgets without user styles */
 void       gtk_widget_reset_rc_styles   (GtkWidget      *widget);
 
+/* Like gtk_widget_reset_rc_styles(), but only restyles the widgets whose
+ * rc style actually changed, a batch at a time from an idle handler.
+ */
+void       gtk_widget_update_rc_styles  (GtkWidget      *widget);
+
 /* Push/pop pairs, to change default values upon a widget's creation.
  * This will override the values that got set by the
  * gtk_widget_set_default_* () functions.
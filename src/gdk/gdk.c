@@ -57,6 +57,8 @@
 
 typedef struct _GdkPredicate  GdkPredicate;
 typedef struct _GdkErrorTrap  GdkErrorTrap;
+typedef struct _GdkAsyncTrap  GdkAsyncTrap;
+typedef struct _GdkStartupPhase GdkStartupPhase;
 
 struct _GdkPredicate
 {
@@ -68,6 +70,29 @@ struct _GdkErrorTrap
 {
   gint error_warnings;
   gint error_code;
+  gulong start_serial;		/* First request covered by the trap */
+};
+
+/* A trap popped with gdk_error_trap_pop_async(), waiting for the
+ * server to process the requests it covers.
+ */
+struct _GdkAsyncTrap
+{
+  gulong start_serial;
+  gulong end_serial;
+  gint error_code;
+  GdkErrorTrapFunc func;
+  gpointer data;
+};
+
+/* An initialisation step being timed for the startup report.
+ */
+struct _GdkStartupPhase
+{
+  const gchar *name;
+  GTimeVal start;
+  guint round_trips;		/* gdk_round_trips at the start */
+  gulong request;		/* Serial of the first request made */
 };
 
 /* 
@@ -114,9 +139,18 @@ static guint32 timer_val;			    /* The timeout length as specified by
 						     *	the user in milliseconds.
 						     */
 static gint autorepeat;
+static gboolean autorepeat_known = FALSE;	    /* Whether autorepeat has been
+						     *	queried yet.
+						     */
+static gboolean startup_report = FALSE;		    /* GDK_STARTUP_REPORT is set */
+static GSList *startup_phases = NULL;		    /* Phases being timed,
+						     *	innermost first.
+						     */
 
 static GSList *gdk_error_traps = NULL;               /* List of error traps */
 static GSList *gdk_error_trap_free_list = NULL;      /* Free list */
+static GSList *gdk_async_traps = NULL;	      /* Traps popped asynchronously,
+					       * oldest first */
 
 #ifdef G_ENABLE_DEBUG
 static const GDebugKey gdk_debug_keys[] = {
@@ -124,7 +158,8 @@ static const GDebugKey gdk_debug_keys[] = {
   {"misc",	    GDK_DEBUG_MISC},
   {"dnd",	    GDK_DEBUG_DND},
   {"color-context", GDK_DEBUG_COLOR_CONTEXT},
-  {"xim",	    GDK_DEBUG_XIM}
+  {"xim",	    GDK_DEBUG_XIM},
+  {"sync",	    GDK_DEBUG_SYNC}
 };
 
 static const int gdk_ndebug_keys = sizeof(gdk_debug_keys)/sizeof(GDebugKey);
@@ -188,11 +223,65 @@ get_option (char ***argv,
  *--------------------------------------------------------------
  */
 
+/* With GDK_STARTUP_REPORT set in the environment, each step of
+ * gdk_init() reports the time it took and the number of round trips
+ * and requests it made. Steps that are put off until first use, like
+ * input device enumeration or opening the input method, report when
+ * they run.
+ */
+void
+_gdk_startup_phase_begin (const gchar *name)
+{
+  GdkStartupPhase *phase;
+
+  if (!startup_report)
+    return;
+
+  phase = g_new (GdkStartupPhase, 1);
+  phase->name = name;
+  g_get_current_time (&phase->start);
+  phase->round_trips = gdk_round_trips;
+  phase->request = gdk_display ? NextRequest (gdk_display) : 1;
+
+  startup_phases = g_slist_prepend (startup_phases, phase);
+}
+
+void
+_gdk_startup_phase_end (void)
+{
+  GdkStartupPhase *phase;
+  GTimeVal now;
+  gdouble elapsed;
+  gulong requests;
+  gint depth;
+
+  if (!startup_phases)
+    return;
+
+  phase = startup_phases->data;
+  startup_phases = g_slist_remove (startup_phases, phase);
+  depth = g_slist_length (startup_phases);
+
+  g_get_current_time (&now);
+  elapsed = ((now.tv_sec - phase->start.tv_sec) * 1000.0 +
+	     (now.tv_usec - phase->start.tv_usec) / 1000.0);
+  requests = gdk_display ? NextRequest (gdk_display) - phase->request : 0;
+
+  g_message ("%s %*s%-*s %8.2f ms %4u round trips %5lu requests",
+	     gdk_initialized ? "deferred:" : "startup: ",
+	     2 * depth, "",
+	     16 - 2 * depth, phase->name,
+	     elapsed,
+	     gdk_round_trips - phase->round_trips,
+	     requests);
+
+  g_free (phase);
+}
+
 gboolean
 gdk_init_check (int	 *argc,
 		char ***argv)
 {
-  XKeyboardState keyboard_state;
   gint synchronize;
   gint i, j, k;
   XClassHint *class_hint;
@@ -217,6 +306,14 @@ gdk_init_check (int	 *argc,
     }
   
   X_GETTIMEOFDAY (&start);
+
+  option = getenv ("GDK_STARTUP_REPORT");
+  startup_report = option != NULL && option[0] != 0;
+
+  option = getenv ("GDK_DRAW_BATCH");
+  if (option != NULL && option[0] != 0)
+    gdk_draw_set_batching (TRUE);
+  _gdk_startup_phase_begin ("gdk_init");
   
   gdk_display_name = NULL;
   
@@ -225,6 +322,8 @@ gdk_init_check (int	 *argc,
   
   synchronize = FALSE;
   
+  gdk_trace_init ();
+  
 #ifdef G_ENABLE_DEBUG
   {
     gchar *debug_string = getenv("GDK_DEBUG");
@@ -409,13 +508,25 @@ gdk_init_check (int	 *argc,
   
   GDK_NOTE (MISC, g_message ("progname: \"%s\"", g_get_prgname ()));
   
+  _gdk_startup_phase_begin ("display");
   gdk_display = XOpenDisplay (gdk_display_name);
   if (!gdk_display)
-    return FALSE;
+    {
+      _gdk_startup_phase_end ();
+      _gdk_startup_phase_end ();
+      return FALSE;
+    }
+  _gdk_round_trip ();		/* connection setup */
   
   if (synchronize)
     XSynchronize (gdk_display, True);
+  _gdk_startup_phase_end ();
+
+  _gdk_startup_phase_begin ("atoms");
+  gdk_atoms_init ();
+  _gdk_startup_phase_end ();
   
+  _gdk_startup_phase_begin ("leader window");
   gdk_screen = DefaultScreen (gdk_display);
   gdk_root_window = RootWindow (gdk_display, gdk_screen);
   
@@ -434,19 +545,18 @@ gdk_init_check (int	 *argc,
                       NULL, NULL, class_hint);
   XFree (class_hint);
   
+  _gdk_startup_phase_end ();
+  
   for (i = 0; i < argc_orig; i++)
     g_free(argv_orig[i]);
   g_free(argv_orig);
   
-  gdk_wm_delete_window = XInternAtom (gdk_display, "WM_DELETE_WINDOW", False);
-  gdk_wm_take_focus = XInternAtom (gdk_display, "WM_TAKE_FOCUS", False);
-  gdk_wm_protocols = XInternAtom (gdk_display, "WM_PROTOCOLS", False);
+  gdk_wm_delete_window = gdk_atom_intern ("WM_DELETE_WINDOW", FALSE);
+  gdk_wm_take_focus = gdk_atom_intern ("WM_TAKE_FOCUS", FALSE);
+  gdk_wm_protocols = gdk_atom_intern ("WM_PROTOCOLS", FALSE);
   gdk_wm_window_protocols[0] = gdk_wm_delete_window;
   gdk_wm_window_protocols[1] = gdk_wm_take_focus;
-  gdk_selection_property = XInternAtom (gdk_display, "GDK_SELECTION", False);
-  
-  XGetKeyboardControl (gdk_display, &keyboard_state);
-  autorepeat = keyboard_state.global_auto_repeat;
+  gdk_selection_property = gdk_atom_intern ("GDK_SELECTION", FALSE);
   
   timer.tv_sec = 0;
   timer.tv_usec = 0;
@@ -454,16 +564,29 @@ gdk_init_check (int	 *argc,
   
   g_atexit (gdk_exit_func);
   
+  _gdk_startup_phase_begin ("events");
   gdk_events_init ();
+  _gdk_startup_phase_end ();
+  _gdk_startup_phase_begin ("visuals");
   gdk_visual_init ();
+  _gdk_startup_phase_end ();
+  _gdk_startup_phase_begin ("root window");
   gdk_window_init ();
+  _gdk_startup_phase_end ();
+  _gdk_startup_phase_begin ("images");
   gdk_image_init ();
-  gdk_input_init ();
-  gdk_dnd_init ();
+  _gdk_startup_phase_end ();
 
-#ifdef USE_XIM
-  gdk_im_open ();
-#endif
+  /* Input devices, drag and drop and the input method are set up
+   * on first use; see gdk_input_init(), gdk_dnd_init() and
+   * gdk_im_open().
+   */
+  
+  _gdk_startup_phase_begin ("record");
+  gdk_record_init ();
+  _gdk_startup_phase_end ();
+  
+  _gdk_startup_phase_end ();
   
   gdk_initialized = 1;
 
@@ -969,15 +1092,33 @@ gdk_set_sm_client_id (const gchar* sm_client_id)
   }
 }
 
+/* The keyboard state is only needed to undo gdk_key_repeat_disable(),
+ * so it is queried right before autorepeat is first turned off.
+ */
 void
 gdk_key_repeat_disable (void)
 {
+  if (!autorepeat_known)
+    {
+      XKeyboardState keyboard_state;
+
+      _gdk_startup_phase_begin ("keyboard");
+      _gdk_round_trip ();
+      XGetKeyboardControl (gdk_display, &keyboard_state);
+      autorepeat = keyboard_state.global_auto_repeat;
+      autorepeat_known = TRUE;
+      _gdk_startup_phase_end ();
+    }
+
   XAutoRepeatOff (gdk_display);
 }
 
 void
 gdk_key_repeat_restore (void)
 {
+  if (!autorepeat_known)
+    return;
+
   if (autorepeat)
     XAutoRepeatOn (gdk_display);
   else
@@ -1020,6 +1161,9 @@ gdk_exit_func (void)
     return;
   in_gdk_exit_func = TRUE;
   
+  gdk_trace_exit ();
+  gdk_record_exit ();
+  
   if (gdk_initialized)
     {
 #ifdef USE_XIM
@@ -1059,12 +1203,34 @@ gdk_exit_func (void)
  *--------------------------------------------------------------
  */
 
+/* Serial numbers wrap around; compare them as a signed difference */
+#define GDK_SERIAL_BEFORE(a, b) ((glong) ((a) - (b)) < 0)
+
 static int
 gdk_x_error (Display	 *display,
 	     XErrorEvent *error)
 {
+  GSList *tmp_list;
+
   if (error->error_code)
     {
+      /* Errors for requests covered by an asynchronous trap are
+       * recorded and reported from _gdk_error_traps_dispatch(),
+       * since no X calls may be made from here.
+       */
+      for (tmp_list = gdk_async_traps; tmp_list; tmp_list = tmp_list->next)
+	{
+	  GdkAsyncTrap *trap = tmp_list->data;
+
+	  if (!GDK_SERIAL_BEFORE (error->serial, trap->start_serial) &&
+	      !GDK_SERIAL_BEFORE (trap->end_serial, error->serial))
+	    {
+	      if (!trap->error_code)
+		trap->error_code = error->error_code;
+	      return 0;
+	    }
+	}
+
       if (gdk_error_warnings)
 	{
 	  char buf[64];
@@ -1179,6 +1345,7 @@ gdk_error_trap_push (void)
   trap = node->data;
   trap->error_code = gdk_error_code;
   trap->error_warnings = gdk_error_warnings;
+  trap->start_serial = NextRequest (gdk_display);
 
   gdk_error_code = 0;
   gdk_error_warnings = 0;
@@ -1217,21 +1384,124 @@ gdk_error_trap_pop (void)
   return result;
 }
 
+/*************************************************************
+ * gdk_error_trap_pop_async:
+ *     Pop an error trap added with gdk_error_trap_push()
+ *     without waiting for the server to process the requests
+ *     made since. Errors caused by those requests are matched
+ *     to the trap by their serial number as they arrive. Once
+ *     the outcome is known, func is called with the code of the
+ *     first error, or 0 if the requests succeeded.
+ *   arguments:
+ *     func:  function to report the outcome to, or NULL if
+ *	      errors should just be ignored.
+ *     data:  user data for func
+ *   results:
+ *************************************************************/
+
+void
+gdk_error_trap_pop_async (GdkErrorTrapFunc func,
+			  gpointer         data)
+{
+  GdkErrorTrap *trap;
+  GdkAsyncTrap *async_trap;
+  gulong start_serial;
+  gint error_code;
+
+  g_return_if_fail (gdk_error_traps != NULL);
+
+  trap = gdk_error_traps->data;
+  start_serial = trap->start_serial;
+  error_code = gdk_error_trap_pop ();
+
+  /* Nothing to wait for if no request was made, or the trap
+   * already caught an error */
+  if (error_code || NextRequest (gdk_display) == start_serial)
+    {
+      if (func)
+	(* func) (error_code, data);
+      return;
+    }
+
+  async_trap = g_new (GdkAsyncTrap, 1);
+  async_trap->start_serial = start_serial;
+  async_trap->end_serial = NextRequest (gdk_display) - 1;
+  async_trap->error_code = 0;
+  async_trap->func = func;
+  async_trap->data = data;
+
+  gdk_async_traps = g_slist_append (gdk_async_traps, async_trap);
+}
+
+void
+_gdk_error_traps_dispatch (void)
+{
+  while (gdk_async_traps)
+    {
+      GdkAsyncTrap *trap = gdk_async_traps->data;
+
+      /* Errors arrive in request order; so once the server has
+       * processed the last request of a trap without an error for
+       * it, that trap has succeeded. */
+      if (!trap->error_code &&
+	  GDK_SERIAL_BEFORE (LastKnownRequestProcessed (gdk_display),
+			     trap->end_serial))
+	break;
+
+      gdk_async_traps = g_slist_remove (gdk_async_traps, trap);
+
+      if (trap->func)
+	(* trap->func) (trap->error_code, trap->data);
+      else if (trap->error_code)
+	GDK_NOTE (MISC, g_message ("ignoring X error %d for requests %ld-%ld",
+				   trap->error_code,
+				   trap->start_serial, trap->end_serial));
+      g_free (trap);
+    }
+}
+
+void
+_gdk_round_trip (void)
+{
+  gdk_round_trips++;
+
+#ifdef G_ENABLE_DEBUG
+  if (gdk_debug_flags & GDK_DEBUG_SYNC)
+    {
+      static guint last_round_trips = 0;
+      static GTimeVal last_report = { 0, 0 };
+      GTimeVal now;
+      glong elapsed;
+
+      g_get_current_time (&now);
+      elapsed = (now.tv_sec - last_report.tv_sec) * 1000 +
+	(now.tv_usec - last_report.tv_usec) / 1000;
+
+      if (elapsed >= 1000)
+	{
+	  if (last_report.tv_sec)
+	    g_message ("%.1f round trips/s",
+		       (gdk_round_trips - last_round_trips) * 1000.0 / elapsed);
+	  last_report = now;
+	  last_round_trips = gdk_round_trips;
+	}
+    }
+#endif /* G_ENABLE_DEBUG */
+}
+
 gint 
 gdk_send_xevent (Window window, gboolean propagate, glong event_mask,
 		 XEvent *event_send)
 {
   Status result;
-  gint old_warnings = gdk_error_warnings;
-  
-  gdk_error_code = 0;
   
-  gdk_error_warnings = 0;
+  /* Don't wait to find out whether the window still exists; a
+   * BadWindow for the event is ignored when it arrives */
+  gdk_error_trap_push ();
   result = XSendEvent (gdk_display, window, propagate, event_mask, event_send);
-  XSync (gdk_display, False);
-  gdk_error_warnings = old_warnings;
+  gdk_error_trap_pop_async (NULL, NULL);
   
-  return result && !gdk_error_code;
+  return result;
 }
 
 #ifndef HAVE_XCONVERTCASE
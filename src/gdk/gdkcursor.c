@@ -68,6 +68,8 @@ gdk_cursor_new_from_pixmap (GdkPixmap *source, GdkPixmap *mask, GdkColor *fg, Gd
   xbg.blue = bg->blue;
   xbg.green = bg->green;
   
+  /* The server copies the pixmaps into the cursor right away */
+  _gdk_draw_batch_flush ();
   xcursor = XCreatePixmapCursor (gdk_display, source_pixmap, mask_pixmap, &xfg, &xbg, x, y);
   private = g_new (GdkCursorPrivate, 1);
   private->xdisplay = gdk_display;
@@ -40,16 +40,48 @@ typedef enum {
   GDK_DRAG_STATUS_DROP
 } GtkDragStatus;
 
+/* A window inside a toplevel, expanded only when a lookup descends
+ * into it. Its rectangle is clipped to its parent's, so a point
+ * inside it is inside all of its ancestors as well.
+ */
+typedef struct _GdkCacheNode GdkCacheNode;
+
+struct _GdkCacheNode {
+  Window xid;
+  gint x_origin, y_origin;	/* Unclipped, relative to the toplevel */
+  gint x, y, width, height;	/* Clipped, relative to the toplevel */
+  glong event_mask;		/* Our event mask on the window */
+  guint expanded : 1;		/* Whether is_client and children are valid */
+  guint is_client : 1;		/* Whether the window has WM_STATE */
+  guint watched : 1;		/* Whether changes to children are reported */
+  GSList *children;		/* Viewable InputOutput children, topmost first */
+};
+
+/* A window the cache selected SubstructureNotify on; the event
+ * mask it had before is restored when the cache is destroyed.
+ */
+typedef struct {
+  Window xid;
+  Window toplevel;		/* The toplevel child it is inside */
+  glong old_event_mask;
+} GdkCacheWatch;
+
 typedef struct {
   guint32 xid;
   gint x, y, width, height;
   gboolean mapped;
+  glong event_mask;		/* Our event mask on the window */
+  GdkCacheNode *node;		/* The part of the tree seen so far, or NULL */
 } GdkCacheChild;
 
 typedef struct {
   GList *children;
   GHashTable *child_hash;
+  GHashTable *watch_hash;	/* GdkCacheWatches by xid */
   guint old_event_mask;
+  guint hits;			/* Lookups answered from the cache */
+  guint misses;			/* Lookups that needed to query the server */
+  guint round_trips;		/* Round trips made for this cache */
 } GdkWindowCache;
 
 /* Structure that holds information about a drag in progress.
@@ -219,7 +251,8 @@ static void
 gdk_window_cache_add (GdkWindowCache *cache,
 		      guint32 xid,
 		      gint x, gint y, gint width, gint height, 
-		      gboolean mapped)
+		      gboolean mapped,
+		      glong event_mask)
 {
   GdkCacheChild *child = g_new (GdkCacheChild, 1);
 
@@ -229,12 +262,92 @@ gdk_window_cache_add (GdkWindowCache *cache,
   child->width = width;
   child->height = height;
   child->mapped = mapped;
+  child->event_mask = event_mask;
+  child->node = NULL;
 
   cache->children = g_list_prepend (cache->children, child);
   g_hash_table_insert (cache->child_hash, GUINT_TO_POINTER (xid), 
 		       cache->children);
 }
 
+static GdkCacheNode *
+gdk_window_cache_node_new (Window xid,
+			   gint   x_origin,
+			   gint   y_origin,
+			   gint   x,
+			   gint   y,
+			   gint   width,
+			   gint   height,
+			   glong  event_mask)
+{
+  GdkCacheNode *node = g_new (GdkCacheNode, 1);
+
+  node->xid = xid;
+  node->x_origin = x_origin;
+  node->y_origin = y_origin;
+  node->x = x;
+  node->y = y;
+  node->width = width;
+  node->height = height;
+  node->event_mask = event_mask;
+  node->expanded = FALSE;
+  node->is_client = FALSE;
+  node->watched = FALSE;
+  node->children = NULL;
+
+  return node;
+}
+
+static void
+gdk_window_cache_node_free (GdkCacheNode *node)
+{
+  g_slist_foreach (node->children, (GFunc)gdk_window_cache_node_free, NULL);
+  g_slist_free (node->children);
+  g_free (node);
+}
+
+static void
+gdk_window_cache_child_invalidate (GdkCacheChild *child)
+{
+  if (child->node)
+    {
+      gdk_window_cache_node_free (child->node);
+      child->node = NULL;
+    }
+}
+
+static void
+gdk_window_cache_child_free (GdkCacheChild *child)
+{
+  gdk_window_cache_child_invalidate (child);
+  g_free (child);
+}
+
+static void
+gdk_window_cache_unwatch (GdkWindowCache *cache,
+			  Window          xid)
+{
+  GdkCacheWatch *watch;
+
+  watch = g_hash_table_lookup (cache->watch_hash, GUINT_TO_POINTER (xid));
+  if (watch)
+    {
+      g_hash_table_remove (cache->watch_hash, GUINT_TO_POINTER (xid));
+      g_free (watch);
+    }
+}
+
+static void
+gdk_window_cache_watch_restore (gpointer key,
+				gpointer value,
+				gpointer data)
+{
+  GdkCacheWatch *watch = value;
+
+  XSelectInput (gdk_display, watch->xid, watch->old_event_mask);
+  g_free (watch);
+}
+
 static GdkFilterReturn
 gdk_window_cache_filter (GdkXEvent *xev,
 			 GdkEvent  *event,
@@ -257,6 +370,12 @@ gdk_window_cache_filter (GdkXEvent *xev,
 	if (node) 
 	  {
 	    GdkCacheChild *child = node->data;
+
+	    /* The tree is relative to the toplevel, so it survives
+	     * a move, but the toplevel clips it to its old size */
+	    if (xce->width != child->width || xce->height != child->height)
+	      gdk_window_cache_child_invalidate (child);
+	    
 	    child->x = xce->x; 
 	    child->y = xce->y;
 	    child->width = xce->width; 
@@ -298,7 +417,7 @@ gdk_window_cache_filter (GdkXEvent *xev,
 				  GUINT_TO_POINTER (xcwe->window))) 
 	  gdk_window_cache_add (cache, xcwe->window, 
 				xcwe->x, xcwe->y, xcwe->width, xcwe->height,
-				FALSE);
+				FALSE, 0);
 	break;
       }
     case DestroyNotify:
@@ -313,9 +432,10 @@ gdk_window_cache_filter (GdkXEvent *xev,
 	    g_hash_table_remove (cache->child_hash,
 				 GUINT_TO_POINTER (xdwe->window));
 	    cache->children = g_list_remove_link (cache->children, node);
-	    g_free (node->data);
+	    gdk_window_cache_child_free (node->data);
 	    g_list_free_1 (node);
 	  }
+	gdk_window_cache_unwatch (cache, xdwe->window);
 	break;
       }
     case MapNotify:
@@ -329,6 +449,8 @@ gdk_window_cache_filter (GdkXEvent *xev,
 	  {
 	    GdkCacheChild *child = node->data;
 	    child->mapped = TRUE;
+	    /* The client window may have changed while unmapped */
+	    gdk_window_cache_child_invalidate (child);
 	  }
 	break;
       }
@@ -354,6 +476,59 @@ gdk_window_cache_filter (GdkXEvent *xev,
   return GDK_FILTER_REMOVE;
 }
 
+/* Handles SubstructureNotify on the windows inside toplevels that
+ * the cache has descended into. These are not GDK windows, so the
+ * events come through the default filters, reported on the parent
+ * of the window that changed.
+ */
+static GdkFilterReturn
+gdk_window_cache_watch_filter (GdkXEvent *xev,
+			       GdkEvent  *event,
+			       gpointer   data)
+{
+  XEvent *xevent = (XEvent *)xev;
+  GdkWindowCache *cache = data;
+  GdkCacheWatch *watch;
+  GdkFilterReturn result;
+  GList *node;
+
+  switch (xevent->type)
+    {
+    case CirculateNotify:
+    case ConfigureNotify:
+    case CreateNotify:
+    case DestroyNotify:
+    case GravityNotify:
+    case MapNotify:
+    case ReparentNotify:
+    case UnmapNotify:
+      break;
+    default:
+      return GDK_FILTER_CONTINUE;
+    }
+
+  watch = g_hash_table_lookup (cache->watch_hash,
+			       GUINT_TO_POINTER (xevent->xany.window));
+  if (!watch)
+    return GDK_FILTER_CONTINUE;
+
+  node = g_hash_table_lookup (cache->child_hash,
+			      GUINT_TO_POINTER (watch->toplevel));
+  if (node)
+    gdk_window_cache_child_invalidate (node->data);
+
+  /* Leave the event alone if someone else asked for it */
+  if (watch->old_event_mask & SubstructureNotifyMask)
+    result = GDK_FILTER_CONTINUE;
+  else
+    result = GDK_FILTER_REMOVE;
+
+  if (xevent->type == DestroyNotify)
+    gdk_window_cache_unwatch (cache, xevent->xdestroywindow.window);
+
+  return result;
+}
+
 static GdkWindowCache *
 gdk_window_cache_new (void)
 {
@@ -368,36 +543,47 @@ gdk_window_cache_new (void)
 
   result->children = NULL;
   result->child_hash = g_hash_table_new (g_direct_hash, NULL);
+  result->watch_hash = g_hash_table_new (g_direct_hash, NULL);
+  result->hits = 0;
+  result->misses = 0;
+  result->round_trips = 0;
 
+  _gdk_round_trip ();
+  result->round_trips++;
   XGetWindowAttributes (gdk_display, gdk_root_window, &xwa);
   result->old_event_mask = xwa.your_event_mask;
   XSelectInput (gdk_display, gdk_root_window,
 		result->old_event_mask | SubstructureNotifyMask);
   gdk_window_add_filter ((GdkWindow *)&gdk_root_parent, 
 			 gdk_window_cache_filter, result);
+  gdk_window_add_filter (NULL, gdk_window_cache_watch_filter, result);
   
   gdk_error_code = 0;
   gdk_error_warnings = 0;
 
+  _gdk_round_trip ();
+  result->round_trips++;
   if (XQueryTree(gdk_display, gdk_root_window, 
 		 &root, &parent, &children, &nchildren) == 0)
-    return result;
+    {
+      gdk_error_warnings = old_warnings;
+      return result;
+    }
   
   for (i = 0; i < nchildren ; i++)
     {
+      _gdk_round_trip ();
+      result->round_trips++;
       XGetWindowAttributes (gdk_display, children[i], &xwa);
 
-      gdk_window_cache_add (result, children[i],
-			    xwa.x, xwa.y, xwa.width, xwa.height,
-			    xwa.map_state != IsUnmapped);
-
       if (gdk_error_code)
 	gdk_error_code = 0;
       else
 	{
 	  gdk_window_cache_add (result, children[i],
 				xwa.x, xwa.y, xwa.width, xwa.height,
-				(xwa.map_state != IsUnmapped));
+				(xwa.map_state != IsUnmapped),
+				xwa.your_event_mask);
 	}
     }
 
@@ -411,26 +597,43 @@ gdk_window_cache_new (void)
 static void
 gdk_window_cache_destroy (GdkWindowCache *cache)
 {
+  GDK_NOTE (DND,
+	    g_message ("window cache: %u hits, %u misses, %u round trips",
+		       cache->hits, cache->misses, cache->round_trips));
+
   XSelectInput (gdk_display, gdk_root_window, cache->old_event_mask);
   gdk_window_remove_filter ((GdkWindow *)&gdk_root_parent, 
 			    gdk_window_cache_filter, cache);
+  gdk_window_remove_filter (NULL, gdk_window_cache_watch_filter, cache);
+
+  /* Some of the watched windows may be gone by now */
+  gdk_error_trap_push ();
+  g_hash_table_foreach (cache->watch_hash,
+			gdk_window_cache_watch_restore, NULL);
+  gdk_error_trap_pop_async (NULL, NULL);
+  g_hash_table_destroy (cache->watch_hash);
 
-  g_list_foreach (cache->children, (GFunc)g_free, NULL);
+  g_list_foreach (cache->children, (GFunc)gdk_window_cache_child_free, NULL);
   g_list_free (cache->children);
   g_hash_table_destroy (cache->child_hash);
 
   g_free (cache);
 }
 
-static Window
-get_client_window_at_coords_recurse (Window  win,
-				     gint    x,
-				     gint    y)
+/* Finds out whether node is a client window, and if not, fetches
+ * its viewable InputOutput children, clipped to node. Before the
+ * children are queried, SubstructureNotify is selected on the
+ * window, so that any later change to them invalidates the
+ * toplevel. Returns FALSE if the window vanished.
+ */
+static gboolean
+gdk_window_cache_expand (GdkWindowCache *cache,
+			 GdkCacheChild  *child,
+			 GdkCacheNode   *node)
 {
   Window root, tmp_parent, *children;
   unsigned int nchildren;
   int i;
-  Window child = None;
   Atom type = None;
   int format;
   unsigned long nitems, after;
@@ -441,7 +644,9 @@ get_client_window_at_coords_recurse (Window  win,
   if (!wm_state_atom)
     wm_state_atom = gdk_atom_intern ("WM_STATE", FALSE);
     
-  XGetWindowProperty (gdk_display, win, 
+  _gdk_round_trip ();
+  cache->round_trips++;
+  XGetWindowProperty (gdk_display, node->xid, 
 		      wm_state_atom, 0, 0, False, AnyPropertyType,
 		      &type, &format, &nitems, &after, &data);
   
@@ -449,62 +654,162 @@ get_client_window_at_coords_recurse (Window  win,
     {
       gdk_error_code = 0;
 
-      return None;
+      return FALSE;
     }
 
+  node->expanded = TRUE;
+
   if (type != None)
     {
       XFree (data);
-      return win;
+      node->is_client = TRUE;
+
+      return TRUE;
     }
 
-#if 0
-  /* This is beautiful! Damn Enlightenment and click-to-focus */
-  XTranslateCoordinates (gdk_display, gdk_root_window, win,
-			 x_root, y_root, &dest_x, &dest_y, &child);
+  /* GDK's own windows can't take SubstructureNotify, since the
+   * events would reach them as changes of their own; their children
+   * are queried again on every lookup instead.
+   */
+  if (!gdk_window_lookup (node->xid))
+    {
+      if (!g_hash_table_lookup (cache->watch_hash,
+				GUINT_TO_POINTER (node->xid)))
+	{
+	  GdkCacheWatch *watch = g_new (GdkCacheWatch, 1);
+
+	  watch->xid = node->xid;
+	  watch->toplevel = child->xid;
+	  watch->old_event_mask = node->event_mask;
+	  g_hash_table_insert (cache->watch_hash,
+			       GUINT_TO_POINTER (node->xid), watch);
+
+	  XSelectInput (gdk_display, node->xid,
+			node->event_mask | SubstructureNotifyMask);
+	}
+      node->watched = TRUE;
+    }
+
+  _gdk_round_trip ();
+  cache->round_trips++;
+  if (XQueryTree(gdk_display, node->xid,
+		 &root, &tmp_parent, &children, &nchildren) == 0)
+    return FALSE;
 
   if (gdk_error_code)
     {
       gdk_error_code = 0;
+      return FALSE;
+    }
 
-      return None;
+  /* XQueryTree lists the children bottom to top */
+  for (i = 0; i < nchildren; i++)
+    {
+      XWindowAttributes xwa;
+      
+      _gdk_round_trip ();
+      cache->round_trips++;
+      XGetWindowAttributes (gdk_display, children[i], &xwa);
+      
+      if (gdk_error_code)
+	gdk_error_code = 0;
+      else if ((xwa.map_state == IsViewable) && (xwa.class == InputOutput))
+	{
+	  gint x_origin = node->x_origin + xwa.x + xwa.border_width;
+	  gint y_origin = node->y_origin + xwa.y + xwa.border_width;
+	  gint x1 = MAX (x_origin, node->x);
+	  gint y1 = MAX (y_origin, node->y);
+	  gint x2 = MIN (x_origin + xwa.width, node->x + node->width);
+	  gint y2 = MIN (y_origin + xwa.height, node->y + node->height);
+
+	  if (x1 < x2 && y1 < y2)
+	    node->children =
+	      g_slist_prepend (node->children,
+			       gdk_window_cache_node_new (children[i],
+							  x_origin, y_origin,
+							  x1, y1,
+							  x2 - x1, y2 - y1,
+							  xwa.your_event_mask));
+	}
     }
-  
-#else
-  if (XQueryTree(gdk_display, win,
-		 &root, &tmp_parent, &children, &nchildren) == 0)
-    return 0;
+      
+  XFree (children);
 
-  if (!gdk_error_code)
+  return TRUE;
+}
+
+/* Finds the client window at x, y relative to the toplevel child,
+ * descending from the toplevel along the windows under the point
+ * and querying only those not seen before. Returns None if the
+ * drop should go to the toplevel itself.
+ */
+static Window
+gdk_window_cache_lookup (GdkWindowCache *cache,
+			 GdkCacheChild  *child,
+			 gint            x,
+			 gint            y)
+{
+  GdkCacheNode *node;
+  gboolean missed = FALSE;
+  Window retval = None;
+
+  if (!child->node)
+    child->node = gdk_window_cache_node_new (child->xid, 0, 0,
+					     0, 0, child->width, child->height,
+					     child->event_mask);
+
+  node = child->node;
+  while (node)
     {
-      for (i = nchildren - 1; (i >= 0) && (child == None); i--)
+      GSList *tmp_list;
+      GdkCacheNode *next = NULL;
+
+      if (!node->expanded || (!node->is_client && !node->watched))
 	{
-	  XWindowAttributes xwa;
-	  
-	  XGetWindowAttributes (gdk_display, children[i], &xwa);
-	  
-	  if (gdk_error_code)
-	    gdk_error_code = 0;
-	  else if ((xwa.map_state == IsViewable) && (xwa.class == InputOutput) &&
-		   (x >= xwa.x) && (x < xwa.x + (gint)xwa.width) &&
-		   (y >= xwa.y) && (y < xwa.y + (gint)xwa.height))
+	  missed = TRUE;
+
+	  g_slist_foreach (node->children,
+			   (GFunc)gdk_window_cache_node_free, NULL);
+	  g_slist_free (node->children);
+	  node->children = NULL;
+	  node->is_client = FALSE;
+
+	  if (!gdk_window_cache_expand (cache, child, node))
+	    {
+	      gdk_window_cache_child_invalidate (child);
+	      cache->misses++;
+	      
+	      return None;
+	    }
+	}
+
+      if (node->is_client)
+	{
+	  retval = node->xid;
+	  break;
+	}
+
+      for (tmp_list = node->children; tmp_list; tmp_list = tmp_list->next)
+	{
+	  GdkCacheNode *tmp_node = tmp_list->data;
+
+	  if ((x >= tmp_node->x) && (x < tmp_node->x + tmp_node->width) &&
+	      (y >= tmp_node->y) && (y < tmp_node->y + tmp_node->height))
 	    {
-	      x -= xwa.x;
-	      y -= xwa.y;
-	      child = children[i];
+	      next = tmp_node;
+	      break;
 	    }
 	}
-      
-      XFree (children);
+
+      node = next;
     }
-  else
-    gdk_error_code = 0;
-#endif  
 
-  if (child)
-    return get_client_window_at_coords_recurse (child, x, y);
+  if (missed)
+    cache->misses++;
   else
-    return None;
+    cache->hits++;
+
+  return retval;
 }
 
 static Window 
@@ -532,9 +837,9 @@ get_client_window_at_coords (GdkWindowCache *cache,
 	  if ((x_root >= child->x) && (x_root < child->x + child->width) &&
 	      (y_root >= child->y) && (y_root < child->y + child->height))
 	    {
-	      retval = get_client_window_at_coords_recurse (child->xid,
-							    x_root - child->x, 
-							    y_root - child->y);
+	      retval = gdk_window_cache_lookup (cache, child,
+						x_root - child->x, 
+						y_root - child->y);
 	      if (!retval)
 		retval = child->xid;
 	    }
@@ -2116,6 +2421,70 @@ xdnd_send_xevent (Window window, gboolean propagate,
     return gdk_send_xevent (window, propagate, 0, event_send);
 }
 
+/* An Xdnd message sent to the drag destination whose outcome is
+ * not known yet.
+ */
+typedef struct {
+  GdkDragContext *context;
+  GdkWindow *dest_window;
+  gboolean sent;
+} XdndSendCheck;
+
+static void
+xdnd_send_check_result (gint     error_code,
+			gpointer data)
+{
+  XdndSendCheck *check = data;
+  GdkDragContext *context = check->context;
+
+  /* If the destination has gone away, stop sending it the rest
+   * of the drag; unless the drag has already moved on elsewhere */
+  if ((error_code || !check->sent) &&
+      context->dest_window == check->dest_window)
+    {
+      GDK_NOTE (DND, 
+		g_message ("Send event to %lx failed",
+			   GDK_WINDOW_XWINDOW (check->dest_window)));
+      gdk_window_unref (context->dest_window);
+      context->dest_window = NULL;
+    }
+
+  gdk_window_unref (check->dest_window);
+  gdk_drag_context_unref (context);
+  g_free (check);
+}
+
+/*************************************************************
+ * xdnd_send_to_dest:
+ *     Send an Xdnd message to the destination of a drag,
+ *     without waiting for the server. If it turns out that
+ *     the destination no longer exists, context->dest_window
+ *     is cleared once the error arrives.
+ *   arguments:
+ *     
+ *   results:
+ *************************************************************/
+
+static void
+xdnd_send_to_dest (GdkDragContext *context,
+		   XEvent         *event_send)
+{
+  Window window = GDK_WINDOW_XWINDOW (context->dest_window);
+  XdndSendCheck *check;
+
+  check = g_new (XdndSendCheck, 1);
+  check->context = context;
+  check->dest_window = context->dest_window;
+  gdk_drag_context_ref (check->context);
+  gdk_window_ref (check->dest_window);
+
+  gdk_error_trap_push ();
+  check->sent = XSendEvent (gdk_display, window, FALSE,
+			    window == gdk_root_window ? ButtonPressMask : 0,
+			    event_send);
+  gdk_error_trap_pop_async (xdnd_send_check_result, check);
+}
+
 static void
 xdnd_send_enter (GdkDragContext *context)
 {
@@ -2156,15 +2525,7 @@ xdnd_send_enter (GdkDragContext *context)
 	}
     }
 
-  if (!xdnd_send_xevent (GDK_WINDOW_XWINDOW (context->dest_window),
-			 FALSE, &xev))
-    {
-      GDK_NOTE (DND, 
-		g_message ("Send event to %lx failed",
-			   GDK_WINDOW_XWINDOW (context->dest_window)));
-      gdk_window_unref (context->dest_window);
-      context->dest_window = NULL;
-    }
+  xdnd_send_to_dest (context, &xev);
 }
 
 static void
@@ -2186,15 +2547,7 @@ xdnd_send_leave (GdkDragContext *context)
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  if (!xdnd_send_xevent (GDK_WINDOW_XWINDOW (context->dest_window),
-			 FALSE, &xev))
-    {
-      GDK_NOTE (DND, 
-		g_message ("Send event to %lx failed",
-			   GDK_WINDOW_XWINDOW (context->dest_window)));
-      gdk_window_unref (context->dest_window);
-      context->dest_window = NULL;
-    }
+  xdnd_send_to_dest (context, &xev);
 }
 
 static void
@@ -2215,15 +2568,7 @@ xdnd_send_drop (GdkDragContext *context, guint32 time)
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  if (!xdnd_send_xevent (GDK_WINDOW_XWINDOW (context->dest_window),
-			 FALSE, &xev))
-    {
-      GDK_NOTE (DND, 
-		g_message ("Send event to %lx failed",
-			   GDK_WINDOW_XWINDOW (context->dest_window)));
-      gdk_window_unref (context->dest_window);
-      context->dest_window = NULL;
-    }
+  xdnd_send_to_dest (context, &xev);
 }
 
 static void
@@ -2248,15 +2593,7 @@ xdnd_send_motion (GdkDragContext *context,
   xev.xclient.data.l[3] = time;
   xev.xclient.data.l[4] = xdnd_action_to_atom (action);
 
-  if (!xdnd_send_xevent (GDK_WINDOW_XWINDOW (context->dest_window),
-			 FALSE, &xev))
-    {
-      GDK_NOTE (DND, 
-		g_message ("Send event to %lx failed",
-			   GDK_WINDOW_XWINDOW (context->dest_window)));
-      gdk_window_unref (context->dest_window);
-      context->dest_window = NULL;
-    }
+  xdnd_send_to_dest (context, &xev);
   private->drag_status = GDK_DRAG_STATUS_MOTION_WAIT;
 }
 
@@ -2676,9 +3013,21 @@ xdnd_drop_filter (GdkXEvent *xev,
  ************************** Public API ***********************
  *************************************************************/
 
+/* Called when the first window is registered as a drop site or the
+ * first drag starts; before that, no drag protocol messages can be
+ * meant for us.
+ */
 void
 gdk_dnd_init (void)
 {
+  static gboolean initialized = FALSE;
+
+  if (initialized)
+    return;
+  initialized = TRUE;
+
+  _gdk_startup_phase_begin ("dnd");
+
   init_byte_order();
 
   gdk_add_client_message_filter (
@@ -2702,6 +3051,8 @@ gdk_dnd_init (void)
   gdk_add_client_message_filter (
 	gdk_atom_intern ("XdndDrop", FALSE),
 	xdnd_drop_filter, NULL);
+
+  _gdk_startup_phase_end ();
 }		      
 
 /* Source side */
@@ -2738,6 +3089,8 @@ gdk_drag_begin (GdkWindow     *window,
   
   g_return_val_if_fail (window != NULL, NULL);
 
+  gdk_dnd_init ();
+
   new_context = gdk_drag_context_new ();
   new_context->is_source = TRUE;
   new_context->source_window = window;
@@ -3242,6 +3595,8 @@ gdk_window_register_dnd (GdkWindow      *window)
 
   g_return_if_fail (window != NULL);
 
+  gdk_dnd_init ();
+
   /* Set Motif drag receiver information property */
 
   if (!motif_drag_receiver_info_atom)
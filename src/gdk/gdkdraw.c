@@ -30,6 +30,164 @@
 #include "gdkprivate.h"
 
 
+/* Batched drawing
+ *
+ * Within gdk_draw_batch_begin() and gdk_draw_batch_end(), and once
+ * enabled with gdk_draw_set_batching() or GDK_DRAW_BATCH, points,
+ * lines and rectangles are not drawn one request each. Consecutive
+ * primitives of the same kind with the same drawable and GC collect in
+ * a client side batch that goes out as a single XDrawPoints,
+ * XDrawSegments, XDrawRectangles or XFillRectangles request.
+ *
+ * The batch is sent when a primitive of another kind, drawable or GC
+ * comes in, before any other request using a GC (_gdk_gc_flush() calls
+ * _gdk_draw_batch_flush()), before a change of its GC, a clear of a
+ * window, a change of window geometry or gdk_image_get(), and at the
+ * end of the outermost batch. Destroying its
+ * drawable discards it.
+ */
+
+typedef enum
+{
+  GDK_DRAW_BATCH_NONE,
+  GDK_DRAW_BATCH_POINTS,
+  GDK_DRAW_BATCH_SEGMENTS,
+  GDK_DRAW_BATCH_RECTANGLES,
+  GDK_DRAW_BATCH_FILLED_RECTANGLES
+} GdkDrawBatchKind;
+
+#define GDK_DRAW_BATCH_SIZE 256
+
+static gboolean		draw_batching = FALSE;
+static guint		draw_batch_depth = 0;
+static GdkDrawBatchKind	draw_batch_kind = GDK_DRAW_BATCH_NONE;
+static GdkDrawable     *draw_batch_drawable = NULL;
+static GdkGC	       *draw_batch_gc = NULL;
+static gint		draw_batch_len = 0;
+static union
+{
+  XPoint     points[GDK_DRAW_BATCH_SIZE];
+  XSegment   segments[GDK_DRAW_BATCH_SIZE];
+  XRectangle rectangles[GDK_DRAW_BATCH_SIZE];
+} draw_batch;
+
+void
+gdk_draw_set_batching (gboolean batching)
+{
+  if (!batching)
+    _gdk_draw_batch_flush ();
+  draw_batching = batching != FALSE;
+}
+
+void
+gdk_draw_batch_begin (void)
+{
+  draw_batch_depth++;
+}
+
+void
+gdk_draw_batch_end (void)
+{
+  g_return_if_fail (draw_batch_depth > 0);
+
+  draw_batch_depth--;
+  if (draw_batch_depth == 0)
+    _gdk_draw_batch_flush ();
+}
+
+void
+_gdk_draw_batch_flush (void)
+{
+  GdkWindowPrivate *drawable_private;
+  GdkDrawBatchKind kind;
+  GC xgc;
+
+  if (draw_batch_kind == GDK_DRAW_BATCH_NONE)
+    return;
+
+  /* Reset first, _gdk_gc_flush() calls back here */
+  kind = draw_batch_kind;
+  draw_batch_kind = GDK_DRAW_BATCH_NONE;
+
+  drawable_private = (GdkWindowPrivate*) draw_batch_drawable;
+  xgc = _gdk_gc_flush (draw_batch_gc);
+
+  switch (kind)
+    {
+    case GDK_DRAW_BATCH_POINTS:
+      XDrawPoints (drawable_private->xdisplay, drawable_private->xwindow, xgc,
+		   draw_batch.points, draw_batch_len, CoordModeOrigin);
+      break;
+    case GDK_DRAW_BATCH_SEGMENTS:
+      XDrawSegments (drawable_private->xdisplay, drawable_private->xwindow, xgc,
+		     draw_batch.segments, draw_batch_len);
+      break;
+    case GDK_DRAW_BATCH_RECTANGLES:
+      XDrawRectangles (drawable_private->xdisplay, drawable_private->xwindow, xgc,
+		       draw_batch.rectangles, draw_batch_len);
+      break;
+    case GDK_DRAW_BATCH_FILLED_RECTANGLES:
+      XFillRectangles (drawable_private->xdisplay, drawable_private->xwindow, xgc,
+		       draw_batch.rectangles, draw_batch_len);
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+  gdk_draw_requests_sent++;
+
+  draw_batch_drawable = NULL;
+  draw_batch_gc = NULL;
+  draw_batch_len = 0;
+}
+
+void
+_gdk_draw_batch_flush_gc (GdkGC *gc)
+{
+  if (gc == draw_batch_gc)
+    _gdk_draw_batch_flush ();
+}
+
+void
+_gdk_draw_batch_discard (GdkDrawable *drawable)
+{
+  if (drawable == draw_batch_drawable)
+    {
+      draw_batch_kind = GDK_DRAW_BATCH_NONE;
+      draw_batch_drawable = NULL;
+      draw_batch_gc = NULL;
+      draw_batch_len = 0;
+    }
+}
+
+/* Returns the index of a free slot in the batch for a primitive of
+ * @kind, or -1 if the primitive has to be drawn right away.
+ */
+static gint
+gdk_draw_batch_slot (GdkDrawable      *drawable,
+		     GdkGC            *gc,
+		     GdkDrawBatchKind  kind)
+{
+  gdk_draw_requests_issued++;
+
+  if (!draw_batching || draw_batch_depth == 0)
+    return -1;
+
+  if (draw_batch_kind != kind ||
+      draw_batch_drawable != drawable ||
+      draw_batch_gc != gc ||
+      draw_batch_len == GDK_DRAW_BATCH_SIZE)
+    {
+      _gdk_draw_batch_flush ();
+
+      draw_batch_kind = kind;
+      draw_batch_drawable = drawable;
+      draw_batch_gc = gc;
+    }
+
+  return draw_batch_len++;
+}
+
+
 void
 gdk_draw_point (GdkDrawable *drawable,
                 GdkGC       *gc,
@@ -38,6 +196,7 @@ gdk_draw_point (GdkDrawable *drawable,
 {
   GdkWindowPrivate *drawable_private;
   GdkGCPrivate *gc_private;
+  gint i;
 
   g_return_if_fail (drawable != NULL);
   g_return_if_fail (gc != NULL);
@@ -45,10 +204,21 @@ gdk_draw_point (GdkDrawable *drawable,
   drawable_private = (GdkWindowPrivate*) drawable;
   if (drawable_private->destroyed)
     return;
+
+  i = gdk_draw_batch_slot (drawable, gc, GDK_DRAW_BATCH_POINTS);
+  if (i >= 0)
+    {
+      draw_batch.points[i].x = x;
+      draw_batch.points[i].y = y;
+      return;
+    }
+
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   XDrawPoint (drawable_private->xdisplay, drawable_private->xwindow,
               gc_private->xgc, x, y);
+  gdk_draw_requests_sent++;
 }
 
 void
@@ -61,6 +231,7 @@ gdk_draw_line (GdkDrawable *drawable,
 {
   GdkWindowPrivate *drawable_private;
   GdkGCPrivate *gc_private;
+  gint i;
 
   g_return_if_fail (drawable != NULL);
   g_return_if_fail (gc != NULL);
@@ -68,10 +239,23 @@ gdk_draw_line (GdkDrawable *drawable,
   drawable_private = (GdkWindowPrivate*) drawable;
   if (drawable_private->destroyed)
     return;
+
+  i = gdk_draw_batch_slot (drawable, gc, GDK_DRAW_BATCH_SEGMENTS);
+  if (i >= 0)
+    {
+      draw_batch.segments[i].x1 = x1;
+      draw_batch.segments[i].y1 = y1;
+      draw_batch.segments[i].x2 = x2;
+      draw_batch.segments[i].y2 = y2;
+      return;
+    }
+
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   XDrawLine (drawable_private->xdisplay, drawable_private->xwindow,
 	     gc_private->xgc, x1, y1, x2, y2);
+  gdk_draw_requests_sent++;
 }
 
 void
@@ -85,6 +269,7 @@ gdk_draw_rectangle (GdkDrawable *drawable,
 {
   GdkWindowPrivate *drawable_private;
   GdkGCPrivate *gc_private;
+  gint i;
 
   g_return_if_fail (drawable != NULL);
   g_return_if_fail (gc != NULL);
@@ -92,19 +277,33 @@ gdk_draw_rectangle (GdkDrawable *drawable,
   drawable_private = (GdkWindowPrivate*) drawable;
   if (drawable_private->destroyed)
     return;
-  gc_private = (GdkGCPrivate*) gc;
 
   if (width == -1)
     width = drawable_private->width;
   if (height == -1)
     height = drawable_private->height;
 
+  i = gdk_draw_batch_slot (drawable, gc,
+			   filled ? GDK_DRAW_BATCH_FILLED_RECTANGLES : GDK_DRAW_BATCH_RECTANGLES);
+  if (i >= 0)
+    {
+      draw_batch.rectangles[i].x = x;
+      draw_batch.rectangles[i].y = y;
+      draw_batch.rectangles[i].width = width;
+      draw_batch.rectangles[i].height = height;
+      return;
+    }
+
+  gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
+
   if (filled)
     XFillRectangle (drawable_private->xdisplay, drawable_private->xwindow,
 		    gc_private->xgc, x, y, width, height);
   else
     XDrawRectangle (drawable_private->xdisplay, drawable_private->xwindow,
 		    gc_private->xgc, x, y, width, height);
+  gdk_draw_requests_sent++;
 }
 
 void
@@ -128,6 +327,7 @@ gdk_draw_arc (GdkDrawable *drawable,
   if (drawable_private->destroyed)
     return;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   if (width == -1)
     width = drawable_private->width;
@@ -162,6 +362,7 @@ gdk_draw_polygon (GdkDrawable *drawable,
   if (drawable_private->destroyed)
     return;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   if (filled)
     {
@@ -223,7 +424,8 @@ gdk_draw_string (GdkDrawable *drawable,
   if (font->type == GDK_FONT_FONT)
     {
       XFontStruct *xfont = (XFontStruct *) font_private->xfont;
-      XSetFont(drawable_private->xdisplay, gc_private->xgc, xfont->fid);
+      gdk_gc_set_font (gc, font);
+      _gdk_gc_flush (gc);
       if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
 	{
 	  XDrawString (drawable_private->xdisplay, drawable_private->xwindow,
@@ -239,8 +441,11 @@ gdk_draw_string (GdkDrawable *drawable,
   else if (font->type == GDK_FONT_FONTSET)
     {
       XFontSet fontset = (XFontSet) font_private->xfont;
+      _gdk_gc_flush (gc);
       XmbDrawString (drawable_private->xdisplay, drawable_private->xwindow,
 		     fontset, gc_private->xgc, x, y, string, strlen (string));
+      /* Xlib switches the GC font behind our back */
+      gc_private->known_mask &= ~GCFont;
     }
   else
     g_error("undefined font type\n");
@@ -279,7 +484,8 @@ gdk_draw_text (GdkDrawable *drawable,
   if (font->type == GDK_FONT_FONT)
     {
       XFontStruct *xfont = (XFontStruct *) font_private->xfont;
-      XSetFont(drawable_private->xdisplay, gc_private->xgc, xfont->fid);
+      gdk_gc_set_font (gc, font);
+      _gdk_gc_flush (gc);
       if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
 	{
 	  XDrawString (drawable_private->xdisplay, drawable_private->xwindow,
@@ -294,8 +500,11 @@ gdk_draw_text (GdkDrawable *drawable,
   else if (font->type == GDK_FONT_FONTSET)
     {
       XFontSet fontset = (XFontSet) font_private->xfont;
+      _gdk_gc_flush (gc);
       XmbDrawString (drawable_private->xdisplay, drawable_private->xwindow,
 		     fontset, gc_private->xgc, x, y, text, text_length);
+      /* Xlib switches the GC font behind our back */
+      gc_private->known_mask &= ~GCFont;
     }
   else
     g_error("undefined font type\n");
@@ -339,6 +548,7 @@ gdk_draw_text_wc (GdkDrawable	 *drawable,
     }
   else if (font->type == GDK_FONT_FONTSET)
     {
+      _gdk_gc_flush (gc);
       if (sizeof(GdkWChar) == sizeof(wchar_t))
 	{
 	  XwcDrawString (drawable_private->xdisplay, drawable_private->xwindow,
@@ -356,6 +566,8 @@ gdk_draw_text_wc (GdkDrawable	 *drawable,
 			 gc_private->xgc, x, y, text_wchar, text_length);
 	  g_free (text_wchar);
 	}
+      /* Xlib switches the GC font behind our back */
+      gc_private->known_mask &= ~GCFont;
     }
   else
     g_error("undefined font type\n");
@@ -385,6 +597,7 @@ gdk_draw_pixmap (GdkDrawable *drawable,
   if (drawable_private->destroyed || src_private->destroyed)
     return;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   if (width == -1)
     width = src_private->width;
@@ -447,6 +660,7 @@ gdk_draw_points (GdkDrawable *drawable,
   if (drawable_private->destroyed)
     return;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   XDrawPoints (drawable_private->xdisplay,
 	       drawable_private->xwindow,
@@ -476,6 +690,7 @@ gdk_draw_segments (GdkDrawable *drawable,
   if (drawable_private->destroyed)
     return;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   XDrawSegments (drawable_private->xdisplay,
 		 drawable_private->xwindow,
@@ -504,6 +719,7 @@ gdk_draw_lines (GdkDrawable *drawable,
   if (drawable_private->destroyed)
     return;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   XDrawLines (drawable_private->xdisplay,
 	      drawable_private->xwindow,
@@ -24,17 +24,27 @@
  * GTK+ at ftp://ftp.gtk.org/pub/gtk/. 
  */
 
+#include "config.h"
+
 #include "gdk.h"
 #include "gdkx.h"
 #include "gdkprivate.h"
 #include "gdkkeysyms.h"
 
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #include "gdkinput.h"
 
 typedef struct _GdkIOClosure GdkIOClosure;
 typedef struct _GdkEventPrivate GdkEventPrivate;
+typedef struct _GdkPostedCall GdkPostedCall;
 
 #define DOUBLE_CLICK_TIME      250
 #define TRIPLE_CLICK_TIME      500
@@ -46,7 +56,11 @@ typedef enum
   /* Following flag is set for events on the event queue during
    * translation and cleared afterwards.
    */
-  GDK_EVENT_PENDING = 1 << 0
+  GDK_EVENT_PENDING = 1 << 0,
+
+  /* Following flag is set for events put back by gdk_event_replay().
+   */
+  GDK_EVENT_REPLAYED = 1 << 1
 } GdkEventFlags;
 
 struct _GdkIOClosure
@@ -63,6 +77,19 @@ struct _GdkEventPrivate
   guint    flags;
 };
 
+struct _GdkPostedCall
+{
+  GdkPostedCall  *next;
+  GdkThreadsFunc  func;
+  gpointer        data;
+  GDestroyNotify  notify;
+};
+
+/* The default time spent making posted calls per main loop iteration,
+ * in microseconds.
+ */
+#define POST_BUDGET		5000
+
 /* 
  * Private function declarations
  */
@@ -92,6 +119,18 @@ static gboolean  gdk_event_dispatch     (gpointer   source_data,
 					 GTimeVal  *current_time,
 					 gpointer   user_data);
 
+static void	 gdk_post_init		(void);
+static gboolean  gdk_post_prepare       (gpointer   source_data, 
+				 	 GTimeVal  *current_time,
+					 gint      *timeout,
+					 gpointer   user_data);
+static gboolean  gdk_post_check         (gpointer   source_data,
+				 	 GTimeVal  *current_time,
+					 gpointer   user_data);
+static gboolean  gdk_post_dispatch      (gpointer   source_data,
+					 GTimeVal  *current_time,
+					 gpointer   user_data);
+
 static void	 gdk_synthesize_click	(GdkEvent  *event, 
 					 gint	    nclicks);
 
@@ -139,6 +178,26 @@ static GSourceFuncs event_funcs = {
 
 GPollFD event_poll_fd;
 
+/* Calls posted with gdk_threads_post(). Other threads push onto
+ * posted_calls, a lock-free stack. The main loop takes the whole stack
+ * at once and moves it, reversed, onto pending_calls, from which the
+ * calls are made in order. A write to the wakeup fd, made whenever a
+ * call is pushed onto an empty stack, wakes up the main loop.
+ */
+static GdkPostedCall * volatile posted_calls = NULL;
+static GdkPostedCall *pending_calls = NULL;
+static guint post_budget = POST_BUDGET;
+static gint post_wakeup_fds[2] = { -1, -1 };
+
+static GSourceFuncs post_funcs = {
+  gdk_post_prepare,
+  gdk_post_check,
+  gdk_post_dispatch,
+  NULL
+};
+
+static GPollFD post_poll_fd;
+
 /*********************************************
  * Functions for maintaining the event queue *
  *********************************************/
@@ -226,6 +285,8 @@ gdk_events_init (void)
   
   g_main_add_poll (&event_poll_fd, GDK_PRIORITY_EVENTS);
 
+  gdk_post_init ();
+
   button_click_time[0] = 0;
   button_click_time[1] = 0;
   button_window[0] = NULL;
@@ -630,6 +691,17 @@ gdk_event_put (GdkEvent *event)
   gdk_event_queue_append (new_event);
 }
 
+void
+gdk_event_put_replayed (GdkEvent *event)
+{
+  GdkEvent *new_event;
+  
+  new_event = gdk_event_copy (event);
+  ((GdkEventPrivate *)new_event)->flags |= GDK_EVENT_REPLAYED;
+
+  gdk_event_queue_append (new_event);
+}
+
 /*
  *--------------------------------------------------------------
  * gdk_event_copy
@@ -1004,6 +1076,7 @@ gdk_event_translate (GdkEvent *event,
   char buf[16];
 #endif
   gint return_val;
+  gboolean origin_known;
   
   return_val = FALSE;
   
@@ -1696,6 +1769,21 @@ gdk_event_translate (GdkEvent *event,
 			   xevent->xreparent.parent,
 			   xevent->xreparent.override_redirect));
 
+      /* Once the window manager has put a toplevel into a frame,
+       * ConfigureNotify coordinates are relative to the frame.
+       */
+      if (window && !window_private->destroyed &&
+	  window_private->window_type != GDK_WINDOW_CHILD &&
+	  window_private->window_type != GDK_WINDOW_FOREIGN)
+	{
+	  window_private->reparented =
+	    xevent->xreparent.parent != gdk_root_window;
+	  gdk_window_origin_changed (window, !window_private->reparented,
+				     xevent->xreparent.x,
+				     xevent->xreparent.y,
+				     xevent->xany.serial);
+	}
+
       /* Not currently handled */
       return_val = FALSE;
       break;
@@ -1761,6 +1849,7 @@ gdk_event_translate (GdkEvent *event,
 	  event->configure.window = window;
 	  event->configure.width = xevent->xconfigure.width;
 	  event->configure.height = xevent->xconfigure.height;
+	  origin_known = FALSE;
 	  
 	  if (!xevent->xconfigure.x &&
 	      !xevent->xconfigure.y &&
@@ -1782,6 +1871,7 @@ gdk_event_translate (GdkEvent *event,
 		    {
 		      event->configure.x = tx;
 		      event->configure.y = ty;
+		      origin_known = TRUE;
 		    }
 		}
 	      else
@@ -1798,6 +1888,25 @@ gdk_event_translate (GdkEvent *event,
 	  window_private->height = xevent->xconfigure.height;
 	  if (window_private->resize_count > 1)
 	    window_private->resize_count -= 1;
+	  
+	  /* Synthetic events from the window manager are in root
+	   * coordinates (ICCCM 4.1.5), as are real ones while we
+	   * aren't reparented.
+	   */
+	  if (origin_known)
+	    gdk_window_origin_changed (window, TRUE,
+				       event->configure.x,
+				       event->configure.y,
+				       xevent->xany.serial);
+	  else
+	    gdk_window_origin_changed (window,
+				       xevent->xconfigure.send_event ||
+				       !window_private->reparented,
+				       xevent->xconfigure.x +
+				       xevent->xconfigure.border_width,
+				       xevent->xconfigure.y +
+				       xevent->xconfigure.border_width,
+				       xevent->xany.serial);
 	}
       break;
       
@@ -2139,14 +2248,22 @@ gdk_event_dispatch (gpointer  source_data,
   GDK_THREADS_ENTER ();
 
   gdk_events_queue();
+  _gdk_error_traps_dispatch ();
   event = gdk_event_unqueue();
 
   if (event)
     {
+      GDK_TRACE_BEGIN ("event", "dispatch", NULL);
+      if (!(((GdkEventPrivate *)event)->flags & GDK_EVENT_REPLAYED))
+	gdk_record_event (event);
       if (event_func)
 	(*event_func) (event, event_data);
       
+      if (((GdkEventPrivate *)event)->flags & GDK_EVENT_REPLAYED)
+	gdk_replay_event_dispatched (event);
+      
       gdk_event_free (event);
+      GDK_TRACE_END ();
     }
   
   GDK_THREADS_LEAVE ();
@@ -2154,6 +2271,202 @@ gdk_event_dispatch (gpointer  source_data,
   return TRUE;
 }
 
+/*************************************************************
+ * Calls posted from other threads
+ *************************************************************/
+
+static void
+gdk_post_init (void)
+{
+  gint i;
+
+#ifdef HAVE_SYS_EVENTFD_H
+  post_wakeup_fds[0] = eventfd (0, 0);
+  post_wakeup_fds[1] = post_wakeup_fds[0];
+  if (post_wakeup_fds[0] < 0)
+#endif
+    if (pipe (post_wakeup_fds) < 0)
+      {
+	g_warning ("Cannot create the wakeup pipe for posted calls");
+	post_wakeup_fds[0] = post_wakeup_fds[1] = -1;
+      }
+
+  /* Neither the producers nor the main loop must ever block on this. */
+  for (i = 0; i < 2; i++)
+    if (post_wakeup_fds[i] >= 0)
+      fcntl (post_wakeup_fds[i], F_SETFL,
+	     fcntl (post_wakeup_fds[i], F_GETFL) | O_NONBLOCK);
+
+  GDK_NOTE (MISC,
+	    g_message ("posted call wakeup fd: %d", post_wakeup_fds[0]));
+
+  g_source_add (GDK_PRIORITY_EVENTS, TRUE, &post_funcs, NULL, NULL, NULL);
+
+  if (post_wakeup_fds[0] >= 0)
+    {
+      post_poll_fd.fd = post_wakeup_fds[0];
+      post_poll_fd.events = G_IO_IN;
+      
+      g_main_add_poll (&post_poll_fd, GDK_PRIORITY_EVENTS);
+    }
+}
+
+static void
+gdk_post_wakeup (void)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+  guint64 value = 1;
+#else
+  gchar value = 0;
+#endif
+
+  if (post_wakeup_fds[1] < 0)
+    return;
+
+  /* If this fails because the pipe is full, the main loop is going to
+   * wake up anyway.
+   */
+  while (write (post_wakeup_fds[1], &value, sizeof (value)) < 0 &&
+	 errno == EINTR)
+    ;
+}
+
+static void
+gdk_post_clear_wakeup (void)
+{
+  gchar buffer[64];
+  gint count;
+
+  if (post_wakeup_fds[0] < 0)
+    return;
+
+  do
+    count = read (post_wakeup_fds[0], buffer, sizeof (buffer));
+  while (count > 0 || (count < 0 && errno == EINTR));
+}
+
+void
+gdk_threads_post (GdkThreadsFunc func,
+		  gpointer       data,
+		  GDestroyNotify notify)
+{
+  GdkPostedCall *call;
+  GdkPostedCall *head;
+
+  g_return_if_fail (func != NULL);
+
+  call = g_new (GdkPostedCall, 1);
+  call->func = func;
+  call->data = data;
+  call->notify = notify;
+
+  do
+    {
+      head = posted_calls;
+      call->next = head;
+    }
+  while (!__sync_bool_compare_and_swap (&posted_calls, head, call));
+
+  if (!head)
+    gdk_post_wakeup ();
+}
+
+void
+gdk_threads_set_post_budget (guint usecs)
+{
+  post_budget = usecs;
+}
+
+/* Move the posted calls onto the end of the pending list. This is only
+ * called from the main loop. The wakeup fd is cleared first, so that a
+ * call posted after the stack has been taken wakes us up again.
+ */
+static void
+gdk_post_collect (void)
+{
+  GdkPostedCall *calls, *next, *reversed = NULL;
+  GdkPostedCall **tail;
+
+  if (!posted_calls)
+    return;
+
+  gdk_post_clear_wakeup ();
+  calls = __sync_lock_test_and_set (&posted_calls, NULL);
+
+  while (calls)
+    {
+      next = calls->next;
+      calls->next = reversed;
+      reversed = calls;
+      calls = next;
+    }
+
+  tail = &pending_calls;
+  while (*tail)
+    tail = &(*tail)->next;
+  *tail = reversed;
+}
+
+static gboolean  
+gdk_post_prepare (gpointer  source_data, 
+		  GTimeVal *current_time,
+		  gint     *timeout,
+		  gpointer  user_data)
+{
+  /* Without a wakeup fd we have to poll the queue. */
+  *timeout = post_wakeup_fds[0] < 0 ? 10 : -1;
+
+  return pending_calls != NULL || posted_calls != NULL;
+}
+
+static gboolean  
+gdk_post_check (gpointer  source_data,
+		GTimeVal *current_time,
+		gpointer  user_data)
+{
+  return pending_calls != NULL || posted_calls != NULL;
+}
+
+static gboolean  
+gdk_post_dispatch (gpointer  source_data,
+		   GTimeVal *current_time,
+		   gpointer  user_data)
+{
+  GdkPostedCall *call;
+  GTimeVal now;
+  glong elapsed;
+
+  GDK_THREADS_ENTER ();
+  GDK_TRACE_BEGIN ("event", "posted_calls", NULL);
+
+  gdk_post_collect ();
+
+  while (pending_calls)
+    {
+      call = pending_calls;
+      pending_calls = call->next;
+
+      (* call->func) (call->data);
+      if (call->notify)
+	(* call->notify) (call->data);
+      g_free (call);
+
+      /* The calls left over are made in the next iteration, after the
+       * events which have come in meanwhile.
+       */
+      g_get_current_time (&now);
+      elapsed = (now.tv_sec - current_time->tv_sec) * 1000000
+	+ (now.tv_usec - current_time->tv_usec);
+      if (elapsed >= post_budget)
+	break;
+    }
+
+  GDK_TRACE_END ();
+  GDK_THREADS_LEAVE ();
+
+  return TRUE;
+}
+
 static void
 gdk_synthesize_click (GdkEvent *event,
 		      gint	nclicks)
@@ -2296,7 +2609,42 @@ gdk_event_send_clientmessage_toall (GdkEvent *event)
 void
 gdk_flush (void)
 {
+  _gdk_draw_batch_flush ();
+
+  GDK_TRACE_BEGIN ("x11", "XSync", NULL);
+  _gdk_round_trip ();
   XSync (gdk_display, False);
+  GDK_TRACE_END ();
+}
+
+/*
+ *--------------------------------------------------------------
+ * gdk_flush_output
+ *
+ *   Flushes the Xlib output buffer, without waiting for the
+ *   X server to process the requests. Use instead of
+ *   gdk_flush() when the requests only need to reach the
+ *   server, e.g. to drop a grab before doing something lengthy.
+ *   Errors can be caught without waiting with
+ *   gdk_error_trap_pop_async().
+ *
+ * Arguments:
+ *
+ * Results:
+ *
+ * Side effects:
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+gdk_flush_output (void)
+{
+  _gdk_draw_batch_flush ();
+
+  GDK_TRACE_BEGIN ("x11", "XFlush", NULL);
+  XFlush (gdk_display);
+  GDK_TRACE_END ();
 }
 
 
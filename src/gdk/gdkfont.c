@@ -28,6 +28,7 @@
 #include <X11/Xos.h>
 #include <langinfo.h>
 #include <locale.h>
+#include <stdlib.h>
 #include "gdk.h"
 #include "gdkprivate.h"
 
@@ -38,10 +39,6 @@
 #  endif
 #endif
 
-#ifdef USE_NATIVE_LOCALE
-#include <stdlib.h>
-#endif
-
 static GHashTable *font_name_hash = NULL;
 static GHashTable *fontset_name_hash = NULL;
 
@@ -49,6 +46,331 @@ static GHashTable *fontset_name_hash = NULL;
 #define FONT_IS_8BIT(private) ((FONT_XFONT(private)->min_byte1 == 0) && \
 			       (FONT_XFONT(private)->max_byte1 == 0))
 
+/* Marks a width table entry that hasn't been measured yet */
+#define GDK_FONT_WIDTH_UNKNOWN  G_MINSHORT
+
+/* Longest multibyte character whose escapement is cached */
+#define GDK_FONT_MB_SEQ_MAX     4
+
+typedef struct _GdkFontMetrics GdkFontMetrics;
+
+/* Per font cache of glyph metrics, so that measuring text doesn't need
+ * to go through Xlib (and, for fontsets, the locale converters) for
+ * every call. All entries are measured with the same Xlib call the
+ * uncached code would make for a single character, and text metrics
+ * are combined the way Xlib combines them, so results are identical.
+ */
+struct _GdkFontMetrics
+{
+  /* GDK_FONT_FONT: per glyph metrics, a page of 256 glyphs per
+   * byte1. Only page 0 exists for 8-bit fonts; pages of 16-bit fonts
+   * are filled as they are first used.
+   */
+  XCharStruct *glyphs[256];
+
+  /* GDK_FONT_FONTSET: escapement of each single byte and of multibyte
+   * characters, keyed by their packed bytes.
+   */
+  gint16 *mb_widths;
+  GHashTable *mb_seq_widths;
+  guint mb_stateful : 1;
+
+  /* gdk_char_width_wc() results, in pages of 256 keyed by code >> 8 */
+  GHashTable *wc_pages;
+};
+
+static gboolean
+gdk_font_metrics_free_page (gpointer key,
+			    gpointer value,
+			    gpointer user_data)
+{
+  g_free (value);
+  return TRUE;
+}
+
+static void
+gdk_font_metrics_free (GdkFontMetrics *metrics)
+{
+  gint i;
+
+  if (!metrics)
+    return;
+
+  for (i = 0; i < 256; i++)
+    g_free (metrics->glyphs[i]);
+  g_free (metrics->mb_widths);
+  if (metrics->mb_seq_widths)
+    g_hash_table_destroy (metrics->mb_seq_widths);
+  if (metrics->wc_pages)
+    {
+      g_hash_table_foreach_remove (metrics->wc_pages,
+				   gdk_font_metrics_free_page, NULL);
+      g_hash_table_destroy (metrics->wc_pages);
+    }
+  g_free (metrics);
+}
+
+static GdkFontMetrics *
+gdk_font_get_metrics (GdkFontPrivate *private)
+{
+  GdkFontMetrics *metrics = private->metrics;
+
+  if (!metrics)
+    {
+      metrics = g_new0 (GdkFontMetrics, 1);
+      if (private->font.type == GDK_FONT_FONTSET)
+	metrics->mb_stateful = (mblen (NULL, 0) != 0);
+      private->metrics = metrics;
+    }
+
+  return metrics;
+}
+
+/* Returns the metrics of glyph byte1/byte2 of a GDK_FONT_FONT, or NULL
+ * if Xlib would skip it as nonexistent.
+ */
+static XCharStruct *
+gdk_font_glyph_metrics (GdkFontPrivate *private,
+			guchar          byte1,
+			guchar          byte2)
+{
+  GdkFontMetrics *metrics = gdk_font_get_metrics (private);
+  XCharStruct *page = metrics->glyphs[byte1];
+  XCharStruct *cs;
+
+  if (!page)
+    {
+      XFontStruct *xfont = FONT_XFONT (private);
+      int direction, font_ascent, font_descent;
+      gint i;
+
+      page = g_new (XCharStruct, 256);
+      for (i = 0; i < 256; i++)
+	{
+	  if (FONT_IS_8BIT (private))
+	    {
+	      gchar c = i;
+
+	      XTextExtents (xfont, &c, 1,
+			    &direction, &font_ascent, &font_descent, &page[i]);
+	    }
+	  else
+	    {
+	      XChar2b c;
+
+	      c.byte1 = byte1;
+	      c.byte2 = i;
+	      XTextExtents16 (xfont, &c, 1,
+			      &direction, &font_ascent, &font_descent, &page[i]);
+	    }
+	}
+      metrics->glyphs[byte1] = page;
+    }
+
+  cs = &page[byte2];
+  if (cs->width == 0 &&
+      (cs->rbearing | cs->lbearing | cs->ascent | cs->descent) == 0)
+    return NULL;
+
+  return cs;
+}
+
+/* Equivalent of XTextExtents/XTextExtents16 using the glyph cache */
+static void
+gdk_font_text_extents (GdkFontPrivate *private,
+		       const gchar    *text,
+		       gint            text_length,
+		       XCharStruct    *overall)
+{
+  const guchar *p = (const guchar *) text;
+  gboolean is_8bit = FONT_IS_8BIT (private);
+  gint n_glyphs = is_8bit ? text_length : text_length / 2;
+  gint nfound = 0;
+  gint i;
+
+  memset (overall, 0, sizeof (XCharStruct));
+
+  for (i = 0; i < n_glyphs; i++)
+    {
+      XCharStruct *cs;
+
+      if (is_8bit)
+	cs = gdk_font_glyph_metrics (private, 0, p[i]);
+      else
+	cs = gdk_font_glyph_metrics (private, p[2 * i], p[2 * i + 1]);
+
+      if (!cs)
+	continue;
+
+      if (nfound++ == 0)
+	*overall = *cs;
+      else
+	{
+	  overall->ascent = MAX (overall->ascent, cs->ascent);
+	  overall->descent = MAX (overall->descent, cs->descent);
+	  overall->lbearing = MIN (overall->lbearing,
+				   overall->width + cs->lbearing);
+	  overall->rbearing = MAX (overall->rbearing,
+				   overall->width + cs->rbearing);
+	  overall->width += cs->width;
+	}
+    }
+}
+
+/* Equivalent of XTextWidth/XTextWidth16 using the glyph cache */
+static gint
+gdk_font_text_width (GdkFontPrivate *private,
+		     const gchar    *text,
+		     gint            text_length)
+{
+  const guchar *p = (const guchar *) text;
+  XCharStruct *cs;
+  gint width = 0;
+  gint i;
+
+  if (FONT_IS_8BIT (private))
+    {
+      for (i = 0; i < text_length; i++)
+	if ((cs = gdk_font_glyph_metrics (private, 0, p[i])))
+	  width += cs->width;
+    }
+  else
+    {
+      for (i = 0; i + 1 < text_length; i += 2)
+	if ((cs = gdk_font_glyph_metrics (private, p[i], p[i + 1])))
+	  width += cs->width;
+    }
+
+  return width;
+}
+
+/* Escapement of a single byte, as XmbTextEscapement gives it */
+static gint
+gdk_fontset_byte_width (GdkFontPrivate *private,
+			gchar           c)
+{
+  GdkFontMetrics *metrics = gdk_font_get_metrics (private);
+  gint i;
+
+  if (!metrics->mb_widths)
+    {
+      metrics->mb_widths = g_new (gint16, 256);
+      for (i = 0; i < 256; i++)
+	metrics->mb_widths[i] = GDK_FONT_WIDTH_UNKNOWN;
+    }
+
+  if (metrics->mb_widths[(guchar) c] == GDK_FONT_WIDTH_UNKNOWN)
+    metrics->mb_widths[(guchar) c] =
+      XmbTextEscapement ((XFontSet) private->xfont, &c, 1);
+
+  return metrics->mb_widths[(guchar) c];
+}
+
+/* Returns the escapement of the character text starts with and
+ * stores its length in len, or returns -1 if the character can't be
+ * split off: for stateful encodings and anything mblen() can't split.
+ * Multibyte characters are cached by their byte sequence.
+ */
+static gint
+gdk_fontset_char_width (GdkFontPrivate *private,
+			const gchar    *text,
+			gint            text_length,
+			gint           *len)
+{
+  GdkFontMetrics *metrics = gdk_font_get_metrics (private);
+  guchar c = text[0];
+  guint32 key = 0;
+  gpointer value;
+  gint j;
+
+  if (metrics->mb_stateful)
+    return -1;
+
+  /* All the stateless encodings we know about keep ASCII as is */
+  *len = (c < 0x80 && c != 0) ? 1 : mblen (text, text_length);
+
+  if (*len == 1)
+    return gdk_fontset_byte_width (private, c);
+  else if (*len < 1 || *len > GDK_FONT_MB_SEQ_MAX)
+    {
+      mblen (NULL, 0);
+      return -1;
+    }
+
+  for (j = 0; j < *len; j++)
+    key = (key << 8) | (guchar) text[j];
+
+  if (!metrics->mb_seq_widths)
+    metrics->mb_seq_widths = g_hash_table_new (g_direct_hash, NULL);
+
+  /* Values are stored offset by one so 0 means not cached */
+  value = g_hash_table_lookup (metrics->mb_seq_widths, GUINT_TO_POINTER (key));
+  if (!value)
+    {
+      value = GINT_TO_POINTER (XmbTextEscapement ((XFontSet) private->xfont,
+						  text, *len) + 1);
+      g_hash_table_insert (metrics->mb_seq_widths,
+			   GUINT_TO_POINTER (key), value);
+    }
+
+  return GPOINTER_TO_INT (value) - 1;
+}
+
+/* Equivalent of XmbTextEscapement. The escapement of a string is the
+ * sum of the escapements of its characters, so those are cached.
+ * Anything gdk_fontset_char_width() can't split goes to Xlib
+ * directly.
+ */
+static gint
+gdk_fontset_text_width (GdkFontPrivate *private,
+			const gchar    *text,
+			gint            text_length)
+{
+  gint width = 0;
+  gint char_width;
+  gint len;
+  gint i = 0;
+
+  while (i < text_length)
+    {
+      char_width = gdk_fontset_char_width (private, text + i,
+					   text_length - i, &len);
+      if (char_width < 0)
+	return XmbTextEscapement ((XFontSet) private->xfont, text, text_length);
+
+      width += char_width;
+      i += len;
+    }
+
+  return width;
+}
+
+static gint16 *
+gdk_font_wc_page (GdkFontPrivate *private,
+		  GdkWChar        character)
+{
+  GdkFontMetrics *metrics = gdk_font_get_metrics (private);
+  gint16 *page;
+
+  if (!metrics->wc_pages)
+    metrics->wc_pages = g_hash_table_new (g_direct_hash, NULL);
+
+  page = g_hash_table_lookup (metrics->wc_pages,
+			      GUINT_TO_POINTER (character >> 8));
+  if (!page)
+    {
+      gint i;
+
+      page = g_new (gint16, 256);
+      for (i = 0; i < 256; i++)
+	page[i] = GDK_FONT_WIDTH_UNKNOWN;
+      g_hash_table_insert (metrics->wc_pages,
+			   GUINT_TO_POINTER (character >> 8), page);
+    }
+
+  return page;
+}
+
 static void
 gdk_font_hash_insert (GdkFontType type, GdkFont *font, const gchar *font_name)
 {
@@ -136,6 +458,7 @@ gdk_font_load (const gchar *font_name)
       private->xfont = xfont;
       private->ref_count = 1;
       private->names = NULL;
+      private->metrics = NULL;
  
       font = (GdkFont*) private;
       font->type = GDK_FONT_FONT;
@@ -225,6 +548,7 @@ gdk_fontset_load (const gchar *fontset_name)
 	}
 
       private->names = NULL;
+      private->metrics = NULL;
       gdk_font_hash_insert (GDK_FONT_FONTSET, font, fontset_name);
       
       return font;
@@ -270,6 +594,7 @@ gdk_font_unref (GdkFont *font)
 	  g_error ("unknown font type.");
 	  break;
 	}
+      gdk_font_metrics_free (private->metrics);
       g_free (font);
     }
 }
@@ -329,38 +654,10 @@ gint
 gdk_string_width (GdkFont     *font,
 		  const gchar *string)
 {
-  GdkFontPrivate *font_private;
-  gint width;
-  XFontStruct *xfont;
-  XFontSet fontset;
-
   g_return_val_if_fail (font != NULL, -1);
   g_return_val_if_fail (string != NULL, -1);
 
-  font_private = (GdkFontPrivate*) font;
-
-  switch (font->type)
-    {
-    case GDK_FONT_FONT:
-      xfont = (XFontStruct *) font_private->xfont;
-      if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
-	{
-	  width = XTextWidth (xfont, string, strlen (string));
-	}
-      else
-	{
-	  width = XTextWidth16 (xfont, (XChar2b *) string, strlen (string) / 2);
-	}
-      break;
-    case GDK_FONT_FONTSET:
-      fontset = (XFontSet) font_private->xfont;
-      width = XmbTextEscapement (fontset, string, strlen(string));
-      break;
-    default:
-      width = 0;
-    }
-
-  return width;
+  return gdk_text_width (font, string, strlen (string));
 }
 
 gint
@@ -370,8 +667,6 @@ gdk_text_width (GdkFont      *font,
 {
   GdkFontPrivate *private;
   gint width;
-  XFontStruct *xfont;
-  XFontSet fontset;
 
   g_return_val_if_fail (font != NULL, -1);
   g_return_val_if_fail (text != NULL, -1);
@@ -381,19 +676,10 @@ gdk_text_width (GdkFont      *font,
   switch (font->type)
     {
     case GDK_FONT_FONT:
-      xfont = (XFontStruct *) private->xfont;
-      if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
-	{
-	  width = XTextWidth (xfont, text, text_length);
-	}
-      else
-	{
-	  width = XTextWidth16 (xfont, (XChar2b *) text, text_length / 2);
-	}
+      width = gdk_font_text_width (private, text, text_length);
       break;
     case GDK_FONT_FONTSET:
-      fontset = (XFontSet) private->xfont;
-      width = XmbTextEscapement (fontset, text, text_length);
+      width = gdk_fontset_text_width (private, text, text_length);
       break;
     default:
       width = 0;
@@ -406,15 +692,11 @@ gdk_text_width_wc (GdkFont	  *font,
 		   const GdkWChar *text,
 		   gint		   text_length)
 {
-  GdkFontPrivate *private;
   gint width;
-  XFontSet fontset;
 
   g_return_val_if_fail (font != NULL, -1);
   g_return_val_if_fail (text != NULL, -1);
 
-  private = (GdkFontPrivate*) font;
-
   switch (font->type)
     {
     case GDK_FONT_FONT:
@@ -434,21 +716,8 @@ gdk_text_width_wc (GdkFont	  *font,
 	break;
       }
     case GDK_FONT_FONTSET:
-      if (sizeof(GdkWChar) == sizeof(wchar_t))
-	{
-	  fontset = (XFontSet) private->xfont;
-	  width = XwcTextEscapement (fontset, (wchar_t *)text, text_length);
-	}
-      else
-	{
-	  wchar_t *text_wchar;
-	  gint i;
-	  fontset = (XFontSet) private->xfont;
-	  text_wchar = g_new(wchar_t, text_length);
-	  for (i=0; i<text_length; i++) text_wchar[i] = text[i];
-	  width = XwcTextEscapement (fontset, text_wchar, text_length);
-	  g_free (text_wchar);
-	}
+      /* Escapements add up, so sum the cached per character ones */
+      width = gdk_text_widths_wc (font, text, text_length, NULL);
       break;
     default:
       width = 0;
@@ -463,8 +732,7 @@ gdk_char_width (GdkFont *font,
 {
   GdkFontPrivate *private;
   gint width;
-  XFontStruct *xfont;
-  XFontSet fontset;
+  XCharStruct *cs;
 
   g_return_val_if_fail (font != NULL, -1);
 
@@ -474,12 +742,16 @@ gdk_char_width (GdkFont *font,
     {
     case GDK_FONT_FONT:
       /* only 8 bits characters are considered here */
-      xfont = (XFontStruct *) private->xfont;
-      width = XTextWidth (xfont, &character, 1);
+      if (FONT_IS_8BIT (private))
+	{
+	  cs = gdk_font_glyph_metrics (private, 0, (guchar) character);
+	  width = cs ? cs->width : 0;
+	}
+      else
+	width = XTextWidth ((XFontStruct *) private->xfont, &character, 1);
       break;
     case GDK_FONT_FONTSET:
-      fontset = (XFontSet) private->xfont;
-      width = XmbTextEscapement (fontset, &character, 1) ;
+      width = gdk_fontset_byte_width (private, character);
       break;
     default:
       width = 0;
@@ -487,16 +759,14 @@ gdk_char_width (GdkFont *font,
   return width;
 }
 
-gint
-gdk_char_width_wc (GdkFont *font,
-		   GdkWChar character)
+static gint
+gdk_char_width_wc_uncached (GdkFont *font,
+			    GdkWChar character)
 {
   GdkFontPrivate *private;
   gint width;
   XFontSet fontset;
 
-  g_return_val_if_fail (font != NULL, -1);
-
   private = (GdkFontPrivate*) font;
 
   switch (font->type)
@@ -539,6 +809,131 @@ gdk_char_width_wc (GdkFont *font,
   return width;
 }
 
+gint
+gdk_char_width_wc (GdkFont *font,
+		   GdkWChar character)
+{
+  gint16 *page;
+
+  g_return_val_if_fail (font != NULL, -1);
+
+  page = gdk_font_wc_page ((GdkFontPrivate*) font, character);
+  if (page[character & 0xff] == GDK_FONT_WIDTH_UNKNOWN)
+    page[character & 0xff] = gdk_char_width_wc_uncached (font, character);
+
+  return page[character & 0xff];
+}
+
+/* Stores the width of each byte of text in widths (if not NULL) and
+ * returns their sum, which is what gdk_text_width() returns. A
+ * character of a 16 bit font or a multibyte character of a fontset
+ * has its width stored at its first byte, and its other bytes get 0;
+ * where fontset text can't be split into characters, the width of the
+ * rest of it goes to the first byte of the rest. Once the font
+ * metrics are cached this makes no X or locale calls.
+ */
+gint
+gdk_text_widths (GdkFont     *font,
+		 const gchar *text,
+		 gint         text_length,
+		 gint        *widths)
+{
+  const guchar *p = (const guchar *) text;
+  GdkFontPrivate *private;
+  XCharStruct *cs;
+  gint total = 0;
+  gint width;
+  gint len;
+  gint i, j;
+
+  g_return_val_if_fail (font != NULL, -1);
+  g_return_val_if_fail (text != NULL, -1);
+
+  private = (GdkFontPrivate*) font;
+
+  for (i = 0; i < text_length; i += len)
+    {
+      len = 1;
+      if (font->type == GDK_FONT_FONTSET)
+	{
+	  width = gdk_fontset_char_width (private, text + i,
+					  text_length - i, &len);
+	  if (width < 0)
+	    {
+	      len = text_length - i;
+	      width = XmbTextEscapement ((XFontSet) private->xfont,
+					 text + i, len);
+	    }
+	}
+      else if (font->type != GDK_FONT_FONT)
+	width = 0;
+      else if (FONT_IS_8BIT (private))
+	{
+	  cs = gdk_font_glyph_metrics (private, 0, p[i]);
+	  width = cs ? cs->width : 0;
+	}
+      else
+	{
+	  /* Glyphs are byte pairs; like gdk_font_text_width(), a
+	   * trailing odd byte has no width */
+	  len = MIN (2, text_length - i);
+	  cs = len == 2 ? gdk_font_glyph_metrics (private, p[i], p[i + 1]) : NULL;
+	  width = cs ? cs->width : 0;
+	}
+
+      if (widths)
+	{
+	  widths[i] = width;
+	  for (j = 1; j < len; j++)
+	    widths[i + j] = 0;
+	}
+      total += width;
+    }
+
+  return total;
+}
+
+/* Like gdk_text_widths(), for wide characters and gdk_char_width_wc() */
+gint
+gdk_text_widths_wc (GdkFont        *font,
+		    const GdkWChar *text,
+		    gint            text_length,
+		    gint           *widths)
+{
+  GdkFontPrivate *private;
+  gint16 *page = NULL;
+  GdkWChar page_index = 0;
+  gint total = 0;
+  gint width;
+  gint i;
+
+  g_return_val_if_fail (font != NULL, -1);
+  g_return_val_if_fail (text != NULL, -1);
+
+  private = (GdkFontPrivate*) font;
+
+  for (i = 0; i < text_length; i++)
+    {
+      if (!page || (text[i] >> 8) != page_index)
+	{
+	  page = gdk_font_wc_page (private, text[i]);
+	  page_index = text[i] >> 8;
+	}
+
+      width = page[text[i] & 0xff];
+      if (width == GDK_FONT_WIDTH_UNKNOWN)
+	{
+	  width = gdk_char_width_wc_uncached (font, text[i]);
+	  page[text[i] & 0xff] = width;
+	}
+      if (widths)
+	widths[i] = width;
+      total += width;
+    }
+
+  return total;
+}
+
 gint
 gdk_string_measure (GdkFont     *font,
                     const gchar *string)
@@ -561,12 +956,8 @@ gdk_text_extents (GdkFont     *font,
 {
   GdkFontPrivate *private;
   XCharStruct overall;
-  XFontStruct *xfont;
   XFontSet    fontset;
   XRectangle  ink, logical;
-  int direction;
-  int font_ascent;
-  int font_descent;
 
   g_return_if_fail (font != NULL);
   g_return_if_fail (text != NULL);
@@ -576,19 +967,7 @@ gdk_text_extents (GdkFont     *font,
   switch (font->type)
     {
     case GDK_FONT_FONT:
-      xfont = (XFontStruct *) private->xfont;
-      if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
-	{
-	  XTextExtents (xfont, text, text_length,
-			&direction, &font_ascent, &font_descent,
-			&overall);
-	}
-      else
-	{
-	  XTextExtents16 (xfont, (XChar2b *) text, text_length / 2,
-			  &direction, &font_ascent, &font_descent,
-			  &overall);
-	}
+      gdk_font_text_extents (private, text, text_length, &overall);
       if (lbearing)
 	*lbearing = overall.lbearing;
       if (rbearing)
@@ -722,12 +1101,8 @@ gdk_text_measure (GdkFont     *font,
 {
   GdkFontPrivate *private;
   XCharStruct overall;
-  XFontStruct *xfont;
   XFontSet    fontset;
   XRectangle  ink, log;
-  int direction;
-  int font_ascent;
-  int font_descent;
   gint width;
 
   g_return_val_if_fail (font != NULL, -1);
@@ -738,19 +1113,7 @@ gdk_text_measure (GdkFont     *font,
   switch (font->type)
     {
     case GDK_FONT_FONT:
-      xfont = (XFontStruct *) private->xfont;
-      if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
-	{
-	  XTextExtents (xfont, text, text_length,
-			&direction, &font_ascent, &font_descent,
-			&overall);
-	}
-      else
-	{
-	  XTextExtents16 (xfont, (XChar2b *) text, text_length / 2,
-			  &direction, &font_ascent, &font_descent,
-			  &overall);
-	}
+      gdk_font_text_extents (private, text, text_length, &overall);
       width = overall.rbearing;
       break;
     case GDK_FONT_FONTSET:
@@ -790,12 +1153,8 @@ gdk_text_height (GdkFont     *font,
 {
   GdkFontPrivate *private;
   XCharStruct overall;
-  XFontStruct *xfont;
   XFontSet    fontset;
   XRectangle  ink, log;
-  int direction;
-  int font_ascent;
-  int font_descent;
   gint height;
 
   g_return_val_if_fail (font != NULL, -1);
@@ -806,19 +1165,7 @@ gdk_text_height (GdkFont     *font,
   switch (font->type)
     {
     case GDK_FONT_FONT:
-      xfont = (XFontStruct *) private->xfont;
-      if ((xfont->min_byte1 == 0) && (xfont->max_byte1 == 0))
-	{
-	  XTextExtents (xfont, text, text_length,
-			&direction, &font_ascent, &font_descent,
-			&overall);
-	}
-      else
-	{
-	  XTextExtents16 (xfont, (XChar2b *) text, text_length / 2,
-			  &direction, &font_ascent, &font_descent,
-			  &overall);
-	}
+      gdk_font_text_extents (private, text, text_length, &overall);
       height = overall.ascent + overall.descent;
       break;
     case GDK_FONT_FONTSET:
@@ -30,6 +30,149 @@
 #include "gdkprivate.h"
 
 
+/* GC components shadowed on the client side. The font, tile and
+ * stipple have no known server default and become known once set.
+ */
+#define GDK_GC_SHADOW_MASK  (GCFunction | GCForeground | GCBackground | \
+			     GCLineWidth | GCLineStyle | GCCapStyle | \
+			     GCJoinStyle | GCFillStyle | GCTile | GCStipple | \
+			     GCTileStipXOrigin | GCTileStipYOrigin | GCFont | \
+			     GCSubwindowMode | GCGraphicsExposures | \
+			     GCClipXOrigin | GCClipYOrigin)
+
+#define GDK_GC_UPDATE_VALUE(private, xvalues, mask, changed, bit, field) \
+  G_STMT_START {							  \
+    if (((mask) & (bit)) &&						  \
+	(!((private)->known_mask & (bit)) ||				  \
+	 (private)->values.field != (xvalues)->field))			  \
+      {									  \
+	(private)->values.field = (xvalues)->field;			  \
+	(changed) |= (bit);						  \
+      }									  \
+  } G_STMT_END
+
+static void
+gdk_gc_update_values (GdkGCPrivate  *private,
+		      XGCValues     *xvalues,
+		      unsigned long  mask)
+{
+  unsigned long changed = 0;
+
+  _gdk_draw_batch_flush_gc ((GdkGC*) private);
+
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCFunction, function);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCForeground, foreground);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCBackground, background);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCLineWidth, line_width);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCLineStyle, line_style);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCCapStyle, cap_style);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCJoinStyle, join_style);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCFillStyle, fill_style);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCTile, tile);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCStipple, stipple);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCTileStipXOrigin, ts_x_origin);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCTileStipYOrigin, ts_y_origin);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCFont, font);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCSubwindowMode, subwindow_mode);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCGraphicsExposures, graphics_exposures);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCClipXOrigin, clip_x_origin);
+  GDK_GC_UPDATE_VALUE (private, xvalues, mask, changed, GCClipYOrigin, clip_y_origin);
+
+  private->known_mask |= mask;
+  private->dirty_mask |= changed;
+}
+
+/* Records a change of the clip. The change is dropped if it matches
+ * what the server already has.
+ */
+static void
+gdk_gc_update_clip (GdkGCPrivate *private,
+		    GdkGCClipType clip_type,
+		    GdkRectangle *rectangle,
+		    Pixmap        pixmap)
+{
+  _gdk_draw_batch_flush_gc ((GdkGC*) private);
+
+  private->clip_type = clip_type;
+  if (rectangle)
+    private->clip_rect = *rectangle;
+  private->clip_pixmap = pixmap;
+
+  if (private->server_clip_type != clip_type)
+    private->clip_dirty = TRUE;
+  else
+    switch (clip_type)
+      {
+      case GDK_GC_CLIP_NONE:
+	private->clip_dirty = FALSE;
+	break;
+      case GDK_GC_CLIP_RECTANGLE:
+	private->clip_dirty =
+	  (private->clip_rect.x != private->server_clip_rect.x ||
+	   private->clip_rect.y != private->server_clip_rect.y ||
+	   private->clip_rect.width != private->server_clip_rect.width ||
+	   private->clip_rect.height != private->server_clip_rect.height);
+	break;
+      case GDK_GC_CLIP_PIXMAP:
+	private->clip_dirty = (private->clip_pixmap != private->server_clip_pixmap);
+	break;
+      default:
+	private->clip_dirty = TRUE;
+	break;
+      }
+}
+
+GC
+_gdk_gc_flush (GdkGC *gc)
+{
+  GdkGCPrivate *private = (GdkGCPrivate*) gc;
+  XRectangle xrectangle;
+
+  _gdk_draw_batch_flush ();
+
+  if (private->clip_dirty)
+    {
+      switch (private->clip_type)
+	{
+	case GDK_GC_CLIP_RECTANGLE:
+	  xrectangle.x = private->clip_rect.x;
+	  xrectangle.y = private->clip_rect.y;
+	  xrectangle.width = private->clip_rect.width;
+	  xrectangle.height = private->clip_rect.height;
+
+	  /* This sets the clip origin as well */
+	  XSetClipRectangles (private->xdisplay, private->xgc,
+			      private->values.clip_x_origin,
+			      private->values.clip_y_origin,
+			      &xrectangle, 1, Unsorted);
+	  private->dirty_mask &= ~(GCClipXOrigin | GCClipYOrigin);
+	  break;
+	case GDK_GC_CLIP_PIXMAP:
+	  XSetClipMask (private->xdisplay, private->xgc, private->clip_pixmap);
+	  break;
+	default:
+	  XSetClipMask (private->xdisplay, private->xgc, None);
+	  break;
+	}
+
+      private->server_clip_type = private->clip_type;
+      private->server_clip_rect = private->clip_rect;
+      private->server_clip_pixmap = private->clip_pixmap;
+      private->clip_dirty = FALSE;
+      gdk_gc_requests_sent++;
+    }
+
+  if (private->dirty_mask)
+    {
+      XChangeGC (private->xdisplay, private->xgc,
+		 private->dirty_mask, &private->values);
+      private->dirty_mask = 0;
+      gdk_gc_requests_sent++;
+    }
+
+  return private->xgc;
+}
+
 GdkGC*
 gdk_gc_new (GdkWindow *window)
 {
@@ -61,6 +204,26 @@ gdk_gc_new_with_values (GdkWindow	*window,
   private->xdisplay = window_private->xdisplay;
   private->ref_count = 1;
 
+  private->dirty_mask = 0;
+  private->clip_type = GDK_GC_CLIP_NONE;
+  private->clip_pixmap = None;
+  private->clip_dirty = FALSE;
+
+  /* Protocol defaults, so that the shadow starts out valid */
+  xvalues.foreground = 0;
+  xvalues.background = 1;
+  xvalues.line_width = 0;
+  xvalues.line_style = LineSolid;
+  xvalues.cap_style = CapButt;
+  xvalues.join_style = JoinMiter;
+  xvalues.tile = None;
+  xvalues.stipple = None;
+  xvalues.font = None;
+  xvalues.ts_x_origin = 0;
+  xvalues.ts_y_origin = 0;
+  xvalues.clip_x_origin = 0;
+  xvalues.clip_y_origin = 0;
+
   xvalues.function = GXcopy;
   xvalues.fill_style = FillSolid;
   xvalues.arc_mode = ArcPieSlice;
@@ -168,6 +331,8 @@ gdk_gc_new_with_values (GdkWindow	*window,
     {
       xvalues.clip_mask = ((GdkPixmapPrivate*) values->clip_mask)->xwindow;
       xvalues_mask |= GCClipMask;
+      private->clip_type = GDK_GC_CLIP_PIXMAP;
+      private->clip_pixmap = xvalues.clip_mask;
     }
   if (values_mask & GDK_GC_SUBWINDOW)
     {
@@ -260,6 +425,12 @@ gdk_gc_new_with_values (GdkWindow	*window,
 
   private->xgc = XCreateGC (private->xdisplay, xwindow, xvalues_mask, &xvalues);
 
+  private->values = xvalues;
+  private->known_mask = (GDK_GC_SHADOW_MASK & ~(GCFont | GCTile | GCStipple)) |
+			(xvalues_mask & GDK_GC_SHADOW_MASK);
+  private->server_clip_type = private->clip_type;
+  private->server_clip_pixmap = private->clip_pixmap;
+
   return gc;
 }
 
@@ -292,6 +463,7 @@ gdk_gc_unref (GdkGC *gc)
     private->ref_count -= 1;
   else
     {
+      _gdk_draw_batch_flush_gc (gc);
       XFreeGC (private->xdisplay, private->xgc);
       memset (gc, 0, sizeof (GdkGCPrivate));
       g_free (gc);
@@ -310,6 +482,7 @@ gdk_gc_get_values (GdkGC       *gc,
 
   private = (GdkGCPrivate*) gc;
 
+  _gdk_gc_flush (gc);
   if (XGetGCValues (private->xdisplay, private->xgc,
 		    GCForeground | GCBackground | GCFont |
 		    GCFunction | GCTile | GCStipple | /* GCClipMask | */
@@ -452,12 +625,15 @@ gdk_gc_set_foreground (GdkGC	*gc,
 		       GdkColor *color)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
   g_return_if_fail (color != NULL);
 
   private = (GdkGCPrivate*) gc;
-  XSetForeground (private->xdisplay, private->xgc, color->pixel);
+  xvalues.foreground = color->pixel;
+  gdk_gc_update_values (private, &xvalues, GCForeground);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -465,12 +641,15 @@ gdk_gc_set_background (GdkGC	*gc,
 		       GdkColor *color)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
   g_return_if_fail (color != NULL);
 
   private = (GdkGCPrivate*) gc;
-  XSetBackground (private->xdisplay, private->xgc, color->pixel);
+  xvalues.background = color->pixel;
+  gdk_gc_update_values (private, &xvalues, GCBackground);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -479,6 +658,7 @@ gdk_gc_set_font (GdkGC	 *gc,
 {
   GdkGCPrivate *gc_private;
   GdkFontPrivate *font_private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
   g_return_if_fail (font != NULL);
@@ -488,8 +668,9 @@ gdk_gc_set_font (GdkGC	 *gc,
       gc_private = (GdkGCPrivate*) gc;
       font_private = (GdkFontPrivate*) font;
       
-      XSetFont (gc_private->xdisplay, gc_private->xgc,
-		((XFontStruct *) font_private->xfont)->fid);
+      xvalues.font = ((XFontStruct *) font_private->xfont)->fid;
+      gdk_gc_update_values (gc_private, &xvalues, GCFont);
+      gdk_gc_requests_issued++;
     }
 }
 
@@ -498,6 +679,7 @@ gdk_gc_set_function (GdkGC	 *gc,
 		     GdkFunction  function)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
@@ -506,51 +688,56 @@ gdk_gc_set_function (GdkGC	 *gc,
   switch (function)
     {
     case GDK_COPY:
-      XSetFunction (private->xdisplay, private->xgc, GXcopy);
+      xvalues.function = GXcopy;
       break;
     case GDK_INVERT:
-      XSetFunction (private->xdisplay, private->xgc, GXinvert);
+      xvalues.function = GXinvert;
       break;
     case GDK_XOR:
-      XSetFunction (private->xdisplay, private->xgc, GXxor);
+      xvalues.function = GXxor;
       break;
     case GDK_CLEAR:
-      XSetFunction (private->xdisplay, private->xgc, GXclear);
+      xvalues.function = GXclear;
       break;
     case GDK_AND:
-      XSetFunction (private->xdisplay, private->xgc, GXand);
+      xvalues.function = GXand;
       break;
     case GDK_AND_REVERSE:
-      XSetFunction (private->xdisplay, private->xgc, GXandReverse);
+      xvalues.function = GXandReverse;
       break;
     case GDK_AND_INVERT:
-      XSetFunction (private->xdisplay, private->xgc, GXandInverted);
+      xvalues.function = GXandInverted;
       break;
     case GDK_NOOP:
-      XSetFunction (private->xdisplay, private->xgc, GXnoop);
+      xvalues.function = GXnoop;
       break;
     case GDK_OR:
-      XSetFunction (private->xdisplay, private->xgc, GXor);
+      xvalues.function = GXor;
       break;
     case GDK_EQUIV:
-      XSetFunction (private->xdisplay, private->xgc, GXequiv);
+      xvalues.function = GXequiv;
       break;
     case GDK_OR_REVERSE:
-      XSetFunction (private->xdisplay, private->xgc, GXorReverse);
+      xvalues.function = GXorReverse;
       break;
     case GDK_COPY_INVERT:
-      XSetFunction (private->xdisplay, private->xgc, GXcopyInverted);
+      xvalues.function = GXcopyInverted;
       break;
     case GDK_OR_INVERT:
-      XSetFunction (private->xdisplay, private->xgc, GXorInverted);
+      xvalues.function = GXorInverted;
       break;
     case GDK_NAND:
-      XSetFunction (private->xdisplay, private->xgc, GXnand);
+      xvalues.function = GXnand;
       break;
     case GDK_SET:
-      XSetFunction (private->xdisplay, private->xgc, GXset);
+      xvalues.function = GXset;
       break;
+    default:
+      return;
     }
+
+  gdk_gc_update_values (private, &xvalues, GCFunction);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -558,6 +745,7 @@ gdk_gc_set_fill (GdkGC	 *gc,
 		 GdkFill  fill)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
@@ -566,18 +754,23 @@ gdk_gc_set_fill (GdkGC	 *gc,
   switch (fill)
     {
     case GDK_SOLID:
-      XSetFillStyle (private->xdisplay, private->xgc, FillSolid);
+      xvalues.fill_style = FillSolid;
       break;
     case GDK_TILED:
-      XSetFillStyle (private->xdisplay, private->xgc, FillTiled);
+      xvalues.fill_style = FillTiled;
       break;
     case GDK_STIPPLED:
-      XSetFillStyle (private->xdisplay, private->xgc, FillStippled);
+      xvalues.fill_style = FillStippled;
       break;
     case GDK_OPAQUE_STIPPLED:
-      XSetFillStyle (private->xdisplay, private->xgc, FillOpaqueStippled);
+      xvalues.fill_style = FillOpaqueStippled;
       break;
+    default:
+      return;
     }
+
+  gdk_gc_update_values (private, &xvalues, GCFillStyle);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -587,6 +780,7 @@ gdk_gc_set_tile (GdkGC	   *gc,
   GdkGCPrivate *private;
   GdkPixmapPrivate *pixmap_private;
   Pixmap pixmap;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
@@ -599,7 +793,9 @@ gdk_gc_set_tile (GdkGC	   *gc,
       pixmap = pixmap_private->xwindow;
     }
 
-  XSetTile (private->xdisplay, private->xgc, pixmap);
+  xvalues.tile = pixmap;
+  gdk_gc_update_values (private, &xvalues, GCTile);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -609,6 +805,7 @@ gdk_gc_set_stipple (GdkGC     *gc,
   GdkGCPrivate *private;
   GdkPixmapPrivate *pixmap_private;
   Pixmap pixmap;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
@@ -621,7 +818,9 @@ gdk_gc_set_stipple (GdkGC     *gc,
       pixmap = pixmap_private->xwindow;
     }
 
-  XSetStipple (private->xdisplay, private->xgc, pixmap);
+  xvalues.stipple = pixmap;
+  gdk_gc_update_values (private, &xvalues, GCStipple);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -630,12 +829,17 @@ gdk_gc_set_ts_origin (GdkGC *gc,
 		      gint   y)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
   private = (GdkGCPrivate*) gc;
 
-  XSetTSOrigin (private->xdisplay, private->xgc, x, y);
+  xvalues.ts_x_origin = x;
+  xvalues.ts_y_origin = y;
+  gdk_gc_update_values (private, &xvalues,
+			GCTileStipXOrigin | GCTileStipYOrigin);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -644,12 +848,16 @@ gdk_gc_set_clip_origin (GdkGC *gc,
 			gint   y)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
   private = (GdkGCPrivate*) gc;
 
-  XSetClipOrigin (private->xdisplay, private->xgc, x, y);
+  xvalues.clip_x_origin = x;
+  xvalues.clip_y_origin = y;
+  gdk_gc_update_values (private, &xvalues, GCClipXOrigin | GCClipYOrigin);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -675,7 +883,10 @@ gdk_gc_set_clip_mask (GdkGC	*gc,
   
   private = (GdkGCPrivate*) gc;
 
-  XSetClipMask (private->xdisplay, private->xgc, xmask);
+  gdk_gc_update_clip (private,
+		      xmask != None ? GDK_GC_CLIP_PIXMAP : GDK_GC_CLIP_NONE,
+		      NULL, xmask);
+  gdk_gc_requests_issued++;
 }
 
 
@@ -684,7 +895,7 @@ gdk_gc_set_clip_rectangle (GdkGC	*gc,
 			   GdkRectangle *rectangle)
 {
   GdkGCPrivate *private;
-  XRectangle xrectangle;
+  XGCValues xvalues;
    
   g_return_if_fail (gc != NULL);
 
@@ -692,16 +903,15 @@ gdk_gc_set_clip_rectangle (GdkGC	*gc,
 
   if (rectangle)
     {
-      xrectangle.x = rectangle->x; 
-      xrectangle.y = rectangle->y;
-      xrectangle.width = rectangle->width;
-      xrectangle.height = rectangle->height;
-      
-      XSetClipRectangles (private->xdisplay, private->xgc, 0, 0,
-			  &xrectangle, 1, Unsorted);
+      /* Setting clip rectangles resets the clip origin */
+      xvalues.clip_x_origin = 0;
+      xvalues.clip_y_origin = 0;
+      gdk_gc_update_values (private, &xvalues, GCClipXOrigin | GCClipYOrigin);
+      gdk_gc_update_clip (private, GDK_GC_CLIP_RECTANGLE, rectangle, None);
     }
   else
-    XSetClipMask (private->xdisplay, private->xgc, None);
+    gdk_gc_update_clip (private, GDK_GC_CLIP_NONE, NULL, None);
+  gdk_gc_requests_issued++;
 } 
 
 void
@@ -719,10 +929,22 @@ gdk_gc_set_clip_region (GdkGC		 *gc,
       GdkRegionPrivate *region_private;
 
       region_private = (GdkRegionPrivate*) region;
+      _gdk_draw_batch_flush_gc (gc);
       XSetRegion (private->xdisplay, private->xgc, region_private->xregion);
+
+      /* Regions aren't shadowed; XSetRegion also resets the clip origin */
+      private->values.clip_x_origin = 0;
+      private->values.clip_y_origin = 0;
+      private->known_mask |= GCClipXOrigin | GCClipYOrigin;
+      private->dirty_mask &= ~(GCClipXOrigin | GCClipYOrigin);
+      private->clip_type = GDK_GC_CLIP_UNKNOWN;
+      private->server_clip_type = GDK_GC_CLIP_UNKNOWN;
+      private->clip_dirty = FALSE;
+      gdk_gc_requests_sent++;
     }
   else
-    XSetClipMask (private->xdisplay, private->xgc, None);
+    gdk_gc_update_clip (private, GDK_GC_CLIP_NONE, NULL, None);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -730,12 +952,15 @@ gdk_gc_set_subwindow (GdkGC	       *gc,
 		      GdkSubwindowMode	mode)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
   private = (GdkGCPrivate*) gc;
 
-  XSetSubwindowMode (private->xdisplay, private->xgc, mode);
+  xvalues.subwindow_mode = mode;
+  gdk_gc_update_values (private, &xvalues, GCSubwindowMode);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -743,12 +968,15 @@ gdk_gc_set_exposures (GdkGC     *gc,
 		      gboolean   exposures)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
 
   g_return_if_fail (gc != NULL);
 
   private = (GdkGCPrivate*) gc;
 
-  XSetGraphicsExposures (private->xdisplay, private->xgc, exposures);
+  xvalues.graphics_exposures = exposures;
+  gdk_gc_update_values (private, &xvalues, GCGraphicsExposures);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -759,6 +987,7 @@ gdk_gc_set_line_attributes (GdkGC	*gc,
 			    GdkJoinStyle join_style)
 {
   GdkGCPrivate *private;
+  XGCValues xvalues;
   int xline_style;
   int xcap_style;
   int xjoin_style;
@@ -815,8 +1044,13 @@ gdk_gc_set_line_attributes (GdkGC	*gc,
       xjoin_style = None;
     }
 
-  XSetLineAttributes (private->xdisplay, private->xgc, line_width,
-		      xline_style, xcap_style, xjoin_style);
+  xvalues.line_width = line_width;
+  xvalues.line_style = xline_style;
+  xvalues.cap_style = xcap_style;
+  xvalues.join_style = xjoin_style;
+  gdk_gc_update_values (private, &xvalues,
+			GCLineWidth | GCLineStyle | GCCapStyle | GCJoinStyle);
+  gdk_gc_requests_issued++;
 }
 
 void
@@ -832,7 +1066,10 @@ gdk_gc_set_dashes (GdkGC      *gc,
 
   private = (GdkGCPrivate*) gc;
 
+  _gdk_draw_batch_flush_gc (gc);
   XSetDashes (private->xdisplay, private->xgc, dash_offset, (const char *)dash_list, n);
+  gdk_gc_requests_issued++;
+  gdk_gc_requests_sent++;
 }
 
 void
@@ -843,6 +1080,24 @@ gdk_gc_copy (GdkGC *dst_gc, GdkGC *src_gc)
   src_private = (GdkGCPrivate *) src_gc;
   dst_private = (GdkGCPrivate *) dst_gc;
 
+  _gdk_gc_flush (src_gc);
+  _gdk_draw_batch_flush_gc (dst_gc);
   XCopyGC (src_private->xdisplay, src_private->xgc, ~((~1) << GCLastBit),
 	   dst_private->xgc);
+  gdk_gc_requests_issued++;
+  gdk_gc_requests_sent++;
+
+  /* Everything was copied, including any clip, so pending changes
+   * on the destination are void.
+   */
+  dst_private->values = src_private->values;
+  dst_private->known_mask = src_private->known_mask;
+  dst_private->dirty_mask = 0;
+  dst_private->clip_type = src_private->server_clip_type;
+  dst_private->clip_rect = src_private->server_clip_rect;
+  dst_private->clip_pixmap = src_private->server_clip_pixmap;
+  dst_private->server_clip_type = src_private->server_clip_type;
+  dst_private->server_clip_rect = src_private->server_clip_rect;
+  dst_private->server_clip_pixmap = src_private->server_clip_pixmap;
+  dst_private->clip_dirty = FALSE;
 }
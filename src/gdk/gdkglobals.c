@@ -31,6 +31,7 @@
 #include "config.h"
 
 guint             gdk_debug_flags = 0;
+gboolean          gdk_trace_enabled = FALSE;
 gint              gdk_use_xshm = TRUE;
 gchar            *gdk_display_name = NULL;
 Display          *gdk_display = NULL;
@@ -61,6 +62,11 @@ gint              gdk_error_code = 0;
 gint              gdk_error_warnings = TRUE;
 gint              gdk_null_window_warnings = TRUE;
 GList            *gdk_default_filters = NULL;
+guint             gdk_gc_requests_issued = 0;
+guint             gdk_gc_requests_sent = 0;
+guint             gdk_draw_requests_issued = 0;
+guint             gdk_draw_requests_sent = 0;
+guint             gdk_round_trips = 0;
 
 gboolean      gdk_xim_using;  	        /* using XIM Protocol if TRUE */
 #ifdef USE_XIM
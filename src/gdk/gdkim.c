@@ -42,6 +42,18 @@
  */
 static gboolean gdk_use_mb;
 
+/* Encodings gdk_mbstowcs() and gdk_wcstombs() convert themselves,
+ * without going through Xlib's text properties or the C library.
+ */
+typedef enum
+{
+  GDK_MB_GENERIC,		/* Xlib or the C library */
+  GDK_MB_BYTES,			/* one byte per character */
+  GDK_MB_UTF8
+} GdkMbEncoding;
+
+static GdkMbEncoding gdk_mb_encoding = GDK_MB_GENERIC;
+
 #ifdef USE_XIM
 
 #include <stdarg.h>
@@ -78,6 +90,7 @@ static XIM        xim_im;			/* global IM */
 static XIMStyles* xim_styles;			/* im supports these styles */
 static XIMStyle xim_best_allowed_style;
 static GList* xim_ic_list;
+static gboolean xim_opened = FALSE;		/* gdk_im_open() was called */
 
 #endif /* USE_XIM */
 
@@ -94,6 +107,23 @@ static GList* xim_ic_list;
  *--------------------------------------------------------------
  */
 
+static gboolean
+gdk_locale_is_utf8 (const gchar *locale)
+{
+  const gchar *codeset;
+  guint len;
+
+  codeset = strchr (locale, '.');
+  if (!codeset)
+    return FALSE;
+
+  codeset++;
+  len = strcspn (codeset, "@;");
+
+  return ((len == 4 && g_strncasecmp (codeset, "utf8", 4) == 0) ||
+	  (len == 5 && g_strncasecmp (codeset, "utf-8", 5) == 0));
+}
+
 gchar*
 gdk_set_locale (void)
 {
@@ -137,9 +167,17 @@ gdk_set_locale (void)
 #endif /* X_LOCALE */
     }
 
+  if (!gdk_use_mb)
+    gdk_mb_encoding = GDK_MB_BYTES;
+  else if (gdk_locale_is_utf8 (setlocale (LC_CTYPE, NULL)))
+    gdk_mb_encoding = GDK_MB_UTF8;
+  else
+    gdk_mb_encoding = GDK_MB_GENERIC;
+
   GDK_NOTE (XIM,
-	    g_message ("%s multi-byte string functions.", 
-		       gdk_use_mb ? "Using" : "Not using"));
+	    g_message ("%s multi-byte string functions%s.", 
+		       gdk_use_mb ? "Using" : "Not using",
+		       gdk_mb_encoding == GDK_MB_UTF8 ? " (UTF-8)" : ""));
   
   return current_locale;
 }
@@ -268,6 +306,9 @@ gdk_im_decide_style (GdkIMStyle supported_style)
   gint i;
   GdkIMStyle style, tmp;
   
+  if (!xim_opened)
+    gdk_im_open ();
+
   g_return_val_if_fail (xim_styles != NULL, 0);
   
   style = 0;
@@ -371,6 +412,7 @@ gdk_im_real_open (void)
 {
   GList *node;
 
+  _gdk_round_trip ();
   xim_im = XOpenIM (GDK_DISPLAY(), NULL, NULL, NULL);
   if (xim_im == NULL)
     {
@@ -400,9 +442,16 @@ gdk_im_real_open (void)
     }
 }
 
+/* Opening the IM talks to the IM server, so it is done when an
+ * input context is first asked for rather than in gdk_init().
+ */
 gint 
 gdk_im_open (void)
 {
+  gint result;
+
+  xim_opened = TRUE;
+
   gdk_xim_ic = NULL;
   gdk_xim_window = (GdkWindow*)NULL;
   xim_im = NULL;
@@ -414,15 +463,18 @@ gdk_im_open (void)
   if (!(xim_best_allowed_style & GDK_IM_STATUS_MASK))
     gdk_im_set_best_style (GDK_IM_STATUS_CALLBACKS);
 
-  if (gdk_im_real_open ())
-    return TRUE;
+  _gdk_startup_phase_begin ("xim");
 
+  result = gdk_im_real_open ();
 #ifdef USE_X11R6_XIM
-  XRegisterIMInstantiateCallback (gdk_display, NULL, NULL, NULL,
-				  gdk_im_instantiate_cb, NULL);
+  if (!result)
+    XRegisterIMInstantiateCallback (gdk_display, NULL, NULL, NULL,
+				    gdk_im_instantiate_cb, NULL);
 #endif
 
-  return FALSE;
+  _gdk_startup_phase_end ();
+
+  return result;
 }
 
 void 
@@ -443,6 +495,9 @@ gdk_im_close (void)
 gboolean
 gdk_im_ready (void)
 {
+  if (!xim_opened)
+    gdk_im_open ();
+
   return (xim_im != NULL);
 }
 
@@ -581,6 +636,9 @@ gdk_ic_new (GdkICAttr *attr, GdkICAttributesType mask)
   g_return_val_if_fail (attr != NULL, NULL);
   g_return_val_if_fail ((mask & GDK_IC_ALL_REQ) == GDK_IC_ALL_REQ, NULL);
 
+  if (!xim_opened)
+    gdk_im_open ();
+
   switch (attr->style & GDK_IM_PREEDIT_MASK)
     {
     case 0:
@@ -1477,6 +1535,202 @@ gdk_ic_get_events (GdkIC *ic)
 
 #endif /* USE_XIM */
 
+/* Conversions for the encodings in GdkMbEncoding. The UTF-8 decoder
+ * copies runs of ASCII a machine word at a time; the encoders size
+ * their result in a first pass, so it is allocated exactly once.
+ */
+
+#define GDK_WORD_HIGHS	((~0UL / 0xff) * 0x80)
+
+static gint
+gdk_mbstowcs_bytes (GdkWChar    *dest,
+		    const gchar *src,
+		    gint         dest_max)
+{
+  gint i;
+      
+  for (i = 0; i < dest_max && src[i]; i++)
+    dest[i] = (guchar) src[i];
+      
+  return i;
+}
+
+static gchar *
+gdk_wcstombs_bytes (const GdkWChar *src,
+		    gint            src_len)
+{
+  gchar *mbstr;
+  gint length;
+  gint i;
+
+  if (src_len < 0)
+    {
+      length = 0;
+      while (src[length] != 0)
+	length++;
+    }
+  else
+    length = src_len;
+
+  mbstr = g_new (gchar, length + 1);
+  for (i = 0; i < length; i++)
+    mbstr[i] = src[i];
+  mbstr[i] = '\0';
+
+  return mbstr;
+}
+
+static gint
+gdk_mbstowcs_utf8 (GdkWChar    *dest,
+		   const gchar *src,
+		   gint         dest_max)
+{
+  const guchar *p = (const guchar *) src;
+  const guchar *end = p + strlen (src);
+  gint n = 0;
+
+  while (n < dest_max)
+    {
+      GdkWChar c;
+      gint len, i;
+
+      /* Runs of ASCII a word at a time, as long as the whole word
+       * lies before the terminating nul.
+       */
+      while (n + (gint) sizeof (gulong) <= dest_max &&
+	     end - p >= (gint) sizeof (gulong))
+	{
+	  gulong word;
+
+	  memcpy (&word, p, sizeof (word));
+	  if (word & GDK_WORD_HIGHS)
+	    break;
+
+	  for (i = 0; i < (gint) sizeof (gulong); i++)
+	    dest[n + i] = p[i];
+	  n += sizeof (gulong);
+	  p += sizeof (gulong);
+	}
+      if (n >= dest_max)
+	break;
+
+      c = *p;
+      if (c < 0x80)
+	{
+	  if (c == 0)
+	    break;
+	  dest[n++] = c;
+	  p++;
+	  continue;
+	}
+
+      if (c < 0xc2)		/* continuation byte or overlong */
+	return -1;
+      else if (c < 0xe0)
+	{
+	  len = 2;
+	  c &= 0x1f;
+	}
+      else if (c < 0xf0)
+	{
+	  len = 3;
+	  c &= 0x0f;
+	}
+      else if (c < 0xf5)
+	{
+	  len = 4;
+	  c &= 0x07;
+	}
+      else
+	return -1;
+
+      /* This also stops at the terminating nul */
+      for (i = 1; i < len; i++)
+	{
+	  if ((p[i] & 0xc0) != 0x80)
+	    return -1;
+	  c = (c << 6) | (p[i] & 0x3f);
+	}
+
+      if ((len == 3 && c < 0x800) ||
+	  (len == 4 && (c < 0x10000 || c > 0x10ffff)) ||
+	  (c >= 0xd800 && c < 0xe000))
+	return -1;
+
+      dest[n++] = c;
+      p += len;
+    }
+
+  return n;
+}
+
+static gchar *
+gdk_wcstombs_utf8 (const GdkWChar *src,
+		   gint            src_len)
+{
+  guchar *result;
+  guchar *p;
+  gint length;
+  gint n = 0;
+  gint i;
+
+  for (i = 0; (src_len < 0 || i < src_len) && src[i]; i++)
+    {
+      GdkWChar c = src[i];
+
+      if (c < 0x80)
+	n += 1;
+      else if (c < 0x800)
+	n += 2;
+      else if (c < 0x10000)
+	{
+	  if (c >= 0xd800 && c < 0xe000)
+	    return NULL;
+	  n += 3;
+	}
+      else if (c < 0x110000)
+	n += 4;
+      else
+	return NULL;
+    }
+  length = i;
+
+  result = g_new (guchar, n + 1);
+  p = result;
+
+  for (i = 0; i < length; i++)
+    {
+      GdkWChar c = src[i];
+
+      if (c < 0x80)
+	*p++ = c;
+      else if (c < 0x800)
+	{
+	  p[0] = 0xc0 | (c >> 6);
+	  p[1] = 0x80 | (c & 0x3f);
+	  p += 2;
+	}
+      else if (c < 0x10000)
+	{
+	  p[0] = 0xe0 | (c >> 12);
+	  p[1] = 0x80 | ((c >> 6) & 0x3f);
+	  p[2] = 0x80 | (c & 0x3f);
+	  p += 3;
+	}
+      else
+	{
+	  p[0] = 0xf0 | (c >> 18);
+	  p[1] = 0x80 | ((c >> 12) & 0x3f);
+	  p[2] = 0x80 | ((c >> 6) & 0x3f);
+	  p[3] = 0x80 | (c & 0x3f);
+	  p += 4;
+	}
+    }
+  *p = '\0';
+
+  return (gchar *) result;
+}
+
 /*
  * gdk_wcstombs_len
  *
@@ -1496,6 +1750,11 @@ _gdk_wcstombs_len (const GdkWChar *src,
   gchar buf[16];
   gchar *p;
 
+  if (gdk_mb_encoding == GDK_MB_UTF8)
+    return gdk_wcstombs_utf8 (src, src_len);
+  else if (gdk_mb_encoding == GDK_MB_BYTES)
+    return gdk_wcstombs_bytes (src, src_len);
+
   if (MB_CUR_MAX <= 16)
     p = buf;
   else
@@ -1533,9 +1792,16 @@ gchar *
 _gdk_wcstombs_len (const GdkWChar *src,
 		   int             len)
 {
+  XTextProperty tpr;
+  wchar_t *src_wc;
   gchar *mbstr = NULL;
   gint length;
   
+  if (gdk_mb_encoding == GDK_MB_UTF8)
+    return gdk_wcstombs_utf8 (src, len);
+  else if (!gdk_use_mb)
+    return gdk_wcstombs_bytes (src, len);
+
   if (len < 0)
     {
       length = 0;
@@ -1546,55 +1812,38 @@ _gdk_wcstombs_len (const GdkWChar *src,
   else
     length = len;
 
-  if (gdk_use_mb)
+  /* The len < 0 part is to ensure nul termination
+   */
+  if (len < 0 && sizeof(wchar_t) == sizeof(GdkWChar))
     {
-      XTextProperty tpr;
-      wchar_t *src_wc;
-
-      /* The len < 0 part is to ensure nul termination
-       */
-      if (len < 0 && sizeof(wchar_t) == sizeof(GdkWChar))
-	{
-	  src_wc = (wchar_t *)src;
-	}
-      else
-	{
-	  gint i;
-
-	  src_wc = g_new (wchar_t, length + 1);
-
-	  for (i = 0; i < length; i++)
-	    src_wc[i] = src[i];
-
-	  src_wc[i] = 0;
-	}
-      
-      if (XwcTextListToTextProperty (gdk_display, &src_wc, 1,
-				     XTextStyle, &tpr) == Success)
-	{
-	  /*
-	   * We must copy the string into an area allocated by glib, because
-	   * the string 'tpr.value' must be freed by XFree().
-	   */
-	  mbstr = g_strdup((const char *)tpr.value);
-	  XFree (tpr.value);
-	}
-
-      if (src_wc != (wchar_t *)src)
-	g_free (src_wc);
+      src_wc = (wchar_t *)src;
     }
   else
     {
       gint i;
 
-      mbstr = g_new (gchar, length + 1);
+      src_wc = g_new (wchar_t, length + 1);
 
-      for (i=0; i < length; i++)
-	mbstr[i] = src[i];
+      for (i = 0; i < length; i++)
+	src_wc[i] = src[i];
 
-      mbstr[i] = '\0';
+      src_wc[i] = 0;
+    }
+  
+  if (XwcTextListToTextProperty (gdk_display, &src_wc, 1,
+				 XTextStyle, &tpr) == Success)
+    {
+      /*
+       * We must copy the string into an area allocated by glib, because
+       * the string 'tpr.value' must be freed by XFree().
+       */
+      mbstr = g_strdup((const char *)tpr.value);
+      XFree (tpr.value);
     }
 
+  if (src_wc != (wchar_t *)src)
+    g_free (src_wc);
+
   return mbstr;
 }
 #endif /* !USE_NATIVE_LOCALE */
@@ -1623,7 +1872,13 @@ gdk_wcstombs (const GdkWChar *src)
 gint
 gdk_mbstowcs (GdkWChar *dest, const gchar *src, gint dest_max)
 {
+  if (gdk_mb_encoding == GDK_MB_UTF8)
+    return gdk_mbstowcs_utf8 (dest, src, dest_max);
+
 #ifdef USE_NATIVE_LOCALE
+  if (gdk_mb_encoding == GDK_MB_BYTES)
+    return gdk_mbstowcs_bytes (dest, src, dest_max);
+
   return mbstowcs ((wchar_t *)dest, src, dest_max);
 #else
   if (gdk_use_mb)
@@ -1656,13 +1911,6 @@ gdk_mbstowcs (GdkWChar *dest, const gchar *src, gint dest_max)
       return len_cpy;
     }
   else
-    {
-      gint i;
-      
-      for (i=0; i<dest_max && src[i]; i++)
-	dest[i] = (guchar)src[i];
-      
-      return i;
-    }
+    return gdk_mbstowcs_bytes (dest, src, dest_max);
 #endif
 }
@@ -129,8 +129,10 @@ gdk_image_check_xshm(Display *display)
   int major, minor, ignore;
   Bool pixmaps;
   
+  _gdk_round_trip ();
   if (XQueryExtension(display, "MIT-SHM", &ignore, &ignore, &ignore)) 
     {
+      _gdk_round_trip ();
       if (XShmQueryVersion(display, &major, &minor, &pixmaps )==True) 
 	{
 	  return (pixmaps==True) ? 2 : 1;
@@ -346,6 +348,8 @@ gdk_image_get (GdkWindow *window,
   if (win_private->destroyed)
     return NULL;
 
+  /* The image has to include any batched drawing */
+  _gdk_draw_batch_flush ();
   ximage = XGetImage (gdk_display,
 		      win_private->xwindow,
 		      x, y, width, height,
@@ -472,6 +476,7 @@ gdk_image_put_normal (GdkDrawable *drawable,
     return;
   image_private = (GdkImagePrivate*) image;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   g_return_if_fail (image->type == GDK_IMAGE_NORMAL);
 
@@ -505,6 +510,7 @@ gdk_image_put_shared (GdkDrawable *drawable,
     return;
   image_private = (GdkImagePrivate*) image;
   gc_private = (GdkGCPrivate*) gc;
+  _gdk_gc_flush (gc);
 
   g_return_if_fail (image->type == GDK_IMAGE_SHARED);
 
@@ -72,22 +72,45 @@ gint              gdk_input_ignore_core;
 
 static GList            *gdk_input_devices;
 static GList            *gdk_input_windows;
+static gboolean          gdk_input_initialized = FALSE;
 
 #include "gdkinputnone.h"
 #include "gdkinputcommon.h"
 #include "gdkinputxfree.h"
 #include "gdkinputgxi.h"
 
+/* Enumerating the devices takes several round trips, so gdk_init()
+ * leaves it to the first function that needs to know about them.
+ * Until then the vtable is empty and only the core pointer exists.
+ */
+void
+gdk_input_init (void)
+{
+  if (gdk_input_initialized)
+    return;
+  gdk_input_initialized = TRUE;
+
+  _gdk_startup_phase_begin ("input");
+  gdk_input_backend_init ();
+  _gdk_startup_phase_end ();
+}
+
 GList *
 gdk_input_list_devices (void)
 {
+  gdk_input_init ();
+
   return gdk_input_devices;
 }
 
 void
 gdk_input_set_source (guint32 deviceid, GdkInputSource source)
 {
-  GdkDevicePrivate *gdkdev = gdk_input_find_device(deviceid);
+  GdkDevicePrivate *gdkdev;
+
+  gdk_input_init ();
+
+  gdkdev = gdk_input_find_device(deviceid);
   g_return_if_fail (gdkdev != NULL);
 
   gdkdev->info.source = source;
@@ -99,6 +122,8 @@ gdk_input_set_mode (guint32 deviceid, GdkInputMode mode)
   if (deviceid == GDK_CORE_POINTER)
     return FALSE;
 
+  gdk_input_init ();
+
   if (gdk_input_vtable.set_mode)
     return gdk_input_vtable.set_mode(deviceid,mode);
   else
@@ -108,7 +133,12 @@ gdk_input_set_mode (guint32 deviceid, GdkInputMode mode)
 void
 gdk_input_set_axes (guint32 deviceid, GdkAxisUse *axes)
 {
-  if (deviceid != GDK_CORE_POINTER && gdk_input_vtable.set_axes)
+  if (deviceid == GDK_CORE_POINTER)
+    return;
+
+  gdk_input_init ();
+
+  if (gdk_input_vtable.set_axes)
     gdk_input_vtable.set_axes (deviceid, axes);
 }
 
@@ -117,7 +147,12 @@ void gdk_input_set_key (guint32 deviceid,
 			guint   keyval,
 			GdkModifierType modifiers)
 {
-  if (deviceid != GDK_CORE_POINTER && gdk_input_vtable.set_key)
+  if (deviceid == GDK_CORE_POINTER)
+    return;
+
+  gdk_input_init ();
+
+  if (gdk_input_vtable.set_key)
     gdk_input_vtable.set_key (deviceid, index, keyval, modifiers);
 }
 
@@ -165,6 +200,8 @@ gdk_input_motion_events (GdkWindow *window,
     }
   else
     {
+      gdk_input_init ();
+
       if (gdk_input_vtable.motion_events)
 	{
 	  return gdk_input_vtable.motion_events(window,
@@ -234,6 +271,8 @@ gdk_input_set_extension_events (GdkWindow *window, gint mask,
 
   if (mask != 0)
     {
+      gdk_input_init ();
+
       iw = g_new(GdkInputWindow,1);
 
       iw->window = window;
@@ -297,6 +336,9 @@ gdk_input_exit (void)
   GList *tmp_list;
   GdkDevicePrivate *gdkdev;
 
+  if (!gdk_input_initialized)
+    return;
+
   for (tmp_list = gdk_input_devices; tmp_list; tmp_list = tmp_list->next)
     {
       gdkdev = (GdkDevicePrivate *)(tmp_list->data);
@@ -348,6 +390,8 @@ gdk_input_window_get_pointer (GdkWindow       *window,
 			      gdouble         *ytilt,
 			      GdkModifierType *mask)
 {
+  gdk_input_init ();
+
   if (gdk_input_vtable.get_pointer)
     gdk_input_vtable.get_pointer (window, deviceid, x, y, pressure,
 				  xtilt, ytilt, mask);
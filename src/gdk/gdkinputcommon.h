@@ -442,6 +442,7 @@ gdk_input_common_init(gint include_core)
 
   /* Init XInput extension */
   
+  _gdk_round_trip ();
   extensions = XListExtensions(display, &num_extensions);
   for (loop = 0; loop < num_extensions &&
 	 (strcmp(extensions[loop], "XInputExtension") != 0); loop++);
@@ -451,6 +452,7 @@ gdk_input_common_init(gint include_core)
     {
       /* XInput extension found */
 
+      _gdk_round_trip ();
       devices = XListInputDevices(display, &num_devices);
   
       for(loop=0; loop<num_devices; loop++)
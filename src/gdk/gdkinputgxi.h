@@ -77,8 +77,8 @@ static void gdk_input_gxi_ungrab_pointer (guint32 time);
 static GdkDevicePrivate *gdk_input_current_device;
 static GdkDevicePrivate *gdk_input_core_pointer;
 
-void
-gdk_input_init(void)
+static void
+gdk_input_backend_init (void)
 {
   GList *tmp_list;
   
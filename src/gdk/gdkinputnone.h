@@ -35,8 +35,8 @@ static void gdk_input_none_get_pointer (GdkWindow       *window,
 					gdouble         *ytilt,
 					GdkModifierType *mask);
 
-void
-gdk_input_init (void)
+static void
+gdk_input_backend_init (void)
 {
   gdk_input_vtable.set_mode           = NULL;
   gdk_input_vtable.set_axes           = NULL;
@@ -48,8 +48,8 @@ static gint gdk_input_xfree_grab_pointer (GdkWindow *     window,
 					guint32         time);
 static void gdk_input_xfree_ungrab_pointer (guint32 time);
 
-void 
-gdk_input_init(void)
+static void
+gdk_input_backend_init (void)
 {
   gdk_input_vtable.set_mode           = gdk_input_xfree_set_mode;
   gdk_input_vtable.set_axes           = gdk_input_common_set_axes;
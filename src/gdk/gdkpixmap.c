@@ -822,6 +822,7 @@ gdk_pixmap_unref (GdkPixmap *pixmap)
   private->ref_count -= 1;
   if (private->ref_count == 0)
     {
+      _gdk_draw_batch_discard (pixmap);
       XFreePixmap (private->xdisplay, private->xwindow);
       gdk_xid_table_remove (private->xwindow);
       g_dataset_destroy (private);
@@ -30,30 +30,196 @@
 #include "gdk.h"
 #include "gdkprivate.h"
 
+/* Atoms GDK uses itself; interned with a single round trip at
+ * gdk_init time, together with any names passed to gdk_atom_prefetch()
+ * before that.
+ */
+static const gchar *gdk_well_known_atoms[] = {
+  "WM_DELETE_WINDOW",
+  "WM_TAKE_FOCUS",
+  "WM_PROTOCOLS",
+  "WM_STATE",
+  "WM_CLIENT_LEADER",
+  "WM_WINDOW_ROLE",
+  "SM_CLIENT_ID",
+  "GDK_SELECTION",
+  "_MOTIF_WM_HINTS",
+  "ENLIGHTENMENT_DESKTOP",
+  "__SWM_VROOT",
+  "_MOTIF_DRAG_AND_DROP_MESSAGE",
+  "_MOTIF_DRAG_INITIATOR_INFO",
+  "_MOTIF_DRAG_RECEIVER_INFO",
+  "_MOTIF_DRAG_TARGETS",
+  "XdndAware",
+  "XdndProxy",
+  "XdndEnter",
+  "XdndLeave",
+  "XdndPosition",
+  "XdndStatus",
+  "XdndDrop",
+  "XdndFinished",
+  "XdndSelection",
+  "XdndTypeList",
+  "XdndActionList",
+  "XdndActionCopy",
+  "XdndActionMove",
+  "XdndActionLink",
+  "XdndActionPrivate",
+  "XdndActionAsk"
+};
+
+static GHashTable *atom_hash = NULL;	  /* name -> atom */
+static GHashTable *atom_name_hash = NULL; /* atom -> name */
+static GSList *atom_prefetch_names = NULL;
+
+static void
+gdk_atom_insert (const gchar *atom_name,
+		 GdkAtom      atom)
+{
+  gchar *name;
+
+  if (!atom_hash)
+    {
+      atom_hash = g_hash_table_new (g_str_hash, g_str_equal);
+      atom_name_hash = g_hash_table_new (g_direct_hash, NULL);
+    }
+
+  /* Both tables share the same copy of the name */
+  name = g_hash_table_lookup (atom_name_hash, GUINT_TO_POINTER (atom));
+  if (!name)
+    {
+      name = g_strdup (atom_name);
+      g_hash_table_insert (atom_name_hash, GUINT_TO_POINTER (atom), name);
+    }
+  g_hash_table_insert (atom_hash, name, GUINT_TO_POINTER (atom));
+}
+
+static GdkAtom
+gdk_atom_lookup (const gchar *atom_name)
+{
+  if (!atom_hash)
+    return None;
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (atom_hash, atom_name));
+}
+
 GdkAtom
 gdk_atom_intern (const gchar *atom_name,
 		 gint         only_if_exists)
 {
   GdkAtom retval;
-  static GHashTable *atom_hash = NULL;
   
-  if (!atom_hash)
-    atom_hash = g_hash_table_new (g_str_hash, g_str_equal);
-
-  retval = GPOINTER_TO_UINT (g_hash_table_lookup (atom_hash, atom_name));
+  retval = gdk_atom_lookup (atom_name);
   if (!retval)
     {
+      _gdk_round_trip ();
       retval = XInternAtom (gdk_display, atom_name, only_if_exists);
 
       if (retval != None)
-	g_hash_table_insert (atom_hash, 
-			     g_strdup (atom_name), 
-			     GUINT_TO_POINTER (retval));
+	gdk_atom_insert (atom_name, retval);
     }
 
   return retval;
 }
 
+/* Interns all atom_names, storing the results in atoms. Names not in
+ * the cache yet are interned with a single XInternAtoms request.
+ */
+void
+gdk_atom_intern_list (const gchar **atom_names,
+		      gint          n_atoms,
+		      gint          only_if_exists,
+		      GdkAtom      *atoms)
+{
+  gchar **missing_names;
+  Atom *missing_atoms;
+  gint n_missing = 0;
+  gint i, j;
+
+  g_return_if_fail (atom_names != NULL || n_atoms == 0);
+  g_return_if_fail (atoms != NULL || n_atoms == 0);
+
+  missing_names = g_new (gchar *, n_atoms);
+  missing_atoms = g_new (Atom, n_atoms);
+
+  for (i = 0; i < n_atoms; i++)
+    {
+      atoms[i] = gdk_atom_lookup (atom_names[i]);
+      if (!atoms[i])
+	missing_names[n_missing++] = (gchar *) atom_names[i];
+    }
+
+  if (n_missing > 0)
+    {
+      for (i = 0; i < n_missing; i++)
+	missing_atoms[i] = None;
+
+      _gdk_round_trip ();
+      XInternAtoms (gdk_display, missing_names, n_missing,
+		    only_if_exists, missing_atoms);
+
+      for (i = 0, j = 0; i < n_atoms; i++)
+	if (!atoms[i])
+	  {
+	    atoms[i] = missing_atoms[j++];
+	    if (atoms[i] != None)
+	      gdk_atom_insert (atom_names[i], atoms[i]);
+	  }
+    }
+
+  g_free (missing_names);
+  g_free (missing_atoms);
+}
+
+/* Interns atom_names ahead of their use. Before gdk_init the names
+ * are remembered, and must stay valid, until the initial prefetch.
+ */
+void
+gdk_atom_prefetch (const gchar **atom_names,
+		   gint          n_atoms)
+{
+  GdkAtom *atoms;
+  gint i;
+
+  g_return_if_fail (atom_names != NULL || n_atoms == 0);
+
+  if (!gdk_display)
+    {
+      for (i = 0; i < n_atoms; i++)
+	atom_prefetch_names = g_slist_prepend (atom_prefetch_names,
+					       (gpointer) atom_names[i]);
+      return;
+    }
+
+  atoms = g_new (GdkAtom, n_atoms);
+  gdk_atom_intern_list (atom_names, n_atoms, FALSE, atoms);
+  g_free (atoms);
+}
+
+void
+gdk_atoms_init (void)
+{
+  const gchar **names;
+  gint n_well_known;
+  gint n_names;
+  GSList *tmp_list;
+
+  n_well_known = sizeof (gdk_well_known_atoms) / sizeof (gdk_well_known_atoms[0]);
+  n_names = n_well_known + g_slist_length (atom_prefetch_names);
+
+  names = g_new (const gchar *, n_names);
+  memcpy (names, gdk_well_known_atoms, sizeof (gdk_well_known_atoms));
+
+  n_names = n_well_known;
+  for (tmp_list = atom_prefetch_names; tmp_list; tmp_list = tmp_list->next)
+    names[n_names++] = tmp_list->data;
+  g_slist_free (atom_prefetch_names);
+  atom_prefetch_names = NULL;
+
+  gdk_atom_prefetch (names, n_names);
+  g_free (names);
+}
+
 gchar*
 gdk_atom_name (GdkAtom atom)
 {
@@ -61,12 +227,20 @@ gdk_atom_name (GdkAtom atom)
   gchar *name;
   gint old_error_warnings;
 
+  if (atom_name_hash)
+    {
+      name = g_hash_table_lookup (atom_name_hash, GUINT_TO_POINTER (atom));
+      if (name)
+	return g_strdup (name);
+    }
+
   /* If this atom doesn't exist, we'll die with an X error unless
      we take precautions */
 
   old_error_warnings = gdk_error_warnings;
   gdk_error_warnings = 0;
   gdk_error_code = 0;
+  _gdk_round_trip ();
   t = XGetAtomName (gdk_display, atom);
   gdk_error_warnings = old_error_warnings;
 
@@ -81,7 +255,10 @@ gdk_atom_name (GdkAtom atom)
     {
       name = g_strdup (t);
       if (t)
-	XFree (t);
+	{
+	  gdk_atom_insert (t, atom);
+	  XFree (t);
+	}
       
       return name;
     }
@@ -126,6 +303,7 @@ gdk_property_get (GdkWindow   *window,
     }
 
   ret_data = NULL;
+  _gdk_round_trip ();
   XGetWindowProperty (xdisplay, xwindow, property,
 		      offset, (length + 3) / 4, pdelete,
 		      type, &ret_prop_type, &ret_format,
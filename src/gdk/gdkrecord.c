@@ -0,0 +1,647 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Modified by the GTK+ Team and others 1997-1999.  See the AUTHORS
+ * file for a list of people on the GTK+ Team.  See the ChangeLog
+ * files for a list of changes.  These files are distributed with
+ * GTK+ at ftp://ftp.gtk.org/pub/gtk/. 
+ */
+
+/* Recording and replaying of the input events.
+ *
+ * When GDK_RECORD is set to a file name, the pointer, keyboard, crossing
+ * and focus events dispatched are written to that file. When GDK_REPLAY
+ * is set, the events in that file are put back on the event queue,
+ * at the recorded pace, or as fast as possible if GDK_REPLAY_FAST is
+ * set. Windows are identified by the order gdk_window_new() created
+ * them in, so the program must create the same windows in the same
+ * order as when the events were recorded. Foreign windows are not
+ * numbered: when they get wrapped depends on what other clients do,
+ * so events on them are neither recorded nor replayed. Replayed events
+ * are not recorded again when both GDK_RECORD and GDK_REPLAY are set.
+ *
+ * While replaying, the time from when each event was due until the main
+ * loop is idle again, that is including the resizes and redraws it
+ * caused, is collected into a histogram per event type. The histograms
+ * are printed when the replay is complete. If GDK_REPLAY_EXIT is set,
+ * the program then exits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gdk.h"
+#include "gdkprivate.h"
+
+#define RECORD_MAGIC "GdkRec1"
+
+/* The recorded event types run from GDK_MOTION_NOTIFY to GDK_FOCUS_CHANGE. */
+#define RECORD_FIRST_TYPE GDK_MOTION_NOTIFY
+#define RECORD_NTYPES	  (GDK_FOCUS_CHANGE - GDK_MOTION_NOTIFY + 1)
+
+/* Latencies are counted in buckets of powers of two microseconds. */
+#define REPLAY_NBUCKETS	  32
+
+typedef struct _GdkRecordEvent  GdkRecordEvent;
+typedef struct _GdkReplayStats  GdkReplayStats;
+
+/* One of these is written for each event, followed by the key string,
+ * if any. All fields are in the byte order of the recording machine.
+ */
+struct _GdkRecordEvent
+{
+  guint32 delay;		/* Microseconds since the previous event */
+  guint32 window;		/* The serial of the window */
+  guint32 time;
+  guint32 state;
+  gfloat  x, y;
+  gfloat  x_root, y_root;
+  guint32 detail;		/* Button, keyval, crossing detail or focus in */
+  gint8   type;
+  guint8  mode;			/* Crossing mode */
+  guint8  focus;		/* Crossing focus */
+  guint8  length;		/* Length of the key string */
+};
+
+struct _GdkReplayStats
+{
+  guint   count;
+  gdouble total;
+  guint32 max;
+  guint   buckets[REPLAY_NBUCKETS];
+};
+
+static const gchar *record_type_names[RECORD_NTYPES] = {
+  "motion_notify", "button_press", "2button_press", "3button_press",
+  "button_release", "key_press", "key_release", "enter_notify",
+  "leave_notify", "focus_change"
+};
+
+static guint32 window_serial = 0;
+
+static FILE *record_file = NULL;
+static GTimeVal record_last;
+
+static gchar *replay_data = NULL;
+static gchar *replay_position;
+static gchar *replay_end;
+static GHashTable *replay_windows = NULL;
+static gboolean replay_fast = FALSE;
+static GTimeVal replay_start;
+static GTimeVal replay_due;
+static GSList *replay_dispatched = NULL;   /* GTimeVals of due times */
+static GSList *replay_put = NULL;	   /* The same, in put order */
+static GSList *replay_put_tail = NULL;
+static guint replay_outstanding = 0;
+static guint replay_skipped = 0;
+static guint replay_timeout = 0;
+static guint replay_idle = 0;
+static GdkReplayStats replay_stats[RECORD_NTYPES];
+
+static gboolean gdk_replay_next (gpointer data);
+
+static glong
+time_diff (GTimeVal *end,
+	   GTimeVal *start)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000
+    + (end->tv_usec - start->tv_usec);
+}
+
+static void
+time_add (GTimeVal *time,
+	  glong	    usecs)
+{
+  time->tv_usec += usecs;
+  time->tv_sec += time->tv_usec / 1000000;
+  time->tv_usec %= 1000000;
+}
+
+void
+gdk_record_init (void)
+{
+  gchar *file;
+
+  file = getenv ("GDK_RECORD");
+  if (file && file[0] && !gdk_event_record_start (file))
+    g_warning ("Cannot record the events to %s", file);
+
+  file = getenv ("GDK_REPLAY");
+  if (file && file[0] &&
+      !gdk_event_replay (file, getenv ("GDK_REPLAY_FAST") == NULL))
+    g_warning ("Cannot replay the events from %s", file);
+}
+
+void
+gdk_record_exit (void)
+{
+  gdk_event_record_stop ();
+}
+
+/* Windows */
+
+static void
+gdk_replay_add_windows (GdkWindow *window)
+{
+  GdkWindowPrivate *private = (GdkWindowPrivate*) window;
+  GList *tmp_list;
+
+  if (private->serial)
+    g_hash_table_insert (replay_windows, GUINT_TO_POINTER (private->serial),
+			 window);
+
+  for (tmp_list = private->children; tmp_list; tmp_list = tmp_list->next)
+    gdk_replay_add_windows (tmp_list->data);
+}
+
+void
+gdk_record_window_new (GdkWindow *window)
+{
+  GdkWindowPrivate *private = (GdkWindowPrivate*) window;
+
+  private->serial = ++window_serial;
+  if (replay_windows)
+    g_hash_table_insert (replay_windows, GUINT_TO_POINTER (private->serial),
+			 window);
+}
+
+void
+gdk_record_window_free (GdkWindow *window)
+{
+  GdkWindowPrivate *private = (GdkWindowPrivate*) window;
+
+  if (replay_windows && private->serial)
+    g_hash_table_remove (replay_windows, GUINT_TO_POINTER (private->serial));
+}
+
+/* Recording */
+
+gboolean
+gdk_event_record_start (const gchar *filename)
+{
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  gdk_event_record_stop ();
+
+  record_file = fopen (filename, "wb");
+  if (!record_file)
+    return FALSE;
+
+  fwrite (RECORD_MAGIC, sizeof (RECORD_MAGIC), 1, record_file);
+  g_get_current_time (&record_last);
+
+  return TRUE;
+}
+
+void
+gdk_event_record_stop (void)
+{
+  if (!record_file)
+    return;
+
+  if (fclose (record_file) != 0)
+    g_warning ("Error writing the recorded events");
+  record_file = NULL;
+}
+
+void
+gdk_record_event (GdkEvent *event)
+{
+  GdkRecordEvent record;
+  GTimeVal now;
+  glong delay;
+
+  if (!record_file ||
+      event->type < RECORD_FIRST_TYPE ||
+      event->type >= RECORD_FIRST_TYPE + RECORD_NTYPES ||
+      !event->any.window ||
+      !((GdkWindowPrivate*) event->any.window)->serial)
+    return;
+
+  memset (&record, 0, sizeof (record));
+
+  g_get_current_time (&now);
+  delay = time_diff (&now, &record_last);
+  record.delay = CLAMP (delay, 0, G_MAXINT);
+  record_last = now;
+
+  record.type = event->type;
+  record.window = ((GdkWindowPrivate*) event->any.window)->serial;
+
+  switch (event->type)
+    {
+    case GDK_MOTION_NOTIFY:
+      record.time = event->motion.time;
+      record.state = event->motion.state;
+      record.x = event->motion.x;
+      record.y = event->motion.y;
+      record.x_root = event->motion.x_root;
+      record.y_root = event->motion.y_root;
+      break;
+    case GDK_BUTTON_PRESS:
+    case GDK_2BUTTON_PRESS:
+    case GDK_3BUTTON_PRESS:
+    case GDK_BUTTON_RELEASE:
+      record.time = event->button.time;
+      record.state = event->button.state;
+      record.x = event->button.x;
+      record.y = event->button.y;
+      record.x_root = event->button.x_root;
+      record.y_root = event->button.y_root;
+      record.detail = event->button.button;
+      break;
+    case GDK_KEY_PRESS:
+    case GDK_KEY_RELEASE:
+      record.time = event->key.time;
+      record.state = event->key.state;
+      record.detail = event->key.keyval;
+      if (event->key.string)
+	record.length = MIN (event->key.length, 255);
+      break;
+    case GDK_ENTER_NOTIFY:
+    case GDK_LEAVE_NOTIFY:
+      record.time = event->crossing.time;
+      record.state = event->crossing.state;
+      record.x = event->crossing.x;
+      record.y = event->crossing.y;
+      record.x_root = event->crossing.x_root;
+      record.y_root = event->crossing.y_root;
+      record.detail = event->crossing.detail;
+      record.mode = event->crossing.mode;
+      record.focus = event->crossing.focus;
+      break;
+    case GDK_FOCUS_CHANGE:
+      record.detail = event->focus_change.in;
+      break;
+    default:
+      break;
+    }
+
+  fwrite (&record, sizeof (record), 1, record_file);
+  if (record.length)
+    fwrite (event->key.string, record.length, 1, record_file);
+}
+
+/* Replaying */
+
+static GdkEvent*
+gdk_replay_event_new (GdkRecordEvent *record,
+		      gchar	     *string)
+{
+  static GdkEvent event;
+  GdkWindow *window;
+
+  window = g_hash_table_lookup (replay_windows,
+				GUINT_TO_POINTER (record->window));
+  if (!window || ((GdkWindowPrivate*) window)->destroyed)
+    return NULL;
+
+  memset (&event, 0, sizeof (event));
+  event.type = record->type;
+  event.any.window = window;
+  event.any.send_event = FALSE;
+
+  switch (event.type)
+    {
+    case GDK_MOTION_NOTIFY:
+      event.motion.time = record->time;
+      event.motion.state = record->state;
+      event.motion.x = record->x;
+      event.motion.y = record->y;
+      event.motion.x_root = record->x_root;
+      event.motion.y_root = record->y_root;
+      event.motion.pressure = 0.5;
+      event.motion.xtilt = 0;
+      event.motion.ytilt = 0;
+      /* The pointer isn't where the event says, so it can't be a hint. */
+      event.motion.is_hint = FALSE;
+      event.motion.source = GDK_SOURCE_MOUSE;
+      event.motion.deviceid = GDK_CORE_POINTER;
+      break;
+    case GDK_BUTTON_PRESS:
+    case GDK_2BUTTON_PRESS:
+    case GDK_3BUTTON_PRESS:
+    case GDK_BUTTON_RELEASE:
+      event.button.time = record->time;
+      event.button.state = record->state;
+      event.button.x = record->x;
+      event.button.y = record->y;
+      event.button.x_root = record->x_root;
+      event.button.y_root = record->y_root;
+      event.button.button = record->detail;
+      event.button.pressure = 0.5;
+      event.button.source = GDK_SOURCE_MOUSE;
+      event.button.deviceid = GDK_CORE_POINTER;
+      break;
+    case GDK_KEY_PRESS:
+    case GDK_KEY_RELEASE:
+      event.key.time = record->time;
+      event.key.state = record->state;
+      event.key.keyval = record->detail;
+      event.key.length = record->length;
+      event.key.string = string;
+      break;
+    case GDK_ENTER_NOTIFY:
+    case GDK_LEAVE_NOTIFY:
+      event.crossing.time = record->time;
+      event.crossing.state = record->state;
+      event.crossing.x = record->x;
+      event.crossing.y = record->y;
+      event.crossing.x_root = record->x_root;
+      event.crossing.y_root = record->y_root;
+      event.crossing.detail = record->detail;
+      event.crossing.mode = record->mode;
+      event.crossing.focus = record->focus;
+      break;
+    case GDK_FOCUS_CHANGE:
+      event.focus_change.in = record->detail;
+      break;
+    default:
+      break;
+    }
+
+  return &event;
+}
+
+gboolean
+gdk_event_replay (const gchar *filename,
+		  gboolean     paced)
+{
+  FILE *file;
+  glong length;
+  gint i;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  if (replay_data)
+    return FALSE;
+
+  file = fopen (filename, "rb");
+  if (!file)
+    return FALSE;
+
+  fseek (file, 0, SEEK_END);
+  length = ftell (file);
+  rewind (file);
+
+  replay_data = g_malloc (MAX (length, 1) + 1);
+  if (length < sizeof (RECORD_MAGIC) ||
+      fread (replay_data, length, 1, file) != 1 ||
+      memcmp (replay_data, RECORD_MAGIC, sizeof (RECORD_MAGIC)) != 0)
+    {
+      fclose (file);
+      g_free (replay_data);
+      replay_data = NULL;
+      return FALSE;
+    }
+  fclose (file);
+
+  replay_position = replay_data + sizeof (RECORD_MAGIC);
+  replay_end = replay_data + length;
+  replay_fast = !paced;
+  replay_skipped = 0;
+  for (i = 0; i < RECORD_NTYPES; i++)
+    memset (&replay_stats[i], 0, sizeof (GdkReplayStats));
+
+  replay_windows = g_hash_table_new (g_direct_hash, NULL);
+  gdk_replay_add_windows ((GdkWindow*) &gdk_root_parent);
+
+  g_get_current_time (&replay_start);
+  replay_due = replay_start;
+
+  replay_timeout = g_timeout_add (0, gdk_replay_next, NULL);
+
+  return TRUE;
+}
+
+static void
+gdk_replay_stats_add (GdkReplayStats *stats,
+		      guint32	      usecs)
+{
+  gint bucket = 0;
+
+  while (bucket < REPLAY_NBUCKETS - 1 && (usecs >> (bucket + 1)))
+    bucket++;
+
+  stats->count++;
+  stats->total += usecs;
+  stats->max = MAX (stats->max, usecs);
+  stats->buckets[bucket]++;
+}
+
+/* Returns the upper bound of the bucket holding the given fraction. */
+static guint32
+gdk_replay_stats_percentile (GdkReplayStats *stats,
+			     gdouble	     fraction)
+{
+  guint count = 0;
+  gint bucket;
+
+  for (bucket = 0; bucket < REPLAY_NBUCKETS - 1; bucket++)
+    {
+      count += stats->buckets[bucket];
+      if (count >= fraction * stats->count)
+	break;
+    }
+
+  return MIN ((guint32) 2 << bucket, stats->max);
+}
+
+static void
+gdk_replay_report (void)
+{
+  GdkReplayStats *stats;
+  GTimeVal now;
+  gint i, bucket;
+
+  g_get_current_time (&now);
+
+  g_print ("Replayed events in %.3f s, %u skipped\n",
+	   time_diff (&now, &replay_start) / 1e6, replay_skipped);
+  g_print ("%-15s %8s %10s %10s %10s %10s %10s\n", "type", "count",
+	   "mean_us", "p50_us", "p90_us", "p99_us", "max_us");
+
+  for (i = 0; i < RECORD_NTYPES; i++)
+    {
+      stats = &replay_stats[i];
+      if (!stats->count)
+	continue;
+
+      g_print ("%-15s %8u %10.0f %10u %10u %10u %10u\n",
+	       record_type_names[i], stats->count, stats->total / stats->count,
+	       gdk_replay_stats_percentile (stats, 0.5),
+	       gdk_replay_stats_percentile (stats, 0.9),
+	       gdk_replay_stats_percentile (stats, 0.99),
+	       stats->max);
+      g_print ("%-15s", "");
+      for (bucket = 0; bucket < REPLAY_NBUCKETS; bucket++)
+	if (stats->buckets[bucket])
+	  g_print (" <%u:%u", 2 << bucket, stats->buckets[bucket]);
+      g_print ("\n");
+    }
+}
+
+static void
+gdk_replay_finish (void)
+{
+  gdk_replay_report ();
+
+  g_hash_table_destroy (replay_windows);
+  replay_windows = NULL;
+  g_free (replay_data);
+  replay_data = NULL;
+
+  if (getenv ("GDK_REPLAY_EXIT"))
+    gdk_exit (0);
+}
+
+/* Puts the events which are due on the queue. In fast mode, only one
+ * event is put at a time, and the next one when the main loop is idle.
+ */
+static gboolean
+gdk_replay_next (gpointer data)
+{
+  GdkRecordEvent record;
+  GdkEvent *event;
+  GTimeVal now, *due;
+  gchar *string;
+  glong delay;
+
+  GDK_THREADS_ENTER ();
+
+  replay_timeout = 0;
+  g_get_current_time (&now);
+
+  while (replay_position + sizeof (record) <= replay_end)
+    {
+      memcpy (&record, replay_position, sizeof (record));
+      if (replay_position + sizeof (record) + record.length > replay_end)
+	break;
+
+      if (replay_fast)
+	{
+	  if (replay_outstanding)
+	    break;
+	  replay_due = now;
+	}
+      else
+	{
+	  delay = time_diff (&replay_due, &now) + record.delay;
+	  if (delay > 0)
+	    {
+	      replay_timeout = g_timeout_add (MAX (delay / 1000, 1),
+					      gdk_replay_next, NULL);
+	      break;
+	    }
+	  time_add (&replay_due, record.delay);
+	}
+
+      replay_position += sizeof (record);
+      string = g_strndup (replay_position, record.length);
+      replay_position += record.length;
+
+      event = gdk_replay_event_new (&record, string);
+      if (event)
+	{
+	  due = g_new (GTimeVal, 1);
+	  *due = replay_due;
+	  replay_put_tail = g_slist_append (replay_put_tail, due);
+	  if (!replay_put)
+	    replay_put = replay_put_tail;
+	  else
+	    replay_put_tail = replay_put_tail->next;
+	  replay_outstanding++;
+
+	  gdk_event_put_replayed (event);
+	}
+      else
+	replay_skipped++;
+
+      g_free (string);
+    }
+
+  if (!replay_timeout && !replay_outstanding &&
+      replay_position + sizeof (record) > replay_end)
+    gdk_replay_finish ();
+
+  GDK_THREADS_LEAVE ();
+
+  return FALSE;
+}
+
+/* Called when the main loop has become idle after dispatching replayed
+ * events; this is where their latency is measured.
+ */
+static gboolean
+gdk_replay_idle (gpointer data)
+{
+  GSList *tmp_list;
+  GTimeVal now, *due;
+  GdkEventType type;
+  glong latency;
+
+  GDK_THREADS_ENTER ();
+
+  replay_idle = 0;
+  g_get_current_time (&now);
+
+  for (tmp_list = replay_dispatched; tmp_list; tmp_list = tmp_list->next->next)
+    {
+      type = GPOINTER_TO_INT (tmp_list->data);
+      due = tmp_list->next->data;
+      latency = time_diff (&now, due);
+      gdk_replay_stats_add (&replay_stats[type - RECORD_FIRST_TYPE],
+			    MAX (latency, 0));
+      g_free (due);
+      replay_outstanding--;
+    }
+  g_slist_free (replay_dispatched);
+  replay_dispatched = NULL;
+
+  if (!replay_timeout)
+    replay_timeout = g_timeout_add (0, gdk_replay_next, NULL);
+
+  GDK_THREADS_LEAVE ();
+
+  return FALSE;
+}
+
+void
+gdk_replay_event_dispatched (GdkEvent *event)
+{
+  GSList *node;
+
+  if (!replay_put)
+    return;
+
+  node = replay_put;
+  replay_put = node->next;
+  if (!replay_put)
+    replay_put_tail = NULL;
+
+  /* Pairs of the type and the due time. */
+  node->next = replay_dispatched;
+  replay_dispatched = g_slist_prepend (node, GINT_TO_POINTER (event->type));
+
+  if (!replay_idle)
+    replay_idle = g_idle_add_full (G_PRIORITY_LOW, gdk_replay_idle,
+				   NULL, NULL);
+}
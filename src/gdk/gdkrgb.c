@@ -2924,7 +2924,12 @@ gdk_rgb_alloc_scratch_image ()
   if (static_image_idx == N_REGIONS)
     {
 #ifndef NO_FLUSH
-      gdk_flush ();
+      /* Only shared memory images are read by the server after the
+       * request is sent, so only they need to wait before reuse;
+       * XPutImage copies normal images into the request.
+       */
+      if (static_image[0]->type == GDK_IMAGE_SHARED)
+	gdk_flush ();
 #endif
 #ifdef VERBOSE
       g_print ("flush, %d puts since last flush\n", sincelast);
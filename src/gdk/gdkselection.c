@@ -118,6 +118,7 @@ gdk_selection_property_get (GdkWindow  *requestor,
     return 0;
 
   t = NULL;
+  _gdk_round_trip ();
   XGetWindowProperty (private->xdisplay, private->xwindow,
 		      gdk_selection_property, 0, 0, False,
 		      AnyPropertyType, &prop_type, &prop_format,
@@ -148,6 +149,7 @@ gdk_selection_property_get (GdkWindow  *requestor,
      protocol, in which case the client has to make sure they'll be
      notified of PropertyChange events _before_ the property is deleted.
      Otherwise there's no guarantee we'll win the race ... */
+  _gdk_round_trip ();
   XGetWindowProperty (private->xdisplay, private->xwindow,
 		      gdk_selection_property, 0, (nbytes + 3) / 4, False,
 		      AnyPropertyType, &prop_type, &prop_format,
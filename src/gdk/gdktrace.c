@@ -0,0 +1,241 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Modified by the GTK+ Team and others 1997-1999.  See the AUTHORS
+ * file for a list of people on the GTK+ Team.  See the ChangeLog
+ * files for a list of changes.  These files are distributed with
+ * GTK+ at ftp://ftp.gtk.org/pub/gtk/. 
+ */
+
+/* Tracing of where the time goes. When GDK_TRACE is set to a file name,
+ * spans recorded with GDK_TRACE_BEGIN() and GDK_TRACE_END() are kept in
+ * a ring buffer per thread, and are written to that file on exit in the
+ * Chrome trace event format, so they can be loaded in chrome://tracing.
+ * When tracing is disabled the macros only test gdk_trace_enabled.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gdk.h"
+#include "gdkprivate.h"
+
+/* The number of begin and end records kept per thread. */
+#define TRACE_BUFFER_SIZE 65536
+
+typedef struct _GdkTraceRecord GdkTraceRecord;
+typedef struct _GdkTraceBuffer GdkTraceBuffer;
+
+struct _GdkTraceRecord
+{
+  const gchar *category;
+  const gchar *name;
+  const gchar *detail;
+  GTimeVal     time;
+  gchar        phase;
+};
+
+struct _GdkTraceBuffer
+{
+  GdkTraceBuffer *next;
+  guint           tid;
+  guint           n_records;	/* The total number recorded */
+  GdkTraceRecord  records[TRACE_BUFFER_SIZE];
+};
+
+static gchar *trace_file = NULL;
+static GTimeVal trace_start;
+static GPrivate *trace_key = NULL;
+static GdkTraceBuffer *trace_buffers = NULL;
+static GdkTraceBuffer *trace_main_buffer = NULL;
+static guint trace_n_buffers = 0;
+
+G_LOCK_DEFINE_STATIC (trace_buffers);
+
+void
+gdk_trace_init (void)
+{
+  gchar *file;
+
+  file = getenv ("GDK_TRACE");
+  if (!file || !file[0])
+    return;
+
+  trace_file = g_strdup (file);
+  g_get_current_time (&trace_start);
+  if (g_thread_supported ())
+    trace_key = g_private_new (NULL);
+
+  gdk_trace_enabled = TRUE;
+}
+
+void
+gdk_trace_exit (void)
+{
+  if (!gdk_trace_enabled)
+    return;
+
+  if (!gdk_trace_dump (trace_file))
+    g_warning ("Cannot write the trace to %s", trace_file);
+
+  gdk_trace_enabled = FALSE;
+}
+
+static GdkTraceBuffer*
+gdk_trace_get_buffer (void)
+{
+  GdkTraceBuffer *buffer;
+
+  buffer = trace_key ? g_private_get (trace_key) : trace_main_buffer;
+  if (buffer)
+    return buffer;
+
+  buffer = g_new (GdkTraceBuffer, 1);
+  buffer->n_records = 0;
+
+  G_LOCK (trace_buffers);
+  buffer->tid = ++trace_n_buffers;
+  buffer->next = trace_buffers;
+  trace_buffers = buffer;
+  G_UNLOCK (trace_buffers);
+
+  if (trace_key)
+    g_private_set (trace_key, buffer);
+  else
+    trace_main_buffer = buffer;
+
+  return buffer;
+}
+
+static void
+gdk_trace_record (gchar        phase,
+		  const gchar *category,
+		  const gchar *name,
+		  const gchar *detail)
+{
+  GdkTraceBuffer *buffer;
+  GdkTraceRecord *record;
+
+  buffer = gdk_trace_get_buffer ();
+  record = &buffer->records[buffer->n_records++ % TRACE_BUFFER_SIZE];
+
+  record->phase = phase;
+  record->category = category;
+  record->name = name;
+  record->detail = detail;
+  g_get_current_time (&record->time);
+}
+
+/* The strings are not copied, so they must stay around until the trace
+ * has been written; detail may be NULL. Spans must be properly nested
+ * within each thread.
+ */
+void
+gdk_trace_begin (const gchar *category,
+		 const gchar *name,
+		 const gchar *detail)
+{
+  gdk_trace_record ('B', category, name, detail);
+}
+
+void
+gdk_trace_end (void)
+{
+  gdk_trace_record ('E', NULL, NULL, NULL);
+}
+
+static void
+gdk_trace_write_string (FILE        *file,
+			const gchar *string)
+{
+  putc ('"', file);
+  for (; *string; string++)
+    {
+      if (*string == '"' || *string == '\\')
+	putc ('\\', file);
+      if ((guchar) *string >= ' ')
+	putc (*string, file);
+    }
+  putc ('"', file);
+}
+
+/* Writes the spans recorded so far to filename. The other threads
+ * should not be recording while this is done.
+ */
+gboolean
+gdk_trace_dump (const gchar *filename)
+{
+  GdkTraceBuffer *buffer;
+  GdkTraceRecord *record;
+  gboolean first = TRUE;
+  gulong timestamp;
+  guint i;
+  FILE *file;
+  gint pid;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  file = fopen (filename, "w");
+  if (!file)
+    return FALSE;
+
+  pid = getpid ();
+
+  fputs ("{\"traceEvents\":[", file);
+
+  G_LOCK (trace_buffers);
+  for (buffer = trace_buffers; buffer; buffer = buffer->next)
+    {
+      /* When the buffer has wrapped around, the oldest records are lost. */
+      i = buffer->n_records > TRACE_BUFFER_SIZE ?
+	buffer->n_records - TRACE_BUFFER_SIZE : 0;
+      for (; i < buffer->n_records; i++)
+	{
+	  record = &buffer->records[i % TRACE_BUFFER_SIZE];
+	  timestamp = (record->time.tv_sec - trace_start.tv_sec) * 1000000
+	    + (record->time.tv_usec - trace_start.tv_usec);
+
+	  fprintf (file, "%s\n{\"ph\":\"%c\",\"ts\":%lu,\"pid\":%d,\"tid\":%u",
+		   first ? "" : ",", record->phase, timestamp, pid, buffer->tid);
+	  first = FALSE;
+
+	  if (record->phase == 'B')
+	    {
+	      fputs (",\"cat\":", file);
+	      gdk_trace_write_string (file, record->category);
+	      fputs (",\"name\":", file);
+	      gdk_trace_write_string (file, record->name);
+	      if (record->detail)
+		{
+		  fputs (",\"args\":{\"detail\":", file);
+		  gdk_trace_write_string (file, record->detail);
+		  putc ('}', file);
+		}
+	    }
+	  putc ('}', file);
+	}
+    }
+  G_UNLOCK (trace_buffers);
+
+  fputs ("\n]}\n", file);
+
+  return fclose (file) == 0;
+}
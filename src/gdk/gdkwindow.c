@@ -219,8 +219,10 @@ gdk_window_init (void)
   unsigned int depth;
   int x, y;
   
+  _gdk_round_trip ();
   XGetGeometry (gdk_display, gdk_root_window, &gdk_root_window,
 		&x, &y, &width, &height, &border_width, &depth);
+  _gdk_round_trip ();
   XGetWindowAttributes (gdk_display, gdk_root_window, &xattributes);
   
   gdk_root_parent.xwindow = gdk_root_window;
@@ -232,6 +234,8 @@ gdk_window_init (void)
   gdk_root_parent.children = NULL;
   gdk_root_parent.colormap = NULL;
   gdk_root_parent.ref_count = 1;
+  gdk_root_parent.depth = depth;
+  gdk_root_parent.origin_valid = TRUE;
   
   gdk_xid_table_insert (&gdk_root_window, &gdk_root_parent);
 }
@@ -283,6 +287,8 @@ gdk_window_new (GdkWindow     *parent,
   private->guffaw_gravity = FALSE;
   private->resize_count = 0;
   private->ref_count = 1;
+  private->untracked = FALSE;
+  private->reparented = FALSE;
   xattributes_mask = 0;
   
   if (attributes_mask & GDK_WA_X)
@@ -297,6 +303,8 @@ gdk_window_new (GdkWindow     *parent,
   
   private->x = x;
   private->y = y;
+  private->root_x = x;
+  private->root_y = y;
   private->width = (attributes->width > 1) ? (attributes->width) : (1);
   private->height = (attributes->height > 1) ? (attributes->height) : (1);
   private->window_type = attributes->window_type;
@@ -404,12 +412,16 @@ gdk_window_new (GdkWindow     *parent,
       private->colormap = gdk_colormap_get_system ();
     }
   
+  private->depth = depth;
+  private->origin_valid = xparent == gdk_root_window;
+  private->geometry_serial = NextRequest (private->xdisplay);
   private->xwindow = XCreateWindow (private->xdisplay, xparent,
 				    x, y, private->width, private->height,
 				    0, depth, class, xvisual,
 				    xattributes_mask, &xattributes);
   gdk_window_ref (window);
   gdk_xid_table_insert (&private->xwindow, window);
+  gdk_record_window_new (window);
   
   if (private->colormap)
     gdk_colormap_ref (private->colormap);
@@ -541,6 +553,12 @@ gdk_window_foreign_new (guint32 anid)
   private->mapped = (attrs.map_state != IsUnmapped);
   private->guffaw_gravity = FALSE;
   private->extension_events = 0;
+  private->depth = attrs.depth;
+  private->origin_valid = FALSE;
+  private->reparented = FALSE;
+  private->untracked = TRUE;
+  private->geometry_serial = 0;
+  private->serial = 0;		/* Not numbered, see gdkrecord.c */
   
   private->colormap = NULL;
   
@@ -585,6 +603,8 @@ gdk_window_internal_destroy (GdkWindow *window,
     case GDK_WINDOW_FOREIGN:
       if (!private->destroyed)
 	{
+	  _gdk_draw_batch_discard (window);
+
 	  if (private->parent)
 	    {
 	      GdkWindowPrivate *parent_private = (GdkWindowPrivate *)private->parent;
@@ -736,6 +756,7 @@ gdk_window_unref (GdkWindow *window)
 	  else
 	    g_warning ("losing last reference to undestroyed window\n");
 	}
+      gdk_record_window_free (window);
       g_dataset_destroy (window);
       g_free (window);
     }
@@ -784,6 +805,34 @@ gdk_window_withdraw (GdkWindow *window)
     XWithdrawWindow (private->xdisplay, private->xwindow, 0);
 }
 
+/* Called before each request that moves or resizes @private. Batched
+ * drawing was meant for the old geometry, so it goes out first. Replies
+ * to anything older are stale, and a toplevel's origin is unknown
+ * until the window manager has told us where it ended up. Override
+ * redirect windows go exactly where they are told.
+ */
+static void
+gdk_window_geometry_request (GdkWindowPrivate *private,
+			     gboolean          move,
+			     gint              x,
+			     gint              y)
+{
+  _gdk_draw_batch_flush ();
+  private->geometry_serial = NextRequest (private->xdisplay);
+  
+  if (private->window_type == GDK_WINDOW_TEMP && !private->reparented)
+    {
+      if (move)
+	{
+	  private->root_x = x;
+	  private->root_y = y;
+	  private->origin_valid = TRUE;
+	}
+    }
+  else if (private->window_type != GDK_WINDOW_CHILD)
+    private->origin_valid = FALSE;
+}
+
 void
 gdk_window_move (GdkWindow *window,
 		 gint       x,
@@ -796,6 +845,7 @@ gdk_window_move (GdkWindow *window,
   private = (GdkWindowPrivate*) window;
   if (!private->destroyed)
     {
+      gdk_window_geometry_request (private, TRUE, x, y);
       XMoveWindow (private->xdisplay, private->xwindow, x, y);
       
       if (private->window_type == GDK_WINDOW_CHILD)
@@ -827,6 +877,7 @@ gdk_window_resize (GdkWindow *window,
        (private->width != (guint16) width) ||
        (private->height != (guint16) height)))
     {
+      gdk_window_geometry_request (private, FALSE, 0, 0);
       XResizeWindow (private->xdisplay, private->xwindow, width, height);
       private->resize_count += 1;
       
@@ -857,6 +908,7 @@ gdk_window_move_resize (GdkWindow *window,
   private = (GdkWindowPrivate*) window;
   if (!private->destroyed)
     {
+      gdk_window_geometry_request (private, TRUE, x, y);
       XMoveResizeWindow (private->xdisplay, private->xwindow, x, y, width, height);
       
       if (private->guffaw_gravity)
@@ -903,12 +955,25 @@ gdk_window_reparent (GdkWindow *window,
   parent_private = (GdkWindowPrivate*) new_parent;
   
   if (!window_private->destroyed && !parent_private->destroyed)
-    XReparentWindow (window_private->xdisplay,
-		     window_private->xwindow,
-		     parent_private->xwindow,
-		     x, y);
+    {
+      _gdk_draw_batch_flush ();
+      window_private->geometry_serial = NextRequest (window_private->xdisplay);
+      XReparentWindow (window_private->xdisplay,
+		       window_private->xwindow,
+		       parent_private->xwindow,
+		       x, y);
+    }
   
   window_private->parent = new_parent;
+  window_private->reparented = FALSE;
+  if (window_private->window_type == GDK_WINDOW_CHILD)
+    {
+      window_private->x = x;
+      window_private->y = y;
+    }
+  window_private->root_x = x;
+  window_private->root_y = y;
+  window_private->origin_valid = (parent_private->window_type == GDK_WINDOW_ROOT);
   
   if (old_parent_private)
     old_parent_private->children = g_list_remove (old_parent_private->children, window);
@@ -931,7 +996,10 @@ gdk_window_clear (GdkWindow *window)
   private = (GdkWindowPrivate*) window;
   
   if (!private->destroyed)
-    XClearWindow (private->xdisplay, private->xwindow);
+    {
+      _gdk_draw_batch_flush ();
+      XClearWindow (private->xdisplay, private->xwindow);
+    }
 }
 
 void
@@ -948,8 +1016,11 @@ gdk_window_clear_area (GdkWindow *window,
   private = (GdkWindowPrivate*) window;
   
   if (!private->destroyed)
-    XClearArea (private->xdisplay, private->xwindow,
-		x, y, width, height, False);
+    {
+      _gdk_draw_batch_flush ();
+      XClearArea (private->xdisplay, private->xwindow,
+		  x, y, width, height, False);
+    }
 }
 
 void
@@ -966,8 +1037,11 @@ gdk_window_clear_area_e (GdkWindow *window,
   private = (GdkWindowPrivate*) window;
   
   if (!private->destroyed)
-    XClearArea (private->xdisplay, private->xwindow,
-		x, y, width, height, True);
+    {
+      _gdk_draw_batch_flush ();
+      XClearArea (private->xdisplay, private->xwindow,
+		  x, y, width, height, True);
+    }
 }
 
 void
@@ -997,6 +1071,7 @@ gdk_window_copy_area (GdkWindow    *window,
   
   if (!src_private->destroyed && !dest_private->destroyed)
     {
+      _gdk_gc_flush (gc);
       XCopyArea (dest_private->xdisplay, src_private->xwindow, dest_private->xwindow,
 		 gc_private->xgc,
 		 source_x, source_y,
@@ -1260,7 +1335,11 @@ gdk_window_set_back_pixmap (GdkWindow *window,
     xpixmap = ParentRelative;
   
   if (!window_private->destroyed)
-    XSetWindowBackgroundPixmap (window_private->xdisplay, window_private->xwindow, xpixmap);
+    {
+      /* The pixmap may still have drawing batched for it */
+      _gdk_draw_batch_flush ();
+      XSetWindowBackgroundPixmap (window_private->xdisplay, window_private->xwindow, xpixmap);
+    }
 }
 
 void
@@ -1323,6 +1402,145 @@ gdk_window_get_user_data (GdkWindow *window,
   *data = window->user_data;
 }
 
+/* Walks from @private up to its toplevel, adding up the positions of
+ * the child windows on the way. Returns the toplevel, or NULL if
+ * some window on the way is not tracked.
+ */
+static GdkWindowPrivate *
+gdk_window_tracked_toplevel (GdkWindowPrivate *private,
+			     gint             *x,
+			     gint             *y)
+{
+  *x = 0;
+  *y = 0;
+  
+  while (private->parent && private->parent != (GdkWindow*) &gdk_root_parent)
+    {
+      if (private->window_type != GDK_WINDOW_CHILD ||
+	  private->destroyed || private->untracked)
+	return NULL;
+      
+      *x += private->x;
+      *y += private->y;
+      private = (GdkWindowPrivate*) private->parent;
+    }
+  
+  switch (private->window_type)
+    {
+    case GDK_WINDOW_ROOT:
+    case GDK_WINDOW_TOPLEVEL:
+    case GDK_WINDOW_DIALOG:
+    case GDK_WINDOW_TEMP:
+      break;
+    default:
+      return NULL;
+    }
+  
+  if (private->destroyed || private->untracked)
+    return NULL;
+  
+  return private;
+}
+
+static gboolean
+gdk_window_cached_origin (GdkWindowPrivate *private,
+			  gint             *x,
+			  gint             *y)
+{
+  GdkWindowPrivate *toplevel;
+  gint tx, ty;
+  
+  toplevel = gdk_window_tracked_toplevel (private, &tx, &ty);
+  if (!toplevel || !toplevel->origin_valid)
+    return FALSE;
+  
+  *x = toplevel->root_x + tx;
+  *y = toplevel->root_y + ty;
+  
+  return TRUE;
+}
+
+/* Records the origin of @window in root coordinates, as found out at
+ * request @serial. If @known is FALSE, the origin has changed to
+ * something we don't know.
+ */
+void
+gdk_window_origin_changed (GdkWindow *window,
+			   gboolean   known,
+			   gint       x,
+			   gint       y,
+			   gulong     serial)
+{
+  GdkWindowPrivate *private = (GdkWindowPrivate*) window;
+  
+  if ((glong) (serial - private->geometry_serial) < 0)
+    return;
+  
+  GDK_NOTE (MISC,
+	    if (known && private->origin_valid &&
+		(private->root_x != x || private->root_y != y))
+	      g_message ("origin of %#lx moved to %d,%d",
+			 private->xwindow, x, y));
+  
+  private->geometry_serial = serial;
+  private->origin_valid = known;
+  private->root_x = x;
+  private->root_y = y;
+}
+
+/* Stores the root origin of a toplevel found by a round trip through
+ * one of its descendants.
+ */
+static void
+gdk_window_cache_origin (GdkWindowPrivate *private,
+			 gint              x,
+			 gint              y,
+			 gulong            serial)
+{
+  GdkWindowPrivate *toplevel;
+  gint tx, ty;
+  
+  toplevel = gdk_window_tracked_toplevel (private, &tx, &ty);
+  if (toplevel && toplevel->window_type != GDK_WINDOW_ROOT)
+    gdk_window_origin_changed ((GdkWindow*) toplevel, TRUE,
+			       x - tx, y - ty, serial);
+}
+
+void
+gdk_window_set_geometry_tracking (GdkWindow *window,
+				  gboolean   track)
+{
+  GdkWindowPrivate *private;
+  Window root;
+  gint tx, ty;
+  guint twidth, theight, tborder_width, tdepth;
+  
+  g_return_if_fail (window != NULL);
+  
+  private = (GdkWindowPrivate*) window;
+  g_return_if_fail (private->window_type != GDK_WINDOW_PIXMAP);
+  
+  if (!track == !!private->untracked)
+    return;
+  
+  private->untracked = !track;
+  private->origin_valid = FALSE;
+  
+  /* Whatever we remember may be out of date by now
+   */
+  if (track && !private->destroyed &&
+      private->window_type == GDK_WINDOW_CHILD)
+    {
+      private->geometry_serial = NextRequest (private->xdisplay);
+      XGetGeometry (private->xdisplay, private->xwindow,
+		    &root, &tx, &ty, &twidth, &theight, &tborder_width, &tdepth);
+      private->x = tx;
+      private->y = ty;
+      private->width = twidth;
+      private->height = theight;
+    }
+}
+
 void
 gdk_window_get_geometry (GdkWindow *window,
 			 gint      *x,
@@ -1347,8 +1565,25 @@ gdk_window_get_geometry (GdkWindow *window,
   
   if (!window_private->destroyed)
     {
-      XGetGeometry (window_private->xdisplay, window_private->xwindow,
-		    &root, &tx, &ty, &twidth, &theight, &tborder_width, &tdepth);
+      /* Child windows only move when we ask them to, so what we have
+       * is what the server has.
+       */
+      if ((window_private->window_type == GDK_WINDOW_CHILD &&
+	   !window_private->untracked) ||
+	  window_private->window_type == GDK_WINDOW_ROOT)
+	{
+	  tx = window_private->x;
+	  ty = window_private->y;
+	  twidth = window_private->width;
+	  theight = window_private->height;
+	  tdepth = window_private->depth;
+	}
+      else
+	{
+	  _gdk_round_trip ();
+	  XGetGeometry (window_private->xdisplay, window_private->xwindow,
+			&root, &tx, &ty, &twidth, &theight, &tborder_width, &tdepth);
+	}
       
       if (x)
 	*x = tx;
@@ -1473,6 +1708,7 @@ gdk_window_get_origin (GdkWindow *window,
   GdkWindowPrivate *private;
   gint return_val;
   Window child;
+  gulong serial;
   gint tx = 0;
   gint ty = 0;
   
@@ -1480,17 +1716,22 @@ gdk_window_get_origin (GdkWindow *window,
   
   private = (GdkWindowPrivate*) window;
   
-  if (!private->destroyed)
+  if (private->destroyed)
+    return_val = 0;
+  else if (gdk_window_cached_origin (private, &tx, &ty))
+    return_val = 1;
+  else
     {
+      serial = NextRequest (private->xdisplay);
+      _gdk_round_trip ();
       return_val = XTranslateCoordinates (private->xdisplay,
 					  private->xwindow,
 					  gdk_root_window,
 					  0, 0, &tx, &ty,
 					  &child);
-      
+      if (return_val)
+	gdk_window_cache_origin (private, tx, ty, serial);
     }
-  else
-    return_val = 0;
   
   if (x)
     *x = tx;
@@ -1513,8 +1754,10 @@ gdk_window_get_deskrelative_origin (GdkWindow *window,
   gint ty = 0;
   Atom type_return;
   static Atom atom = 0;
+  static gboolean atom_checked = FALSE;
   gulong number_return, bytes_after_return;
   guchar *data_return;
+  GdkWindowPrivate *toplevel;
   
   g_return_val_if_fail (window != NULL, 0);
   
@@ -1522,8 +1765,28 @@ gdk_window_get_deskrelative_origin (GdkWindow *window,
   
   if (!private->destroyed)
     {
-      if (!atom)
-	atom = XInternAtom (private->xdisplay, "ENLIGHTENMENT_DESKTOP", False);
+      /* Only Enlightenment has desktop windows; when it isn't running,
+       * or our toplevel sits directly on the root window, this is the
+       * same as the root origin.
+       */
+      if (!atom_checked)
+	{
+	  atom = gdk_atom_intern ("ENLIGHTENMENT_DESKTOP", TRUE);
+	  atom_checked = TRUE;
+	}
+      toplevel = gdk_window_tracked_toplevel (private, &tx, &ty);
+      if (toplevel && toplevel->origin_valid &&
+	  (atom == None || !toplevel->reparented))
+	{
+	  if (x)
+	    *x = toplevel->root_x + tx;
+	  if (y)
+	    *y = toplevel->root_y + ty;
+	  return TRUE;
+	}
+      if (atom == None)
+	return gdk_window_get_origin (window, x, y);
+      
       win = private->xwindow;
       
       while (XQueryTree (private->xdisplay, win, &root, &parent,
@@ -1643,6 +1906,7 @@ gdk_window_get_pointer (GdkWindow       *window,
   private = (GdkWindowPrivate*) window;
   
   return_val = NULL;
+  _gdk_round_trip ();
   if (!private->destroyed &&
       XQueryPointer (private->xdisplay, private->xwindow, &root, &child,
 		     &rootx, &rooty, &winx, &winy, &xmask))
@@ -1682,6 +1946,7 @@ gdk_window_at_pointer (gint *win_x,
   while (xwindow)
     {
       xwindow_last = xwindow;
+      _gdk_round_trip ();
       XQueryPointer (private->xdisplay,
 		     xwindow,
 		     &root, &xwindow,
@@ -1920,6 +2185,7 @@ gdk_window_shape_combine_mask (GdkWindow *window,
 	  pixmap = None;
 	}
       
+      _gdk_draw_batch_flush ();
       XShapeCombineMask (window_private->xdisplay,
 			 window_private->xwindow,
 			 ShapeBounding,
@@ -2061,6 +2327,10 @@ gdk_window_set_icon (GdkWindow *window,
       wm_hints->icon_mask = private->xwindow;
     }
 
+  /* The window manager reads the icon pixmaps as soon as it sees
+   * the hints, so their contents must be on the server first */
+  if (pixmap != NULL || mask != NULL)
+    _gdk_draw_batch_flush ();
   XSetWMHints (window_private->xdisplay, window_private->xwindow, wm_hints);
   XFree (wm_hints);
 }
@@ -2139,8 +2409,7 @@ gdk_window_set_mwm_hints (GdkWindow *window,
     return;
   
   if (!hints_atom)
-    hints_atom = XInternAtom (window_private->xdisplay, 
-			      _XA_MOTIF_WM_HINTS, FALSE);
+    hints_atom = gdk_atom_intern (_XA_MOTIF_WM_HINTS, FALSE);
   
   XGetWindowProperty (window_private->xdisplay, window_private->xwindow,
 		      hints_atom, 0, sizeof (MotifWmHints)/sizeof (long),
@@ -30,6 +30,7 @@
 #include <ctype.h>
 #include <string.h>
 #include "gtkaccelgroup.h"
+#include "gtkprivate.h"
 #include "gdk/gdkkeysyms.h"
 #include "gtksignal.h"
 #include "gtkwidget.h"
@@ -61,6 +62,7 @@ static guint		 accel_entries_key_id = 0;
 static GHashTable	*accel_entry_hash_table = NULL;
 static GMemChunk	*accel_tables_mem_chunk = NULL;
 static GMemChunk	*accel_entries_mem_chunk = NULL;
+static GSList		*accel_group_miss_funcs = NULL;
 
 
 /* --- functions --- */
@@ -252,6 +254,45 @@ gtk_accel_group_lookup (GtkAccelGroup	*accel_group,
   return g_hash_table_lookup (accel_entry_hash_table, &key_entry);
 }
 
+static GtkAccelEntry*
+gtk_accel_group_lookup_or_miss (GtkAccelGroup	*accel_group,
+				guint		 accel_key,
+				GdkModifierType	 accel_mods)
+{
+  GtkAccelEntry *entry;
+  GSList *slist;
+
+  entry = gtk_accel_group_lookup (accel_group, accel_key, accel_mods);
+  for (slist = accel_group_miss_funcs; slist && !entry; slist = slist->next)
+    {
+      GtkAccelGroupMissFunc func = (GtkAccelGroupMissFunc) slist->data;
+
+      if (func (accel_group, accel_key, accel_mods))
+	entry = gtk_accel_group_lookup (accel_group, accel_key, accel_mods);
+    }
+
+  return entry;
+}
+
+void
+gtk_accel_group_add_miss_func (GtkAccelGroupMissFunc func)
+{
+  g_return_if_fail (func != NULL);
+
+  if (!g_slist_find (accel_group_miss_funcs, (gpointer) func))
+    accel_group_miss_funcs = g_slist_append (accel_group_miss_funcs,
+					     (gpointer) func);
+}
+
+void
+gtk_accel_group_remove_miss_func (GtkAccelGroupMissFunc func)
+{
+  g_return_if_fail (func != NULL);
+
+  accel_group_miss_funcs = g_slist_remove (accel_group_miss_funcs,
+					   (gpointer) func);
+}
+
 gboolean
 gtk_accel_group_activate (GtkAccelGroup	 *accel_group,
 			  guint		  accel_key,
@@ -261,7 +302,7 @@ gtk_accel_group_activate (GtkAccelGroup	 *accel_group,
   
   g_return_val_if_fail (accel_group != NULL, FALSE);
   
-  entry = gtk_accel_group_lookup (accel_group, accel_key, accel_mods);
+  entry = gtk_accel_group_lookup_or_miss (accel_group, accel_key, accel_mods);
   if (entry && entry->signal_id &&
       (!GTK_IS_WIDGET (entry->object) || GTK_WIDGET_IS_SENSITIVE (entry->object)))
     {
@@ -31,10 +31,12 @@
 
 
 #define	MAX_ARG_LENGTH	(256)
+#define	MAX_ARG_CACHE	(4096)
 
 
 /* --- typedefs --- */
 typedef struct _GtkArgQueryData	GtkArgQueryData;
+typedef struct _GtkArgCacheKey	GtkArgCacheKey;
 
 
 /* --- structures --- */
@@ -43,10 +45,87 @@ struct _GtkArgQueryData
   GList *arg_list;
   GtkType class_type;
 };
+struct _GtkArgCacheKey
+{
+  GHashTable *arg_info_hash_table;
+  GtkType object_type;
+  gchar *arg_name;
+};
+
+
+/* --- variables --- */
+/* resolved (info table, object type, arg name) triples, so repeated
+ * lookups of the same name skip the parsing and the walk up the
+ * class ancestry in gtk_arg_get_info().
+ */
+static GHashTable *arg_cache_ht = NULL;
 
 
 
 /* --- functions --- */
+static guint
+gtk_arg_cache_key_hash (gconstpointer key)
+{
+  const GtkArgCacheKey *ckey = key;
+
+  return (g_str_hash (ckey->arg_name) ^
+	  ckey->object_type ^
+	  GPOINTER_TO_UINT (ckey->arg_info_hash_table));
+}
+
+static gint
+gtk_arg_cache_key_equal (gconstpointer key_1,
+			 gconstpointer key_2)
+{
+  const GtkArgCacheKey *ckey1 = key_1;
+  const GtkArgCacheKey *ckey2 = key_2;
+
+  return (ckey1->object_type == ckey2->object_type &&
+	  ckey1->arg_info_hash_table == ckey2->arg_info_hash_table &&
+	  strcmp (ckey1->arg_name, ckey2->arg_name) == 0);
+}
+
+static gboolean
+gtk_arg_cache_free_entry (gpointer key,
+			  gpointer value,
+			  gpointer user_data)
+{
+  GtkArgCacheKey *ckey = key;
+
+  g_free (ckey->arg_name);
+  g_free (ckey);
+
+  return TRUE;
+}
+
+static void
+gtk_arg_cache_flush (void)
+{
+  if (arg_cache_ht)
+    g_hash_table_foreach_remove (arg_cache_ht, gtk_arg_cache_free_entry, NULL);
+}
+
+static void
+gtk_arg_cache_insert (GHashTable  *arg_info_hash_table,
+		      GtkType      object_type,
+		      const gchar *arg_name,
+		      GtkArgInfo  *info)
+{
+  GtkArgCacheKey *ckey;
+
+  if (!arg_cache_ht)
+    arg_cache_ht = g_hash_table_new (gtk_arg_cache_key_hash,
+				     gtk_arg_cache_key_equal);
+  else if (g_hash_table_size (arg_cache_ht) >= MAX_ARG_CACHE)
+    gtk_arg_cache_flush ();
+
+  ckey = g_new (GtkArgCacheKey, 1);
+  ckey->arg_info_hash_table = arg_info_hash_table;
+  ckey->object_type = object_type;
+  ckey->arg_name = g_strdup (arg_name);
+  g_hash_table_insert (arg_cache_ht, ckey, info);
+}
+
 GtkArgInfo*
 gtk_arg_type_new_static (GtkType      base_class_type,
 			 const gchar *arg_name,
@@ -111,6 +190,10 @@ gtk_arg_type_new_static (GtkType      base_class_type,
 
   g_hash_table_insert (arg_info_hash_table, info, info);
 
+  /* a new argument may shadow one that a subtype's name resolved to
+   */
+  gtk_arg_cache_flush ();
+
   return info;
 }
 
@@ -151,15 +234,29 @@ gtk_arg_get_info (GtkType       object_type,
 {
   GtkType otype;
   gchar buffer[MAX_ARG_LENGTH];
+  const gchar *full_name;
   guint len;
   gchar *p;
   
   *info_p = NULL;
+
+  if (arg_name && arg_cache_ht)
+    {
+      GtkArgCacheKey ckey;
+
+      ckey.arg_info_hash_table = arg_info_hash_table;
+      ckey.object_type = object_type;
+      ckey.arg_name = (gchar*) arg_name;
+      *info_p = g_hash_table_lookup (arg_cache_ht, &ckey);
+      if (*info_p)
+	return NULL;
+    }
   
   /* security audit
    */
   if (!arg_name || strlen (arg_name) > MAX_ARG_LENGTH - 8)
     return g_strdup ("argument name exceeds maximum size.");
+  full_name = arg_name;
 
   /* split off the object-type part
    */
@@ -235,6 +332,8 @@ gtk_arg_get_info (GtkType       object_type,
 			"' class ancestry",
 			NULL);
 
+  gtk_arg_cache_insert (arg_info_hash_table, object_type, full_name, *info_p);
+
   return NULL;
 }
 
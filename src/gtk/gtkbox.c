@@ -25,6 +25,7 @@
  */
 
 #include "gtkbox.h"
+#include "gtkchildindex.h"
 
 enum {
   ARG_0,
@@ -339,6 +340,7 @@ gtk_box_pack_start (GtkBox    *box,
   child_info->pack = GTK_PACK_START;
 
   box->children = g_list_append (box->children, child_info);
+  gtk_child_index_add (GTK_WIDGET (box), g_list_last (box->children));
 
   gtk_widget_set_parent (child, GTK_WIDGET (box));
   
@@ -376,6 +378,7 @@ gtk_box_pack_end (GtkBox    *box,
   child_info->pack = GTK_PACK_END;
 
   box->children = g_list_append (box->children, child_info);
+  gtk_child_index_add (GTK_WIDGET (box), g_list_last (box->children));
 
   gtk_widget_set_parent (child, GTK_WIDGET (box));
 
@@ -452,17 +455,7 @@ gtk_box_reorder_child (GtkBox                   *box,
   g_return_if_fail (GTK_IS_BOX (box));
   g_return_if_fail (child != NULL);
 
-  list = box->children;
-  while (list)
-    {
-      GtkBoxChild *child_info;
-
-      child_info = list->data;
-      if (child_info->widget == child)
-	break;
-
-      list = list->next;
-    }
+  list = gtk_child_index_find (GTK_WIDGET (box), box->children, child);
 
   if (list && box->children->next)
     {
@@ -499,6 +492,8 @@ gtk_box_reorder_child (GtkBox                   *box,
 	  list->next = tmp_list;
 	}
 
+      gtk_child_index_invalidate (GTK_WIDGET (box));
+
       if (GTK_WIDGET_VISIBLE (child) && GTK_WIDGET_VISIBLE (box))
 	gtk_widget_queue_resize (child);
     }
@@ -519,18 +514,12 @@ gtk_box_query_child_packing (GtkBox             *box,
   g_return_if_fail (GTK_IS_BOX (box));
   g_return_if_fail (child != NULL);
 
-  list = box->children;
-  while (list)
-    {
-      child_info = list->data;
-      if (child_info->widget == child)
-	break;
-
-      list = list->next;
-    }
+  list = gtk_child_index_find (GTK_WIDGET (box), box->children, child);
 
   if (list)
     {
+      child_info = list->data;
+
       if (expand)
 	*expand = child_info->expand;
       if (fill)
@@ -557,18 +546,12 @@ gtk_box_set_child_packing (GtkBox               *box,
   g_return_if_fail (GTK_IS_BOX (box));
   g_return_if_fail (child != NULL);
 
-  list = box->children;
-  while (list)
-    {
-      child_info = list->data;
-      if (child_info->widget == child)
-	break;
-
-      list = list->next;
-    }
+  list = gtk_child_index_find (GTK_WIDGET (box), box->children, child);
 
   if (list)
     {
+      child_info = list->data;
+
       child_info->expand = expand != FALSE;
       child_info->fill = fill != FALSE;
       child_info->padding = padding;
@@ -632,66 +615,58 @@ gtk_box_unmap (GtkWidget *widget)
     }
 }
 
+static void
+gtk_box_draw_child (gpointer data,
+		    gpointer user_data)
+{
+  GtkBoxChild *child = data;
+  GdkRectangle *area = user_data;
+  GdkRectangle child_area;
+
+  if (GTK_WIDGET_DRAWABLE (child->widget) &&
+      gtk_widget_intersect (child->widget, area, &child_area))
+    gtk_widget_draw (child->widget, &child_area);
+}
+
 static void
 gtk_box_draw (GtkWidget    *widget,
 	      GdkRectangle *area)
 {
-  GtkBox *box;
-  GtkBoxChild *child;
-  GdkRectangle child_area;
-  GList *children;
-  
   g_return_if_fail (widget != NULL);
   g_return_if_fail (GTK_IS_BOX (widget));
    
   if (GTK_WIDGET_DRAWABLE (widget))
-    {
-      box = GTK_BOX (widget);
-	
-      children = box->children;
-      while (children)
-	{
-	  child = children->data;
-	  children = children->next;
-	     
-	  if (GTK_WIDGET_DRAWABLE (child->widget) &&
-	      gtk_widget_intersect (child->widget, area, &child_area))
-	    gtk_widget_draw (child->widget, &child_area);
-	}
-    }
+    gtk_child_index_foreach (widget, GTK_BOX (widget)->children, area,
+			     gtk_box_draw_child, area);
+}
+
+static void
+gtk_box_expose_child (gpointer data,
+		      gpointer user_data)
+{
+  GtkBoxChild *child = data;
+  GdkEventExpose *event = user_data;
+  GdkEventExpose child_event;
+
+  child_event = *event;
+
+  if (GTK_WIDGET_DRAWABLE (child->widget) &&
+      GTK_WIDGET_NO_WINDOW (child->widget) &&
+      gtk_widget_intersect (child->widget, &event->area, &child_event.area))
+    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
 }
 
 static gint
 gtk_box_expose (GtkWidget      *widget,
 		GdkEventExpose *event)
 {
-  GtkBox *box;
-  GtkBoxChild *child;
-  GdkEventExpose child_event;
-  GList *children;
-
   g_return_val_if_fail (widget != NULL, FALSE);
   g_return_val_if_fail (GTK_IS_BOX (widget), FALSE);
   g_return_val_if_fail (event != NULL, FALSE);
 
   if (GTK_WIDGET_DRAWABLE (widget))
-    {
-      box = GTK_BOX (widget);
-
-      child_event = *event;
-
-      children = box->children;
-      while (children)
-	{
-	  child = children->data;
-	  children = children->next;
-
-	  if (GTK_WIDGET_DRAWABLE (child->widget) &&
-	      GTK_WIDGET_NO_WINDOW (child->widget) &&
-	      gtk_widget_intersect (child->widget, &event->area, &child_event.area))
-	    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
-	}
-    }
+    gtk_child_index_foreach (widget, GTK_BOX (widget)->children, &event->area,
+			     gtk_box_expose_child, event);
 
   return FALSE;
 }
@@ -721,32 +696,26 @@ gtk_box_remove (GtkContainer *container,
 
   box = GTK_BOX (container);
 
-  children = box->children;
-  while (children)
+  children = gtk_child_index_find (GTK_WIDGET (box), box->children, widget);
+  if (children)
     {
-      child = children->data;
-
-      if (child->widget == widget)
-	{
-	  gboolean was_visible;
-
-	  was_visible = GTK_WIDGET_VISIBLE (widget);
-	  gtk_widget_unparent (widget);
+      gboolean was_visible;
 
-	  box->children = g_list_remove_link (box->children, children);
-	  g_list_free (children);
-	  g_free (child);
+      child = children->data;
 
-	  /* queue resize regardless of GTK_WIDGET_VISIBLE (container),
-	   * since that's what is needed by toplevels.
-	   */
-	  if (was_visible)
-	    gtk_widget_queue_resize (GTK_WIDGET (container));
+      was_visible = GTK_WIDGET_VISIBLE (widget);
+      gtk_widget_unparent (widget);
 
-	  break;
-	}
+      gtk_child_index_remove (GTK_WIDGET (box), widget);
+      box->children = g_list_remove_link (box->children, children);
+      g_list_free (children);
+      g_free (child);
 
-      children = children->next;
+      /* queue resize regardless of GTK_WIDGET_VISIBLE (container),
+       * since that's what is needed by toplevels.
+       */
+      if (was_visible)
+	gtk_widget_queue_resize (GTK_WIDGET (container));
     }
 }
 
@@ -0,0 +1,464 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Modified by the GTK+ Team and others 1997-1999.  See the AUTHORS
+ * file for a list of people on the GTK+ Team.  See the ChangeLog
+ * files for a list of changes.  These files are distributed with
+ * GTK+ at ftp://ftp.gtk.org/pub/gtk/.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "gtkchildindex.h"
+#include "gtkprivate.h"
+
+
+/* Containers with fewer children than this are just walked */
+#define GTK_CHILD_INDEX_THRESHOLD  32
+
+/* Children covering more grid cells than this are kept in a separate
+ * list that every query visits */
+#define GTK_CHILD_INDEX_LARGE_CELLS 16
+
+#define CHILD_WIDGET(info) (*(GtkWidget **)(info))
+
+typedef struct _GtkChildIndex GtkChildIndex;
+
+struct _GtkChildIndex
+{
+  /* child widget -> link in the container's list */
+  GHashTable *links;
+
+  /* The grid. The entries are the child structures in list order, the
+   * cells hold indices into them, cell c using the range
+   * cell_start[c] .. cell_start[c + 1] of cell_entries.
+   */
+  guint grid_valid : 1;
+  guint n_entries;
+  gpointer *entries;
+  guint *stamps;
+  guint stamp;
+  gint x, y;
+  gint cell_width, cell_height;
+  gint n_cols, n_rows;
+  guint *cell_start;
+  guint *cell_entries;
+  guint *large;
+  guint n_large;
+};
+
+static const gchar *child_index_key = "gtk-child-index";
+static guint        child_index_key_id = 0;
+
+static void
+gtk_child_index_free_grid (GtkChildIndex *index)
+{
+  g_free (index->entries);
+  g_free (index->stamps);
+  g_free (index->cell_start);
+  g_free (index->cell_entries);
+  g_free (index->large);
+
+  index->entries = NULL;
+  index->stamps = NULL;
+  index->cell_start = NULL;
+  index->cell_entries = NULL;
+  index->large = NULL;
+  index->n_entries = 0;
+  index->n_large = 0;
+  index->grid_valid = FALSE;
+}
+
+static void
+gtk_child_index_free (gpointer data)
+{
+  GtkChildIndex *index = data;
+
+  gtk_child_index_free_grid (index);
+  g_hash_table_destroy (index->links);
+  g_free (index);
+}
+
+static GtkChildIndex *
+gtk_child_index_get (GtkWidget *container)
+{
+  if (!GTK_WIDGET_HAS_CHILD_INDEX (container))
+    return NULL;
+
+  return gtk_object_get_data_by_id (GTK_OBJECT (container), child_index_key_id);
+}
+
+static GtkChildIndex *
+gtk_child_index_create (GtkWidget *container,
+			GList     *children)
+{
+  GtkChildIndex *index;
+
+  if (!child_index_key_id)
+    child_index_key_id = g_quark_from_static_string (child_index_key);
+
+  index = g_new0 (GtkChildIndex, 1);
+  index->links = g_hash_table_new (g_direct_hash, NULL);
+
+  for (; children; children = children->next)
+    g_hash_table_insert (index->links, CHILD_WIDGET (children->data), children);
+
+  gtk_object_set_data_by_id_full (GTK_OBJECT (container), child_index_key_id,
+				  index, gtk_child_index_free);
+  GTK_PRIVATE_SET_FLAG (container, GTK_HAS_CHILD_INDEX);
+
+  return index;
+}
+
+/* Returns the index, creating it once @children is long enough */
+static GtkChildIndex *
+gtk_child_index_ensure (GtkWidget *container,
+			GList     *children)
+{
+  GtkChildIndex *index;
+  GList *tmp_list;
+  guint n;
+
+  index = gtk_child_index_get (container);
+  if (index)
+    return index;
+
+  for (tmp_list = children, n = 0;
+       tmp_list && n < GTK_CHILD_INDEX_THRESHOLD;
+       tmp_list = tmp_list->next)
+    n++;
+
+  if (n < GTK_CHILD_INDEX_THRESHOLD)
+    return NULL;
+
+  return gtk_child_index_create (container, children);
+}
+
+GList*
+gtk_child_index_find (GtkWidget *container,
+		      GList     *children,
+		      GtkWidget *child)
+{
+  GtkChildIndex *index;
+  GList *tmp_list;
+  guint n;
+
+  g_return_val_if_fail (container != NULL, NULL);
+
+  index = gtk_child_index_get (container);
+  if (index)
+    return g_hash_table_lookup (index->links, child);
+
+  for (tmp_list = children, n = 0; tmp_list; tmp_list = tmp_list->next, n++)
+    if (CHILD_WIDGET (tmp_list->data) == child)
+      break;
+
+  /* The search was long enough to be worth an index next time */
+  if (n >= GTK_CHILD_INDEX_THRESHOLD)
+    gtk_child_index_create (container, children);
+
+  return tmp_list;
+}
+
+void
+gtk_child_index_add (GtkWidget *container,
+		     GList     *link)
+{
+  GtkChildIndex *index;
+
+  g_return_if_fail (container != NULL);
+  g_return_if_fail (link != NULL);
+
+  index = gtk_child_index_get (container);
+  if (index)
+    {
+      g_hash_table_insert (index->links, CHILD_WIDGET (link->data), link);
+      gtk_child_index_free_grid (index);
+    }
+}
+
+void
+gtk_child_index_remove (GtkWidget *container,
+			GtkWidget *child)
+{
+  GtkChildIndex *index;
+
+  g_return_if_fail (container != NULL);
+
+  index = gtk_child_index_get (container);
+  if (index)
+    {
+      g_hash_table_remove (index->links, child);
+      gtk_child_index_free_grid (index);
+    }
+}
+
+void
+gtk_child_index_invalidate (GtkWidget *container)
+{
+  GtkChildIndex *index;
+
+  g_return_if_fail (container != NULL);
+
+  index = gtk_child_index_get (container);
+  if (index)
+    index->grid_valid = FALSE;
+}
+
+static void
+gtk_child_index_cells (GtkChildIndex *index,
+		       GdkRectangle  *area,
+		       gint          *col1,
+		       gint          *row1,
+		       gint          *col2,
+		       gint          *row2)
+{
+  *col1 = (area->x - index->x) / index->cell_width;
+  *row1 = (area->y - index->y) / index->cell_height;
+  *col2 = (area->x + area->width - 1 - index->x) / index->cell_width;
+  *row2 = (area->y + area->height - 1 - index->y) / index->cell_height;
+
+  *col1 = CLAMP (*col1, 0, index->n_cols - 1);
+  *row1 = CLAMP (*row1, 0, index->n_rows - 1);
+  *col2 = CLAMP (*col2, 0, index->n_cols - 1);
+  *row2 = CLAMP (*row2, 0, index->n_rows - 1);
+}
+
+static void
+gtk_child_index_build (GtkChildIndex *index,
+		       GList         *children)
+{
+  GdkRectangle bbox = { 0, 0, 0, 0 };
+  GList *tmp_list;
+  guint n_cells, n_sized;
+  guint i, c;
+  gint col1, row1, col2, row2, row, col;
+  guint *fill;
+
+  gtk_child_index_free_grid (index);
+
+  index->n_entries = g_list_length (children);
+  index->entries = g_new (gpointer, MAX (index->n_entries, 1));
+  index->stamps = g_new0 (guint, MAX (index->n_entries, 1));
+  index->large = g_new (guint, MAX (index->n_entries, 1));
+  index->stamp = 0;
+
+  n_sized = 0;
+  for (tmp_list = children, i = 0; tmp_list; tmp_list = tmp_list->next, i++)
+    {
+      GtkWidget *widget = CHILD_WIDGET (tmp_list->data);
+
+      index->entries[i] = tmp_list->data;
+      if (widget->allocation.width > 0 && widget->allocation.height > 0)
+	{
+	  GdkRectangle area;
+
+	  area.x = widget->allocation.x;
+	  area.y = widget->allocation.y;
+	  area.width = widget->allocation.width;
+	  area.height = widget->allocation.height;
+
+	  if (n_sized++)
+	    gdk_rectangle_union (&bbox, &area, &bbox);
+	  else
+	    bbox = area;
+	}
+    }
+
+  /* Aim for about one child per cell, with the cells following the
+   * aspect ratio of the area the children cover */
+  n_sized = MAX (n_sized, 1);
+  bbox.width = MAX (bbox.width, 1);
+  bbox.height = MAX (bbox.height, 1);
+
+  index->n_cols = sqrt ((gdouble) n_sized * bbox.width / bbox.height) + 0.5;
+  index->n_cols = CLAMP (index->n_cols, 1, MIN (n_sized, bbox.width));
+  index->n_rows = (n_sized + index->n_cols - 1) / index->n_cols;
+  index->n_rows = CLAMP (index->n_rows, 1, bbox.height);
+
+  index->x = bbox.x;
+  index->y = bbox.y;
+  index->cell_width = (bbox.width + index->n_cols - 1) / index->n_cols;
+  index->cell_height = (bbox.height + index->n_rows - 1) / index->n_rows;
+
+  n_cells = index->n_cols * index->n_rows;
+  index->cell_start = g_new0 (guint, n_cells + 1);
+
+  /* First pass counts the entries of each cell, second fills them in */
+  for (i = 0; i < index->n_entries; i++)
+    {
+      GtkWidget *widget = CHILD_WIDGET (index->entries[i]);
+      GdkRectangle area;
+
+      if (widget->allocation.width <= 0 || widget->allocation.height <= 0)
+	continue;
+
+      area.x = widget->allocation.x;
+      area.y = widget->allocation.y;
+      area.width = widget->allocation.width;
+      area.height = widget->allocation.height;
+      gtk_child_index_cells (index, &area, &col1, &row1, &col2, &row2);
+
+      if ((col2 - col1 + 1) * (row2 - row1 + 1) > GTK_CHILD_INDEX_LARGE_CELLS)
+	{
+	  index->large[index->n_large++] = i;
+	  continue;
+	}
+
+      for (row = row1; row <= row2; row++)
+	for (col = col1; col <= col2; col++)
+	  index->cell_start[row * index->n_cols + col + 1]++;
+    }
+
+  for (c = 0; c < n_cells; c++)
+    index->cell_start[c + 1] += index->cell_start[c];
+
+  index->cell_entries = g_new (guint, MAX (index->cell_start[n_cells], 1));
+  fill = g_new (guint, n_cells);
+  for (c = 0; c < n_cells; c++)
+    fill[c] = index->cell_start[c];
+
+  for (i = 0; i < index->n_entries; i++)
+    {
+      GtkWidget *widget = CHILD_WIDGET (index->entries[i]);
+      GdkRectangle area;
+
+      if (widget->allocation.width <= 0 || widget->allocation.height <= 0)
+	continue;
+
+      area.x = widget->allocation.x;
+      area.y = widget->allocation.y;
+      area.width = widget->allocation.width;
+      area.height = widget->allocation.height;
+      gtk_child_index_cells (index, &area, &col1, &row1, &col2, &row2);
+
+      if ((col2 - col1 + 1) * (row2 - row1 + 1) > GTK_CHILD_INDEX_LARGE_CELLS)
+	continue;
+
+      for (row = row1; row <= row2; row++)
+	for (col = col1; col <= col2; col++)
+	  index->cell_entries[fill[row * index->n_cols + col]++] = i;
+    }
+
+  g_free (fill);
+
+  index->grid_valid = TRUE;
+}
+
+static gint
+gtk_child_index_compare (const void *a,
+			 const void *b)
+{
+  return (gint)*(const guint *)a - (gint)*(const guint *)b;
+}
+
+void
+gtk_child_index_foreach (GtkWidget    *container,
+			 GList        *children,
+			 GdkRectangle *area,
+			 GFunc         func,
+			 gpointer      data)
+{
+  GtkChildIndex *index;
+  gpointer *hits;
+  guint *hit_entries;
+  guint n_hits, i, j;
+  gint col1, row1, col2, row2, row;
+
+  g_return_if_fail (container != NULL);
+  g_return_if_fail (area != NULL);
+  g_return_if_fail (func != NULL);
+
+  index = gtk_child_index_ensure (container, children);
+  if (!index)
+    {
+      while (children)
+	{
+	  gpointer child = children->data;
+
+	  children = children->next;
+	  (* func) (child, data);
+	}
+      return;
+    }
+
+  if (!index->grid_valid)
+    gtk_child_index_build (index, children);
+
+  if (area->width <= 0 || area->height <= 0 ||
+      area->x >= index->x + index->n_cols * index->cell_width ||
+      area->y >= index->y + index->n_rows * index->cell_height ||
+      area->x + area->width <= index->x ||
+      area->y + area->height <= index->y)
+    {
+      n_hits = 0;
+      hit_entries = NULL;
+    }
+  else
+    {
+      gtk_child_index_cells (index, area, &col1, &row1, &col2, &row2);
+
+      n_hits = index->n_large;
+      for (row = row1; row <= row2; row++)
+	n_hits += (index->cell_start[row * index->n_cols + col2 + 1] -
+		   index->cell_start[row * index->n_cols + col1]);
+      hit_entries = g_new (guint, MAX (n_hits, 1));
+
+      if (++index->stamp == 0)
+	{
+	  for (i = 0; i < index->n_entries; i++)
+	    index->stamps[i] = 0;
+	  index->stamp = 1;
+	}
+
+      /* Children spanning several cells are only taken once */
+      n_hits = 0;
+      for (i = 0; i < index->n_large; i++)
+	hit_entries[n_hits++] = index->large[i];
+      for (row = row1; row <= row2; row++)
+	for (j = index->cell_start[row * index->n_cols + col1];
+	     j < index->cell_start[row * index->n_cols + col2 + 1];
+	     j++)
+	  {
+	    guint entry = index->cell_entries[j];
+
+	    if (index->stamps[entry] != index->stamp)
+	      {
+		index->stamps[entry] = index->stamp;
+		hit_entries[n_hits++] = entry;
+	      }
+	  }
+
+      /* Forward in list order, as the full walk would */
+      qsort (hit_entries, n_hits, sizeof (guint), gtk_child_index_compare);
+    }
+
+  /* Copied out, since the callbacks may change the children and so
+   * the index */
+  hits = g_new (gpointer, MAX (n_hits, 1));
+  for (i = 0; i < n_hits; i++)
+    hits[i] = index->entries[hit_entries[i]];
+  g_free (hit_entries);
+
+  for (i = 0; i < n_hits; i++)
+    (* func) (hits[i], data);
+
+  g_free (hits);
+}
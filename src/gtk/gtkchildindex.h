@@ -0,0 +1,81 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Modified by the GTK+ Team and others 1997-1999.  See the AUTHORS
+ * file for a list of people on the GTK+ Team.  See the ChangeLog
+ * files for a list of changes.  These files are distributed with
+ * GTK+ at ftp://ftp.gtk.org/pub/gtk/.
+ */
+
+#ifndef __GTK_CHILD_INDEX_H__
+#define __GTK_CHILD_INDEX_H__
+
+
+#include <gdk/gdk.h>
+#include <gtk/gtkwidget.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/* Private helper for containers that keep their children in a GList
+ * of child structures whose first member is the child's GtkWidget
+ * pointer (GtkBoxChild, GtkTableChild, GtkFixedChild, GtkPackerChild).
+ *
+ * Once a container has enough children, it gets an index mapping each
+ * child widget to its list link, and a grid of the child allocations
+ * that is rebuilt lazily after any child is reallocated. Containers
+ * must report every link they insert with gtk_child_index_add() and
+ * every child they unlink with gtk_child_index_remove().
+ */
+
+/* Returns the link of @children holding @child, or NULL.
+ */
+GList* gtk_child_index_find	  (GtkWidget	*container,
+				   GList	*children,
+				   GtkWidget	*child);
+void   gtk_child_index_add	  (GtkWidget	*container,
+				   GList	*link);
+void   gtk_child_index_remove	  (GtkWidget	*container,
+				   GtkWidget	*child);
+
+/* Marks the child allocations as changed; also called on the parent
+ * from gtk_widget_size_allocate().
+ */
+void   gtk_child_index_invalidate (GtkWidget	*container);
+
+/* Calls @func on the child structures of @children that may intersect
+ * @area, in list order. Callers still have to check the intersection.
+ */
+void   gtk_child_index_foreach	  (GtkWidget	*container,
+				   GList	*children,
+				   GdkRectangle *area,
+				   GFunc	 func,
+				   gpointer	 data);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+#endif /* __GTK_CHILD_INDEX_H__ */
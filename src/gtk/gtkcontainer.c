@@ -826,6 +826,7 @@ static gboolean
 gtk_container_idle_sizer (gpointer data)
 {
   GDK_THREADS_ENTER ();
+  GDK_TRACE_BEGIN ("layout", "idle_sizer", NULL);
 
   /* we may be invoked with a container_resize_queue of NULL, because
    * queue_resize could have been adding an extra idle function while
@@ -847,6 +848,7 @@ gtk_container_idle_sizer (gpointer data)
       gtk_container_check_resize (GTK_CONTAINER (widget));
     }
 
+  GDK_TRACE_END ();
   GDK_THREADS_LEAVE ();
   
   return FALSE;
@@ -31,8 +31,10 @@
 
 #include "gtkdnd.h"
 #include "gtkinvisible.h"
+#include "gtklayout.h"
 #include "gtkmain.h"
 #include "gtksignal.h"
+#include "gtkviewport.h"
 #include "gtkwindow.h"
 
 static GSList *drag_widgets = NULL;
@@ -44,6 +46,9 @@ typedef struct _GtkDragDestSite GtkDragDestSite;
 typedef struct _GtkDragDestInfo GtkDragDestInfo;
 typedef struct _GtkDragAnim GtkDragAnim;
 typedef struct _GtkDragFindData GtkDragFindData;
+typedef struct _GtkDragSiteEntry GtkDragSiteEntry;
+typedef struct _GtkDragSiteNode GtkDragSiteNode;
+typedef struct _GtkDragSiteIndex GtkDragSiteIndex;
 
 
 typedef enum 
@@ -148,6 +153,41 @@ struct _GtkDragFindData
   guint32 time;
 };
 
+/* A drop site of a toplevel, as found by walking its widget tree */
+struct _GtkDragSiteEntry
+{
+  GtkWidget *widget;
+  GdkRectangle area;		/* Part of the toplevel where the site
+				 * can be hit, clipped by its ancestors */
+  gint x_origin;		/* Origin of the coordinates passed to */
+  gint y_origin;		/* the site, relative to the toplevel */
+  guint order;			/* Order in which the tree walk would
+				 * try the site */
+};
+
+/* Node of a bounding volume hierarchy over the entries */
+struct _GtkDragSiteNode
+{
+  GdkRectangle bbox;
+  guint start;			/* Range of entries for a leaf */
+  guint end;
+  GtkDragSiteNode *left;
+  GtkDragSiteNode *right;
+};
+
+/* Index of the drop sites of a toplevel; rebuilt after something
+ * that could move one of the sites marks it stale.
+ */
+struct _GtkDragSiteIndex
+{
+  gboolean stale;
+  GtkDragSiteEntry *entries;
+  guint n_entries;
+  GtkDragSiteNode *root;
+  GHashTable *ancestors;	/* The sites and all their ancestors */
+  GSList *adjustments;		/* Adjustments scrolling any of the sites */
+};
+
 /* Enumeration for some targets we handle internally */
 
 enum {
@@ -164,6 +204,9 @@ static GdkColormap *default_icon_colormap = NULL;
 static gint         default_icon_hot_x;
 static gint         default_icon_hot_y;
 
+/* The drop site indexes of all toplevels */
+static GSList      *gtk_drag_site_indexes = NULL;
+
 /* Forward declarations */
 static void          gtk_drag_get_event_actions (GdkEvent        *event, 
 					         gint             button,
@@ -187,8 +230,9 @@ static void      gtk_drag_selection_received  (GtkWidget          *widget,
 					       GtkSelectionData   *selection_data,
 					       guint32             time,
 					       gpointer            data);
-static void      gtk_drag_find_widget         (GtkWidget          *widget,
+static void      gtk_drag_find_site           (GtkWidget          *toplevel,
 					       GtkDragFindData    *data);
+static void      gtk_drag_sites_invalidate    (GtkWidget          *widget);
 static void      gtk_drag_proxy_begin         (GtkWidget          *widget,
 					       GtkDragDestInfo    *dest_info);
 static void      gtk_drag_dest_info_destroy   (gpointer            data);
@@ -882,6 +926,7 @@ gtk_drag_dest_set   (GtkWidget            *widget,
 
   gtk_object_set_data_full (GTK_OBJECT (widget), "gtk-drag-dest",
 			    site, gtk_drag_dest_site_destroy);
+  gtk_drag_sites_invalidate (widget);
 }
 
 /*************************************************************
@@ -933,6 +978,7 @@ gtk_drag_dest_set_proxy (GtkWidget      *widget,
 
   gtk_object_set_data_full (GTK_OBJECT (widget), "gtk-drag-dest",
 			    site, gtk_drag_dest_site_destroy);
+  gtk_drag_sites_invalidate (widget);
 }
 
 /*************************************************************
@@ -948,6 +994,7 @@ gtk_drag_dest_unset (GtkWidget *widget)
 {
   g_return_if_fail (widget != NULL);
 
+  gtk_drag_sites_invalidate (widget);
   gtk_object_set_data (GTK_OBJECT (widget), "gtk-drag-dest", NULL);
 }
 
@@ -994,6 +1041,8 @@ gtk_drag_dest_handle_event (GtkWidget *toplevel,
   switch (event->type)
     {
     case GDK_DRAG_ENTER:
+      /* Windows may have been moved without an allocation */
+      gtk_drag_sites_invalidate (toplevel);
       break;
       
     case GDK_DRAG_LEAVE:
@@ -1035,7 +1084,7 @@ gtk_drag_dest_handle_event (GtkWidget *toplevel,
 	  gtk_drag_dest_motion : gtk_drag_dest_drop;
 	data.time = event->dnd.time;
 	
-	gtk_drag_find_widget (toplevel, &data);
+	gtk_drag_find_site (toplevel, &data);
 
 	if (info->widget && !data.found)
 	  {
@@ -1223,25 +1272,163 @@ get_all_children (GtkContainer *container)
 
 
 /*************************************************************
- * gtk_drag_find_widget:
- *     Recursive callback used to locate widgets for 
- *     DRAG_MOTION and DROP_START events.
+ * gtk_drag_sites_invalidate:
+ *     Marks the drop site index of the toplevel of widget as
+ *     out of date. Called when drop sites are added or removed,
+ *     and when a drag enters the toplevel.
  *   arguments:
  *     
  *   results:
  *************************************************************/
 
 static void
-gtk_drag_find_widget (GtkWidget       *widget,
-		      GtkDragFindData *data)
+gtk_drag_sites_invalidate (GtkWidget *widget)
+{
+  GtkWidget *toplevel = gtk_widget_get_toplevel (widget);
+  GtkDragSiteIndex *index;
+
+  index = gtk_object_get_data (GTK_OBJECT (toplevel), "gtk-drag-site-index");
+  if (index)
+    index->stale = TRUE;
+}
+
+/*************************************************************
+ * gtk_drag_sites_widget_changed:
+ *     Marks the drop site index of the toplevel of widget as
+ *     out of date, if widget is a drop site or an ancestor of
+ *     one, so that a change to it can have moved a site.
+ *   arguments:
+ *     
+ *   results:
+ *************************************************************/
+
+static void
+gtk_drag_sites_widget_changed (GtkWidget *widget,
+			       GtkWidget *toplevel)
+{
+  GtkDragSiteIndex *index;
+
+  index = gtk_object_get_data (GTK_OBJECT (toplevel), "gtk-drag-site-index");
+  if (!index || index->stale)
+    return;
+
+  if (g_hash_table_lookup (index->ancestors, widget) ||
+      gtk_object_get_data (GTK_OBJECT (widget), "gtk-drag-dest"))
+    index->stale = TRUE;
+}
+
+/* Emission hook for widgets being allocated, mapped, unmapped
+ * or reparented.
+ */
+static gboolean
+gtk_drag_sites_widget_hook (GtkObject *object,
+			    guint      signal_id,
+			    guint      n_params,
+			    GtkArg    *params,
+			    gpointer   data)
+{
+  GtkWidget *widget = GTK_WIDGET (object);
+
+  gtk_drag_sites_widget_changed (widget, gtk_widget_get_toplevel (widget));
+
+  /* A widget leaving a toplevel takes its sites out of that
+   * toplevel's index */
+  if (signal_id == GPOINTER_TO_UINT (data))
+    {
+      GtkObject *previous_parent = GTK_VALUE_OBJECT (params[0]);
+      GtkWidget *previous_toplevel;
+
+      if (previous_parent)
+	{
+	  previous_toplevel = gtk_widget_get_toplevel (GTK_WIDGET (previous_parent));
+	  gtk_drag_sites_widget_changed (widget, previous_toplevel);
+	}
+    }
+
+  return TRUE;
+}
+
+/* Emission hook for adjustments changing their value; marks the
+ * indexes of the sites scrolled by the adjustment as stale.
+ */
+static gboolean
+gtk_drag_sites_adjustment_hook (GtkObject *object,
+				guint      signal_id,
+				guint      n_params,
+				GtkArg    *params,
+				gpointer   data)
+{
+  GSList *tmp_list;
+
+  for (tmp_list = gtk_drag_site_indexes; tmp_list; tmp_list = tmp_list->next)
+    {
+      GtkDragSiteIndex *index = tmp_list->data;
+
+      if (!index->stale && g_slist_find (index->adjustments, object))
+	index->stale = TRUE;
+    }
+
+  return TRUE;
+}
+
+static void
+gtk_drag_sites_add_hooks (void)
+{
+  static const gchar *widget_signals[] = {
+    "size_allocate", "map", "unmap", "parent_set"
+  };
+  static gboolean hooks_added = FALSE;
+  guint parent_set_id;
+  guint i;
+
+  if (hooks_added)
+    return;
+  hooks_added = TRUE;
+
+  parent_set_id = gtk_signal_lookup ("parent_set", GTK_TYPE_WIDGET);
+  for (i = 0; i < sizeof (widget_signals) / sizeof (widget_signals[0]); i++)
+    gtk_signal_add_emission_hook (gtk_signal_lookup (widget_signals[i],
+						     GTK_TYPE_WIDGET),
+				  gtk_drag_sites_widget_hook,
+				  GUINT_TO_POINTER (parent_set_id));
+
+  gtk_signal_add_emission_hook (gtk_signal_lookup ("value_changed",
+						   GTK_TYPE_ADJUSTMENT),
+				gtk_drag_sites_adjustment_hook, NULL);
+}
+
+/*************************************************************
+ * gtk_drag_sites_collect:
+ *     Recursively collects the drop sites below widget, in the
+ *     order the old recursive search tried them: depth first,
+ *     children before their parents.
+ *   arguments:
+ *     widget:    
+ *     x, y:      origin of the window of widget's parent,
+ *                relative to the toplevel
+ *     clip:      area of the parent the pointer has to be in,
+ *                NULL for the toplevel
+ *     entries:   list to prepend found sites to
+ *     order:     counter for GtkDragSiteEntry.order
+ *   results:
+ *************************************************************/
+
+static void
+gtk_drag_sites_collect (GtkWidget    *widget,
+			gint          x,
+			gint          y,
+			GdkRectangle *clip,
+			GSList      **entries,
+			guint        *order)
 {
   GtkAllocation new_allocation;
+  GdkRectangle area;
   gint x_offset = 0;
   gint y_offset = 0;
 
   new_allocation = widget->allocation;
 
-  if (data->found || !GTK_WIDGET_MAPPED (widget))
+  if (!GTK_WIDGET_MAPPED (widget))
     return;
 
   /* Note that in the following code, we only count the
@@ -1289,53 +1476,324 @@ gtk_drag_find_widget (GtkWidget       *widget,
 	}
     }
 
-  if (data->toplevel ||
-      ((data->x >= new_allocation.x) && (data->y >= new_allocation.y) &&
-       (data->x < new_allocation.x + new_allocation.width) && 
-       (data->y < new_allocation.y + new_allocation.height)))
+  /* The toplevel catches everything */
+  if (clip)
+    {
+      GdkRectangle rect;
+
+      rect.x = x + new_allocation.x;
+      rect.y = y + new_allocation.y;
+      rect.width = MAX (new_allocation.width, 0);
+      rect.height = MAX (new_allocation.height, 0);
+
+      if (!gdk_rectangle_intersect (&rect, clip, &area))
+	return;
+    }
+  else
     {
-      /* First, check if the drag is in a valid drop site in
-       * one of our children 
-       */
-      if (GTK_IS_CONTAINER (widget))
+      area.x = area.y = -G_MAXSHORT;
+      area.width = area.height = 2 * G_MAXSHORT;
+    }
+
+  if (GTK_IS_CONTAINER (widget))
+    {
+      GList *children = get_all_children (GTK_CONTAINER (widget));
+      GList *tmp_list;
+
+      tmp_list = children;
+      while (tmp_list)
 	{
-	  GtkDragFindData new_data = *data;
-	  GList *children = get_all_children (GTK_CONTAINER (widget));
-	  GList *tmp_list;
+	  GtkWidget *child = tmp_list->data;
 
-	  new_data.x -= x_offset;
-	  new_data.y -= y_offset;
-	  new_data.found = FALSE;
-	  new_data.toplevel = FALSE;
+	  if (child->parent == widget)
+	    gtk_drag_sites_collect (child, x + x_offset, y + y_offset,
+				    &area, entries, order);
+	  
+	  gtk_widget_unref (child);
+	  tmp_list = tmp_list->next;
+	}
 
-	  tmp_list = children;
-	  while (tmp_list)
-	    {
-	      GtkWidget *child = tmp_list->data;
+      g_list_free (children);
+    }
 
-	      if (child->parent == widget)
-		gtk_drag_find_widget (child, &new_data);
-	      
-	      gtk_widget_unref (child);
-	      tmp_list = tmp_list->next;
-	    }
+  if (gtk_object_get_data (GTK_OBJECT (widget), "gtk-drag-dest"))
+    {
+      GtkDragSiteEntry *entry = g_new (GtkDragSiteEntry, 1);
 
-	  g_list_free (children);
+      entry->widget = widget;
+      entry->area = area;
+      entry->x_origin = x + x_offset;
+      entry->y_origin = y + y_offset;
+      entry->order = (*order)++;
 
-	  data->found = new_data.found;
+      *entries = g_slist_prepend (*entries, entry);
+    }
+}
+
+static gint gtk_drag_sites_sort_axis;
+
+static gint
+gtk_drag_sites_compare_center (const void *a,
+			       const void *b)
+{
+  const GdkRectangle *area_a = &((const GtkDragSiteEntry *)a)->area;
+  const GdkRectangle *area_b = &((const GtkDragSiteEntry *)b)->area;
+  gint center_a, center_b;
+
+  if (gtk_drag_sites_sort_axis == 0)
+    {
+      center_a = area_a->x + area_a->width / 2;
+      center_b = area_b->x + area_b->width / 2;
+    }
+  else
+    {
+      center_a = area_a->y + area_a->height / 2;
+      center_b = area_b->y + area_b->height / 2;
+    }
+
+  return center_a - center_b;
+}
+
+static gint
+gtk_drag_sites_compare_order (const void *a,
+			      const void *b)
+{
+  const GtkDragSiteEntry *entry_a = a;
+  const GtkDragSiteEntry *entry_b = b;
+
+  return (gint)entry_a->order - (gint)entry_b->order;
+}
+
+/* Sites in a leaf of the hierarchy */
+#define GTK_DRAG_SITES_PER_LEAF 4
+
+static GtkDragSiteNode *
+gtk_drag_sites_build (GtkDragSiteEntry *entries,
+		      guint             start,
+		      guint             end)
+{
+  GtkDragSiteNode *node = g_new (GtkDragSiteNode, 1);
+  guint i;
+
+  node->bbox = entries[start].area;
+  for (i = start + 1; i < end; i++)
+    gdk_rectangle_union (&node->bbox, &entries[i].area, &node->bbox);
+
+  node->start = start;
+  node->end = end;
+
+  if (end - start <= GTK_DRAG_SITES_PER_LEAF)
+    {
+      node->left = NULL;
+      node->right = NULL;
+    }
+  else
+    {
+      guint middle = start + (end - start) / 2;
+
+      /* Split along the longer side of the bounding box */
+      gtk_drag_sites_sort_axis = node->bbox.width >= node->bbox.height ? 0 : 1;
+      qsort (entries + start, end - start, sizeof (GtkDragSiteEntry),
+	     gtk_drag_sites_compare_center);
+
+      node->left = gtk_drag_sites_build (entries, start, middle);
+      node->right = gtk_drag_sites_build (entries, middle, end);
+    }
+
+  return node;
+}
+
+static void
+gtk_drag_sites_node_free (GtkDragSiteNode *node)
+{
+  if (node->left)
+    {
+      gtk_drag_sites_node_free (node->left);
+      gtk_drag_sites_node_free (node->right);
+    }
+  g_free (node);
+}
+
+static void
+gtk_drag_site_index_free (gpointer data)
+{
+  GtkDragSiteIndex *index = data;
+
+  gtk_drag_site_indexes = g_slist_remove (gtk_drag_site_indexes, index);
+
+  if (index->root)
+    gtk_drag_sites_node_free (index->root);
+  g_free (index->entries);
+  g_hash_table_destroy (index->ancestors);
+  g_slist_free (index->adjustments);
+  g_free (index);
+}
+
+/* Records the ancestors of a drop site in the index, and the
+ * adjustments of any viewports and layouts among them.
+ */
+static void
+gtk_drag_site_index_add_ancestors (GtkDragSiteIndex *index,
+				   GtkWidget        *widget)
+{
+  GtkAdjustment *hadj = NULL;
+  GtkAdjustment *vadj = NULL;
+
+  while (widget && !g_hash_table_lookup (index->ancestors, widget))
+    {
+      g_hash_table_insert (index->ancestors, widget, widget);
+
+      if (GTK_IS_VIEWPORT (widget))
+	{
+	  hadj = GTK_VIEWPORT (widget)->hadjustment;
+	  vadj = GTK_VIEWPORT (widget)->vadjustment;
+	}
+      else if (GTK_IS_LAYOUT (widget))
+	{
+	  hadj = GTK_LAYOUT (widget)->hadjustment;
+	  vadj = GTK_LAYOUT (widget)->vadjustment;
 	}
 
-      /* If not, and this widget is registered as a drop site, check to
-       * emit "drag_motion" to check if we are actually in
-       * a drop site.
-       */
+      if (hadj && !g_slist_find (index->adjustments, hadj))
+	index->adjustments = g_slist_prepend (index->adjustments, hadj);
+      if (vadj && !g_slist_find (index->adjustments, vadj))
+	index->adjustments = g_slist_prepend (index->adjustments, vadj);
+      hadj = vadj = NULL;
+
+      widget = widget->parent;
+    }
+}
+
+static GtkDragSiteIndex *
+gtk_drag_site_index_get (GtkWidget *toplevel)
+{
+  GtkDragSiteIndex *index;
+  GSList *entries = NULL;
+  GSList *tmp_list;
+  guint order = 0;
+  guint i;
+
+  index = gtk_object_get_data (GTK_OBJECT (toplevel), "gtk-drag-site-index");
+  if (index && !index->stale)
+    return index;
+
+  gtk_drag_sites_add_hooks ();
+
+  gtk_drag_sites_collect (toplevel, 0, 0, NULL, &entries, &order);
+
+  index = g_new (GtkDragSiteIndex, 1);
+  index->stale = FALSE;
+  index->n_entries = g_slist_length (entries);
+  index->entries = g_new (GtkDragSiteEntry, MAX (index->n_entries, 1));
+  index->ancestors = g_hash_table_new (g_direct_hash, NULL);
+  index->adjustments = NULL;
+
+  for (tmp_list = entries, i = 0; tmp_list; tmp_list = tmp_list->next, i++)
+    {
+      index->entries[i] = *(GtkDragSiteEntry *)tmp_list->data;
+      gtk_drag_site_index_add_ancestors (index, index->entries[i].widget);
+      g_free (tmp_list->data);
+    }
+  g_slist_free (entries);
+
+  index->root = index->n_entries ?
+    gtk_drag_sites_build (index->entries, 0, index->n_entries) : NULL;
+
+  gtk_object_set_data_full (GTK_OBJECT (toplevel), "gtk-drag-site-index",
+			    index, gtk_drag_site_index_free);
+  gtk_drag_site_indexes = g_slist_prepend (gtk_drag_site_indexes, index);
+
+  return index;
+}
+
+static void
+gtk_drag_sites_query (GtkDragSiteIndex  *index,
+		      GtkDragSiteNode   *node,
+		      gint               x,
+		      gint               y,
+		      GSList           **hits)
+{
+  guint i;
+
+  if ((x < node->bbox.x) || (y < node->bbox.y) ||
+      (x >= node->bbox.x + node->bbox.width) ||
+      (y >= node->bbox.y + node->bbox.height))
+    return;
+
+  if (node->left)
+    {
+      gtk_drag_sites_query (index, node->left, x, y, hits);
+      gtk_drag_sites_query (index, node->right, x, y, hits);
+    }
+  else
+    for (i = node->start; i < node->end; i++)
+      {
+	GdkRectangle *area = &index->entries[i].area;
+
+	if ((x >= area->x) && (y >= area->y) &&
+	    (x < area->x + area->width) && (y < area->y + area->height))
+	  *hits = g_slist_prepend (*hits, &index->entries[i]);
+      }
+}
+
+/*************************************************************
+ * gtk_drag_find_site:
+ *     Locates the drop site for DRAG_MOTION and DROP_START
+ *     events within toplevel, using the toplevel's drop site
+ *     index. Sites under the pointer are tried in the order
+ *     of the old recursive search, until one accepts.
+ *   arguments:
+ *     
+ *   results:
+ *************************************************************/
+
+static void
+gtk_drag_find_site (GtkWidget       *toplevel,
+		    GtkDragFindData *data)
+{
+  GtkDragSiteIndex *index;
+  GtkDragSiteEntry *hits;
+  GSList *hit_list = NULL;
+  GSList *tmp_list;
+  guint n_hits, i;
+
+  if (!GTK_WIDGET_MAPPED (toplevel))
+    return;
+
+  index = gtk_drag_site_index_get (toplevel);
+  if (!index->root)
+    return;
+
+  gtk_drag_sites_query (index, index->root, data->x, data->y, &hit_list);
+
+  n_hits = g_slist_length (hit_list);
+  hits = g_new (GtkDragSiteEntry, MAX (n_hits, 1));
+  for (tmp_list = hit_list, i = 0; tmp_list; tmp_list = tmp_list->next, i++)
+    {
+      /* Copied, and the widgets referenced, since the callbacks may
+       * change the widget tree and so the index */
+      hits[i] = *(GtkDragSiteEntry *)tmp_list->data;
+      gtk_widget_ref (hits[i].widget);
+    }
+  g_slist_free (hit_list);
+
+  qsort (hits, n_hits, sizeof (GtkDragSiteEntry),
+	 gtk_drag_sites_compare_order);
+
+  for (i = 0; i < n_hits; i++)
+    {
+      GtkWidget *widget = hits[i].widget;
+
+      /* Emit "drag_motion" to check if we are actually in a drop
+       * site */
       if (!data->found &&
+	  !GTK_OBJECT_DESTROYED (widget) &&
 	  gtk_object_get_data (GTK_OBJECT (widget), "gtk-drag-dest"))
 	{
 	  data->found = data->callback (widget,
 					data->context,
-					data->x - x_offset,
-					data->y - y_offset,
+					data->x - hits[i].x_origin,
+					data->y - hits[i].y_origin,
 					data->time);
 	  /* If so, send a "drag_leave" to the last widget */
 	  if (data->found)
@@ -1347,7 +1805,11 @@ gtk_drag_find_widget (GtkWidget       *widget,
 	      data->info->widget = widget;
 	    }
 	}
+
+      gtk_widget_unref (widget);
     }
+
+  g_free (hits);
 }
 
 static void
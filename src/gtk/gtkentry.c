@@ -152,6 +152,10 @@ static void gtk_entry_set_selection       (GtkEditable       *editable,
 					   gint               end);
 
 static void gtk_entry_recompute_offsets   (GtkEntry          *entry);
+static void gtk_entry_char_widths         (GtkEntry          *entry,
+					   gint               start,
+					   gint               end,
+					   gint              *widths);
 static gint gtk_entry_find_position       (GtkEntry          *entry, 
 					   gint               position);
 static void gtk_entry_set_position_from_editable (GtkEditable *editable,
@@ -1819,26 +1823,23 @@ gtk_entry_insert_text (GtkEditable *editable,
   
   if (GTK_WIDGET_REALIZED (entry))
     {
+      gint start_offset;
       gint offset = 0;
+      gint width;
       
       for (i = last_pos; i >= end_pos; i--)
 	entry->char_offset[i] = entry->char_offset[i - insertion_length];
-      
+
+      /* Measure the new characters in place, then turn their widths
+       * into offsets */
+      start_offset = entry->char_offset[start_pos];
+      gtk_entry_char_widths (entry, start_pos, end_pos,
+			     entry->char_offset + start_pos);
       for (i=start_pos; i<end_pos; i++)
 	{
-	  GdkWChar ch;
-
-	  entry->char_offset[i] = entry->char_offset[start_pos] + offset;
-
-	  if (editable->visible)
-	    ch = entry->text[i];
-	  else 
-	    ch = gtk_entry_get_invisible_char (entry);
-
-	  if (entry->use_wchar)
-	    offset += gdk_char_width_wc (GTK_WIDGET (entry)->style->font, ch);
-	  else
-	    offset += gdk_char_width (GTK_WIDGET (entry)->style->font, ch);
+	  width = entry->char_offset[i];
+	  entry->char_offset[i] = start_offset + offset;
+	  offset += width;
 	}
       for (i = end_pos; i <= last_pos; i++)
 	entry->char_offset[i] += offset;
@@ -1851,29 +1852,50 @@ gtk_entry_insert_text (GtkEditable *editable,
   gtk_entry_queue_draw (entry);
 }
 
+/* Stores the widths of the characters from start to end in widths */
+static void
+gtk_entry_char_widths (GtkEntry *entry,
+		       gint      start,
+		       gint      end,
+		       gint     *widths)
+{
+  GdkFont *font = GTK_WIDGET (entry)->style->font;
+  gint width;
+  gint i;
+
+  if (!GTK_EDITABLE (entry)->visible)
+    {
+      GdkWChar ch = gtk_entry_get_invisible_char (entry);
+
+      if (entry->use_wchar)
+	width = gdk_char_width_wc (font, ch);
+      else
+	width = gdk_char_width (font, ch);
+
+      for (i = start; i < end; i++)
+	widths[i - start] = width;
+    }
+  else if (entry->use_wchar)
+    gdk_text_widths_wc (font, entry->text + start, end - start, widths);
+  else
+    for (i = start; i < end; i++)
+      widths[i - start] = gdk_char_width (font, entry->text[i]);
+}
+
 /* Recompute the x offsets of all characters in the buffer */
 static void
 gtk_entry_recompute_offsets (GtkEntry *entry)
 {
   gint i;
   gint offset = 0;
-  GtkEditable *editable = GTK_EDITABLE (entry);
+  gint width;
 
+  gtk_entry_char_widths (entry, 0, entry->text_length, entry->char_offset);
   for (i=0; i<entry->text_length; i++)
     {
-      GdkWChar ch;
-
+      width = entry->char_offset[i];
       entry->char_offset[i] = offset;
-
-      if (editable->visible)
-	ch = entry->text[i];
-      else
-	ch = gtk_entry_get_invisible_char (entry);
-
-      if (entry->use_wchar)
-	offset += gdk_char_width_wc (GTK_WIDGET (entry)->style->font, ch);
-      else
-	offset += gdk_char_width (GTK_WIDGET (entry)->style->font, ch);
+      offset += width;
     }
   
   entry->char_offset[i] = offset;
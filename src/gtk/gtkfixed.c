@@ -25,6 +25,7 @@
  */
 
 #include "gtkfixed.h"
+#include "gtkchildindex.h"
 
 
 static void gtk_fixed_class_init    (GtkFixedClass    *klass);
@@ -147,6 +148,7 @@ gtk_fixed_put (GtkFixed       *fixed,
   gtk_widget_set_parent (widget, GTK_WIDGET (fixed));
 
   fixed->children = g_list_append (fixed->children, child_info); 
+  gtk_child_index_add (GTK_WIDGET (fixed), g_list_last (fixed->children));
 
   if (GTK_WIDGET_REALIZED (fixed))
     gtk_widget_realize (widget);
@@ -173,22 +175,15 @@ gtk_fixed_move (GtkFixed       *fixed,
   g_return_if_fail (GTK_IS_FIXED (fixed));
   g_return_if_fail (widget != NULL);
 
-  children = fixed->children;
-  while (children)
+  children = gtk_child_index_find (GTK_WIDGET (fixed), fixed->children, widget);
+  if (children)
     {
       child = children->data;
-      children = children->next;
+      child->x = x;
+      child->y = y;
 
-      if (child->widget == widget)
-        {
-          child->x = x;
-          child->y = y;
-
-          if (GTK_WIDGET_VISIBLE (widget) && GTK_WIDGET_VISIBLE (fixed))
-            gtk_widget_queue_resize (GTK_WIDGET (fixed));
-
-          break;
-        }
+      if (GTK_WIDGET_VISIBLE (widget) && GTK_WIDGET_VISIBLE (fixed))
+        gtk_widget_queue_resize (GTK_WIDGET (fixed));
     }
 }
 
@@ -351,65 +346,60 @@ gtk_fixed_paint (GtkWidget    *widget,
 }
 
 static void
-gtk_fixed_draw (GtkWidget    *widget,
-		GdkRectangle *area)
+gtk_fixed_draw_child (gpointer data,
+		      gpointer user_data)
 {
-  GtkFixed *fixed;
-  GtkFixedChild *child;
+  GtkFixedChild *child = data;
+  GdkRectangle *area = user_data;
   GdkRectangle child_area;
-  GList *children;
 
+  if (gtk_widget_intersect (child->widget, area, &child_area))
+    gtk_widget_draw (child->widget, &child_area);
+}
+
+static void
+gtk_fixed_draw (GtkWidget    *widget,
+		GdkRectangle *area)
+{
   g_return_if_fail (widget != NULL);
   g_return_if_fail (GTK_IS_FIXED (widget));
 
   if (GTK_WIDGET_DRAWABLE (widget))
     {
-      fixed = GTK_FIXED (widget);
       gtk_fixed_paint (widget, area);
 
-      children = fixed->children;
-      while (children)
-	{
-	  child = children->data;
-	  children = children->next;
-
-	  if (gtk_widget_intersect (child->widget, area, &child_area))
-	    gtk_widget_draw (child->widget, &child_area);
-	}
+      gtk_child_index_foreach (widget, GTK_FIXED (widget)->children, area,
+			       gtk_fixed_draw_child, area);
     }
 }
 
+static void
+gtk_fixed_expose_child (gpointer data,
+			gpointer user_data)
+{
+  GtkFixedChild *child = data;
+  GdkEventExpose *event = user_data;
+  GdkEventExpose child_event;
+
+  child_event = *event;
+
+  if (GTK_WIDGET_NO_WINDOW (child->widget) &&
+      gtk_widget_intersect (child->widget, &event->area, 
+			    &child_event.area))
+    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
+}
+
 static gint
 gtk_fixed_expose (GtkWidget      *widget,
 		  GdkEventExpose *event)
 {
-  GtkFixed *fixed;
-  GtkFixedChild *child;
-  GdkEventExpose child_event;
-  GList *children;
-
   g_return_val_if_fail (widget != NULL, FALSE);
   g_return_val_if_fail (GTK_IS_FIXED (widget), FALSE);
   g_return_val_if_fail (event != NULL, FALSE);
 
   if (GTK_WIDGET_DRAWABLE (widget))
-    {
-      fixed = GTK_FIXED (widget);
-
-      child_event = *event;
-
-      children = fixed->children;
-      while (children)
-	{
-	  child = children->data;
-	  children = children->next;
-
-	  if (GTK_WIDGET_NO_WINDOW (child->widget) &&
-	      gtk_widget_intersect (child->widget, &event->area, 
-				    &child_event.area))
-	    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
-	}
-    }
+    gtk_child_index_foreach (widget, GTK_FIXED (widget)->children, &event->area,
+			     gtk_fixed_expose_child, event);
 
   return FALSE;
 }
@@ -439,28 +429,21 @@ gtk_fixed_remove (GtkContainer *container,
 
   fixed = GTK_FIXED (container);
 
-  children = fixed->children;
-  while (children)
+  children = gtk_child_index_find (GTK_WIDGET (fixed), fixed->children, widget);
+  if (children)
     {
-      child = children->data;
+      gboolean was_visible = GTK_WIDGET_VISIBLE (widget);
 
-      if (child->widget == widget)
-	{
-	  gboolean was_visible = GTK_WIDGET_VISIBLE (widget);
-	  
-	  gtk_widget_unparent (widget);
-
-	  fixed->children = g_list_remove_link (fixed->children, children);
-	  g_list_free (children);
-	  g_free (child);
+      child = children->data;
+      gtk_widget_unparent (widget);
 
-	  if (was_visible && GTK_WIDGET_VISIBLE (container))
-	    gtk_widget_queue_resize (GTK_WIDGET (container));
+      gtk_child_index_remove (GTK_WIDGET (fixed), widget);
+      fixed->children = g_list_remove_link (fixed->children, children);
+      g_list_free (children);
+      g_free (child);
 
-	  break;
-	}
-
-      children = children->next;
+      if (was_visible && GTK_WIDGET_VISIBLE (container))
+	gtk_widget_queue_resize (GTK_WIDGET (container));
     }
 }
 
@@ -69,6 +69,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <X11/Xlib.h>
 
 #include "gdk/gdkx.h"
@@ -83,6 +87,7 @@
 #include "gtkhbbox.h"
 #include "gtkhbox.h"
 #include "gtklabel.h"
+#include "gtkmain.h"
 #include "gtknotebook.h"
 #include "gtkradiobutton.h"
 #include "gtksignal.h"
@@ -91,6 +96,10 @@
 #include "gtkscrolledwindow.h"
 #include "gtkintl.h"
 
+#ifdef G_THREADS_IMPL_POSIX
+#include <pthread.h>
+#endif
+
 /* The maximum number of fontnames requested with XListFonts(). */
 #define MAX_FONTS 32767
 
@@ -176,7 +185,9 @@ struct _GtkFontSelInfo {
   /* This stores all the font sizes available for every style.
      Each style holds an index into these arrays. */
   guint16 *pixel_sizes;
+  gint npixel_sizes;
   guint16 *point_sizes;
+  gint npoint_sizes;
   
   /* These are the arrays of strings of all possible weights, slants, 
      set widths, spacings, charsets & foundries, and the amount of space
@@ -184,6 +195,15 @@ struct _GtkFontSelInfo {
   gchar **properties[GTK_NUM_FONT_PROPERTIES];
   guint16 nproperties[GTK_NUM_FONT_PROPERTIES];
   guint16 space_allocated[GTK_NUM_FONT_PROPERTIES];
+
+  /* These are indexes built once the tables above are complete. The
+     font types hold the union of the style flags of each font. For each
+     property value, property_fonts lists the fonts having a style with
+     that value, from property_font_starts[value] up to
+     property_font_starts[value + 1]. */
+  guint8 *font_types;
+  gint *property_font_starts[GTK_NUM_FONT_PROPERTIES];
+  gint *property_fonts[GTK_NUM_FONT_PROPERTIES];
 };
 
 /* These are the field numbers in the X Logical Font Description fontnames,
@@ -266,6 +286,41 @@ typedef enum
 
 static GtkFontSelInfo *fontsel_info = NULL;
 
+/* When there is no usable cache and threads are enabled, the font
+   tables are built by a worker thread. fontsel_info stays NULL until it
+   has finished; in the meantime the font selections created are kept
+   in the waiting list and show the families found so far. The lock
+   protects the font_info table of the info being built, and done. */
+typedef struct _GtkFontSelLoader GtkFontSelLoader;
+struct _GtkFontSelLoader
+{
+  GtkFontSelInfo *info;
+  gchar **xfontnames;
+  gint num_fonts;
+  gchar *key;
+  gchar *file;
+
+  GMutex *lock;
+  gboolean done;
+#ifdef G_THREADS_IMPL_POSIX
+  pthread_t thread;
+#endif
+
+  gint nfonts_shown;
+  GSList *waiting;
+  guint timeout;
+};
+
+static GtkFontSelLoader *fontsel_loader = NULL;
+
+/* The font tables are cached in this file in the home directory, keyed by
+   the server's font path and vendor release. */
+#define FONT_CACHE_FILE ".gtk-fontsel-cache"
+#define FONT_CACHE_MAGIC "GtkFSel1"
+
+/* How often the font list is refreshed while it is being built. */
+#define FONT_LOADER_INTERVAL 250
+
 /* The initial size and increment of each of the arrays of property values. */
 #define PROPERTY_ARRAY_INCREMENT	16
 
@@ -275,10 +330,36 @@ static void    gtk_font_selection_destroy	     (GtkObject      *object);
 
 /* These are all used for class initialization - loading in the fonts etc. */
 static void    gtk_font_selection_get_fonts          (void);
-static void    gtk_font_selection_insert_font        (GSList         *fontnames[],
-						      gint           *ntable,
-						      gchar          *fontname);
-static gint    gtk_font_selection_insert_field       (gchar          *fontname,
+static void    gtk_font_selection_wait_for_fonts     (void);
+static void    gtk_font_selection_build_info         (GtkFontSelInfo *info,
+						      gchar         **xfontnames,
+						      gint            num_fonts,
+						      GMutex         *lock);
+static void    gtk_font_selection_index_info         (GtkFontSelInfo *info);
+static void    gtk_font_selection_insert_font        (GtkFontSelInfo *info,
+						      GSList         *fontnames[],
+						      gchar          *fontname,
+						      GMutex         *lock);
+static gint    gtk_font_selection_insert_field       (GtkFontSelInfo *info,
+						      gchar          *fontname,
+						      gint            prop);
+static gchar*  gtk_font_selection_cache_key          (void);
+static gchar*  gtk_font_selection_cache_file         (void);
+static GtkFontSelInfo* gtk_font_selection_load_cache (const gchar    *key,
+						      const gchar    *file);
+static void    gtk_font_selection_save_cache         (GtkFontSelInfo *info,
+						      const gchar    *key,
+						      const gchar    *file);
+#ifdef G_THREADS_IMPL_POSIX
+static gpointer gtk_font_selection_loader_thread     (gpointer        data);
+static gint    gtk_font_selection_loader_timeout     (gpointer        data);
+static void    gtk_font_selection_loader_finish      (void);
+#endif
+static void    gtk_font_selection_fill               (GtkFontSelection *fontsel);
+static void    gtk_font_selection_show_partial_fonts (GtkFontSelection *fontsel,
+						      gchar         **families,
+						      gint            nfamilies);
+static void    gtk_font_selection_insert_properties  (GtkFontSelection *fontsel,
 						      gint            prop);
 
 /* These are the callbacks & related functions. */
@@ -445,14 +526,13 @@ gtk_font_selection_init(GtkFontSelection *fontsel)
   GtkWidget *text_frame;
   GtkWidget *text_box, *frame;
   GtkWidget *table, *label, *hbox, *hbox2, *clist, *button, *vbox, *alignment;
-  gint i, prop, row;
+  gint i, prop;
   gchar *titles[] = { NULL, NULL, NULL };
   gchar buffer[128];
   gchar *size;
   gint size_to_match;
   gchar *row_text[3];
-  gchar *property, *text;
-  gboolean inserted;
+  gchar *property;
   
   /* Number of internationalized titles here must match number
      of NULL initializers above */
@@ -584,8 +664,17 @@ gtk_font_selection_init(GtkFontSelection *fontsel)
   
   
   /* Insert the fonts. If there exist fonts with the same family but
-     different foundries, then the foundry name is appended in brackets. */
-  gtk_font_selection_show_available_fonts(fontsel);
+     different foundries, then the foundry name is appended in brackets.
+     If the fonts are still being loaded this is done when they are ready. */
+  if (fontsel_info)
+    gtk_font_selection_show_available_fonts(fontsel);
+  else
+    {
+      gtk_widget_set_sensitive (fontsel->font_clist, FALSE);
+      fontsel_loader->waiting = g_slist_prepend (fontsel_loader->waiting,
+						 fontsel);
+      fontsel_loader->nfonts_shown = -1;
+    }
   
   gtk_signal_connect (GTK_OBJECT (fontsel->font_clist), "select_row",
 		      GTK_SIGNAL_FUNC(gtk_font_selection_select_font),
@@ -768,9 +857,15 @@ gtk_font_selection_init(GtkFontSelection *fontsel)
   gtk_box_pack_start (GTK_BOX (fontsel->info_vbox),
 		      fontsel->actual_font_name, FALSE, TRUE, 0);
   
-  sprintf(buffer, _("%i fonts available with a total of %i styles."),
-	  fontsel_info->nfonts, fontsel_info->nstyles);
-  label = gtk_label_new(buffer);
+  if (fontsel_info)
+    {
+      sprintf(buffer, _("%i fonts available with a total of %i styles."),
+	      fontsel_info->nfonts, fontsel_info->nstyles);
+      label = gtk_label_new(buffer);
+    }
+  else
+    label = gtk_label_new(_("Loading fonts..."));
+  gtk_object_set_data (GTK_OBJECT (fontsel), "gtk-font-info-label", label);
   gtk_widget_show (label);
   gtk_box_pack_start (GTK_BOX (fontsel->info_vbox), label, FALSE, FALSE, 0);
   
@@ -783,6 +878,8 @@ gtk_font_selection_init(GtkFontSelection *fontsel)
   fontsel->filter_vbox = gtk_vbox_new (FALSE, 4);
   gtk_widget_show (fontsel->filter_vbox);
   gtk_container_set_border_width (GTK_CONTAINER (fontsel->filter_vbox), 2);
+  if (!fontsel_info)
+    gtk_widget_set_sensitive (fontsel->filter_vbox, FALSE);
   label = gtk_label_new(_("Filter"));
   gtk_notebook_append_page (GTK_NOTEBOOK (fontsel),
 			    fontsel->filter_vbox, label);
@@ -884,38 +981,55 @@ gtk_font_selection_init(GtkFontSelection *fontsel)
 			  GTK_SIGNAL_FUNC(gtk_font_selection_unselect_filter),
 			  fontsel);
       
-      /* Insert the property names, expanded, and in sorted order.
-	 But we make sure that the wildcard '*' is first. */
-      gtk_clist_freeze (GTK_CLIST(clist));
+      /* The wildcard '*' is always first. The property names are inserted
+	 after it when the fonts have been loaded. */
       property = N_("*");
       gtk_clist_append(GTK_CLIST(clist), &property);
+      gtk_clist_select_row(GTK_CLIST(clist), 0, 0);
+      fontsel->filter_clists[prop] = clist;
       
-      for (i = 1; i < fontsel_info->nproperties[prop]; i++) {
-	property = _(fontsel_info->properties[prop][i]);
-	if (prop == SLANT)
-	  property = gtk_font_selection_expand_slant_code(property);
-	else if (prop == SPACING)
-	  property = gtk_font_selection_expand_spacing_code(property);
-	
-	inserted = FALSE;
-	for (row = 1; row < GTK_CLIST(clist)->rows; row++)
+      if (fontsel_info)
+	gtk_font_selection_insert_properties (fontsel, prop);
+    }
+}
+
+
+/* This inserts the property names into a filter clist, expanded, and in
+   sorted order after the wildcard '*'. */
+static void
+gtk_font_selection_insert_properties (GtkFontSelection *fontsel,
+				      gint		prop)
+{
+  GtkWidget *clist;
+  gchar *property, *text;
+  gboolean inserted;
+  gint i, row;
+  
+  clist = fontsel->filter_clists[prop];
+  gtk_clist_freeze (GTK_CLIST(clist));
+  for (i = 1; i < fontsel_info->nproperties[prop]; i++) {
+    property = _(fontsel_info->properties[prop][i]);
+    if (prop == SLANT)
+      property = gtk_font_selection_expand_slant_code(property);
+    else if (prop == SPACING)
+      property = gtk_font_selection_expand_spacing_code(property);
+    
+    inserted = FALSE;
+    for (row = 1; row < GTK_CLIST(clist)->rows; row++)
+      {
+	gtk_clist_get_text(GTK_CLIST(clist), row, 0, &text);
+	if (strcmp(property, text) < 0)
 	  {
-	    gtk_clist_get_text(GTK_CLIST(clist), row, 0, &text);
-	    if (strcmp(property, text) < 0)
-	      {
-		inserted = TRUE;
-		gtk_clist_insert(GTK_CLIST(clist), row, &property);
-		break;
-	      }
+	    inserted = TRUE;
+	    gtk_clist_insert(GTK_CLIST(clist), row, &property);
+	    break;
 	  }
-	if (!inserted)
-	  row = gtk_clist_append(GTK_CLIST(clist), &property);
-	gtk_clist_set_row_data(GTK_CLIST(clist), row, GINT_TO_POINTER (i));
       }
-      gtk_clist_select_row(GTK_CLIST(clist), 0, 0);
-      gtk_clist_thaw (GTK_CLIST(clist));
-      fontsel->filter_clists[prop] = clist;
-    }
+    if (!inserted)
+      row = gtk_clist_append(GTK_CLIST(clist), &property);
+    gtk_clist_set_row_data(GTK_CLIST(clist), row, GINT_TO_POINTER (i));
+  }
+  gtk_clist_thaw (GTK_CLIST(clist));
 }
 
 GtkWidget *
@@ -938,7 +1052,13 @@ gtk_font_selection_destroy (GtkObject *object)
   
   fontsel = GTK_FONT_SELECTION (object);
   
-  /* All we have to do is unref the font, if we have one. */
+#ifdef G_THREADS_IMPL_POSIX
+  if (fontsel_loader)
+    fontsel_loader->waiting = g_slist_remove (fontsel_loader->waiting,
+					      fontsel);
+#endif
+  
+  /* Otherwise all we have to do is unref the font, if we have one. */
   if (fontsel->font)
     gdk_font_unref (fontsel->font);
   
@@ -1867,6 +1987,10 @@ gtk_font_selection_switch_page (GtkWidget       *w,
   if (!GTK_WIDGET_VISIBLE(w))
     return;
   
+  /* Nothing can be shown until the fonts have been loaded. */
+  if (!fontsel_info)
+    return;
+  
   if (page_num == 0)
     gtk_font_selection_update_filter(fontsel);
   else if (page_num == 1)
@@ -2184,16 +2308,32 @@ gtk_font_selection_update_filter     (GtkFontSelection *fontsel)
 }  
 
 
-/* This shows all the available fonts in the font clist. */
+static gint
+gtk_font_selection_compare_indices (const void *a,
+				    const void *b)
+{
+  return *(const gint *) a - *(const gint *) b;
+}
+
+
+/* This shows all the available fonts in the font clist. The filters are
+   turned into a mask of the allowed values for each property, and the
+   property index is used to find the fonts with the most restrictive one,
+   so only those fonts need to be checked. */
 static void
 gtk_font_selection_show_available_fonts     (GtkFontSelection *fontsel)
 {
   FontInfo *font_info, *font;
+  FontStyle *styles;
   GtkFontFilter *filter;
-  gint nfonts, i, j, k, row, style, font_row = -1;
+  guint8 *masks[GTK_NUM_FONT_PROPERTIES];
+  guint8 *mask, *marks;
+  gint *candidates, *starts, *fonts;
+  gint nfonts, ncandidates, i, j, k, c, row, style, font_row = -1;
+  gint prop, best_prop, count, best_count, value, type_filter;
   gchar font_buffer[XLFD_MAX_FIELD_LEN * 2 + 4];
   gchar *font_item;
-  gboolean matched, matched_style;
+  gboolean matched_style;
   
 #ifdef FONTSEL_DEBUG
   g_message("In show_available_fonts\n");
@@ -2201,48 +2341,108 @@ gtk_font_selection_show_available_fonts     (GtkFontSelection *fontsel)
   font_info = fontsel_info->font_info;
   nfonts = fontsel_info->nfonts;
   
-  /* Filter the list of fonts. */
-  gtk_clist_freeze (GTK_CLIST(fontsel->font_clist));
-  gtk_clist_clear (GTK_CLIST(fontsel->font_clist));
-  for (i = 0; i < nfonts; i++)
+  type_filter = fontsel->filters[GTK_FONT_FILTER_BASE].font_type
+    & fontsel->filters[GTK_FONT_FILTER_USER].font_type;
+  
+  /* Create the masks. A property which isn't filtered has no mask. */
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
     {
-      font = &font_info[i];
-      
-      /* Check if the foundry passes through all filters. */
-      matched = TRUE;
+      masks[prop] = NULL;
       for (k = 0; k < GTK_NUM_FONT_FILTERS; k++)
 	{
 	  filter = &fontsel->filters[k];
-
-	  if (filter->property_nfilters[FOUNDRY] != 0)
+	  if (filter->property_nfilters[prop] == 0)
+	    continue;
+	  
+	  mask = g_new0 (guint8, fontsel_info->nproperties[prop]);
+	  for (j = 0; j < filter->property_nfilters[prop]; j++)
 	    {
-	      matched = FALSE;
-	      for (j = 0; j < filter->property_nfilters[FOUNDRY]; j++)
-		{
-		  if (font->foundry == filter->property_filters[FOUNDRY][j])
-		    {
-		      matched = TRUE;
-		      break;
-		    }
-		}
-	      if (!matched)
-		break;
+	      value = filter->property_filters[prop][j];
+	      if (value < fontsel_info->nproperties[prop])
+		mask[value] = !masks[prop] || masks[prop][value];
 	    }
+	  g_free (masks[prop]);
+	  masks[prop] = mask;
+	}
+    }
+  
+  /* Find the filtered property which matches the fewest fonts. */
+  best_prop = -1;
+  best_count = nfonts;
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    {
+      if (!masks[prop])
+	continue;
+      starts = fontsel_info->property_font_starts[prop];
+      count = 0;
+      for (value = 0; value < fontsel_info->nproperties[prop]; value++)
+	if (masks[prop][value])
+	  count += starts[value + 1] - starts[value];
+      if (count < best_count)
+	{
+	  best_prop = prop;
+	  best_count = count;
+	}
+    }
+  
+  if (best_prop == -1)
+    {
+      candidates = NULL;
+      ncandidates = nfonts;
+    }
+  else
+    {
+      /* A font may be listed under several of the allowed values. */
+      starts = fontsel_info->property_font_starts[best_prop];
+      fonts = fontsel_info->property_fonts[best_prop];
+      candidates = g_new (gint, MAX (best_count, 1));
+      marks = g_new0 (guint8, MAX (nfonts, 1));
+      ncandidates = 0;
+      for (value = 0; value < fontsel_info->nproperties[best_prop]; value++)
+	{
+	  if (!masks[best_prop][value])
+	    continue;
+	  for (j = starts[value]; j < starts[value + 1]; j++)
+	    if (!marks[fonts[j]])
+	      {
+		marks[fonts[j]] = TRUE;
+		candidates[ncandidates++] = fonts[j];
+	      }
 	}
+      g_free (marks);
+      qsort (candidates, ncandidates, sizeof (gint),
+	     gtk_font_selection_compare_indices);
+    }
+  
+  /* Filter the list of fonts. */
+  gtk_clist_freeze (GTK_CLIST(fontsel->font_clist));
+  gtk_clist_clear (GTK_CLIST(fontsel->font_clist));
+  for (c = 0; c < ncandidates; c++)
+    {
+      i = candidates ? candidates[c] : c;
+      font = &font_info[i];
       
-      if (!matched)
+      /* Check if any of the styles has a type which passes the filters, and
+	 if the foundry passes through all filters. */
+      if (!(fontsel_info->font_types[i] & type_filter))
 	continue;
-
-
+      if (masks[FOUNDRY] && !masks[FOUNDRY][font->foundry])
+	continue;
+      
       /* Now check if the other properties are matched in at least one style.*/
+      styles = &fontsel_info->font_styles[font->style_index];
       matched_style = FALSE;
-      for (style = 0; style < font->nstyles; style++)
+      for (style = 0; style < font->nstyles && !matched_style; style++)
 	{
-	  if (gtk_font_selection_style_visible(fontsel, font, style))
-	    {
-	      matched_style = TRUE;
-	      break;
-	    }
+	  if (!(styles[style].flags & type_filter))
+	    continue;
+	  matched_style = TRUE;
+	  for (prop = 0; prop < GTK_NUM_STYLE_PROPERTIES; prop++)
+	    if (masks[prop] && !masks[prop][styles[style].properties[prop]])
+	      {
+		matched_style = FALSE;
+		break;
+	      }
 	}
       if (!matched_style)
 	continue;
@@ -2268,6 +2468,10 @@ gtk_font_selection_show_available_fonts     (GtkFontSelection *fontsel)
     }
   gtk_clist_thaw (GTK_CLIST(fontsel->font_clist));
   
+  g_free (candidates);
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    g_free (masks[prop]);
+  
   /* If the currently-selected font isn't in the new list, reset the
      selection. */
   if (font_row == -1)
@@ -2428,6 +2632,8 @@ gtk_font_selection_set_filter	(GtkFontSelection *fontsel,
   gint base_font_type, user_font_type;
   gboolean filter_set;
 
+  gtk_font_selection_wait_for_fonts ();
+
   /* Put them into an array so we can use a simple loop. */
   filter_strings[FOUNDRY]   = foundries;
   filter_strings[WEIGHT]    = weights;
@@ -2629,11 +2835,698 @@ gtk_font_selection_filter_state (GtkFontSelection *fontsel,
 static void
 gtk_font_selection_get_fonts (void)
 {
+  GtkFontSelInfo *info;
   gchar **xfontnames;
+  gchar *key, *file;
+  gint num_fonts;
+  
+  key = gtk_font_selection_cache_key ();
+  file = gtk_font_selection_cache_file ();
+  
+  info = gtk_font_selection_load_cache (key, file);
+  if (info)
+    {
+      gtk_font_selection_index_info (info);
+      fontsel_info = info;
+      g_free (key);
+      g_free (file);
+      return;
+    }
+  
+  /* Get a maximum of MAX_FONTS fontnames from the X server.
+     Use "-*" as the pattern rather than "-*-*-*-*-*-*-*-*-*-*-*-*-*-*" since
+     the latter may result in fonts being returned which don't actually exist.
+     xlsfonts also uses "*" so I think it's OK. "-*" gets rid of aliases. */
+  xfontnames = XListFonts (GDK_DISPLAY(), "-*", MAX_FONTS, &num_fonts);
+  /* Output a warning if we actually get MAX_FONTS fonts. */
+  if (num_fonts == MAX_FONTS)
+    g_warning(_("MAX_FONTS exceeded. Some fonts may be missing."));
+  
+  info = g_new0 (GtkFontSelInfo, 1);
+  
+#ifdef G_THREADS_IMPL_POSIX
+  /* Parsing the fontnames doesn't need the X connection, so if we can we
+     do it in a worker thread, which also writes the cache. */
+  if (g_thread_supported ())
+    {
+      fontsel_loader = g_new0 (GtkFontSelLoader, 1);
+      fontsel_loader->info = info;
+      fontsel_loader->xfontnames = xfontnames;
+      fontsel_loader->num_fonts = num_fonts;
+      fontsel_loader->key = key;
+      fontsel_loader->file = file;
+      fontsel_loader->lock = g_mutex_new ();
+      fontsel_loader->nfonts_shown = -1;
+      
+      if (pthread_create (&fontsel_loader->thread, NULL,
+			  gtk_font_selection_loader_thread,
+			  fontsel_loader) == 0)
+	{
+	  fontsel_loader->timeout
+	    = gtk_timeout_add (FONT_LOADER_INTERVAL,
+			       gtk_font_selection_loader_timeout, NULL);
+	  return;
+	}
+      
+      g_mutex_free (fontsel_loader->lock);
+      g_free (fontsel_loader);
+      fontsel_loader = NULL;
+    }
+#endif
+  
+  gtk_font_selection_build_info (info, xfontnames, num_fonts, NULL);
+  XFreeFontNames (xfontnames);
+  
+  gtk_font_selection_save_cache (info, key, file);
+  g_free (key);
+  g_free (file);
+  
+  gtk_font_selection_index_info (info);
+  fontsel_info = info;
+}
+
+
+/* This makes sure the font tables are complete, waiting for the worker
+   thread if they are still being built. */
+static void
+gtk_font_selection_wait_for_fonts (void)
+{
+#ifdef G_THREADS_IMPL_POSIX
+  if (fontsel_loader)
+    gtk_font_selection_loader_finish ();
+#endif
+}
+
+
+#ifdef G_THREADS_IMPL_POSIX
+static gpointer
+gtk_font_selection_loader_thread (gpointer data)
+{
+  GtkFontSelLoader *loader = data;
+  
+  gtk_font_selection_build_info (loader->info, loader->xfontnames,
+				 loader->num_fonts, loader->lock);
+  gtk_font_selection_save_cache (loader->info, loader->key, loader->file);
+  
+  g_mutex_lock (loader->lock);
+  loader->done = TRUE;
+  g_mutex_unlock (loader->lock);
+  
+  return NULL;
+}
+
+
+static void
+gtk_font_selection_loader_finish (void)
+{
+  GtkFontSelLoader *loader = fontsel_loader;
+  GSList *waiting, *tmp_list;
+  
+  pthread_join (loader->thread, NULL);
+  
+  if (loader->timeout)
+    gtk_timeout_remove (loader->timeout);
+  XFreeFontNames (loader->xfontnames);
+  g_mutex_free (loader->lock);
+  g_free (loader->key);
+  g_free (loader->file);
+  
+  gtk_font_selection_index_info (loader->info);
+  fontsel_info = loader->info;
+  
+  waiting = loader->waiting;
+  fontsel_loader = NULL;
+  g_free (loader);
+  
+  for (tmp_list = waiting; tmp_list; tmp_list = tmp_list->next)
+    gtk_font_selection_fill (tmp_list->data);
+  g_slist_free (waiting);
+}
+
+
+/* This checks if the worker thread has finished, and if not shows the
+   families found so far in the waiting font selections. */
+static gint
+gtk_font_selection_loader_timeout (gpointer data)
+{
+  GtkFontSelLoader *loader;
+  GtkFontSelInfo *info;
+  gchar **families = NULL;
+  gint nfamilies = 0;
+  gboolean done;
+  GSList *tmp_list;
+  gint i;
+  
+  GDK_THREADS_ENTER ();
+  
+  loader = fontsel_loader;
+  info = loader->info;
+  
+  g_mutex_lock (loader->lock);
+  done = loader->done;
+  if (!done && info->nfonts != loader->nfonts_shown)
+    {
+      /* The family strings are never freed or moved, so we can use them
+	 after unlocking. */
+      loader->nfonts_shown = info->nfonts;
+      families = g_new (gchar*, info->nfonts);
+      for (i = 0; i < info->nfonts; i++)
+	if (i == 0 || info->font_info[i].family != info->font_info[i-1].family)
+	  families[nfamilies++] = info->font_info[i].family;
+    }
+  g_mutex_unlock (loader->lock);
+  
+  if (done)
+    {
+      loader->timeout = 0;
+      gtk_font_selection_loader_finish ();
+    }
+  else if (families)
+    {
+      for (tmp_list = loader->waiting; tmp_list; tmp_list = tmp_list->next)
+	gtk_font_selection_show_partial_fonts (tmp_list->data,
+					       families, nfamilies);
+      g_free (families);
+    }
+  
+  GDK_THREADS_LEAVE ();
+  
+  return !done;
+}
+#endif
+
+
+/* This fills in the parts of a font selection which need the font tables,
+   for font selections created while they were being built. */
+static void
+gtk_font_selection_fill (GtkFontSelection *fontsel)
+{
+  GtkWidget *label;
+  gchar buffer[128];
+  gint prop;
+  
+  label = gtk_object_get_data (GTK_OBJECT (fontsel), "gtk-font-info-label");
+  sprintf(buffer, _("%i fonts available with a total of %i styles."),
+	  fontsel_info->nfonts, fontsel_info->nstyles);
+  gtk_label_set_text (GTK_LABEL (label), buffer);
+  
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    gtk_font_selection_insert_properties (fontsel, prop);
+  
+  gtk_widget_set_sensitive (fontsel->font_clist, TRUE);
+  gtk_widget_set_sensitive (fontsel->filter_vbox, TRUE);
+  
+  gtk_font_selection_show_available_fonts (fontsel);
+}
+
+
+/* This shows the families found so far while the font tables are being
+   built. They can't be selected until the tables are complete. */
+static void
+gtk_font_selection_show_partial_fonts (GtkFontSelection *fontsel,
+				       gchar		**families,
+				       gint		  nfamilies)
+{
+  gint i;
+  
+  gtk_clist_freeze (GTK_CLIST(fontsel->font_clist));
+  gtk_clist_clear (GTK_CLIST(fontsel->font_clist));
+  for (i = 0; i < nfamilies; i++)
+    gtk_clist_append (GTK_CLIST(fontsel->font_clist), &families[i]);
+  gtk_clist_thaw (GTK_CLIST(fontsel->font_clist));
+}
+
+
+/* This builds the indexes used when filtering the fonts. */
+static void
+gtk_font_selection_index_info (GtkFontSelInfo *info)
+{
+  FontInfo *font;
+  FontStyle *styles;
+  gint *starts, *fonts, *last_font;
+  gint prop, nvalues, i, style, value;
+  gboolean fill;
+  
+  info->font_types = g_new0 (guint8, MAX (info->nfonts, 1));
+  for (i = 0; i < info->nfonts; i++)
+    {
+      font = &info->font_info[i];
+      styles = &info->font_styles[font->style_index];
+      for (style = 0; style < font->nstyles; style++)
+	info->font_types[i] |= styles[style].flags & GTK_FONT_ALL;
+    }
+  
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    {
+      nvalues = info->nproperties[prop];
+      starts = g_new0 (gint, nvalues + 1);
+      last_font = g_new (gint, nvalues);
+      fonts = NULL;
+      
+      /* The first pass counts the fonts for each value, the second one
+	 fills them in, using starts[value] as the next free position. */
+      for (fill = FALSE; fill <= TRUE; fill++)
+	{
+	  for (value = 0; value < nvalues; value++)
+	    last_font[value] = -1;
+	  
+	  for (i = 0; i < info->nfonts; i++)
+	    {
+	      font = &info->font_info[i];
+	      styles = &info->font_styles[font->style_index];
+	      for (style = 0; style < font->nstyles; style++)
+		{
+		  value = (prop == FOUNDRY) ? font->foundry
+		    : styles[style].properties[prop];
+		  if (last_font[value] == i)
+		    continue;
+		  last_font[value] = i;
+		  
+		  if (fill)
+		    fonts[starts[value]++] = i;
+		  else
+		    starts[value + 1]++;
+		}
+	    }
+	  
+	  if (!fill)
+	    {
+	      for (value = 0; value < nvalues; value++)
+		starts[value + 1] += starts[value];
+	      fonts = g_new (gint, MAX (starts[nvalues], 1));
+	      /* Shift the starts down, so that they are advanced back to
+		 their proper values by the fill pass. */
+	      for (value = nvalues; value > 0; value--)
+		starts[value] = starts[value - 1];
+	      starts[0] = 0;
+	    }
+	}
+      
+      g_free (last_font);
+      info->property_font_starts[prop] = starts;
+      info->property_fonts[prop] = fonts;
+    }
+}
+
+
+/* The cache file starts with a FontCacheHeader followed by the key. The
+   font table, the styles and the sizes, the offsets of the property values
+   and the strings follow, each aligned to 8 bytes. The styles and sizes are
+   used directly from the mapped file. */
+typedef struct _FontCacheHeader FontCacheHeader;
+typedef struct _FontCacheFont   FontCacheFont;
+
+struct _FontCacheHeader
+{
+  gchar   magic[8];
+  guint32 header_size;
+  guint32 style_size;
+  guint32 key_length;
+  guint32 nfonts;
+  guint32 nstyles;
+  guint32 npixel_sizes;
+  guint32 npoint_sizes;
+  guint32 nproperties[GTK_NUM_FONT_PROPERTIES];
+  guint32 strings_size;
+};
+
+struct _FontCacheFont
+{
+  guint32 family;
+  gint32  style_index;
+  guint16 foundry;
+  guint16 nstyles;
+};
+
+#define FONT_CACHE_ALIGN(offset) (((offset) + 7) & ~7)
+
+enum {
+  FONT_CACHE_FONTS,
+  FONT_CACHE_STYLES,
+  FONT_CACHE_PIXEL_SIZES,
+  FONT_CACHE_POINT_SIZES,
+  FONT_CACHE_PROPERTIES,
+  FONT_CACHE_STRINGS,
+  FONT_CACHE_END,
+  FONT_CACHE_NSECTIONS
+};
+
+static void
+gtk_font_selection_cache_layout (FontCacheHeader *header,
+				 gulong		  offsets[])
+{
+  gulong nvalues = 0;
+  gint prop;
+  
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    nvalues += header->nproperties[prop];
+  
+  offsets[FONT_CACHE_FONTS] = FONT_CACHE_ALIGN (sizeof (FontCacheHeader)
+						+ header->key_length);
+  offsets[FONT_CACHE_STYLES] = FONT_CACHE_ALIGN (offsets[FONT_CACHE_FONTS]
+			 + (gulong) header->nfonts * sizeof (FontCacheFont));
+  offsets[FONT_CACHE_PIXEL_SIZES] = FONT_CACHE_ALIGN (offsets[FONT_CACHE_STYLES]
+			 + (gulong) header->nstyles * header->style_size);
+  offsets[FONT_CACHE_POINT_SIZES] = FONT_CACHE_ALIGN (offsets[FONT_CACHE_PIXEL_SIZES]
+			 + (gulong) header->npixel_sizes * sizeof (guint16));
+  offsets[FONT_CACHE_PROPERTIES] = FONT_CACHE_ALIGN (offsets[FONT_CACHE_POINT_SIZES]
+			 + (gulong) header->npoint_sizes * sizeof (guint16));
+  offsets[FONT_CACHE_STRINGS] = offsets[FONT_CACHE_PROPERTIES]
+    + nvalues * sizeof (guint32);
+  offsets[FONT_CACHE_END] = offsets[FONT_CACHE_STRINGS] + header->strings_size;
+}
+
+
+/* The key identifies the set of fonts on the server: if the font path or
+   the server changes, the cache is rebuilt. */
+static gchar*
+gtk_font_selection_cache_key (void)
+{
+  GString *key;
+  gchar **paths;
+  gchar *result;
+  gint npaths, i;
+  
+  key = g_string_new (ServerVendor (GDK_DISPLAY ()));
+  g_string_sprintfa (key, "\n%d\n%d", VendorRelease (GDK_DISPLAY ()),
+		     MAX_FONTS);
+  
+  paths = XGetFontPath (GDK_DISPLAY (), &npaths);
+  for (i = 0; i < npaths; i++)
+    {
+      g_string_append_c (key, '\n');
+      g_string_append (key, paths[i]);
+    }
+  if (paths)
+    XFreeFontPath (paths);
+  
+  result = key->str;
+  g_string_free (key, FALSE);
+  
+  return result;
+}
+
+
+static gchar*
+gtk_font_selection_cache_file (void)
+{
+  gchar *home;
+  
+  home = g_get_home_dir ();
+  if (!home)
+    return NULL;
+  
+  return g_strconcat (home, "/", FONT_CACHE_FILE, NULL);
+}
+
+
+static GtkFontSelInfo*
+gtk_font_selection_load_cache (const gchar *key,
+			       const gchar *file)
+{
+  GtkFontSelInfo *info;
+  FontCacheHeader *header;
+  FontCacheFont *fonts;
+  FontStyle *style;
+  guint32 *values;
+  gchar *map, *strings;
+  gulong offsets[FONT_CACHE_NSECTIONS];
+  struct stat statbuf;
+  gint fd, i, prop;
+  
+  if (!file)
+    return NULL;
+  
+  fd = open (file, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  
+  if (fstat (fd, &statbuf) < 0 ||
+      statbuf.st_size < sizeof (FontCacheHeader))
+    {
+      close (fd);
+      return NULL;
+    }
+  
+  /* The styles' displayed flags are written to, so the mapping must be
+     private and writable. */
+  map = mmap (NULL, statbuf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+	      fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return NULL;
+  
+  header = (FontCacheHeader *) map;
+  if (memcmp (header->magic, FONT_CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+      header->header_size != sizeof (FontCacheHeader) ||
+      header->style_size != sizeof (FontStyle) ||
+      header->key_length != strlen (key) ||
+      header->key_length > statbuf.st_size - sizeof (FontCacheHeader) ||
+      memcmp (map + sizeof (FontCacheHeader), key, header->key_length) != 0)
+    goto invalid;
+  
+  gtk_font_selection_cache_layout (header, offsets);
+  if (offsets[FONT_CACHE_END] != statbuf.st_size ||
+      header->strings_size == 0 ||
+      map[statbuf.st_size - 1] != '\0')
+    goto invalid;
+  
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    if (header->nproperties[prop] == 0 || header->nproperties[prop] > 0xffff)
+      goto invalid;
+  
+  /* Check all the indexes, so that a corrupt file can't crash us later. */
+  fonts = (FontCacheFont *) (map + offsets[FONT_CACHE_FONTS]);
+  for (i = 0; i < header->nfonts; i++)
+    if (fonts[i].family >= header->strings_size ||
+	fonts[i].foundry >= header->nproperties[FOUNDRY] ||
+	fonts[i].style_index < 0 ||
+	fonts[i].style_index + fonts[i].nstyles > header->nstyles)
+      goto invalid;
+  
+  style = (FontStyle *) (map + offsets[FONT_CACHE_STYLES]);
+  for (i = 0; i < header->nstyles; i++, style++)
+    {
+      for (prop = 0; prop < GTK_NUM_STYLE_PROPERTIES; prop++)
+	if (style->properties[prop] >= header->nproperties[prop])
+	  goto invalid;
+      if (style->pixel_sizes_index < 0 ||
+	  style->pixel_sizes_index + style->npixel_sizes > header->npixel_sizes ||
+	  style->point_sizes_index < 0 ||
+	  style->point_sizes_index + style->npoint_sizes > header->npoint_sizes)
+	goto invalid;
+    }
+  
+  values = (guint32 *) (map + offsets[FONT_CACHE_PROPERTIES]);
+  for (i = 0; i < (offsets[FONT_CACHE_STRINGS]
+		   - offsets[FONT_CACHE_PROPERTIES]) / sizeof (guint32); i++)
+    if (values[i] >= header->strings_size)
+      goto invalid;
+  
+  /* Now create the tables, pointing into the mapped file. */
+  strings = map + offsets[FONT_CACHE_STRINGS];
+  info = g_new0 (GtkFontSelInfo, 1);
+  
+  info->nfonts = header->nfonts;
+  info->font_info = g_new (FontInfo, MAX (header->nfonts, 1));
+  for (i = 0; i < header->nfonts; i++)
+    {
+      /* Fonts of the same family share the family string. */
+      if (i > 0 && fonts[i].family == fonts[i-1].family)
+	info->font_info[i].family = info->font_info[i-1].family;
+      else
+	info->font_info[i].family = strings + fonts[i].family;
+      info->font_info[i].foundry = fonts[i].foundry;
+      info->font_info[i].style_index = fonts[i].style_index;
+      info->font_info[i].nstyles = fonts[i].nstyles;
+    }
+  
+  info->font_styles = (FontStyle *) (map + offsets[FONT_CACHE_STYLES]);
+  info->nstyles = header->nstyles;
+  info->pixel_sizes = (guint16 *) (map + offsets[FONT_CACHE_PIXEL_SIZES]);
+  info->npixel_sizes = header->npixel_sizes;
+  info->point_sizes = (guint16 *) (map + offsets[FONT_CACHE_POINT_SIZES]);
+  info->npoint_sizes = header->npoint_sizes;
+  
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    {
+      info->nproperties[prop] = header->nproperties[prop];
+      info->space_allocated[prop] = header->nproperties[prop];
+      info->properties[prop] = g_new (gchar*, header->nproperties[prop]);
+      for (i = 0; i < header->nproperties[prop]; i++)
+	info->properties[prop][i] = strings + *values++;
+    }
+  
+  return info;
+  
+ invalid:
+  munmap (map, statbuf.st_size);
+  return NULL;
+}
+
+
+static gboolean
+gtk_font_selection_cache_write (FILE	    *fp,
+				gconstpointer data,
+				gulong	     length,
+				gulong	    *position)
+{
+  *position += length;
+  return length == 0 || fwrite (data, length, 1, fp) == 1;
+}
+
+
+static gboolean
+gtk_font_selection_cache_pad (FILE   *fp,
+			      gulong  offset,
+			      gulong *position)
+{
+  static const gchar zeros[8] = { 0 };
+  
+  return gtk_font_selection_cache_write (fp, zeros, offset - *position,
+					 position);
+}
+
+
+static guint32
+gtk_font_selection_cache_string (GString     *strings,
+				 const gchar *string)
+{
+  guint32 offset = strings->len;
+  
+  g_string_append (strings, string);
+  g_string_append_c (strings, '\0');
+  
+  return offset;
+}
+
+
+/* This writes the font tables to the cache file. The file is written
+   under a temporary name and then renamed, so readers never see a partial
+   file. This may be called from the worker thread, so it must not use the
+   X connection. */
+static void
+gtk_font_selection_save_cache (GtkFontSelInfo *info,
+			       const gchar    *key,
+			       const gchar    *file)
+{
+  FontCacheHeader header;
+  FontCacheFont *fonts;
+  GString *strings;
+  guint32 *values;
+  gulong offsets[FONT_CACHE_NSECTIONS];
+  gulong position = 0;
+  gchar *tmp_file;
+  gboolean ok;
+  FILE *fp;
+  gint fd, i, prop, nvalues;
+  
+  if (!file)
+    return;
+  
+  strings = g_string_new (NULL);
+  
+  fonts = g_new (FontCacheFont, MAX (info->nfonts, 1));
+  for (i = 0; i < info->nfonts; i++)
+    {
+      if (i > 0 && info->font_info[i].family == info->font_info[i-1].family)
+	fonts[i].family = fonts[i-1].family;
+      else
+	fonts[i].family = gtk_font_selection_cache_string (strings,
+						   info->font_info[i].family);
+      fonts[i].style_index = info->font_info[i].style_index;
+      fonts[i].foundry = info->font_info[i].foundry;
+      fonts[i].nstyles = info->font_info[i].nstyles;
+    }
+  
+  nvalues = 0;
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    nvalues += info->nproperties[prop];
+  values = g_new (guint32, nvalues);
+  nvalues = 0;
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    for (i = 0; i < info->nproperties[prop]; i++)
+      values[nvalues++] = gtk_font_selection_cache_string (strings,
+						   info->properties[prop][i]);
+  
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, FONT_CACHE_MAGIC, sizeof (header.magic));
+  header.header_size = sizeof (FontCacheHeader);
+  header.style_size = sizeof (FontStyle);
+  header.key_length = strlen (key);
+  header.nfonts = info->nfonts;
+  header.nstyles = info->nstyles;
+  header.npixel_sizes = info->npixel_sizes;
+  header.npoint_sizes = info->npoint_sizes;
+  for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
+    header.nproperties[prop] = info->nproperties[prop];
+  header.strings_size = strings->len;
+  gtk_font_selection_cache_layout (&header, offsets);
+  
+  tmp_file = g_strconcat (file, ".XXXXXX", NULL);
+  fd = mkstemp (tmp_file);
+  fp = fd >= 0 ? fdopen (fd, "w") : NULL;
+  
+  ok = fp != NULL;
+  ok = ok && gtk_font_selection_cache_write (fp, &header, sizeof (header),
+					     &position);
+  ok = ok && gtk_font_selection_cache_write (fp, key, header.key_length,
+					     &position);
+  ok = ok && gtk_font_selection_cache_pad (fp, offsets[FONT_CACHE_FONTS],
+					   &position);
+  ok = ok && gtk_font_selection_cache_write (fp, fonts,
+					     info->nfonts * sizeof (FontCacheFont),
+					     &position);
+  ok = ok && gtk_font_selection_cache_pad (fp, offsets[FONT_CACHE_STYLES],
+					   &position);
+  ok = ok && gtk_font_selection_cache_write (fp, info->font_styles,
+					     info->nstyles * sizeof (FontStyle),
+					     &position);
+  ok = ok && gtk_font_selection_cache_pad (fp, offsets[FONT_CACHE_PIXEL_SIZES],
+					   &position);
+  ok = ok && gtk_font_selection_cache_write (fp, info->pixel_sizes,
+					     info->npixel_sizes * sizeof (guint16),
+					     &position);
+  ok = ok && gtk_font_selection_cache_pad (fp, offsets[FONT_CACHE_POINT_SIZES],
+					   &position);
+  ok = ok && gtk_font_selection_cache_write (fp, info->point_sizes,
+					     info->npoint_sizes * sizeof (guint16),
+					     &position);
+  ok = ok && gtk_font_selection_cache_pad (fp, offsets[FONT_CACHE_PROPERTIES],
+					   &position);
+  ok = ok && gtk_font_selection_cache_write (fp, values,
+					     nvalues * sizeof (guint32),
+					     &position);
+  ok = ok && gtk_font_selection_cache_write (fp, strings->str, strings->len,
+					     &position);
+  
+  if (fp)
+    ok = (fclose (fp) == 0) && ok;
+  else if (fd >= 0)
+    close (fd);
+  
+  if (fd >= 0)
+    {
+      if (!ok || rename (tmp_file, file) != 0)
+	unlink (tmp_file);
+    }
+  
+  g_free (tmp_file);
+  g_free (values);
+  g_free (fonts);
+  g_string_free (strings, TRUE);
+}
+
+
+static void
+gtk_font_selection_build_info (GtkFontSelInfo *info,
+			       gchar         **xfontnames,
+			       gint            num_fonts,
+			       GMutex         *lock)
+{
   GSList **fontnames;
   gchar *fontname;
   GSList * temp_list;
-  gint num_fonts;
   gint i, prop, style, size;
   gint npixel_sizes = 0, npoint_sizes = 0;
   FontInfo *font;
@@ -2645,24 +3538,13 @@ gtk_font_selection_get_fonts (void)
   guint8 flags;
   guint16 *pixel_sizes, *point_sizes, *tmp_sizes;
   
-  fontsel_info = g_new (GtkFontSelInfo, 1);
-  
-  /* Get a maximum of MAX_FONTS fontnames from the X server.
-     Use "-*" as the pattern rather than "-*-*-*-*-*-*-*-*-*-*-*-*-*-*" since
-     the latter may result in fonts being returned which don't actually exist.
-     xlsfonts also uses "*" so I think it's OK. "-*" gets rid of aliases. */
-  xfontnames = XListFonts (GDK_DISPLAY(), "-*", MAX_FONTS, &num_fonts);
-  /* Output a warning if we actually get MAX_FONTS fonts. */
-  if (num_fonts == MAX_FONTS)
-    g_warning(_("MAX_FONTS exceeded. Some fonts may be missing."));
-  
   /* The maximum size of all these tables is the number of font names
      returned. We realloc them later when we know exactly how many
      unique entries there are. */
-  fontsel_info->font_info = g_new (FontInfo, num_fonts);
-  fontsel_info->font_styles = g_new (FontStyle, num_fonts);
-  fontsel_info->pixel_sizes = g_new (guint16, num_fonts);
-  fontsel_info->point_sizes = g_new (guint16, num_fonts);
+  info->font_info = g_new (FontInfo, num_fonts);
+  info->font_styles = g_new (FontStyle, num_fonts);
+  info->pixel_sizes = g_new (guint16, num_fonts);
+  info->point_sizes = g_new (guint16, num_fonts);
   
   fontnames = g_new (GSList*, num_fonts);
   
@@ -2670,10 +3552,10 @@ gtk_font_selection_get_fonts (void)
      may be realloc'ed later. Put the wildcard '*' in the first elements. */
   for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
     {
-      fontsel_info->properties[prop] = g_new(gchar*, PROPERTY_ARRAY_INCREMENT);
-      fontsel_info->space_allocated[prop] = PROPERTY_ARRAY_INCREMENT;
-      fontsel_info->nproperties[prop] = 1;
-      fontsel_info->properties[prop][0] = "*";
+      info->properties[prop] = g_new(gchar*, PROPERTY_ARRAY_INCREMENT);
+      info->space_allocated[prop] = PROPERTY_ARRAY_INCREMENT;
+      info->nproperties[prop] = 1;
+      info->properties[prop][0] = "*";
     }
   
   
@@ -2681,14 +3563,14 @@ gtk_font_selection_get_fonts (void)
      foundry (fonts with different foundries are placed in seaparate FontInfos.
      All fontnames in each family + foundry are placed into the fontnames
      array of lists. */
-  fontsel_info->nfonts = 0;
+  info->nfonts = 0;
   for (i = 0; i < num_fonts; i++)
     {
 #ifdef FONTSEL_DEBUG
       g_message("%s\n", xfontnames[i]);
 #endif
       if (gtk_font_selection_is_xlfd_font_name (xfontnames[i]))
-	gtk_font_selection_insert_font (fontnames, &fontsel_info->nfonts, xfontnames[i]);
+	gtk_font_selection_insert_font (info, fontnames, xfontnames[i], lock);
       else
 	{
 #ifdef FONTSEL_DEBUG
@@ -2701,20 +3583,24 @@ gtk_font_selection_get_fonts (void)
   /* Since many font names will be in the same FontInfo not all of the
      allocated FontInfo table will be used, so we will now reallocate it
      with the real size. */
-  fontsel_info->font_info = g_realloc(fontsel_info->font_info,
-				      sizeof(FontInfo) * fontsel_info->nfonts);
+  if (lock)
+    g_mutex_lock (lock);
+  info->font_info = g_realloc(info->font_info,
+			      sizeof(FontInfo) * info->nfonts);
+  if (lock)
+    g_mutex_unlock (lock);
   
   
   /* Now we work out which choices of weight/slant etc. are valid for each
      font. */
-  fontsel_info->nstyles = 0;
-  current_style = fontsel_info->font_styles;
-  for (i = 0; i < fontsel_info->nfonts; i++)
+  info->nstyles = 0;
+  current_style = info->font_styles;
+  for (i = 0; i < info->nfonts; i++)
     {
-      font = &fontsel_info->font_info[i];
+      font = &info->font_info[i];
       
       /* Use the next free position in the styles array. */
-      font->style_index = fontsel_info->nstyles;
+      font->style_index = info->nstyles;
       
       /* Now step through each of the fontnames with this family, and create
 	 a style for each fontname. Each style contains the index into the
@@ -2729,7 +3615,7 @@ gtk_font_selection_get_fonts (void)
 	  for (prop = 0; prop < GTK_NUM_STYLE_PROPERTIES; prop++)
 	    {
 	      current_style->properties[prop]
-		= gtk_font_selection_insert_field (fontname, prop);
+		= gtk_font_selection_insert_field (info, fontname, prop);
 	    }
 	  current_style->pixel_sizes_index = npixel_sizes;
 	  current_style->npixel_sizes = 0;
@@ -2768,7 +3654,7 @@ gtk_font_selection_get_fonts (void)
 	  
 	  /* Now we check to make sure that the style is unique. If it isn't
 	     we forget it. */
-	  prev_style = fontsel_info->font_styles + font->style_index;
+	  prev_style = info->font_styles + font->style_index;
 	  matched_style = FALSE;
 	  while (prev_style < current_style)
 	    {
@@ -2796,7 +3682,7 @@ gtk_font_selection_get_fonts (void)
 	      prev_style->flags |= flags;
 	      if (flags == GTK_FONT_BITMAP)
 		{
-		  pixel_sizes = fontsel_info->pixel_sizes
+		  pixel_sizes = info->pixel_sizes
 		    + prev_style->pixel_sizes_index;
 		  found_size = FALSE;
 		  for (size = 0; size < prev_style->npixel_sizes; size++)
@@ -2814,7 +3700,7 @@ gtk_font_selection_get_fonts (void)
 		     update the indexes of any following styles. */
 		  if (!found_size)
 		    {
-		      for (tmp_sizes = fontsel_info->pixel_sizes + npixel_sizes;
+		      for (tmp_sizes = info->pixel_sizes + npixel_sizes;
 			   tmp_sizes > pixel_sizes; tmp_sizes--)
 			*tmp_sizes = *(tmp_sizes - 1);
 		      
@@ -2830,7 +3716,7 @@ gtk_font_selection_get_fonts (void)
 			}
 		    }
 		  
-		  point_sizes = fontsel_info->point_sizes
+		  point_sizes = info->point_sizes
 		    + prev_style->point_sizes_index;
 		  found_size = FALSE;
 		  for (size = 0; size < prev_style->npoint_sizes; size++)
@@ -2848,7 +3734,7 @@ gtk_font_selection_get_fonts (void)
 		     update the indexes of any following styles. */
 		  if (!found_size)
 		    {
-		      for (tmp_sizes = fontsel_info->point_sizes + npoint_sizes;
+		      for (tmp_sizes = info->point_sizes + npoint_sizes;
 			   tmp_sizes > point_sizes; tmp_sizes--)
 			*tmp_sizes = *(tmp_sizes - 1);
 		      
@@ -2870,13 +3756,13 @@ gtk_font_selection_get_fonts (void)
 	      current_style->flags = flags;
 	      if (flags == GTK_FONT_BITMAP)
 		{
-		  fontsel_info->pixel_sizes[npixel_sizes++] = pixels;
+		  info->pixel_sizes[npixel_sizes++] = pixels;
 		  current_style->npixel_sizes = 1;
-		  fontsel_info->point_sizes[npoint_sizes++] = points;
+		  info->point_sizes[npoint_sizes++] = points;
 		  current_style->npoint_sizes = 1;
 		}
 	      style++;
-	      fontsel_info->nstyles++;
+	      info->nstyles++;
 	      current_style++;
 	    }
 	}
@@ -2890,30 +3776,31 @@ gtk_font_selection_get_fonts (void)
   
   /* Since some repeated styles may be skipped we won't have used all the
      allocated space, so we will now reallocate it with the real size. */
-  fontsel_info->font_styles = g_realloc(fontsel_info->font_styles,
-					sizeof(FontStyle) * fontsel_info->nstyles);
-  fontsel_info->pixel_sizes = g_realloc(fontsel_info->pixel_sizes,
-					sizeof(guint16) * npixel_sizes);
-  fontsel_info->point_sizes = g_realloc(fontsel_info->point_sizes,
-					sizeof(guint16) * npoint_sizes);
+  info->font_styles = g_realloc(info->font_styles,
+				sizeof(FontStyle) * info->nstyles);
+  info->pixel_sizes = g_realloc(info->pixel_sizes,
+				sizeof(guint16) * npixel_sizes);
+  info->point_sizes = g_realloc(info->point_sizes,
+				sizeof(guint16) * npoint_sizes);
+  info->npixel_sizes = npixel_sizes;
+  info->npoint_sizes = npoint_sizes;
   g_free(fontnames);
-  XFreeFontNames (xfontnames);
   
   
   /* Debugging Output */
   /* This outputs all FontInfos. */
 #ifdef FONTSEL_DEBUG
   g_message("\n\n Font Family           Weight    Slant     Set Width Spacing   Charset\n\n");
-  for (i = 0; i < fontsel_info->nfonts; i++)
+  for (i = 0; i < info->nfonts; i++)
     {
-      FontInfo *font = &fontsel_info->font_info[i];
-      FontStyle *styles = fontsel_info->font_styles + font->style_index;
+      FontInfo *font = &info->font_info[i];
+      FontStyle *styles = info->font_styles + font->style_index;
       for (style = 0; style < font->nstyles; style++)
 	{
 	  g_message("%5i %-16.16s ", i, font->family);
 	  for (prop = 0; prop < GTK_NUM_STYLE_PROPERTIES; prop++)
 	    g_message("%-9.9s ",
-		      fontsel_info->properties[prop][styles->properties[prop]]);
+		      info->properties[prop][styles->properties[prop]]);
 	  g_message("\n      ");
 	  
 	  if (styles->flags & GTK_FONT_BITMAP)
@@ -2927,7 +3814,7 @@ gtk_font_selection_get_fonts (void)
 	  if (styles->npixel_sizes)
 	    {
 	      g_message("      Pixel sizes: ");
-	      tmp_sizes = fontsel_info->pixel_sizes + styles->pixel_sizes_index;
+	      tmp_sizes = info->pixel_sizes + styles->pixel_sizes_index;
 	      for (size = 0; size < styles->npixel_sizes; size++)
 		g_message("%i ", *tmp_sizes++);
 	      g_message("\n");
@@ -2936,7 +3823,7 @@ gtk_font_selection_get_fonts (void)
 	  if (styles->npoint_sizes)
 	    {
 	      g_message("      Point sizes: ");
-	      tmp_sizes = fontsel_info->point_sizes + styles->point_sizes_index;
+	      tmp_sizes = info->point_sizes + styles->point_sizes_index;
 	      for (size = 0; size < styles->npoint_sizes; size++)
 		g_message("%i ", *tmp_sizes++);
 	      g_message("\n");
@@ -2950,8 +3837,8 @@ gtk_font_selection_get_fonts (void)
   for (prop = 0; prop < GTK_NUM_FONT_PROPERTIES; prop++)
     {
       g_message("Property: %s\n", xlfd_field_names[xlfd_index[prop]]);
-      for (i = 0; i < fontsel_info->nproperties[prop]; i++)
-        g_message("  %s\n", fontsel_info->properties[prop][i]);
+      for (i = 0; i < info->nproperties[prop]; i++)
+        g_message("  %s\n", info->properties[prop][i]);
     }
 #endif
 }
@@ -2961,9 +3848,10 @@ gtk_font_selection_get_fonts (void)
    fontname is added to the FontInfos list of fontnames, else a new FontInfo
    is created and inserted in alphabetical order in the table. */
 static void
-gtk_font_selection_insert_font (GSList		      *fontnames[],
-				gint		      *ntable,
-				gchar		      *fontname)
+gtk_font_selection_insert_font (GtkFontSelInfo	      *info,
+				GSList		      *fontnames[],
+				gchar		      *fontname,
+				GMutex		      *lock)
 {
   FontInfo *table;
   FontInfo temp_info;
@@ -2975,7 +3863,7 @@ gtk_font_selection_insert_font (GSList		      *fontnames[],
   gint middle, cmp;
   gchar family_buffer[XLFD_MAX_FIELD_LEN];
   
-  table = fontsel_info->font_info;
+  table = info->font_info;
   
   /* insert a fontname into a table */
   family = gtk_font_selection_get_xlfd_field (fontname, XLFD_FAMILY,
@@ -2983,14 +3871,14 @@ gtk_font_selection_insert_font (GSList		      *fontnames[],
   if (!family)
     return;
   
-  foundry = gtk_font_selection_insert_field (fontname, FOUNDRY);
+  foundry = gtk_font_selection_insert_field (info, fontname, FOUNDRY);
   
   lower = 0;
-  if (*ntable > 0)
+  if (info->nfonts > 0)
     {
       /* Do a binary search to determine if we have already encountered
        *  a font with this family & foundry. */
-      upper = *ntable;
+      upper = info->nfonts;
       while (lower < upper)
 	{
 	  middle = (lower + upper) >> 1;
@@ -3001,8 +3889,8 @@ gtk_font_selection_insert_font (GSList		      *fontnames[],
 	    {
 	      family_exists = TRUE;
 	      family = table[middle].family;
-	      cmp = strcmp(fontsel_info->properties[FOUNDRY][foundry],
-			   fontsel_info->properties[FOUNDRY][table[middle].foundry]);
+	      cmp = strcmp(info->properties[FOUNDRY][foundry],
+			   info->properties[FOUNDRY][table[middle].foundry]);
 	    }
 	  
 	  if (cmp == 0)
@@ -3023,16 +3911,21 @@ gtk_font_selection_insert_font (GSList		      *fontnames[],
   temp_info.foundry = foundry;
   temp_fontname = g_slist_prepend (NULL, fontname);
   
-  (*ntable)++;
+  /* The table may be read by the main thread while we are building
+     it in the background, to show the families found so far. */
+  if (lock)
+    g_mutex_lock (lock);
+
+  info->nfonts++;
   
   /* Quickly insert the entry into the table in sorted order
    *  using a modification of insertion sort and the knowledge
    *  that the entries proper position in the table was determined
    *  above in the binary search and is contained in the "lower"
    *  variable. */
-  if (*ntable > 1)
+  if (info->nfonts > 1)
     {
-      upper = *ntable - 1;
+      upper = info->nfonts - 1;
       while (lower != upper)
 	{
 	  table[upper] = table[upper-1];
@@ -3042,6 +3935,9 @@ gtk_font_selection_insert_font (GSList		      *fontnames[],
     }
   table[lower] = temp_info;
   fontnames[lower] = temp_fontname;
+
+  if (lock)
+    g_mutex_unlock (lock);
 }
 
 
@@ -3049,7 +3945,8 @@ gtk_font_selection_insert_font (GSList		      *fontnames[],
    appropriate properties array. If not it is added. Thus eventually we get
    arrays of all possible weights/slants etc. It returns the array index. */
 static gint
-gtk_font_selection_insert_field (gchar		       *fontname,
+gtk_font_selection_insert_field (GtkFontSelInfo	       *info,
+				 gchar		       *fontname,
 				 gint			prop)
 {
   gchar field_buffer[XLFD_MAX_FIELD_LEN];
@@ -3062,23 +3959,23 @@ gtk_font_selection_insert_field (gchar		       *fontname,
     return 0;
   
   /* If the field is already in the array just return its index. */
-  for (index = 0; index < fontsel_info->nproperties[prop]; index++)
-    if (!strcmp(field, fontsel_info->properties[prop][index]))
+  for (index = 0; index < info->nproperties[prop]; index++)
+    if (!strcmp(field, info->properties[prop][index]))
       return index;
   
   /* Make sure we have enough space to add the field. */
-  if (fontsel_info->nproperties[prop] == fontsel_info->space_allocated[prop])
+  if (info->nproperties[prop] == info->space_allocated[prop])
     {
-      fontsel_info->space_allocated[prop] += PROPERTY_ARRAY_INCREMENT;
-      fontsel_info->properties[prop] = g_realloc(fontsel_info->properties[prop],
-						 sizeof(gchar*)
-						 * fontsel_info->space_allocated[prop]);
+      info->space_allocated[prop] += PROPERTY_ARRAY_INCREMENT;
+      info->properties[prop] = g_realloc(info->properties[prop],
+					 sizeof(gchar*)
+					 * info->space_allocated[prop]);
     }
   
   /* Add the new field. */
-  index = fontsel_info->nproperties[prop];
-  fontsel_info->properties[prop][index] = g_strdup(field);
-  fontsel_info->nproperties[prop]++;
+  index = info->nproperties[prop];
+  info->properties[prop][index] = g_strdup(field);
+  info->nproperties[prop]++;
   return index;
 }
 
@@ -3092,6 +3989,7 @@ gtk_font_selection_get_font (GtkFontSelection *fontsel)
 {
   g_return_val_if_fail (GTK_IS_FONT_SELECTION (fontsel), NULL);
 
+  gtk_font_selection_wait_for_fonts ();
   gtk_font_selection_update_size (fontsel);
   
   return fontsel->font;
@@ -3109,6 +4007,7 @@ gtk_font_selection_get_font_name (GtkFontSelection *fontsel)
   g_return_val_if_fail (fontsel != NULL, NULL);
   g_return_val_if_fail (GTK_IS_FONT_SELECTION (fontsel), NULL);
   
+  gtk_font_selection_wait_for_fonts ();
   gtk_font_selection_update_size (fontsel);
   
   /* If no family has been selected return NULL. */
@@ -3161,6 +4060,8 @@ gtk_font_selection_set_font_name (GtkFontSelection *fontsel,
   g_return_val_if_fail (GTK_IS_FONT_SELECTION (fontsel), FALSE);
   g_return_val_if_fail (fontname != NULL, FALSE);
   
+  gtk_font_selection_wait_for_fonts ();
+  
   /* Check it is a valid fontname. */
   if (!gtk_font_selection_is_xlfd_font_name(fontname))
     return FALSE;
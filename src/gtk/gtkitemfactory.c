@@ -37,6 +37,7 @@
 #include	"gtk/gtkcheckmenuitem.h"
 #include	"gtk/gtktearoffmenuitem.h"
 #include	"gtk/gtkaccellabel.h"
+#include	"gtk/gtkprivate.h"
 #include        "gdk/gdkkeysyms.h"
 #include	<string.h>
 #include	<sys/stat.h>
@@ -49,11 +50,14 @@
 /* --- defines --- */
 #define		ITEM_FACTORY_STRING	((gchar*) item_factory_string)
 #define		ITEM_BLOCK_SIZE		(128)
+#define		ACCEL_INDEX_KEY(k, m)	(GUINT_TO_POINTER ((k) ^ ((m) << 16)))
 
 
 /* --- structures --- */
 typedef struct	_GtkIFCBData		GtkIFCBData;
 typedef struct  _GtkIFDumpData		GtkIFDumpData;
+typedef struct  _GtkIFPending		GtkIFPending;
+typedef struct  _GtkIFLazyData		GtkIFLazyData;
 struct _GtkIFCBData
 {
   GtkItemFactoryCallback  func;
@@ -68,6 +72,26 @@ struct _GtkIFDumpData
   guint		         modified_only : 1;
   GtkPatternSpec	*pspec;
 };
+/* An entry of a submenu that has not been popped up yet; its widgets
+ * are only created once the submenu is needed.
+ */
+struct _GtkIFPending
+{
+  GtkItemFactory	*ifactory;
+  GtkItemFactoryItem	*item;
+  gchar			*path;
+  gchar			*parent_path;
+  GtkItemFactoryEntry	 entry;
+  gpointer		 callback_data;
+  guint			 callback_type;
+  guint			 accel_key;
+  guint			 accel_mods;
+};
+struct _GtkIFLazyData
+{
+  GHashTable		*pending;	/* path -> GtkIFPending */
+  GHashTable		*branches;	/* parent path -> GSList of GtkIFPending */
+};
 
 
 /* --- prototypes --- */
@@ -75,6 +99,10 @@ static void	gtk_item_factory_class_init		(GtkItemFactoryClass  *klass);
 static void	gtk_item_factory_init			(GtkItemFactory	      *ifactory);
 static void	gtk_item_factory_destroy		(GtkObject	      *object);
 static void	gtk_item_factory_finalize		(GtkObject	      *object);
+static gboolean	gtk_item_factory_accel_miss		(GtkAccelGroup	      *accel_group,
+							 guint		       accel_key,
+							 GdkModifierType       accel_mods);
+static void	gtk_item_factory_pending_reindex	(GtkItemFactoryItem   *item);
 
 
 /* --- static variables --- */
@@ -98,6 +126,10 @@ static GQuark		 quark_type_tearoff_item = 0;
 static GQuark		 quark_type_separator_item = 0;
 static GQuark		 quark_type_branch = 0;
 static GQuark		 quark_type_last_branch = 0;
+static GQuark		 quark_lazy_data = 0;
+static GQuark		 quark_lazy_menu = 0;
+static GHashTable	*ifactory_pending_accels = NULL;
+static GHashTable	*ifactory_pending_items = NULL;
 static	GScannerConfig	ifactory_scanner_config =
 {
   (
@@ -211,6 +243,14 @@ gtk_item_factory_class_init (GtkItemFactoryClass  *class)
   quark_type_separator_item	= g_quark_from_static_string ("<Separator>");
   quark_type_branch		= g_quark_from_static_string ("<Branch>");
   quark_type_last_branch	= g_quark_from_static_string ("<LastBranch>");
+  quark_lazy_data		= g_quark_from_static_string ("GtkItemFactory-lazy-data");
+  quark_lazy_menu		= g_quark_from_static_string ("GtkItemFactory-lazy-menu");
+
+  ifactory_pending_accels = g_hash_table_new (g_direct_hash, NULL);
+  ifactory_pending_items = g_hash_table_new (g_direct_hash, NULL);
+
+  /* accelerators of entries that have no widgets yet */
+  gtk_accel_group_add_miss_func (gtk_item_factory_accel_miss);
 }
 
 static void
@@ -354,6 +394,7 @@ gtk_item_factory_item_add_accelerator (GtkWidget	  *widget,
       item->modified = TRUE;
       
       gtk_item_factory_propagate_accelerator (item, widget);
+      gtk_item_factory_pending_reindex (item);
     }
 
   return TRUE;
@@ -376,6 +417,7 @@ gtk_item_factory_item_remove_accelerator (GtkWidget	     *widget,
       item->modified = TRUE;
       
       gtk_item_factory_propagate_accelerator (item, widget);
+      gtk_item_factory_pending_reindex (item);
     }
 }
 
@@ -547,6 +589,457 @@ gtk_item_factory_add_item (GtkItemFactory		*ifactory,
     ifactory->items = g_slist_prepend (ifactory->items, item);
 }
 
+static GtkWidget*
+gtk_item_factory_find_widget (GtkItemFactory *ifactory,
+			      const gchar    *path)
+{
+  GtkItemFactoryClass *class;
+  GtkItemFactoryItem *item;
+
+  class = GTK_ITEM_FACTORY_CLASS (GTK_OBJECT (ifactory)->klass);
+
+  if (path[0] == '<')
+    item = g_hash_table_lookup (class->item_ht, (gpointer) path);
+  else
+    {
+      gchar *fpath;
+
+      fpath = g_strconcat (ifactory->path, path, NULL);
+      item = g_hash_table_lookup (class->item_ht, fpath);
+      g_free (fpath);
+    }
+
+  if (item)
+    {
+      GSList *slist;
+
+      for (slist = item->widgets; slist; slist = slist->next)
+	{
+	  if (gtk_item_factory_from_widget (slist->data) == ifactory)
+	    return slist->data;
+	}
+    }
+
+  return NULL;
+}
+
+static void
+gtk_item_factory_pending_unindex (GtkIFPending *pending)
+{
+  GSList *slist;
+
+  if (!pending->accel_key)
+    return;
+
+  slist = g_hash_table_lookup (ifactory_pending_accels,
+			       ACCEL_INDEX_KEY (pending->accel_key, pending->accel_mods));
+  slist = g_slist_remove (slist, pending);
+  if (slist)
+    g_hash_table_insert (ifactory_pending_accels,
+			 ACCEL_INDEX_KEY (pending->accel_key, pending->accel_mods),
+			 slist);
+  else
+    g_hash_table_remove (ifactory_pending_accels,
+			 ACCEL_INDEX_KEY (pending->accel_key, pending->accel_mods));
+
+  pending->accel_key = 0;
+  pending->accel_mods = 0;
+}
+
+/* Entries are indexed by their accelerator the way the accel group
+ * would store it, so a key press can find the entry to create.
+ */
+static void
+gtk_item_factory_pending_index (GtkIFPending *pending)
+{
+  GtkItemFactoryItem *item = pending->item;
+  GSList *slist;
+
+  gtk_item_factory_pending_unindex (pending);
+
+  if (!item->accelerator_key || !pending->ifactory->accel_group)
+    return;
+
+  pending->accel_key = gdk_keyval_to_lower (item->accelerator_key);
+  pending->accel_mods = item->accelerator_mods & pending->ifactory->accel_group->modifier_mask;
+
+  slist = g_hash_table_lookup (ifactory_pending_accels,
+			       ACCEL_INDEX_KEY (pending->accel_key, pending->accel_mods));
+  g_hash_table_insert (ifactory_pending_accels,
+		       ACCEL_INDEX_KEY (pending->accel_key, pending->accel_mods),
+		       g_slist_prepend (slist, pending));
+}
+
+static void
+gtk_item_factory_pending_reindex (GtkItemFactoryItem *item)
+{
+  GSList *slist;
+
+  if (!ifactory_pending_items)
+    return;
+
+  for (slist = g_hash_table_lookup (ifactory_pending_items, item); slist; slist = slist->next)
+    gtk_item_factory_pending_index (slist->data);
+}
+
+static void
+gtk_item_factory_pending_free (GtkIFPending *pending)
+{
+  GSList *slist;
+
+  gtk_item_factory_pending_unindex (pending);
+
+  slist = g_hash_table_lookup (ifactory_pending_items, pending->item);
+  slist = g_slist_remove (slist, pending);
+  if (slist)
+    g_hash_table_insert (ifactory_pending_items, pending->item, slist);
+  else
+    g_hash_table_remove (ifactory_pending_items, pending->item);
+
+  g_free (pending->path);
+  g_free (pending->parent_path);
+  g_free (pending->entry.path);
+  g_free (pending->entry.accelerator);
+  g_free (pending->entry.item_type);
+  g_free (pending);
+}
+
+static void
+gtk_item_factory_lazy_free_pending (gpointer key,
+				    gpointer value,
+				    gpointer user_data)
+{
+  gtk_item_factory_pending_free (value);
+}
+
+static void
+gtk_item_factory_lazy_free_branch (gpointer key,
+				   gpointer value,
+				   gpointer user_data)
+{
+  g_free (key);
+  g_slist_free (value);
+}
+
+static void
+gtk_item_factory_lazy_data_free (gpointer data)
+{
+  GtkIFLazyData *lazy = data;
+
+  g_hash_table_foreach (lazy->branches, gtk_item_factory_lazy_free_branch, NULL);
+  g_hash_table_foreach (lazy->pending, gtk_item_factory_lazy_free_pending, NULL);
+  g_hash_table_destroy (lazy->branches);
+  g_hash_table_destroy (lazy->pending);
+  g_free (lazy);
+}
+
+static GtkIFLazyData*
+gtk_item_factory_lazy_data (GtkItemFactory *ifactory,
+			    gboolean        create)
+{
+  GtkIFLazyData *lazy;
+
+  lazy = gtk_object_get_data_by_id (GTK_OBJECT (ifactory), quark_lazy_data);
+  if (!lazy && create)
+    {
+      lazy = g_new (GtkIFLazyData, 1);
+      lazy->pending = g_hash_table_new (g_str_hash, g_str_equal);
+      lazy->branches = g_hash_table_new (g_str_hash, g_str_equal);
+      gtk_object_set_data_by_id_full (GTK_OBJECT (ifactory), quark_lazy_data,
+				      lazy, gtk_item_factory_lazy_data_free);
+    }
+
+  return lazy;
+}
+
+static gboolean
+gtk_item_factory_is_pending (GtkItemFactory *ifactory,
+			     const gchar    *path)
+{
+  GtkIFLazyData *lazy;
+
+  lazy = gtk_item_factory_lazy_data (ifactory, FALSE);
+
+  return lazy && g_hash_table_lookup (lazy->pending, path) != NULL;
+}
+
+/* Forgets the pending entries below parent_path, after their submenu
+ * went away before it was ever popped up.
+ */
+static void
+gtk_item_factory_drop_pending (GtkIFLazyData *lazy,
+			       const gchar   *parent_path)
+{
+  gpointer key;
+  gpointer value;
+  GSList *slist;
+
+  if (!g_hash_table_lookup_extended (lazy->branches, parent_path, &key, &value))
+    return;
+
+  g_hash_table_remove (lazy->branches, parent_path);
+  g_free (key);
+
+  for (slist = value; slist; slist = slist->next)
+    {
+      GtkIFPending *pending = slist->data;
+
+      g_hash_table_remove (lazy->pending, pending->path);
+      gtk_item_factory_drop_pending (lazy, pending->path);
+      gtk_item_factory_pending_free (pending);
+    }
+  g_slist_free (value);
+}
+
+/* Creates the pending entries of the submenu at parent_path, which
+ * must exist already.
+ */
+static void
+gtk_item_factory_populate (GtkItemFactory *ifactory,
+			   const gchar    *parent_path)
+{
+  GtkIFLazyData *lazy;
+  GtkWidget *parent;
+  gpointer key;
+  gpointer value;
+  GSList *slist;
+  gchar *path;
+
+  path = g_strdup (parent_path);
+
+  parent = gtk_item_factory_find_widget (ifactory, path);
+  if (parent && gtk_object_get_data_by_id (GTK_OBJECT (parent), quark_lazy_menu))
+    {
+      gtk_menu_set_populate_func (GTK_MENU (parent), NULL, NULL);
+      gtk_object_remove_data_by_id (GTK_OBJECT (parent), quark_lazy_menu);
+    }
+
+  lazy = gtk_item_factory_lazy_data (ifactory, FALSE);
+  if (lazy && g_hash_table_lookup_extended (lazy->branches, path, &key, &value))
+    {
+      g_hash_table_remove (lazy->branches, path);
+      g_free (key);
+
+      for (slist = g_slist_reverse (value); slist; slist = slist->next)
+	{
+	  GtkIFPending *pending = slist->data;
+
+	  g_hash_table_remove (lazy->pending, pending->path);
+	  gtk_item_factory_pending_unindex (pending);
+
+	  gtk_item_factory_create_item (ifactory,
+					&pending->entry,
+					pending->callback_data,
+					pending->callback_type);
+	  gtk_item_factory_pending_free (pending);
+	}
+      g_slist_free (value);
+    }
+
+  g_free (path);
+}
+
+/* Creates the widget for path if it is still pending, along with the
+ * rest of its submenu and the submenus above it.
+ */
+static void
+gtk_item_factory_ensure (GtkItemFactory *ifactory,
+			 const gchar    *path)
+{
+  GtkIFLazyData *lazy;
+  GtkIFPending *pending;
+  gchar *parent_path;
+
+  lazy = gtk_item_factory_lazy_data (ifactory, FALSE);
+  if (!lazy)
+    return;
+
+  pending = g_hash_table_lookup (lazy->pending, path);
+  if (!pending)
+    return;
+
+  parent_path = g_strdup (pending->parent_path);
+  gtk_item_factory_ensure (ifactory, parent_path);
+  gtk_item_factory_populate (ifactory, parent_path);
+  g_free (parent_path);
+}
+
+static void
+gtk_item_factory_populate_menu (GtkWidget *menu,
+				gpointer   data)
+{
+  GtkItemFactory *ifactory;
+  gchar *path;
+
+  ifactory = gtk_item_factory_from_widget (menu);
+  path = gtk_object_get_data_by_id (GTK_OBJECT (menu), quark_lazy_menu);
+
+  if (ifactory && path)
+    gtk_item_factory_populate (ifactory, path);
+}
+
+static void
+gtk_item_factory_lazy_menu_destroyed (GtkWidget      *menu,
+				      GtkItemFactory *ifactory)
+{
+  GtkIFLazyData *lazy;
+  gchar *path;
+
+  lazy = gtk_item_factory_lazy_data (ifactory, FALSE);
+  path = gtk_object_get_data_by_id (GTK_OBJECT (menu), quark_lazy_menu);
+
+  if (lazy && path)
+    gtk_item_factory_drop_pending (lazy, path);
+}
+
+/* Entries added to menu are recorded as pending until it is first
+ * popped up.
+ */
+static void
+gtk_item_factory_set_lazy_menu (GtkItemFactory *ifactory,
+				GtkWidget      *menu,
+				const gchar    *path)
+{
+  gtk_object_set_data_by_id_full (GTK_OBJECT (menu), quark_lazy_menu,
+				  g_strdup (path), g_free);
+  gtk_menu_set_populate_func (GTK_MENU (menu), gtk_item_factory_populate_menu, NULL);
+  gtk_signal_connect_while_alive (GTK_OBJECT (menu),
+				  "destroy",
+				  GTK_SIGNAL_FUNC (gtk_item_factory_lazy_menu_destroyed),
+				  ifactory,
+				  GTK_OBJECT (ifactory));
+}
+
+static gboolean
+gtk_item_factory_defer_item (GtkItemFactory	 *ifactory,
+			     GtkItemFactoryEntry *entry,
+			     gpointer		  callback_data,
+			     guint		  callback_type,
+			     const gchar	 *path,
+			     const gchar	 *parent_path)
+{
+  GtkItemFactoryClass *class;
+  GtkIFLazyData *lazy;
+  GtkIFPending *pending;
+  gpointer key;
+  gpointer value;
+  gchar *fpath;
+
+  if (!gtk_item_factory_is_pending (ifactory, parent_path))
+    {
+      GtkWidget *parent;
+
+      parent = gtk_item_factory_find_widget (ifactory, parent_path);
+      if (!parent || !gtk_object_get_data_by_id (GTK_OBJECT (parent), quark_lazy_menu))
+	return FALSE;
+    }
+
+  lazy = gtk_item_factory_lazy_data (ifactory, TRUE);
+  if (g_hash_table_lookup (lazy->pending, path))
+    return FALSE;
+
+  class = GTK_ITEM_FACTORY_CLASS (GTK_OBJECT (ifactory)->klass);
+
+  pending = g_new (GtkIFPending, 1);
+  pending->ifactory = ifactory;
+  pending->path = g_strdup (path);
+  pending->parent_path = g_strdup (parent_path);
+  pending->entry.path = g_strdup (entry->path);
+  pending->entry.accelerator = g_strdup (entry->accelerator);
+  pending->entry.callback = entry->callback;
+  pending->entry.callback_action = entry->callback_action;
+  pending->entry.item_type = g_strdup (entry->item_type);
+  pending->callback_data = callback_data;
+  pending->callback_type = callback_type;
+  pending->accel_key = 0;
+  pending->accel_mods = 0;
+
+  /* register the path right away, as gtk_item_factory_add_foreign()
+   * would, so rc files and dumps see the entry's accelerator
+   */
+  fpath = g_strconcat (ifactory->path, path, NULL);
+  pending->item = g_hash_table_lookup (class->item_ht, fpath);
+  if (!pending->item)
+    {
+      GtkItemFactoryItem *item;
+      guint keyval = 0;
+      guint mods = 0;
+
+      if (entry->accelerator)
+	gtk_accelerator_parse (entry->accelerator, &keyval, &mods);
+
+      item = g_chunk_new (GtkItemFactoryItem, ifactory_item_chunks);
+
+      item->path = fpath;
+      item->accelerator_key = keyval != GDK_VoidSymbol ? keyval : 0;
+      item->accelerator_mods = mods;
+      item->modified = FALSE;
+      item->in_propagation = FALSE;
+      item->dummy = NULL;
+      item->widgets = NULL;
+
+      g_hash_table_insert (class->item_ht, item->path, item);
+      pending->item = item;
+    }
+  else
+    g_free (fpath);
+
+  g_hash_table_insert (ifactory_pending_items, pending->item,
+		       g_slist_prepend (g_hash_table_lookup (ifactory_pending_items,
+							     pending->item),
+					pending));
+  gtk_item_factory_pending_index (pending);
+
+  g_hash_table_insert (lazy->pending, pending->path, pending);
+  if (g_hash_table_lookup_extended (lazy->branches, parent_path, &key, &value))
+    g_hash_table_insert (lazy->branches, key, g_slist_prepend (value, pending));
+  else
+    g_hash_table_insert (lazy->branches, g_strdup (parent_path),
+			 g_slist_prepend (NULL, pending));
+
+  return TRUE;
+}
+
+static gboolean
+gtk_item_factory_accel_miss (GtkAccelGroup   *accel_group,
+			     guint	      accel_key,
+			     GdkModifierType  accel_mods)
+{
+  GtkItemFactory *ifactory = NULL;
+  gchar *path = NULL;
+  GSList *slist;
+
+  accel_key = gdk_keyval_to_lower (accel_key);
+  accel_mods &= accel_group->modifier_mask;
+
+  for (slist = g_hash_table_lookup (ifactory_pending_accels,
+				    ACCEL_INDEX_KEY (accel_key, accel_mods));
+       slist;
+       slist = slist->next)
+    {
+      GtkIFPending *pending = slist->data;
+
+      if (pending->accel_key == accel_key &&
+	  pending->accel_mods == accel_mods &&
+	  pending->ifactory->accel_group == accel_group)
+	{
+	  ifactory = pending->ifactory;
+	  path = g_strdup (pending->path);
+	  break;
+	}
+    }
+
+  if (!path)
+    return FALSE;
+
+  gtk_object_ref (GTK_OBJECT (ifactory));
+  gtk_item_factory_ensure (ifactory, path);
+  gtk_object_unref (GTK_OBJECT (ifactory));
+  g_free (path);
+
+  return TRUE;
+}
+
 void
 gtk_item_factory_construct (GtkItemFactory	*ifactory,
 			    GtkType		 container_type,
@@ -591,6 +1084,11 @@ gtk_item_factory_construct (GtkItemFactory	*ifactory,
 			     NULL, 0, NULL, 0,
 			     ITEM_FACTORY_STRING,
 			     ifactory->widget);
+
+  /* popup menus are filled in when they first pop up
+   */
+  if (GTK_IS_MENU (ifactory->widget))
+    gtk_item_factory_set_lazy_menu (ifactory, ifactory->widget, "");
 }
 
 GtkItemFactory*
@@ -640,6 +1138,8 @@ gtk_item_factory_destroy (GtkObject *object)
 
   ifactory = (GtkItemFactory*) object;
 
+  gtk_object_remove_data_by_id (object, quark_lazy_data);
+
   if (ifactory->widget)
     {
       GtkObject *dobj;
@@ -838,47 +1338,55 @@ GtkWidget*
 gtk_item_factory_get_widget (GtkItemFactory *ifactory,
 			     const gchar    *path)
 {
-  GtkItemFactoryClass *class;
-  GtkItemFactoryItem *item;
-
   g_return_val_if_fail (GTK_IS_ITEM_FACTORY (ifactory), NULL);
   g_return_val_if_fail (path != NULL, NULL);
 
-  class = GTK_ITEM_FACTORY_CLASS (GTK_OBJECT (ifactory)->klass);
-
-  if (path[0] == '<')
-    item = g_hash_table_lookup (class->item_ht, (gpointer) path);
-  else
-    {
-      gchar *fpath;
-
-      fpath = g_strconcat (ifactory->path, path, NULL);
-      item = g_hash_table_lookup (class->item_ht, fpath);
-      g_free (fpath);
-    }
+  if (path[0] != '<')
+    gtk_item_factory_ensure (ifactory, path);
+  else if (strncmp (path, ifactory->path, strlen (ifactory->path)) == 0)
+    gtk_item_factory_ensure (ifactory, path + strlen (ifactory->path));
 
-  if (item)
-    {
-      GSList *slist;
+  return gtk_item_factory_find_widget (ifactory, path);
+}
 
-      for (slist = item->widgets; slist; slist = slist->next)
-	{
-	  if (gtk_item_factory_from_widget (slist->data) == ifactory)
-	    return slist->data;
-	}
-    }
+static void
+gtk_item_factory_pending_action (gpointer key,
+				 gpointer value,
+				 gpointer user_data)
+{
+  GtkIFPending *pending = value;
+  gpointer *data = user_data;
 
-  return NULL;
+  if (pending->entry.callback_action == GPOINTER_TO_UINT (data[0]))
+    data[1] = g_slist_prepend (data[1], g_strdup (pending->path));
 }
 
 GtkWidget*
 gtk_item_factory_get_widget_by_action (GtkItemFactory *ifactory,
 				       guint	       action)
 {
+  GtkIFLazyData *lazy;
   GSList *slist;
 
   g_return_val_if_fail (GTK_IS_ITEM_FACTORY (ifactory), NULL);
 
+  lazy = gtk_item_factory_lazy_data (ifactory, FALSE);
+  if (lazy)
+    {
+      gpointer data[2];
+
+      data[0] = GUINT_TO_POINTER (action);
+      data[1] = NULL;
+      g_hash_table_foreach (lazy->pending, gtk_item_factory_pending_action, data);
+
+      for (slist = data[1]; slist; slist = slist->next)
+	{
+	  gtk_item_factory_ensure (ifactory, slist->data);
+	  g_free (slist->data);
+	}
+      g_slist_free (data[1]);
+    }
+
   for (slist = ifactory->items; slist; slist = slist->next)
     {
       GtkItemFactoryItem *item = slist->data;
@@ -999,6 +1507,41 @@ gtk_item_factory_create_item (GtkItemFactory	     *ifactory,
   g_return_if_fail (entry->path[0] == '/');
   g_return_if_fail (callback_type >= 1 && callback_type <= 2);
 
+  if (!gtk_item_factory_parse_path (ifactory, entry->path, 
+				    &path, &parent_path, &name))
+    return;
+
+  if (!gtk_item_factory_find_widget (ifactory, parent_path) &&
+      !gtk_item_factory_is_pending (ifactory, parent_path))
+    {
+      GtkItemFactoryEntry pentry;
+      gchar *ppath, *p;
+
+      ppath = g_strdup (entry->path);
+      p = strrchr (ppath, '/');
+      g_return_if_fail (p != NULL);
+      *p = 0;
+      pentry.path = ppath;
+      pentry.accelerator = NULL;
+      pentry.callback = NULL;
+      pentry.callback_action = 0;
+      pentry.item_type = "<Branch>";
+
+      gtk_item_factory_create_item (ifactory, &pentry, NULL, 1);
+      g_free (ppath);
+    }
+
+  /* entries of submenus that were not popped up yet are only recorded
+   */
+  if (gtk_item_factory_defer_item (ifactory, entry, callback_data, callback_type,
+				   path, parent_path))
+    {
+      g_free (path);
+      g_free (parent_path);
+      g_free (name);
+      return;
+    }
+
   if (!entry->item_type ||
       entry->item_type[0] == 0)
     {
@@ -1045,37 +1588,16 @@ gtk_item_factory_create_item (GtkItemFactory	     *ifactory,
 	  g_warning ("GtkItemFactory: entry path `%s' has invalid type `%s'",
 		     entry->path,
 		     item_type_path);
+	  g_free (path);
+	  g_free (parent_path);
+	  g_free (name);
 	  return;
 	}
     }
 
-  if (!gtk_item_factory_parse_path (ifactory, entry->path, 
-				    &path, &parent_path, &name))
-    return;
-
   parent = gtk_item_factory_get_widget (ifactory, parent_path);
-  if (!parent)
-    {
-      GtkItemFactoryEntry pentry;
-      gchar *ppath, *p;
-
-      ppath = g_strdup (entry->path);
-      p = strrchr (ppath, '/');
-      g_return_if_fail (p != NULL);
-      *p = 0;
-      pentry.path = ppath;
-      pentry.accelerator = NULL;
-      pentry.callback = NULL;
-      pentry.callback_action = 0;
-      pentry.item_type = "<Branch>";
-
-      gtk_item_factory_create_item (ifactory, &pentry, NULL, 1);
-      g_free (ppath);
-
-      parent = gtk_item_factory_get_widget (ifactory, parent_path);
-      g_return_if_fail (parent != NULL);
-    }
   g_free (parent_path);
+  g_return_if_fail (parent != NULL);
 
   if (GTK_IS_OPTION_MENU (parent))
     {
@@ -1153,6 +1675,7 @@ gtk_item_factory_create_item (GtkItemFactory	     *ifactory,
 			       NULL);
       
       gtk_menu_item_set_submenu (GTK_MENU_ITEM (parent), widget);
+      gtk_item_factory_set_lazy_menu (ifactory, widget, path);
     }	   
   
   gtk_item_factory_add_item (ifactory,
@@ -1501,6 +2024,7 @@ gtk_item_factory_parse_menu_path (GScanner            *scanner,
 	{
 	  item->modified = TRUE;
 	  gtk_item_factory_propagate_accelerator (item, NULL);
+	  gtk_item_factory_pending_reindex (item);
 	}
     }
   
@@ -217,6 +217,11 @@ gtk_label_init (GtkLabel *label)
   label->max_width = 0;
   label->jtype = GTK_JUSTIFY_CENTER;
   label->wrap = FALSE;
+
+  label->wrap_longest = 0;
+  label->wrap_natural = -1;
+  label->wrap_width = -1;
+  label->wrap_height = 0;
   
   gtk_label_set_text (label, "");
 }
@@ -405,6 +410,9 @@ gtk_label_word_alloc (void)
 static void
 gtk_label_free_words (GtkLabel *label)
 {
+  label->wrap_natural = -1;
+  label->wrap_width = -1;
+
   while (label->words)
     {
       GtkLabelWord *word = label->words;
@@ -825,41 +833,59 @@ gtk_label_size_request (GtkWidget      *widget,
    *     5. gtk_misc_set_padding has changed xpad.
    *     6.  maybe others?...
    *
-   * Too much of a pain to detect all these case, so always re-fill.  I
-   * don't think it's really that slow.
+   * For wrapped labels, the words only depend on the text, the font
+   * and the justification, so they are kept until one of 1-3 frees
+   * them. The width picked without a usize and the line breaks for
+   * the last width are cached along with them, so refilling only
+   * happens when the target width actually changes.
    */
   
   if (label->wrap)
     {
       GtkWidgetAuxInfo *aux_info;
-      gint longest_paragraph;
+      gint width;
       
-      longest_paragraph = gtk_label_split_text_wrapped (label);
+      if (!label->words)
+	label->wrap_longest = gtk_label_split_text_wrapped (label);
       
       aux_info = gtk_object_get_data (GTK_OBJECT (widget), "gtk-aux-info");
       if (aux_info && aux_info->width > 0)
-	{
-	  label->max_width = MAX (aux_info->width - 2 * label->misc.xpad, 1);
-	  gtk_label_split_text_wrapped (label);
-	}
+	width = MAX (aux_info->width - 2 * label->misc.xpad, 1);
       else
 	{
-	  label->max_width = gdk_string_width (GTK_WIDGET (label)->style->font,
-					       "This is a good enough length for any line to have.");
-	  label->max_width = MIN (label->max_width, (gdk_screen_width () + 1) / 2);
-	  label->max_width = MIN (label->max_width, longest_paragraph);
-	  if (longest_paragraph > 0)
+	  if (label->wrap_natural < 0)
 	    {
-	      gint nlines, perfect_width;
-	      
-	      nlines = (longest_paragraph + label->max_width - 1) / label->max_width;
-	      perfect_width = (longest_paragraph + nlines - 1) / nlines;
-	      label->max_width = gtk_label_pick_width (label,
-						       perfect_width,
-						       label->max_width);
+	      gint longest_paragraph = label->wrap_longest;
+
+	      width = gdk_string_width (GTK_WIDGET (label)->style->font,
+					"This is a good enough length for any line to have.");
+	      width = MIN (width, (gdk_screen_width () + 1) / 2);
+	      width = MIN (width, longest_paragraph);
+	      if (longest_paragraph > 0)
+		{
+		  gint nlines, perfect_width;
+		  
+		  nlines = (longest_paragraph + width - 1) / width;
+		  perfect_width = (longest_paragraph + nlines - 1) / nlines;
+		  width = gtk_label_pick_width (label, perfect_width, width);
+		}
+	      label->wrap_natural = width;
 	    }
+	  width = label->wrap_natural;
+	}
+
+      if (width != label->wrap_width)
+	{
+	  gtk_label_finalize_lines_wrap (label, requisition, width);
+	  label->wrap_width = width;
+	  label->wrap_height = requisition->height - 2 * label->misc.ypad;
+	}
+      else
+	{
+	  label->max_width = width;
+	  requisition->width = width + 2 * label->misc.xpad;
+	  requisition->height = label->wrap_height + 2 * label->misc.ypad;
 	}
-      gtk_label_finalize_lines_wrap (label, requisition, label->max_width);
     }
   else if (!label->words)
     {
@@ -31,10 +31,13 @@
 #include "gtklayout.h"
 #include "gtksignal.h"
 #include "gtkprivate.h"
+#include "gtkmain.h"
+#include "gtkwindow.h"
 #include "gdk/gdkx.h"
 
 typedef struct _GtkLayoutAdjData GtkLayoutAdjData;
 typedef struct _GtkLayoutChild   GtkLayoutChild;
+typedef struct _GtkLayoutCell    GtkLayoutCell;
 
 struct _GtkLayoutAdjData {
   gint dx;
@@ -45,11 +48,35 @@ struct _GtkLayoutChild {
   GtkWidget *widget;
   gint x;
   gint y;
+
+  /* The size the child was entered into the cell index with */
+  gint width;
+  gint height;
+
+  guint serial;			/* stacking order */
+  guint query_serial;
+  guint active : 1;
+  guint large : 1;
+};
+
+struct _GtkLayoutCell {
+  gint x;
+  gint y;
+  GSList *children;
 };
 
 #define IS_ONSCREEN(x,y) ((x >= G_MINSHORT) && (x <= G_MAXSHORT) && \
                           (y >= G_MINSHORT) && (y <= G_MAXSHORT))
 
+/* Side of a cell of the child index. Children covering more than
+ * GTK_LAYOUT_MAX_CELLS cells are kept in a separate list instead.
+ */
+#define GTK_LAYOUT_CELL_SIZE 256
+#define GTK_LAYOUT_MAX_CELLS 16
+
+#define CELL_OF(v) ((v) >= 0 ? (v) / GTK_LAYOUT_CELL_SIZE : \
+		    -((-(v) - 1) / GTK_LAYOUT_CELL_SIZE) - 1)
+
 static void     gtk_layout_class_init         (GtkLayoutClass *class);
 static void     gtk_layout_init               (GtkLayout      *layout);
 
@@ -82,6 +109,22 @@ static void     gtk_layout_allocate_child     (GtkLayout      *layout,
 					       GtkLayoutChild *child);
 static void     gtk_layout_position_children  (GtkLayout      *layout);
 
+static guint    gtk_layout_cell_hash          (gconstpointer   key);
+static gint     gtk_layout_cell_equal         (gconstpointer   a,
+					       gconstpointer   b);
+static void     gtk_layout_index_child        (GtkLayout      *layout,
+					       GtkLayoutChild *child);
+static void     gtk_layout_unindex_child      (GtkLayout      *layout,
+					       GtkLayoutChild *child);
+static gboolean gtk_layout_update_region      (GtkLayout      *layout,
+					       gboolean        force);
+static gboolean gtk_layout_child_in_region    (GtkLayout      *layout,
+					       GtkLayoutChild *child);
+static void     gtk_layout_activate_child     (GtkLayout      *layout,
+					       GtkLayoutChild *child);
+static void     gtk_layout_deactivate_child   (GtkLayout      *layout,
+					       GtkLayoutChild *child);
+
 static void     gtk_layout_adjust_allocations_recurse (GtkWidget *widget,
 						       gpointer   cb_data);
 static void     gtk_layout_adjust_allocations         (GtkLayout *layout,
@@ -204,6 +247,10 @@ gtk_layout_finalize (GtkObject *object)
   gtk_object_unref (GTK_OBJECT (layout->hadjustment));
   gtk_object_unref (GTK_OBJECT (layout->vadjustment));
 
+  g_hash_table_destroy (layout->child_cells);
+  g_list_free (layout->large_children);
+  g_list_free (layout->active_children);
+
   GTK_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -228,6 +275,15 @@ gtk_layout_set_vadjustment (GtkLayout     *layout,
   gtk_layout_set_adjustments (layout, layout->hadjustment, adjustment);
 }
 
+void
+gtk_layout_set_unrealize_offscreen (GtkLayout *layout,
+				    gboolean   unrealize)
+{
+  g_return_if_fail (layout != NULL);
+  g_return_if_fail (GTK_IS_LAYOUT (layout));
+
+  layout->unrealize_offscreen = unrealize != FALSE;
+}
 
 void           
 gtk_layout_put (GtkLayout     *layout, 
@@ -236,6 +292,7 @@ gtk_layout_put (GtkLayout     *layout,
 		gint           y)
 {
   GtkLayoutChild *child;
+  GtkRequisition requisition;
 
   g_return_if_fail (layout != NULL);
   g_return_if_fail (GTK_IS_LAYOUT (layout));
@@ -244,25 +301,42 @@ gtk_layout_put (GtkLayout     *layout,
   
   child = g_new (GtkLayoutChild, 1);
 
+  gtk_widget_get_child_requisition (child_widget, &requisition);
+
   child->widget = child_widget;
   child->x = x;
   child->y = y;
+  child->width = requisition.width;
+  child->height = requisition.height;
+  child->serial = layout->child_serial++;
+  child->query_serial = 0;
+  child->active = FALSE;
 
   layout->children = g_list_append (layout->children, child);
+  gtk_layout_index_child (layout, child);
   
   gtk_widget_set_parent (child_widget, GTK_WIDGET (layout));
   if (GTK_WIDGET_REALIZED (layout))
     gtk_widget_set_parent_window (child->widget, layout->bin_window);
 
-  if (!IS_ONSCREEN (x, y))
+  /* The child gets its allocation from the resize queued below
+   */
+  if (gtk_layout_child_in_region (layout, child))
+    {
+      child->active = TRUE;
+      layout->active_children = g_list_append (layout->active_children,
+					       child);
+    }
+  else
     GTK_PRIVATE_SET_FLAG (child_widget, GTK_IS_OFFSCREEN);
 
-  if (GTK_WIDGET_REALIZED (layout))
+  if (GTK_WIDGET_REALIZED (layout) &&
+      (child->active || !layout->unrealize_offscreen))
     gtk_widget_realize (child_widget);
     
   if (GTK_WIDGET_VISIBLE (layout) && GTK_WIDGET_VISIBLE (child_widget))
     {
-      if (GTK_WIDGET_MAPPED (layout))
+      if (GTK_WIDGET_MAPPED (layout) && child->active)
 	gtk_widget_map (child_widget);
 
       gtk_widget_queue_resize (child_widget);
@@ -289,8 +363,10 @@ gtk_layout_move (GtkLayout     *layout,
 
       if (child->widget == child_widget)
 	{
+	  gtk_layout_unindex_child (layout, child);
 	  child->x = x;
 	  child->y = y;
+	  gtk_layout_index_child (layout, child);
 
 	  if (GTK_WIDGET_VISIBLE (child_widget) && GTK_WIDGET_VISIBLE (layout))
 	    gtk_widget_queue_resize (child_widget);
@@ -424,6 +500,18 @@ gtk_layout_init (GtkLayout *layout)
   layout->visibility = GDK_VISIBILITY_PARTIAL;
 
   layout->freeze_count = 0;
+
+  layout->child_cells = g_hash_table_new (gtk_layout_cell_hash,
+					  gtk_layout_cell_equal);
+  layout->large_children = NULL;
+  layout->active_children = NULL;
+  layout->active_x = 0;
+  layout->active_y = 0;
+  layout->active_width = 0;
+  layout->active_height = 0;
+  layout->child_serial = 0;
+  layout->query_serial = 0;
+  layout->unrealize_offscreen = FALSE;
 }
 
 /* Widget methods
@@ -504,7 +592,7 @@ gtk_layout_map (GtkWidget *widget)
 
   GTK_WIDGET_SET_FLAGS (widget, GTK_MAPPED);
 
-  tmp_list = layout->children;
+  tmp_list = layout->active_children;
   while (tmp_list)
     {
       GtkLayoutChild *child = tmp_list->data;
@@ -582,15 +670,34 @@ gtk_layout_size_allocate (GtkWidget     *widget,
   
   layout = GTK_LAYOUT (widget);
 
+  gtk_layout_update_region (layout, TRUE);
+
+  /* Only the children near the viewport are allocated; the others
+   * get their allocation once they are scrolled into the region.
+   */
   tmp_list = layout->children;
 
   while (tmp_list)
     {
       GtkLayoutChild *child = tmp_list->data;
+      GtkRequisition requisition;
+
       tmp_list = tmp_list->next;
 
-      gtk_layout_position_child (layout, child);
-      gtk_layout_allocate_child (layout, child);
+      gtk_widget_get_child_requisition (child->widget, &requisition);
+      if (requisition.width != child->width ||
+	  requisition.height != child->height)
+	{
+	  gtk_layout_unindex_child (layout, child);
+	  child->width = requisition.width;
+	  child->height = requisition.height;
+	  gtk_layout_index_child (layout, child);
+	}
+
+      if (child->active && gtk_layout_child_in_region (layout, child))
+	gtk_layout_allocate_child (layout, child);
+      else
+	gtk_layout_position_child (layout, child);
     }
 
   if (GTK_WIDGET_REALIZED (widget))
@@ -635,7 +742,7 @@ gtk_layout_draw (GtkWidget *widget, GdkRectangle *area)
     gdk_window_clear_area (layout->bin_window,
 			   area->x, area->y, area->width, area->height);
   
-  tmp_list = layout->children;
+  tmp_list = layout->active_children;
   while (tmp_list)
     {
       GtkLayoutChild *child = tmp_list->data;
@@ -661,7 +768,7 @@ gtk_layout_expose (GtkWidget *widget, GdkEventExpose *event)
   if (event->window != layout->bin_window)
     return FALSE;
   
-  tmp_list = layout->children;
+  tmp_list = layout->active_children;
   while (tmp_list)
     {
       GtkLayoutChild *child = tmp_list->data;
@@ -703,6 +810,11 @@ gtk_layout_remove (GtkContainer *container,
 
   if (tmp_list)
     {
+      if (child->active)
+	layout->active_children = g_list_remove (layout->active_children,
+						 child);
+      gtk_layout_unindex_child (layout, child);
+
       GTK_PRIVATE_UNSET_FLAG (widget, GTK_IS_OFFSCREEN);
 
       gtk_widget_unparent (widget);
@@ -742,9 +854,149 @@ gtk_layout_forall (GtkContainer *container,
 /* Operations on children
  */
 
+static guint
+gtk_layout_cell_hash (gconstpointer key)
+{
+  const GtkLayoutCell *cell = key;
+
+  return cell->x * 7919 + cell->y;
+}
+
+static gint
+gtk_layout_cell_equal (gconstpointer a,
+		       gconstpointer b)
+{
+  const GtkLayoutCell *cell_a = a;
+  const GtkLayoutCell *cell_b = b;
+
+  return cell_a->x == cell_b->x && cell_a->y == cell_b->y;
+}
+
 static void
-gtk_layout_position_child (GtkLayout      *layout,
-			   GtkLayoutChild *child)
+gtk_layout_child_cells (GtkLayoutChild *child,
+			gint           *x1,
+			gint           *y1,
+			gint           *x2,
+			gint           *y2)
+{
+  *x1 = CELL_OF (child->x);
+  *y1 = CELL_OF (child->y);
+  *x2 = CELL_OF (child->x + MAX (child->width, 1) - 1);
+  *y2 = CELL_OF (child->y + MAX (child->height, 1) - 1);
+}
+
+static void
+gtk_layout_index_child (GtkLayout      *layout,
+			GtkLayoutChild *child)
+{
+  gint x1, y1, x2, y2;
+  gint i, j;
+
+  gtk_layout_child_cells (child, &x1, &y1, &x2, &y2);
+
+  child->large = (x2 - x1 + 1) * (y2 - y1 + 1) > GTK_LAYOUT_MAX_CELLS;
+  if (child->large)
+    {
+      layout->large_children = g_list_prepend (layout->large_children, child);
+      return;
+    }
+
+  for (i = x1; i <= x2; i++)
+    for (j = y1; j <= y2; j++)
+      {
+	GtkLayoutCell key;
+	GtkLayoutCell *cell;
+
+	key.x = i;
+	key.y = j;
+	cell = g_hash_table_lookup (layout->child_cells, &key);
+	if (!cell)
+	  {
+	    cell = g_new (GtkLayoutCell, 1);
+	    cell->x = i;
+	    cell->y = j;
+	    cell->children = NULL;
+	    g_hash_table_insert (layout->child_cells, cell, cell);
+	  }
+
+	cell->children = g_slist_prepend (cell->children, child);
+      }
+}
+
+static void
+gtk_layout_unindex_child (GtkLayout      *layout,
+			  GtkLayoutChild *child)
+{
+  gint x1, y1, x2, y2;
+  gint i, j;
+
+  if (child->large)
+    {
+      layout->large_children = g_list_remove (layout->large_children, child);
+      return;
+    }
+
+  gtk_layout_child_cells (child, &x1, &y1, &x2, &y2);
+
+  for (i = x1; i <= x2; i++)
+    for (j = y1; j <= y2; j++)
+      {
+	GtkLayoutCell key;
+	GtkLayoutCell *cell;
+
+	key.x = i;
+	key.y = j;
+	cell = g_hash_table_lookup (layout->child_cells, &key);
+	if (!cell)
+	  continue;
+
+	cell->children = g_slist_remove (cell->children, child);
+	if (!cell->children)
+	  {
+	    g_hash_table_remove (layout->child_cells, cell);
+	    g_free (cell);
+	  }
+      }
+}
+
+/* The active region is the viewport grown by a margin of one
+ * viewport on each side. It is only moved when the viewport gets
+ * within half a margin of its edge, so most scroll steps don't
+ * need to look at the index at all. Returns TRUE if it moved.
+ */
+static gboolean
+gtk_layout_update_region (GtkLayout *layout,
+			  gboolean   force)
+{
+  GtkWidget *widget = GTK_WIDGET (layout);
+  gint margin_x, margin_y;
+  gint x, y;
+
+  margin_x = MAX (widget->allocation.width, GTK_LAYOUT_CELL_SIZE);
+  margin_y = MAX (widget->allocation.height, GTK_LAYOUT_CELL_SIZE);
+  x = layout->xoffset;
+  y = layout->yoffset;
+
+  if (!force && layout->active_width > 0 &&
+      x - margin_x / 2 >= layout->active_x &&
+      y - margin_y / 2 >= layout->active_y &&
+      x + widget->allocation.width + margin_x / 2 <=
+        layout->active_x + layout->active_width &&
+      y + widget->allocation.height + margin_y / 2 <=
+        layout->active_y + layout->active_height)
+    return FALSE;
+
+  layout->active_x = x - margin_x;
+  layout->active_y = y - margin_y;
+  layout->active_width = widget->allocation.width + 2 * margin_x;
+  layout->active_height = widget->allocation.height + 2 * margin_y;
+
+  return TRUE;
+}
+
+static gboolean
+gtk_layout_child_in_region (GtkLayout      *layout,
+			    GtkLayoutChild *child)
 {
   gint x;
   gint y;
@@ -752,26 +1004,105 @@ gtk_layout_position_child (GtkLayout      *layout,
   x = child->x - layout->xoffset;
   y = child->y - layout->yoffset;
 
-  if (IS_ONSCREEN (x,y))
+  return (IS_ONSCREEN (x, y) &&
+	  child->x < layout->active_x + layout->active_width &&
+	  child->y < layout->active_y + layout->active_height &&
+	  child->x + MAX (child->width, 1) > layout->active_x &&
+	  child->y + MAX (child->height, 1) > layout->active_y);
+}
+
+static gint
+gtk_layout_child_compare (gconstpointer a,
+			  gconstpointer b)
+{
+  const GtkLayoutChild *child_a = a;
+  const GtkLayoutChild *child_b = b;
+
+  return child_a->serial < child_b->serial ? -1 : 1;
+}
+
+static void
+gtk_layout_activate_child (GtkLayout      *layout,
+			   GtkLayoutChild *child)
+{
+  child->active = TRUE;
+
+  /* Drawing walks the active children, so keep them in stacking order
+   */
+  layout->active_children = g_list_insert_sorted (layout->active_children,
+						  child,
+						  gtk_layout_child_compare);
+
+  /* Allocate while still flagged offscreen, so the stale allocation
+   * doesn't get queued for clearing.
+   */
+  gtk_layout_allocate_child (layout, child);
+  GTK_PRIVATE_UNSET_FLAG (child->widget, GTK_IS_OFFSCREEN);
+
+  if (GTK_WIDGET_MAPPED (layout) &&
+      GTK_WIDGET_VISIBLE (child->widget) &&
+      !GTK_WIDGET_MAPPED (child->widget))
+    gtk_widget_map (child->widget);
+}
+
+/* Whether the child contains the focus or the grab, in which case
+ * we keep it realized.
+ */
+static gboolean
+gtk_layout_child_busy (GtkLayoutChild *child)
+{
+  GtkWidget *toplevel;
+  GtkWidget *grab;
+
+  toplevel = gtk_widget_get_toplevel (child->widget);
+  if (GTK_IS_WINDOW (toplevel))
     {
-      if (GTK_WIDGET_MAPPED (layout) &&
-	  GTK_WIDGET_VISIBLE (child->widget))
-	{
-	  if (!GTK_WIDGET_MAPPED (child->widget))
-	    gtk_widget_map (child->widget);
-	}
+      GtkWidget *focus = GTK_WINDOW (toplevel)->focus_widget;
 
-      if (GTK_WIDGET_IS_OFFSCREEN (child->widget))
-	GTK_PRIVATE_UNSET_FLAG (child->widget, GTK_IS_OFFSCREEN);
+      if (focus && (focus == child->widget ||
+		    gtk_widget_is_ancestor (focus, child->widget)))
+	return TRUE;
     }
-  else
-    {
-      if (!GTK_WIDGET_IS_OFFSCREEN (child->widget))
-	GTK_PRIVATE_SET_FLAG (child->widget, GTK_IS_OFFSCREEN);
 
-      if (GTK_WIDGET_MAPPED (child->widget))
-	gtk_widget_unmap (child->widget);
+  grab = gtk_grab_get_current ();
+  if (grab && (grab == child->widget ||
+	       gtk_widget_is_ancestor (grab, child->widget)))
+    return TRUE;
+
+  return FALSE;
+}
+
+static void
+gtk_layout_deactivate_child (GtkLayout      *layout,
+			     GtkLayoutChild *child)
+{
+  child->active = FALSE;
+  layout->active_children = g_list_remove (layout->active_children, child);
+
+  GTK_PRIVATE_SET_FLAG (child->widget, GTK_IS_OFFSCREEN);
+
+  if (GTK_WIDGET_MAPPED (child->widget))
+    gtk_widget_unmap (child->widget);
+
+  if (layout->unrealize_offscreen &&
+      GTK_WIDGET_REALIZED (child->widget) &&
+      !gtk_layout_child_busy (child))
+    gtk_widget_unrealize (child->widget);
+}
+
+static void
+gtk_layout_position_child (GtkLayout      *layout,
+			   GtkLayoutChild *child)
+{
+  if (gtk_layout_child_in_region (layout, child))
+    {
+      if (!child->active)
+	gtk_layout_activate_child (layout, child);
     }
+  else if (child->active)
+    gtk_layout_deactivate_child (layout, child);
+  else if (GTK_WIDGET_MAPPED (child->widget))
+    gtk_widget_unmap (child->widget);
 }
 
 static void
@@ -790,18 +1121,93 @@ gtk_layout_allocate_child (GtkLayout      *layout,
   gtk_widget_size_allocate (child->widget, &allocation);
 }
 
+static GSList *
+gtk_layout_collect_child (GtkLayout      *layout,
+			  GtkLayoutChild *child,
+			  GSList         *entering)
+{
+  if (child->query_serial != layout->query_serial)
+    {
+      child->query_serial = layout->query_serial;
+      if (!child->active && gtk_layout_child_in_region (layout, child))
+	entering = g_slist_prepend (entering, child);
+    }
+
+  return entering;
+}
+
+/* Brings the set of active children up to date with the current
+ * offsets. This only visits the active children and, if the active
+ * region moved, the cells it covers, so the cost doesn't depend on
+ * the total number of children.
+ */
 static void
 gtk_layout_position_children (GtkLayout *layout)
 {
   GList *tmp_list;
+  GSList *entering = NULL;
+  gboolean moved;
 
-  tmp_list = layout->children;
+  moved = gtk_layout_update_region (layout, FALSE);
+
+  tmp_list = layout->active_children;
   while (tmp_list)
     {
       GtkLayoutChild *child = tmp_list->data;
       tmp_list = tmp_list->next;
       
-      gtk_layout_position_child (layout, child);
+      if (!gtk_layout_child_in_region (layout, child))
+	gtk_layout_deactivate_child (layout, child);
+    }
+
+  layout->query_serial++;
+
+  tmp_list = layout->large_children;
+  while (tmp_list)
+    {
+      entering = gtk_layout_collect_child (layout, tmp_list->data, entering);
+      tmp_list = tmp_list->next;
+    }
+
+  if (moved)
+    {
+      gint x1, y1, x2, y2;
+      gint i, j;
+
+      x1 = CELL_OF (layout->active_x);
+      y1 = CELL_OF (layout->active_y);
+      x2 = CELL_OF (layout->active_x + layout->active_width - 1);
+      y2 = CELL_OF (layout->active_y + layout->active_height - 1);
+
+      for (i = x1; i <= x2; i++)
+	for (j = y1; j <= y2; j++)
+	  {
+	    GtkLayoutCell key;
+	    GtkLayoutCell *cell;
+	    GSList *cell_list;
+
+	    key.x = i;
+	    key.y = j;
+	    cell = g_hash_table_lookup (layout->child_cells, &key);
+	    if (!cell)
+	      continue;
+
+	    for (cell_list = cell->children; cell_list; cell_list = cell_list->next)
+	      entering = gtk_layout_collect_child (layout, cell_list->data,
+						   entering);
+	  }
+    }
+
+  /* Mapping may run arbitrary code, so don't do it while walking
+   * the index.
+   */
+  while (entering)
+    {
+      GSList *tmp = entering;
+
+      gtk_layout_activate_child (layout, entering->data);
+      entering = entering->next;
+      g_slist_free_1 (tmp);
     }
 }
 
@@ -832,7 +1238,7 @@ gtk_layout_adjust_allocations (GtkLayout *layout,
   data.dx = dx;
   data.dy = dy;
 
-  tmp_list = layout->children;
+  tmp_list = layout->active_children;
   while (tmp_list)
     {
       GtkLayoutChild *child = tmp_list->data;
@@ -219,6 +219,28 @@ check_setugid (void)
   return TRUE;
 }
 
+/* Atoms used by the selection, DND and rc code; they are interned
+ * together with GDK's own atoms in gdk_init.
+ */
+static const gchar *gtk_prefetch_atoms[] = {
+  "INCR",
+  "MULTIPLE",
+  "TIMESTAMP",
+  "TARGETS",
+  "DELETE",
+  "NULL",
+  "TEXT",
+  "COMPOUND_TEXT",
+  "CLIPBOARD",
+  "WM_TRANSIENT_FOR",
+  "XmTRANSFER_SUCCESS",
+  "XmTRANSFER_FAILURE",
+  "_GTK_READ_RCFILES",
+  "gtk-clist-drag-reorder",
+  "application/x-rootwin-drop",
+  "application/x-color"
+};
+
 gboolean
 gtk_init_check (int	 *argc,
 		char   ***argv)
@@ -241,6 +263,9 @@ gtk_init_check (int	 *argc,
   g_set_print_handler (gtk_print);
 #endif
   
+  gdk_atom_prefetch (gtk_prefetch_atoms,
+		     sizeof (gtk_prefetch_atoms) / sizeof (gtk_prefetch_atoms[0]));
+
   /* Initialize "gdk". We pass along the 'argc' and 'argv'
    *  parameters as they contain information that GDK uses
    */
@@ -310,6 +335,11 @@ gtk_init_check (int	 *argc,
               g_log_set_always_fatal (fatal_mask);
 	      (*argv)[i] = NULL;
 	    }
+	  else if (strcmp ("--gtk-rc-cache-rebuild", (*argv)[i]) == 0)
+	    {
+	      gtk_rc_cache_rebuild ();
+	      (*argv)[i] = NULL;
+	    }
 #ifdef G_ENABLE_DEBUG
 	  else if ((strcmp ("--gtk-debug", (*argv)[i]) == 0) ||
 		   (strncmp ("--gtk-debug=", (*argv)[i], 12) == 0))
@@ -523,7 +553,7 @@ gtk_main (void)
       GDK_THREADS_LEAVE ();
       g_main_run (loop);
       GDK_THREADS_ENTER ();
-      gdk_flush ();
+      gdk_flush_output ();
     }
 
   if (quit_functions)
@@ -560,7 +590,7 @@ gtk_main (void)
 	  quit_functions = work;
 	}
 
-      gdk_flush ();
+      gdk_flush_output ();
     }
 	      
   main_loops = g_slist_remove (main_loops, loop);
@@ -746,8 +776,13 @@ gtk_main_do_event (GdkEvent *event)
 	}
       break;
       
-    case GDK_PROPERTY_NOTIFY:
     case GDK_EXPOSE:
+      gdk_draw_batch_begin ();
+      gtk_widget_event (event_widget, event);
+      gdk_draw_batch_end ();
+      break;
+
+    case GDK_PROPERTY_NOTIFY:
     case GDK_NO_EXPOSE:
     case GDK_FOCUS_CHANGE:
     case GDK_CONFIGURE:
@@ -42,6 +42,7 @@
 #define SUBMENU_NAV_HYSTERESIS_TIMEOUT 333
 
 typedef struct _GtkMenuAttachData	GtkMenuAttachData;
+typedef struct _GtkMenuPopulateData	GtkMenuPopulateData;
 
 struct _GtkMenuAttachData
 {
@@ -49,6 +50,12 @@ struct _GtkMenuAttachData
   GtkMenuDetachFunc detacher;
 };
 
+struct _GtkMenuPopulateData
+{
+  GtkCallback func;
+  gpointer data;
+};
+
 
 static void	gtk_menu_class_init    (GtkMenuClass	  *klass);
 static void	gtk_menu_init	       (GtkMenu		  *menu);
@@ -105,6 +112,8 @@ static const gchar       *navigation_region_key = "gtk-menu-navigation_region";
 static GQuark             navigation_region_key_id = 0;
 static const gchar       *navigation_timeout_key = "gtk-menu-navigation_timeout";
 static GQuark             navigation_timeout_key_id = 0;
+static const gchar       *populate_key = "gtk-menu-populate";
+static GQuark             populate_key_id = 0;
 
 
 GtkType
@@ -456,6 +465,51 @@ gtk_menu_tearoff_bg_copy (GtkMenu *menu)
     }
 }
 
+void
+gtk_menu_set_populate_func (GtkMenu     *menu,
+			    GtkCallback  func,
+			    gpointer     data)
+{
+  GtkMenuPopulateData *populate = NULL;
+
+  g_return_if_fail (menu != NULL);
+  g_return_if_fail (GTK_IS_MENU (menu));
+
+  if (!populate_key_id)
+    populate_key_id = g_quark_from_static_string (populate_key);
+
+  if (func)
+    {
+      populate = g_new (GtkMenuPopulateData, 1);
+      populate->func = func;
+      populate->data = data;
+    }
+
+  gtk_object_set_data_by_id_full (GTK_OBJECT (menu), populate_key_id,
+				  populate, populate ? g_free : NULL);
+}
+
+static void
+gtk_menu_populate (GtkMenu *menu)
+{
+  GtkMenuPopulateData *populate;
+  GtkCallback func;
+  gpointer data;
+
+  if (!populate_key_id)
+    return;
+
+  populate = gtk_object_get_data_by_id (GTK_OBJECT (menu), populate_key_id);
+  if (populate)
+    {
+      func = populate->func;
+      data = populate->data;
+      gtk_object_remove_data_by_id (GTK_OBJECT (menu), populate_key_id);
+
+      (* func) (GTK_WIDGET (menu), data);
+    }
+}
+
 void
 gtk_menu_popup (GtkMenu		    *menu,
 		GtkWidget	    *parent_menu_shell,
@@ -473,6 +527,8 @@ gtk_menu_popup (GtkMenu		    *menu,
   g_return_if_fail (menu != NULL);
   g_return_if_fail (GTK_IS_MENU (menu));
   
+  gtk_menu_populate (menu);
+
   menu_shell = GTK_MENU_SHELL (menu);
   
   menu_shell->parent_menu_shell = parent_menu_shell;
@@ -757,6 +813,8 @@ gtk_menu_set_tearoff_state (GtkMenu  *menu,
 	  if (GTK_WIDGET_VISIBLE (menu))
 	    gtk_menu_popdown (menu);
 
+	  gtk_menu_populate (menu);
+
 	  if (!menu->tearoff_window)
 	    {
 	      GtkWidget *attach_widget;
@@ -858,7 +858,7 @@ gtk_menu_shell_activate_item (GtkMenuShell      *menu_shell,
       /* flush the x-queue, so any grabs are removed and
        * the menu is actually taken down
        */
-      gdk_flush ();
+      gdk_flush_output ();
     }
 
   gtk_widget_activate (menu_item);
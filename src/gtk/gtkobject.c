@@ -93,6 +93,7 @@ gtk_object_debug (void)
     g_hash_table_foreach (living_objs_ht, gtk_object_debug_foreach, NULL);
   
   g_message ("living objects count = %d", obj_count);
+  gtk_type_describe_allocations (GTK_TYPE_OBJECT);
 }
 #endif	/* G_ENABLE_DEBUG */
 
@@ -670,6 +671,98 @@ gtk_object_getv (GtkObject           *object,
     gtk_object_arg_get (object, args, NULL);
 }
 
+GtkArgInfo*
+gtk_object_arg_resolve (GtkType      object_type,
+			const gchar *arg_name)
+{
+  GtkArgInfo *info;
+  gchar *error;
+
+  g_return_val_if_fail (GTK_FUNDAMENTAL_TYPE (object_type) == GTK_TYPE_OBJECT, NULL);
+  g_return_val_if_fail (arg_name != NULL, NULL);
+
+  /* make sure the class, and with it its arguments, exists
+   */
+  gtk_type_class (object_type);
+
+  error = gtk_arg_get_info (object_type,
+			    object_arg_info_ht,
+			    arg_name,
+			    &info);
+  if (error)
+    {
+      g_warning ("gtk_object_arg_resolve(): %s", error);
+      g_free (error);
+      return NULL;
+    }
+
+  return info;
+}
+
+void
+gtk_object_setv_by_info (GtkObject   *object,
+			 guint	      n_args,
+			 GtkArgInfo **infos,
+			 GtkArg	     *args)
+{
+  GtkType object_type;
+  guint i;
+
+  g_return_if_fail (object != NULL);
+  g_return_if_fail (GTK_IS_OBJECT (object));
+  if (n_args)
+    g_return_if_fail (infos != NULL && args != NULL);
+
+  object_type = GTK_OBJECT_TYPE (object);
+  for (i = 0; i < n_args; i++)
+    {
+      GtkArgInfo *info = infos[i];
+
+      g_return_if_fail (info != NULL);
+      if (!gtk_type_is_a (object_type, info->class_type))
+	{
+	  g_warning ("gtk_object_setv_by_info(): argument \"%s\" does not apply to `%s'",
+		     info->full_name,
+		     gtk_type_name (object_type));
+	  continue;
+	}
+      gtk_object_arg_set (object, &args[i], info);
+    }
+}
+
+void
+gtk_object_getv_by_info (GtkObject   *object,
+			 guint	      n_args,
+			 GtkArgInfo **infos,
+			 GtkArg	     *args)
+{
+  GtkType object_type;
+  guint i;
+
+  g_return_if_fail (object != NULL);
+  g_return_if_fail (GTK_IS_OBJECT (object));
+  if (n_args)
+    g_return_if_fail (infos != NULL && args != NULL);
+
+  object_type = GTK_OBJECT_TYPE (object);
+  for (i = 0; i < n_args; i++)
+    {
+      GtkArgInfo *info = infos[i];
+
+      g_return_if_fail (info != NULL);
+      args[i].name = info->name;
+      if (!gtk_type_is_a (object_type, info->class_type))
+	{
+	  g_warning ("gtk_object_getv_by_info(): argument \"%s\" does not apply to `%s'",
+		     info->full_name,
+		     gtk_type_name (object_type));
+	  args[i].type = GTK_TYPE_INVALID;
+	  continue;
+	}
+      gtk_object_arg_get (object, &args[i], info);
+    }
+}
+
 void
 gtk_object_get (GtkObject   *object,
 		const gchar *first_arg_name,
@@ -95,6 +95,7 @@ terms specified in this license.
 
 
 #include "gtkpacker.h"
+#include "gtkchildindex.h"
 
 
 enum {
@@ -633,6 +634,7 @@ gtk_packer_add_defaults (GtkPacker       *packer,
   pchild->i_pad_y = packer->default_i_pad_y;
   
   packer->children = g_list_append(packer->children, (gpointer) pchild);
+  gtk_child_index_add (GTK_WIDGET (packer), g_list_last (packer->children));
   
   gtk_widget_set_parent (child, GTK_WIDGET (packer));
   
@@ -683,6 +685,7 @@ gtk_packer_add (GtkPacker       *packer,
   pchild->i_pad_y = i_pad_y;
   
   packer->children = g_list_append(packer->children, (gpointer) pchild);
+  gtk_child_index_add (GTK_WIDGET (packer), g_list_last (packer->children));
   
   gtk_widget_set_parent (child, GTK_WIDGET (packer));
   
@@ -717,29 +720,26 @@ gtk_packer_set_child_packing (GtkPacker       *packer,
   g_return_if_fail (GTK_IS_PACKER (packer));
   g_return_if_fail (child != NULL);
   
-  list = g_list_first(packer->children);
-  while (list != NULL) 
+  list = gtk_child_index_find (GTK_WIDGET (packer), packer->children, child);
+  if (list != NULL) 
     {
       pchild = (GtkPackerChild*) list->data;
-      if (pchild->widget == child) 
-	{
-	  pchild->side = side;
-	  pchild->anchor = anchor;
-	  pchild->options = options;
-	  
-	  pchild->use_default = 0;
-	  
-	  pchild->border_width = border_width;
-	  pchild->pad_x = pad_x;
-	  pchild->pad_y = pad_y;
-	  pchild->i_pad_x = i_pad_x;
-	  pchild->i_pad_y = i_pad_y;
-	  
-	  if (GTK_WIDGET_VISIBLE (child) && GTK_WIDGET_VISIBLE (packer))
-	    gtk_widget_queue_resize (child);
-	  return;
-        }
-      list = g_list_next(list);
+
+      pchild->side = side;
+      pchild->anchor = anchor;
+      pchild->options = options;
+      
+      pchild->use_default = 0;
+      
+      pchild->border_width = border_width;
+      pchild->pad_x = pad_x;
+      pchild->pad_y = pad_y;
+      pchild->i_pad_x = i_pad_x;
+      pchild->i_pad_y = i_pad_y;
+      
+      if (GTK_WIDGET_VISIBLE (child) && GTK_WIDGET_VISIBLE (packer))
+	gtk_widget_queue_resize (child);
+      return;
     }
 
   g_warning ("couldn't find child `%s' amongst the packer's children", gtk_type_name (GTK_OBJECT_TYPE (child)));
@@ -756,17 +756,7 @@ gtk_packer_reorder_child (GtkPacker *packer,
   g_return_if_fail (GTK_IS_PACKER (packer));
   g_return_if_fail (child != NULL);
 
-  list = packer->children;
-  while (list)
-    {
-      GtkPackerChild *child_info;
-
-      child_info = list->data;
-      if (child_info->widget == child)
-	break;
-
-      list = list->next;
-    }
+  list = gtk_child_index_find (GTK_WIDGET (packer), packer->children, child);
 
   if (list && packer->children->next)
     {
@@ -803,6 +793,8 @@ gtk_packer_reorder_child (GtkPacker *packer,
 	  list->next = tmp_list;
 	}
 
+      gtk_child_index_invalidate (GTK_WIDGET (packer));
+
       if (GTK_WIDGET_VISIBLE (child) && GTK_WIDGET_VISIBLE (packer))
 	gtk_widget_queue_resize (child);
     }
@@ -822,27 +814,21 @@ gtk_packer_remove (GtkContainer *container,
   
   packer = GTK_PACKER (container);
   
-  children = g_list_first(packer->children);
-  while (children) 
+  children = gtk_child_index_find (GTK_WIDGET (packer), packer->children, widget);
+  if (children) 
     {
       child = children->data;
       
-      if (child->widget == widget) 
-	{
-	  visible = GTK_WIDGET_VISIBLE (widget);
-	  gtk_widget_unparent (widget);
-	  
-	  packer->children = g_list_remove_link (packer->children, children);
-	  g_list_free (children);
-	  g_free (child);
-	  
-	  if (visible && GTK_WIDGET_VISIBLE (container))
-	    gtk_widget_queue_resize (GTK_WIDGET (container));
-	  
-	  break;
-        }
+      visible = GTK_WIDGET_VISIBLE (widget);
+      gtk_widget_unparent (widget);
       
-      children = g_list_next(children);
+      gtk_child_index_remove (GTK_WIDGET (packer), widget);
+      packer->children = g_list_remove_link (packer->children, children);
+      g_list_free (children);
+      g_free (child);
+      
+      if (visible && GTK_WIDGET_VISIBLE (container))
+	gtk_widget_queue_resize (GTK_WIDGET (container));
     }
 }
 
@@ -897,64 +883,55 @@ gtk_packer_unmap (GtkWidget *widget)
 }
 
 static void 
-gtk_packer_draw (GtkWidget    *widget,
-		 GdkRectangle *area)
+gtk_packer_draw_child (gpointer data,
+		       gpointer user_data)
 {
-  GtkPacker *packer;
-  GtkPackerChild *child;
+  GtkPackerChild *child = data;
+  GdkRectangle *area = user_data;
   GdkRectangle child_area;
-  GList *children;
 
+  if (gtk_widget_intersect (child->widget, area, &child_area))
+    gtk_widget_draw (child->widget, &child_area);
+}
+
+static void 
+gtk_packer_draw (GtkWidget    *widget,
+		 GdkRectangle *area)
+{
   g_return_if_fail (widget != NULL);
   g_return_if_fail (GTK_IS_PACKER (widget));
  
   if (GTK_WIDGET_DRAWABLE (widget)) 
-    {
-      packer = GTK_PACKER (widget);
-      
-      children = g_list_first(packer->children);
-      while (children != NULL) 
-	{
-	  child = children->data;
-	  children = g_list_next(children);
-	  
-	  if (gtk_widget_intersect (child->widget, area, &child_area))
-	    gtk_widget_draw (child->widget, &child_area);
-        }
-    }
-  
+    gtk_child_index_foreach (widget, GTK_PACKER (widget)->children, area,
+			     gtk_packer_draw_child, area);
+}
+
+static void 
+gtk_packer_expose_child (gpointer data,
+			 gpointer user_data)
+{
+  GtkPackerChild *child = data;
+  GdkEventExpose *event = user_data;
+  GdkEventExpose child_event;
+
+  child_event = *event;
+
+  if (GTK_WIDGET_NO_WINDOW (child->widget) &&
+      gtk_widget_intersect (child->widget, &event->area, &child_event.area))
+    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
 }
 
 static gint 
 gtk_packer_expose (GtkWidget      *widget,
 		   GdkEventExpose *event)
 {
-  GtkPacker *packer;
-  GtkPackerChild *child;
-  GdkEventExpose child_event;
-  GList *children;
-  
   g_return_val_if_fail (widget != NULL, FALSE);
   g_return_val_if_fail (GTK_IS_PACKER (widget), FALSE);
   g_return_val_if_fail (event != NULL, FALSE);
   
   if (GTK_WIDGET_DRAWABLE (widget)) 
-    {
-      packer = GTK_PACKER (widget);
-      
-      child_event = *event;
-      
-      children = g_list_first(packer->children);
-      while (children) 
-	{
-	  child = children->data;
-	  children = g_list_next(children);
-	  
-	  if (GTK_WIDGET_NO_WINDOW (child->widget) &&
-	      gtk_widget_intersect (child->widget, &event->area, &child_event.area))
-	    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
-	}
-    }   
+    gtk_child_index_foreach (widget, GTK_PACKER (widget)->children, &event->area,
+			     gtk_packer_expose_child, event);
   
   return FALSE;
 }
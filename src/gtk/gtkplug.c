@@ -194,8 +194,7 @@ gtk_plug_realize (GtkWidget *widget)
     {
       gdk_error_trap_push ();
       gdk_window_destroy (widget->window);
-      gdk_flush ();
-      gdk_error_trap_pop ();
+      gdk_error_trap_pop_async (NULL, NULL);
       widget->window = gdk_window_new (NULL, &attributes, attributes_mask);
     }
   
@@ -302,8 +301,7 @@ gtk_plug_key_press_event (GtkWidget   *widget,
 	      XSetInputFocus (GDK_DISPLAY (),
 			      GDK_WINDOW_XWINDOW (plug->socket_window),
 			      RevertToParent, event->time);
-	      gdk_flush ();
-	      gdk_error_trap_pop ();
+	      gdk_error_trap_pop_async (NULL, NULL);
 
 	      gtk_plug_forward_key_press (plug, event);
 	    }
@@ -342,8 +340,7 @@ gtk_plug_forward_key_press (GtkPlug *plug, GdkEventKey *event)
   XSendEvent (gdk_display,
 	      GDK_WINDOW_XWINDOW (plug->socket_window),
 	      False, NoEventMask, &xevent);
-  gdk_flush ();
-  gdk_error_trap_pop ();
+  gdk_error_trap_pop_async (NULL, NULL);
 }
 
 /* Copied from Window, Ughh */
@@ -438,7 +435,6 @@ gtk_plug_set_focus (GtkWindow *window,
       XSendEvent (gdk_display,
 		  GDK_WINDOW_XWINDOW (plug->socket_window),
 		  False, NoEventMask, &xevent);
-      gdk_flush ();
-      gdk_error_trap_pop ();
+      gdk_error_trap_pop_async (NULL, NULL);
     }
 }
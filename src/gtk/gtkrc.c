@@ -33,8 +33,17 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <langinfo.h>
+#include <sys/mman.h>
+#include "config.h"
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include "gtkcontainer.h"
+#include "gtkmain.h"
 #include "gtkrc.h"
 #include "gtkbindings.h"
 #include "gtkthemes.h"
@@ -44,6 +53,7 @@ typedef struct _GtkRcSet    GtkRcSet;
 typedef struct _GtkRcNode   GtkRcNode;
 typedef struct _GtkRcFile   GtkRcFile;
 typedef struct _GtkRcStylePrivate  GtkRcStylePrivate;
+typedef struct _GtkRcCachePath    GtkRcCachePath;
 
 struct _GtkRcSet
 {
@@ -54,11 +64,20 @@ struct _GtkRcSet
 struct _GtkRcFile
 {
   time_t mtime;
+  guint32 mtime_nsec;		/* State of the file when it was read, */
+  guint32 size;			/* to tell whether it has changed since; */
+  guint32 ino;			/* truncated the way the rc cache keeps it */
   gchar *name;
   gchar *canonical_name;
   gboolean reload;
 };
 
+#ifdef HAVE_STAT_ST_MTIM_TV_NSEC
+#define GTK_RC_STAT_MTIME_NSEC(statbuf) ((statbuf).st_mtim.tv_nsec)
+#else
+#define GTK_RC_STAT_MTIME_NSEC(statbuf) 0
+#endif
+
 struct _GtkRcStylePrivate
 {
   GtkRcStyle style;
@@ -68,6 +87,19 @@ struct _GtkRcStylePrivate
   GSList *rc_style_lists;
 };
 
+/* A "widget", "widget_class" or "class" statement of an rc file,
+ * remembered for the rc cache. The patterns of GtkRcSet are changed
+ * by gtk_pattern_spec_init(), so they cannot be saved from there.
+ */
+struct _GtkRcCachePath
+{
+  gchar *name;			/* rc style or binding set */
+  GtkPathType path_type;
+  gchar *pattern;
+  GtkPathPriorityType priority;
+  gboolean is_binding;
+};
+
 static guint	   gtk_rc_style_hash		   (const char   *name);
 static gint	   gtk_rc_style_compare		   (const char   *a,
 						    const char   *b);
@@ -84,6 +116,8 @@ static GtkStyle *  gtk_rc_style_to_style           (GtkRcStyle   *rc_style);
 static GtkStyle*   gtk_rc_style_init		   (GSList       *rc_styles);
 static void        gtk_rc_parse_file               (const gchar  *filename,
 						    gboolean      reload);
+static gboolean    gtk_rc_file_changed             (GtkRcFile    *rc_file,
+						    struct stat  *statbuf);
 
 static void	   gtk_rc_parse_any		   (const gchar  *input_name,
 						    gint	  input_fd,
@@ -114,10 +148,15 @@ static guint	   gtk_rc_parse_path_pattern	   (GScanner     *scanner);
 static void        gtk_rc_clear_hash_node          (gpointer   key, 
 						    gpointer   data, 
 						    gpointer   user_data);
-static void        gtk_rc_clear_styles               (void);
 static void        gtk_rc_append_default_pixmap_path (void);
 static void        gtk_rc_append_default_module_path (void);
 static void        gtk_rc_add_initial_default_files  (void);
+static void        gtk_rc_watch_file                 (GtkRcFile    *rc_file);
+static gchar *     gtk_rc_cache_get_file	     (GSList       *names);
+static gboolean    gtk_rc_cache_load		     (const gchar  *cache_file,
+						      GSList       *names);
+static void        gtk_rc_cache_save		     (const gchar  *cache_file,
+						      GSList       *names);
 
 
 static const GScannerConfig	gtk_rc_scanner_config =
@@ -222,6 +261,11 @@ GSList *rc_files = NULL;
 
 static GtkImageLoader image_loader = NULL;
 
+/* Path statements of the rc files parsed while the cache is being built */
+static GSList *rc_cache_paths = NULL;
+static gboolean rc_cache_recording = FALSE;
+static gboolean rc_cache_rebuild = FALSE;
+
 /* RC file handling */
 
 
@@ -444,6 +488,8 @@ gtk_rc_init (void)
   static gchar *locale_suffixes[8];
   static gint n_locale_suffixes = 0;
 
+  GSList *names, *slist;
+  gchar *cache_file;
   gint i, j;
 
   static gboolean initted = FALSE;
@@ -553,6 +599,7 @@ gtk_rc_init (void)
       g_free (locale);
     }
   
+  names = NULL;
   i = 0;
   while (gtk_rc_default_files[i] != NULL)
     {
@@ -560,19 +607,34 @@ gtk_rc_init (void)
        * to parse before the default file.
        */
       for (j=n_locale_suffixes-1; j>=0; j--)
-	{
-	  gchar *name = g_strconcat (gtk_rc_default_files[i],
-				     ".",
-				     locale_suffixes[j],
-				     NULL);
-	  gtk_rc_parse (name);
-	  g_free (name);
-	}
+	names = g_slist_prepend (names, g_strconcat (gtk_rc_default_files[i],
+						     ".",
+						     locale_suffixes[j],
+						     NULL));
 
-      gtk_rc_parse (gtk_rc_default_files[i]);
+      names = g_slist_prepend (names, g_strdup (gtk_rc_default_files[i]));
       i++;
     }
- }
+  names = g_slist_reverse (names);
+
+  cache_file = gtk_rc_cache_get_file (names);
+  if (!cache_file || !gtk_rc_cache_load (cache_file, names))
+    {
+      rc_cache_recording = cache_file != NULL;
+
+      for (slist = names; slist; slist = slist->next)
+	gtk_rc_parse (slist->data);
+
+      rc_cache_recording = FALSE;
+      if (cache_file)
+	gtk_rc_cache_save (cache_file, names);
+    }
+
+  for (slist = names; slist; slist = slist->next)
+    g_free (slist->data);
+  g_slist_free (names);
+  g_free (cache_file);
+}
 
 void
 gtk_rc_parse_string (const gchar *rc_string)
@@ -582,6 +644,20 @@ gtk_rc_parse_string (const gchar *rc_string)
   gtk_rc_parse_any ("-", -1, rc_string);
 }
 
+/* Checks whether the file an rc file was read from has changed
+ * since; the modification time alone misses edits made within the
+ * same second, and files replaced by another one with an older time.
+ */
+static gboolean
+gtk_rc_file_changed (GtkRcFile   *rc_file,
+		     struct stat *statbuf)
+{
+  return ((guint32) statbuf->st_mtime != (guint32) rc_file->mtime ||
+	  (guint32) GTK_RC_STAT_MTIME_NSEC (*statbuf) != rc_file->mtime_nsec ||
+	  (guint32) statbuf->st_size != rc_file->size ||
+	  (guint32) statbuf->st_ino != rc_file->ino);
+}
+
 static void
 gtk_rc_parse_file (const gchar *filename, gboolean reload)
 {
@@ -607,6 +683,9 @@ gtk_rc_parse_file (const gchar *filename, gboolean reload)
       rc_file->name = g_strdup (filename);
       rc_file->canonical_name = NULL;
       rc_file->mtime = 0;
+      rc_file->mtime_nsec = 0;
+      rc_file->size = 0;
+      rc_file->ino = 0;
       rc_file->reload = reload;
 
       rc_files = g_slist_append (rc_files, rc_file);
@@ -633,14 +712,19 @@ gtk_rc_parse_file (const gchar *filename, gboolean reload)
 	  rc_file->canonical_name = str->str;
 	  g_string_free (str, FALSE);
 	}
+
+      gtk_rc_watch_file (rc_file);
     }
 
-  if (!lstat (rc_file->canonical_name, &statbuf))
+  if (!stat (rc_file->canonical_name, &statbuf))
     {
       gint fd;
       GSList *tmp_list;
 
       rc_file->mtime = statbuf.st_mtime;
+      rc_file->mtime_nsec = GTK_RC_STAT_MTIME_NSEC (statbuf);
+      rc_file->size = statbuf.st_size;
+      rc_file->ino = statbuf.st_ino;
 
       fd = open (rc_file->canonical_name, O_RDONLY);
       if (fd < 0)
@@ -823,50 +907,159 @@ gtk_rc_free_rc_sets (GSList *slist)
     }
 }
 
+static gboolean
+gtk_rc_str_equal (const gchar *a,
+		  const gchar *b)
+{
+  return a == b || (a && b && strcmp (a, b) == 0);
+}
+
+/* Whether the two rc styles give the same styles. The data of theme
+ * engines is opaque, so their rc styles never compare equal.
+ */
+static gboolean
+gtk_rc_style_equal (GtkRcStyle *a,
+		    GtkRcStyle *b)
+{
+  gint i;
+
+  if (a->engine || b->engine)
+    return FALSE;
+
+  if (!gtk_rc_str_equal (a->font_name, b->font_name) ||
+      !gtk_rc_str_equal (a->fontset_name, b->fontset_name))
+    return FALSE;
+
+  for (i = 0; i < 5; i++)
+    {
+      if (!gtk_rc_str_equal (a->bg_pixmap_name[i], b->bg_pixmap_name[i]) ||
+	  a->color_flags[i] != b->color_flags[i])
+	return FALSE;
+
+      if (((a->color_flags[i] & GTK_RC_FG) && !gdk_color_equal (&a->fg[i], &b->fg[i])) ||
+	  ((a->color_flags[i] & GTK_RC_BG) && !gdk_color_equal (&a->bg[i], &b->bg[i])) ||
+	  ((a->color_flags[i] & GTK_RC_TEXT) && !gdk_color_equal (&a->text[i], &b->text[i])) ||
+	  ((a->color_flags[i] & GTK_RC_BASE) && !gdk_color_equal (&a->base[i], &b->base[i])))
+	return FALSE;
+    }
+
+  return TRUE;
+}
+
 static void
-gtk_rc_clear_styles (void)
+gtk_rc_collect_reusable_style (gpointer key,
+			       gpointer data,
+			       gpointer user_data)
 {
-  /* Clear out all old rc_styles */
+  GHashTable *old_style_ht = ((gpointer*) user_data)[0];
+  GSList **reusable = ((gpointer*) user_data)[1];
+  GtkRcStyle *old_style;
 
-  if (rc_style_ht)
+  old_style = g_hash_table_lookup (old_style_ht, key);
+  if (old_style && gtk_rc_style_equal (old_style, data))
     {
-      g_hash_table_foreach (rc_style_ht, gtk_rc_clear_hash_node, NULL);
-      g_hash_table_destroy (rc_style_ht);
-      rc_style_ht = NULL;
+      *reusable = g_slist_prepend (*reusable, data);
+      *reusable = g_slist_prepend (*reusable, old_style);
     }
+}
 
-  gtk_rc_free_rc_sets (gtk_rc_sets_widget);
-  g_slist_free (gtk_rc_sets_widget);
-  gtk_rc_sets_widget = NULL;
+static void
+gtk_rc_replace_set_styles (GSList     *sets,
+			   GtkRcStyle *new_style,
+			   GtkRcStyle *old_style)
+{
+  for (; sets; sets = sets->next)
+    {
+      GtkRcSet *rc_set = sets->data;
 
-  gtk_rc_free_rc_sets (gtk_rc_sets_widget_class);
-  g_slist_free (gtk_rc_sets_widget_class);
-  gtk_rc_sets_widget_class = NULL;
+      if (rc_set->rc_style == new_style)
+	rc_set->rc_style = old_style;
+    }
+}
 
-  gtk_rc_free_rc_sets (gtk_rc_sets_class);
-  g_slist_free (gtk_rc_sets_class);
-  gtk_rc_sets_class = NULL;
+/* Puts the rc styles of @old_style_ht back in place of the freshly
+ * parsed rc styles that are equal to them. Since realized styles are
+ * looked up by their list of rc styles, widgets whose rc styles did
+ * not change then get the very same style again.
+ */
+static void
+gtk_rc_reuse_styles (GHashTable *old_style_ht)
+{
+  GSList *reusable = NULL;
+  GSList *slist;
+  gpointer data[2];
+
+  if (!old_style_ht || !rc_style_ht)
+    return;
+
+  data[0] = old_style_ht;
+  data[1] = &reusable;
+  g_hash_table_foreach (rc_style_ht, gtk_rc_collect_reusable_style, data);
+
+  for (slist = reusable; slist; slist = slist->next->next)
+    {
+      GtkRcStyle *old_style = slist->data;
+      GtkRcStyle *new_style = slist->next->data;
+
+      g_hash_table_remove (rc_style_ht, new_style->name);
+      g_hash_table_insert (rc_style_ht, old_style->name, old_style);
+      gtk_rc_style_ref (old_style);
+
+      gtk_rc_replace_set_styles (gtk_rc_sets_widget, new_style, old_style);
+      gtk_rc_replace_set_styles (gtk_rc_sets_widget_class, new_style, old_style);
+      gtk_rc_replace_set_styles (gtk_rc_sets_class, new_style, old_style);
+
+      gtk_rc_style_unref (new_style);
+    }
+  g_slist_free (reusable);
 }
 
-gboolean
-gtk_rc_reparse_all (void)
+static gboolean
+gtk_rc_sets_equal (GSList *a,
+		   GSList *b)
+{
+  while (a && b)
+    {
+      GtkRcSet *set_a = a->data;
+      GtkRcSet *set_b = b->data;
+
+      if (set_a->rc_style != set_b->rc_style ||
+	  set_a->pspec.match_type != set_b->pspec.match_type ||
+	  strcmp (set_a->pspec.pattern, set_b->pspec.pattern) != 0)
+	return FALSE;
+
+      a = a->next;
+      b = b->next;
+    }
+
+  return a == b;
+}
+
+/* Parses the rc files again if @force is set or if any of them was
+ * modified, and returns whether this could have changed any style.
+ */
+static gboolean
+gtk_rc_reparse (gboolean force)
 {
   GSList *tmp_list;
-  gboolean mtime_modified = FALSE;
+  gboolean mtime_modified = force;
+  gboolean changed;
   GtkRcFile *rc_file;
+  GHashTable *old_style_ht;
+  GSList *old_sets_widget, *old_sets_widget_class, *old_sets_class;
 
   struct stat statbuf;
 
-  /* Check through and see if any of the RC's have had their
-   * mtime modified. If so, reparse everything.
+  /* Check through and see if any of the RC's have been
+   * modified. If so, reparse everything.
    */
   tmp_list = rc_files;
-  while (tmp_list)
+  while (tmp_list && !mtime_modified)
     {
       rc_file = tmp_list->data;
       
-      if (!lstat (rc_file->name, &statbuf) && 
-	  (statbuf.st_mtime > rc_file->mtime))
+      if (!stat (rc_file->name, &statbuf) && 
+	  gtk_rc_file_changed (rc_file, &statbuf))
 	{
 	  mtime_modified = TRUE;
 	  break;
@@ -875,24 +1068,243 @@ gtk_rc_reparse_all (void)
       tmp_list = tmp_list->next;
     }
 
-  if (mtime_modified)
+  if (!mtime_modified)
+    return FALSE;
+
+  /* Keep the old rc styles and sets until the files are parsed,
+   * to find out what actually changed.
+   */
+  old_style_ht = rc_style_ht;
+  old_sets_widget = gtk_rc_sets_widget;
+  old_sets_widget_class = gtk_rc_sets_widget_class;
+  old_sets_class = gtk_rc_sets_class;
+  rc_style_ht = NULL;
+  gtk_rc_sets_widget = NULL;
+  gtk_rc_sets_widget_class = NULL;
+  gtk_rc_sets_class = NULL;
+
+  tmp_list = rc_files;
+  while (tmp_list)
+    {
+      rc_file = tmp_list->data;
+      if (rc_file->reload)
+	gtk_rc_parse_file (rc_file->name, FALSE);
+
+      tmp_list = tmp_list->next;
+    }
+
+  gtk_rc_reuse_styles (old_style_ht);
+
+  changed = !(gtk_rc_sets_equal (gtk_rc_sets_widget, old_sets_widget) &&
+	      gtk_rc_sets_equal (gtk_rc_sets_widget_class, old_sets_widget_class) &&
+	      gtk_rc_sets_equal (gtk_rc_sets_class, old_sets_class));
+
+  GTK_NOTE (MISC, g_message ("rc files reparsed, styles %s",
+			     changed ? "changed" : "unchanged"));
+
+  if (old_style_ht)
+    {
+      g_hash_table_foreach (old_style_ht, gtk_rc_clear_hash_node, NULL);
+      g_hash_table_destroy (old_style_ht);
+    }
+  gtk_rc_free_rc_sets (old_sets_widget);
+  g_slist_free (old_sets_widget);
+  gtk_rc_free_rc_sets (old_sets_widget_class);
+  g_slist_free (old_sets_widget_class);
+  gtk_rc_free_rc_sets (old_sets_class);
+  g_slist_free (old_sets_class);
+
+  return changed;
+}
+
+gboolean
+gtk_rc_reparse_all (void)
+{
+  return gtk_rc_reparse (FALSE);
+}
+
+/* Watching the rc files
+ *
+ * The directories of the rc files are watched with inotify, so that
+ * files replaced by a rename or created later are noticed as well.
+ * For an rc file that is a symbolic link, the directory of the file
+ * it points to is watched too. A change reparses the rc files shortly
+ * afterwards, after which the toplevels are restyled by
+ * gtk_widget_update_rc_styles().
+ */
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+#define GTK_RC_RELOAD_DELAY 200
+
+static guint rc_reload_timeout = 0;
+static gint rc_watch_fd = -1;
+static GHashTable *rc_watch_dirs = NULL;	/* watch descriptor -> directory */
+static GHashTable *rc_watch_targets = NULL;	/* files rc files link to */
+
+static gint
+gtk_rc_reload_timeout (gpointer data)
+{
+  GList *toplevels;
+  GSList *tmp_list;
+
+  GDK_THREADS_ENTER ();
+
+  rc_reload_timeout = 0;
+
+  if (gtk_rc_reparse (TRUE))
+    for (toplevels = gtk_container_get_toplevels (); toplevels; toplevels = toplevels->next)
+      gtk_widget_update_rc_styles (toplevels->data);
+
+  /* Links may point elsewhere now */
+  for (tmp_list = rc_files; tmp_list; tmp_list = tmp_list->next)
+    gtk_rc_watch_file (tmp_list->data);
+
+  GDK_THREADS_LEAVE ();
+
+  return FALSE;
+}
+
+static gboolean
+gtk_rc_watch_matches (gint         wd,
+		      const gchar *name)
+{
+  const gchar *dir;
+  gchar *filename;
+  GSList *tmp_list;
+  gboolean result = FALSE;
+
+  dir = g_hash_table_lookup (rc_watch_dirs, GINT_TO_POINTER (wd));
+  if (!dir)
+    return FALSE;
+
+  filename = g_strconcat (dir, dir[1] ? "/" : "", name, NULL);
+  for (tmp_list = rc_files; tmp_list && !result; tmp_list = tmp_list->next)
     {
-      gtk_rc_clear_styles();
+      GtkRcFile *rc_file = tmp_list->data;
 
-      tmp_list = rc_files;
-      while (tmp_list)
+      result = rc_file->canonical_name && !strcmp (rc_file->canonical_name, filename);
+    }
+  if (!result)
+    result = g_hash_table_lookup (rc_watch_targets, filename) != NULL;
+  g_free (filename);
+
+  return result;
+}
+
+static void
+gtk_rc_watch_input (gpointer          data,
+		    gint              source,
+		    GdkInputCondition condition)
+{
+  union {
+    struct inotify_event event;
+    gchar data[4096];
+  } buffer;
+  gboolean changed = FALSE;
+  gint len;
+
+  GDK_THREADS_ENTER ();
+
+  while ((len = read (source, buffer.data, sizeof (buffer))) > 0)
+    {
+      gchar *p = buffer.data;
+
+      while (p < buffer.data + len)
 	{
-	  rc_file = tmp_list->data;
-	  if (rc_file->reload)
-	    gtk_rc_parse_file (rc_file->name, FALSE);
-	  
-	  tmp_list = tmp_list->next;
+	  struct inotify_event *event = (struct inotify_event*) p;
+
+	  if (event->mask & IN_Q_OVERFLOW)
+	    changed = TRUE;
+	  else if (event->mask & IN_IGNORED)
+	    {
+	      gpointer key = GINT_TO_POINTER (event->wd);
+
+	      g_free (g_hash_table_lookup (rc_watch_dirs, key));
+	      g_hash_table_remove (rc_watch_dirs, key);
+	    }
+	  else if (event->len && gtk_rc_watch_matches (event->wd, event->name))
+	    changed = TRUE;
+
+	  p += sizeof (struct inotify_event) + event->len;
+	}
+    }
+
+  if (changed && !rc_reload_timeout)
+    {
+      GTK_NOTE (MISC, g_message ("rc files changed, reloading"));
+      rc_reload_timeout = gtk_timeout_add (GTK_RC_RELOAD_DELAY,
+					   gtk_rc_reload_timeout, NULL);
+    }
+
+  GDK_THREADS_LEAVE ();
+}
+
+/* Watches dir, which is freed */
+static void
+gtk_rc_watch_dir (gchar *dir)
+{
+  gint wd;
+
+  wd = inotify_add_watch (rc_watch_fd, dir,
+			  IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+			  IN_CREATE | IN_DELETE | IN_ATTRIB);
+  if (wd >= 0 && !g_hash_table_lookup (rc_watch_dirs, GINT_TO_POINTER (wd)))
+    g_hash_table_insert (rc_watch_dirs, GINT_TO_POINTER (wd), dir);
+  else
+    g_free (dir);
+}
+
+static void
+gtk_rc_watch_file (GtkRcFile *rc_file)
+{
+  gchar resolved[MAXPATHLEN];
+
+  if (!rc_file->canonical_name)
+    return;
+
+  if (rc_watch_fd < 0)
+    {
+      if (rc_watch_dirs)
+	return;		/* inotify is not available */
+
+      rc_watch_dirs = g_hash_table_new (g_direct_hash, NULL);
+      rc_watch_targets = g_hash_table_new (g_str_hash, g_str_equal);
+      rc_watch_fd = inotify_init ();
+      if (rc_watch_fd < 0)
+	return;
+
+      fcntl (rc_watch_fd, F_SETFD, FD_CLOEXEC);
+      fcntl (rc_watch_fd, F_SETFL, fcntl (rc_watch_fd, F_GETFL) | O_NONBLOCK);
+      gdk_input_add (rc_watch_fd, GDK_INPUT_READ, gtk_rc_watch_input, NULL);
+    }
+
+  /* The link itself, in case it is replaced */
+  gtk_rc_watch_dir (g_dirname (rc_file->canonical_name));
+
+  /* And what it resolves to, where edits to the file happen */
+  if (realpath (rc_file->canonical_name, resolved) &&
+      strcmp (resolved, rc_file->canonical_name) != 0)
+    {
+      if (!g_hash_table_lookup (rc_watch_targets, resolved))
+	{
+	  gchar *target = g_strdup (resolved);
+
+	  g_hash_table_insert (rc_watch_targets, target, target);
 	}
+      gtk_rc_watch_dir (g_dirname (resolved));
     }
+}
+
+#else /* !HAVE_SYS_INOTIFY_H */
 
-  return mtime_modified;
+static void
+gtk_rc_watch_file (GtkRcFile *rc_file)
+{
 }
 
+#endif /* !HAVE_SYS_INOTIFY_H */
+
 static GSList *
 gtk_rc_styles_match (GSList       *rc_styles,
 		     GSList	  *sets,
@@ -2297,10 +2709,657 @@ gtk_rc_parse_path_pattern (GScanner   *scanner)
 	gtk_rc_sets_class = g_slist_prepend (gtk_rc_sets_class, rc_set);
     }
 
+  if (rc_cache_recording)
+    {
+      GtkRcCachePath *cpath;
+
+      cpath = g_new (GtkRcCachePath, 1);
+      cpath->name = g_strdup (scanner->value.v_string);
+      cpath->path_type = path_type;
+      cpath->pattern = g_strdup (pattern);
+      cpath->priority = priority;
+      cpath->is_binding = is_binding;
+      rc_cache_paths = g_slist_prepend (rc_cache_paths, cpath);
+    }
+
   g_free (pattern);
   return G_TOKEN_NONE;
 }
 
+/* The rc cache
+ *
+ * Parsing the default rc files at every startup means scanning them and
+ * looking up their files again and again, though they hardly ever
+ * change. So gtk_rc_init() saves what parsing them resulted in, the rc
+ * styles, the path statements and the pixmap and module paths, to a
+ * cache file, and maps that file instead of parsing the next time, as
+ * long as the same rc files are to be read and neither the files read
+ * nor the files that were missing changed.
+ *
+ * The cache is $GTK_RC_CACHE, or ~/.gtk-rc-cache/ followed by a hash
+ * of the rc file names; an empty $GTK_RC_CACHE disables it. It holds a
+ * header, the records as 32 bit words and a table of nul terminated
+ * strings that the records refer to by offset. Rc styles with a theme
+ * engine keep engine private data, so they make the result uncachable.
+ */
+
+#define GTK_RC_CACHE_MAGIC	(('G' << 24) | ('R' << 16) | ('C' << 8) | 'C')
+#define GTK_RC_CACHE_VERSION	2
+#define GTK_RC_CACHE_NONE	(~(guint32) 0)
+
+#define GTK_RC_CACHE_FILE_EXISTS (1 << 0)
+#define GTK_RC_CACHE_FILE_RELOAD (1 << 1)
+
+typedef struct _GtkRcCacheHeader GtkRcCacheHeader;
+typedef struct _GtkRcCacheBuffer GtkRcCacheBuffer;
+typedef struct _GtkRcCacheReader GtkRcCacheReader;
+
+struct _GtkRcCacheHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint32 n_names;
+  guint32 n_files;
+  guint32 n_pixmap_paths;
+  guint32 n_module_paths;
+  guint32 n_styles;
+  guint32 n_paths;
+  guint32 n_words;
+  guint32 strings_size;
+};
+
+struct _GtkRcCacheBuffer
+{
+  guint8 *data;
+  guint32 len;
+  guint32 alloc;
+};
+
+struct _GtkRcCacheReader
+{
+  const guint32 *words;
+  guint32 n_words;
+  guint32 pos;
+  const gchar *strings;
+  guint32 strings_size;
+  gboolean failed;
+};
+
+static gchar *
+gtk_rc_cache_get_file (GSList *names)
+{
+  const gchar *env;
+  gchar *home;
+  guint hash;
+
+  /* Only the initial parse of the default files is cached
+   */
+  if (rc_files || rc_style_ht || gtk_rc_sets_widget ||
+      gtk_rc_sets_widget_class || gtk_rc_sets_class)
+    return NULL;
+
+  env = getenv ("GTK_RC_CACHE");
+  if (env)
+    return env[0] ? g_strdup (env) : NULL;
+
+  home = g_get_home_dir ();
+  if (!home)
+    return NULL;
+
+  hash = 0;
+  for (; names; names = names->next)
+    hash = (hash << 5) - hash + g_str_hash (names->data);
+
+  return g_strdup_printf ("%s/.gtk-rc-cache/%08x", home, hash);
+}
+
+static void
+gtk_rc_cache_buffer_append (GtkRcCacheBuffer *buffer,
+			    gconstpointer     data,
+			    guint32           len)
+{
+  if (buffer->len + len > buffer->alloc)
+    {
+      buffer->alloc = MAX (buffer->alloc * 2, buffer->len + len);
+      buffer->alloc = MAX (buffer->alloc, 1024);
+      buffer->data = g_realloc (buffer->data, buffer->alloc);
+    }
+  memcpy (buffer->data + buffer->len, data, len);
+  buffer->len += len;
+}
+
+static void
+gtk_rc_cache_put_word (GtkRcCacheBuffer *words,
+		       guint32           word)
+{
+  gtk_rc_cache_buffer_append (words, &word, sizeof (word));
+}
+
+static void
+gtk_rc_cache_put_string (GtkRcCacheBuffer *words,
+			 GtkRcCacheBuffer *strings,
+			 const gchar      *string)
+{
+  if (!string)
+    gtk_rc_cache_put_word (words, GTK_RC_CACHE_NONE);
+  else
+    {
+      gtk_rc_cache_put_word (words, strings->len);
+      gtk_rc_cache_buffer_append (strings, string, strlen (string) + 1);
+    }
+}
+
+static void
+gtk_rc_cache_put_color (GtkRcCacheBuffer *words,
+			GdkColor         *color)
+{
+  gtk_rc_cache_put_word (words, color->pixel);
+  gtk_rc_cache_put_word (words, color->red);
+  gtk_rc_cache_put_word (words, color->green);
+  gtk_rc_cache_put_word (words, color->blue);
+}
+
+static void
+gtk_rc_cache_collect_style (gpointer key,
+			    gpointer value,
+			    gpointer user_data)
+{
+  GSList **styles = user_data;
+
+  *styles = g_slist_prepend (*styles, value);
+}
+
+static gboolean
+gtk_rc_cache_write (gint         fd,
+		    gconstpointer data,
+		    guint32      len)
+{
+  const guint8 *p = data;
+
+  while (len > 0)
+    {
+      gint count = write (fd, p, len);
+
+      if (count < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return FALSE;
+	}
+      p += count;
+      len -= count;
+    }
+
+  return TRUE;
+}
+
+static void
+gtk_rc_cache_save (const gchar *cache_file,
+		   GSList      *names)
+{
+  GtkRcCacheHeader header;
+  GtkRcCacheBuffer words = { NULL, 0, 0 };
+  GtkRcCacheBuffer strings = { NULL, 0, 0 };
+  GSList *styles = NULL;
+  GSList *slist;
+  gboolean cachable = TRUE;
+  gchar *dir, *tmp_name;
+  gint fd, i;
+
+  if (rc_style_ht)
+    g_hash_table_foreach (rc_style_ht, gtk_rc_cache_collect_style, &styles);
+  for (slist = styles; slist; slist = slist->next)
+    if (((GtkRcStyle*) slist->data)->engine)
+      cachable = FALSE;
+
+  /* Relative names of included files depend on the current directory
+   */
+  for (slist = rc_files; slist; slist = slist->next)
+    if (((GtkRcFile*) slist->data)->name[0] != '/')
+      cachable = FALSE;
+
+  if (!cachable)
+    {
+      GTK_NOTE (MISC, g_message ("rc cache: rc files cannot be cached"));
+      goto out;
+    }
+
+  memset (&header, 0, sizeof (header));
+  header.magic = GTK_RC_CACHE_MAGIC;
+  header.version = GTK_RC_CACHE_VERSION;
+
+  for (slist = names; slist; slist = slist->next)
+    {
+      gtk_rc_cache_put_string (&words, &strings, slist->data);
+      header.n_names++;
+    }
+
+  for (slist = rc_files; slist; slist = slist->next)
+    {
+      GtkRcFile *rc_file = slist->data;
+      struct stat statbuf;
+      guint32 flags = 0;
+
+      if (!stat (rc_file->name, &statbuf))
+	flags |= GTK_RC_CACHE_FILE_EXISTS;
+      if (rc_file->reload)
+	flags |= GTK_RC_CACHE_FILE_RELOAD;
+
+      gtk_rc_cache_put_string (&words, &strings, rc_file->name);
+      gtk_rc_cache_put_word (&words, rc_file->mtime);
+      gtk_rc_cache_put_word (&words, rc_file->mtime_nsec);
+      gtk_rc_cache_put_word (&words, rc_file->size);
+      gtk_rc_cache_put_word (&words, rc_file->ino);
+      gtk_rc_cache_put_word (&words, flags);
+      header.n_files++;
+    }
+
+  for (i = 0; pixmap_path[i]; i++)
+    {
+      gtk_rc_cache_put_string (&words, &strings, pixmap_path[i]);
+      header.n_pixmap_paths++;
+    }
+
+  for (i = 0; module_path[i]; i++)
+    {
+      gtk_rc_cache_put_string (&words, &strings, module_path[i]);
+      header.n_module_paths++;
+    }
+
+  for (slist = styles; slist; slist = slist->next)
+    {
+      GtkRcStyle *rc_style = slist->data;
+
+      gtk_rc_cache_put_string (&words, &strings, rc_style->name);
+      gtk_rc_cache_put_string (&words, &strings, rc_style->font_name);
+      gtk_rc_cache_put_string (&words, &strings, rc_style->fontset_name);
+      for (i = 0; i < 5; i++)
+	gtk_rc_cache_put_string (&words, &strings, rc_style->bg_pixmap_name[i]);
+      for (i = 0; i < 5; i++)
+	{
+	  gtk_rc_cache_put_word (&words, rc_style->color_flags[i]);
+	  gtk_rc_cache_put_color (&words, &rc_style->fg[i]);
+	  gtk_rc_cache_put_color (&words, &rc_style->bg[i]);
+	  gtk_rc_cache_put_color (&words, &rc_style->text[i]);
+	  gtk_rc_cache_put_color (&words, &rc_style->base[i]);
+	}
+      header.n_styles++;
+    }
+
+  /* The path statements, in the order they were parsed
+   */
+  rc_cache_paths = g_slist_reverse (rc_cache_paths);
+  for (slist = rc_cache_paths; slist; slist = slist->next)
+    {
+      GtkRcCachePath *cpath = slist->data;
+
+      gtk_rc_cache_put_string (&words, &strings, cpath->name);
+      gtk_rc_cache_put_string (&words, &strings, cpath->pattern);
+      gtk_rc_cache_put_word (&words, cpath->path_type);
+      gtk_rc_cache_put_word (&words, cpath->priority);
+      gtk_rc_cache_put_word (&words, cpath->is_binding);
+      header.n_paths++;
+    }
+
+  /* So the string table is never empty and always terminated
+   */
+  gtk_rc_cache_buffer_append (&strings, "", 1);
+
+  header.n_words = words.len / sizeof (guint32);
+  header.strings_size = strings.len;
+
+  dir = g_dirname (cache_file);
+  mkdir (dir, 0700);
+  g_free (dir);
+
+  tmp_name = g_strdup_printf ("%s.%d", cache_file, (gint) getpid ());
+  fd = open (tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      GTK_NOTE (MISC, g_message ("rc cache: cannot create \"%s\": %s",
+				 tmp_name, g_strerror (errno)));
+    }
+  else if (!gtk_rc_cache_write (fd, &header, sizeof (header)) ||
+	   !gtk_rc_cache_write (fd, words.data, words.len) ||
+	   !gtk_rc_cache_write (fd, strings.data, strings.len) ||
+	   close (fd) < 0 ||
+	   rename (tmp_name, cache_file) < 0)
+    {
+      GTK_NOTE (MISC, g_message ("rc cache: cannot write \"%s\": %s",
+				 cache_file, g_strerror (errno)));
+      unlink (tmp_name);
+    }
+  else
+    GTK_NOTE (MISC, g_message ("rc cache: wrote \"%s\"", cache_file));
+  g_free (tmp_name);
+
+  g_free (words.data);
+  g_free (strings.data);
+
+ out:
+  g_slist_free (styles);
+
+  for (slist = rc_cache_paths; slist; slist = slist->next)
+    {
+      GtkRcCachePath *cpath = slist->data;
+
+      g_free (cpath->name);
+      g_free (cpath->pattern);
+      g_free (cpath);
+    }
+  g_slist_free (rc_cache_paths);
+  rc_cache_paths = NULL;
+}
+
+static guint32
+gtk_rc_cache_get_word (GtkRcCacheReader *reader)
+{
+  if (reader->pos >= reader->n_words)
+    {
+      reader->failed = TRUE;
+      return 0;
+    }
+
+  return reader->words[reader->pos++];
+}
+
+static const gchar *
+gtk_rc_cache_get_string (GtkRcCacheReader *reader)
+{
+  guint32 offset = gtk_rc_cache_get_word (reader);
+
+  if (offset == GTK_RC_CACHE_NONE)
+    return NULL;
+  if (offset >= reader->strings_size)
+    {
+      reader->failed = TRUE;
+      return NULL;
+    }
+
+  return reader->strings + offset;
+}
+
+static void
+gtk_rc_cache_get_color (GtkRcCacheReader *reader,
+			GdkColor         *color)
+{
+  color->pixel = gtk_rc_cache_get_word (reader);
+  color->red = gtk_rc_cache_get_word (reader);
+  color->green = gtk_rc_cache_get_word (reader);
+  color->blue = gtk_rc_cache_get_word (reader);
+}
+
+/* Reads the records of the cache. Without @apply, this only checks
+ * that the cache is well formed and up to date; with @apply, which is
+ * only done after a successful check, it recreates the parse results.
+ */
+static gboolean
+gtk_rc_cache_read (GtkRcCacheReader       *reader,
+		   const GtkRcCacheHeader *header,
+		   GSList                 *names,
+		   gboolean                apply)
+{
+  GSList *slist = names;
+  const gchar *name;
+  guint32 i, j;
+
+  for (i = 0; i < header->n_names; i++)
+    {
+      name = gtk_rc_cache_get_string (reader);
+      if (!apply && (!slist || !name || strcmp (name, slist->data) != 0))
+	return FALSE;
+      if (slist)
+	slist = slist->next;
+    }
+  if (!apply && slist)
+    return FALSE;
+
+  for (i = 0; i < header->n_files; i++)
+    {
+      GtkRcFile cached;
+      guint32 flags;
+
+      name = gtk_rc_cache_get_string (reader);
+      cached.mtime = gtk_rc_cache_get_word (reader);
+      cached.mtime_nsec = gtk_rc_cache_get_word (reader);
+      cached.size = gtk_rc_cache_get_word (reader);
+      cached.ino = gtk_rc_cache_get_word (reader);
+      flags = gtk_rc_cache_get_word (reader);
+      if (!name || name[0] != '/')
+	return FALSE;
+
+      if (!apply)
+	{
+	  struct stat statbuf;
+	  gboolean exists;
+
+	  exists = !stat (name, &statbuf);
+	  if (exists != ((flags & GTK_RC_CACHE_FILE_EXISTS) != 0) ||
+	      (exists && gtk_rc_file_changed (&cached, &statbuf)))
+	    {
+	      GTK_NOTE (MISC, g_message ("rc cache: \"%s\" changed", name));
+	      return FALSE;
+	    }
+	}
+      else
+	{
+	  GtkRcFile *rc_file;
+
+	  rc_file = g_new (GtkRcFile, 1);
+	  rc_file->name = g_strdup (name);
+	  rc_file->canonical_name = rc_file->name;
+	  rc_file->mtime = cached.mtime;
+	  rc_file->mtime_nsec = cached.mtime_nsec;
+	  rc_file->size = cached.size;
+	  rc_file->ino = cached.ino;
+	  rc_file->reload = (flags & GTK_RC_CACHE_FILE_RELOAD) != 0;
+
+	  rc_files = g_slist_append (rc_files, rc_file);
+	  gtk_rc_watch_file (rc_file);
+	}
+    }
+
+  if (header->n_pixmap_paths >= GTK_RC_MAX_PIXMAP_PATHS ||
+      header->n_module_paths >= GTK_RC_MAX_MODULE_PATHS)
+    return FALSE;
+
+  if (apply)
+    for (i = 0; pixmap_path[i]; i++)
+      {
+	g_free (pixmap_path[i]);
+	pixmap_path[i] = NULL;
+      }
+  for (i = 0; i < header->n_pixmap_paths; i++)
+    {
+      name = gtk_rc_cache_get_string (reader);
+      if (apply)
+	pixmap_path[i] = g_strdup (name);
+    }
+
+  if (apply)
+    for (i = 0; module_path[i]; i++)
+      {
+	g_free (module_path[i]);
+	module_path[i] = NULL;
+      }
+  for (i = 0; i < header->n_module_paths; i++)
+    {
+      name = gtk_rc_cache_get_string (reader);
+      if (apply)
+	module_path[i] = g_strdup (name);
+    }
+
+  for (i = 0; i < header->n_styles; i++)
+    {
+      GtkRcStyle rc_style;
+      const gchar *pixmap_names[5];
+      const gchar *font_name, *fontset_name;
+
+      name = gtk_rc_cache_get_string (reader);
+      font_name = gtk_rc_cache_get_string (reader);
+      fontset_name = gtk_rc_cache_get_string (reader);
+      for (j = 0; j < 5; j++)
+	pixmap_names[j] = gtk_rc_cache_get_string (reader);
+      for (j = 0; j < 5; j++)
+	{
+	  rc_style.color_flags[j] = gtk_rc_cache_get_word (reader);
+	  gtk_rc_cache_get_color (reader, &rc_style.fg[j]);
+	  gtk_rc_cache_get_color (reader, &rc_style.bg[j]);
+	  gtk_rc_cache_get_color (reader, &rc_style.text[j]);
+	  gtk_rc_cache_get_color (reader, &rc_style.base[j]);
+	}
+      if (!name)
+	return FALSE;
+
+      if (apply)
+	{
+	  GtkRcStyle *new_style = gtk_rc_style_new ();
+
+	  new_style->name = g_strdup (name);
+	  new_style->font_name = g_strdup (font_name);
+	  new_style->fontset_name = g_strdup (fontset_name);
+	  for (j = 0; j < 5; j++)
+	    {
+	      new_style->bg_pixmap_name[j] = g_strdup (pixmap_names[j]);
+	      new_style->color_flags[j] = rc_style.color_flags[j];
+	      new_style->fg[j] = rc_style.fg[j];
+	      new_style->bg[j] = rc_style.bg[j];
+	      new_style->text[j] = rc_style.text[j];
+	      new_style->base[j] = rc_style.base[j];
+	    }
+
+	  if (!rc_style_ht)
+	    rc_style_ht = g_hash_table_new ((GHashFunc) gtk_rc_style_hash,
+					    (GCompareFunc) gtk_rc_style_compare);
+	  g_hash_table_insert (rc_style_ht, new_style->name, new_style);
+	}
+    }
+
+  /* Replay the path statements just like gtk_rc_parse_path_pattern()
+   */
+  for (i = 0; i < header->n_paths; i++)
+    {
+      const gchar *pattern;
+      GtkPathType path_type;
+      GtkPathPriorityType priority;
+      gboolean is_binding;
+
+      name = gtk_rc_cache_get_string (reader);
+      pattern = gtk_rc_cache_get_string (reader);
+      path_type = gtk_rc_cache_get_word (reader);
+      priority = gtk_rc_cache_get_word (reader);
+      is_binding = gtk_rc_cache_get_word (reader);
+      if (!name || !pattern ||
+	  (path_type != GTK_PATH_WIDGET &&
+	   path_type != GTK_PATH_WIDGET_CLASS &&
+	   path_type != GTK_PATH_CLASS))
+	return FALSE;
+
+      if (!apply)
+	continue;
+
+      if (is_binding)
+	{
+	  GtkBindingSet *binding;
+
+	  binding = gtk_binding_set_find (name);
+	  if (!binding)
+	    binding = gtk_binding_set_new (name);
+	  gtk_binding_set_add_path (binding, path_type, pattern, priority);
+	}
+      else
+	{
+	  GtkRcStyle *rc_style;
+	  GtkRcSet *rc_set;
+
+	  rc_style = gtk_rc_style_find (name);
+	  if (!rc_style)
+	    continue;
+
+	  rc_set = g_new (GtkRcSet, 1);
+	  gtk_pattern_spec_init (&rc_set->pspec, pattern);
+	  rc_set->rc_style = rc_style;
+
+	  if (path_type == GTK_PATH_WIDGET)
+	    gtk_rc_sets_widget = g_slist_prepend (gtk_rc_sets_widget, rc_set);
+	  else if (path_type == GTK_PATH_WIDGET_CLASS)
+	    gtk_rc_sets_widget_class = g_slist_prepend (gtk_rc_sets_widget_class, rc_set);
+	  else
+	    gtk_rc_sets_class = g_slist_prepend (gtk_rc_sets_class, rc_set);
+	}
+    }
+
+  return !reader->failed && reader->pos == reader->n_words;
+}
+
+static gboolean
+gtk_rc_cache_load (const gchar *cache_file,
+		   GSList      *names)
+{
+  GtkRcCacheHeader *header;
+  GtkRcCacheReader reader;
+  struct stat statbuf;
+  gpointer map;
+  gsize size;
+  gboolean valid;
+  gint fd;
+
+  if (rc_cache_rebuild)
+    return FALSE;
+
+  fd = open (cache_file, O_RDONLY);
+  if (fd < 0)
+    return FALSE;
+  if (fstat (fd, &statbuf) < 0 || statbuf.st_size < sizeof (GtkRcCacheHeader))
+    {
+      close (fd);
+      return FALSE;
+    }
+  size = statbuf.st_size;
+  map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return FALSE;
+
+  header = map;
+  valid = (header->magic == GTK_RC_CACHE_MAGIC &&
+	   header->version == GTK_RC_CACHE_VERSION &&
+	   header->n_words < size / sizeof (guint32) &&
+	   header->strings_size > 0 &&
+	   sizeof (GtkRcCacheHeader) + header->n_words * sizeof (guint32) +
+	   header->strings_size == size);
+  if (valid)
+    {
+      reader.words = (const guint32*) (header + 1);
+      reader.n_words = header->n_words;
+      reader.strings = (const gchar*) (reader.words + reader.n_words);
+      reader.strings_size = header->strings_size;
+      reader.failed = FALSE;
+      reader.pos = 0;
+
+      valid = (reader.strings[reader.strings_size - 1] == '\0' &&
+	       gtk_rc_cache_read (&reader, header, names, FALSE));
+    }
+  if (valid)
+    {
+      reader.pos = 0;
+      gtk_rc_cache_read (&reader, header, names, TRUE);
+    }
+
+  munmap (map, size);
+
+  GTK_NOTE (MISC, g_message ("rc cache: %s \"%s\"",
+			     valid ? "loaded" : "ignoring", cache_file));
+
+  return valid;
+}
+
+void
+gtk_rc_cache_rebuild (void)
+{
+  rc_cache_rebuild = TRUE;
+}
+
 /*
 typedef  GdkPixmap * (*GtkImageLoader) (GdkWindow   *window,
                                         GdkColormap *colormap,
@@ -61,10 +61,19 @@
 
 /* #define DEBUG_SELECTION */
 
-/* Maximum size of a sent chunk, in bytes. Also the default size of
+/* Minimum size of a sent chunk, in bytes. Also the default size of
    our buffers */
 #define GTK_SELECTION_MAX_SIZE 4000
 
+/* Upper bound on the chunk size derived from the server's maximum
+   request size; keeps the property the server has to hold for us
+   reasonably small */
+#define GTK_SELECTION_MAX_CHUNK (1 << 20)
+
+/* Upper bound on the buffer we preallocate from the size announced
+   in an INCR property */
+#define GTK_SELECTION_MAX_PREALLOC (64 << 20)
+
 enum {
   INCR,
   MULTIPLE,
@@ -77,6 +86,7 @@ typedef struct _GtkSelectionInfo GtkSelectionInfo;
 typedef struct _GtkIncrConversion GtkIncrConversion;
 typedef struct _GtkIncrInfo GtkIncrInfo;
 typedef struct _GtkRetrievalInfo GtkRetrievalInfo;
+typedef struct _GtkSelectionStream GtkSelectionStream;
 
 struct _GtkSelectionInfo
 {
@@ -85,11 +95,23 @@ struct _GtkSelectionInfo
   guint32    time;		/* time used to acquire selection */
 };
 
+struct _GtkSelectionStream
+{
+  GtkSelectionData      *selection_data;
+  GtkSelectionStreamFunc func;
+  gpointer               data;
+  GtkDestroyNotify       destroy;
+  gint                   n_pending;	/* Bytes of an incomplete item at
+					 * the start of the chunk buffer */
+};
+
 struct _GtkIncrConversion 
 {
   GdkAtom	    target;	/* Requested target */
   GdkAtom	    property;	/* Property to store in */
-  GtkSelectionData  data;	/* The data being supplied */
+  GtkSelectionData  data;	/* The data being supplied; for streamed
+				 * data, a buffer of one chunk */
+  GtkSelectionStream *stream;	/* Provider of streamed data, or NULL */
   gint		    offset;	/* Current offset in sent selection.
 				 *  -1 => All done
 				 *  -2 => Only the final (empty) portion
@@ -121,6 +143,7 @@ struct _GtkRetrievalInfo
   guint32 idle_time;		/* Number of seconds since we last heard
 				   from selection owner */
   guchar   *buffer;		/* Buffer in which to accumulate results */
+  gint	   buffer_size;		/* Allocated size of buffer */
   gint	   offset;		/* Current offset in buffer, -1 indicates
 				   not yet started */
   guint32 notify_time;		/* Timestamp from SelectionNotify */
@@ -136,18 +159,23 @@ static void gtk_selection_retrieval_report  (GtkRetrievalInfo *info,
 					     guchar           *buffer,
 					     gint              length,
 					     guint32           time);
-static void gtk_selection_invoke_handler    (GtkWidget        *widget,
-					     GtkSelectionData *data,
-					     guint             time);
+static GtkSelectionStream *gtk_selection_invoke_handler (GtkWidget        *widget,
+							 GtkSelectionData *data,
+							 guint             time);
 static void gtk_selection_default_handler   (GtkWidget        *widget,
 					     GtkSelectionData *data);
 static int  gtk_selection_bytes_per_item    (gint              format);
+static gint gtk_selection_chunk_size        (void);
+static void gtk_selection_stream_read_all   (GtkSelectionData   *data,
+					     GtkSelectionStream *stream);
+static void gtk_selection_stream_free       (GtkSelectionStream *stream);
 
 /* Local Data */
 static gint initialize = TRUE;
 static GList *current_retrievals = NULL;
 static GList *current_incrs = NULL;
 static GList *current_selections = NULL;
+static GSList *pending_streams = NULL;	/* Of the handlers being invoked */
 
 static GdkAtom gtk_selection_atoms[LAST_ATOM];
 static const char *gtk_selection_handler_key = "gtk-selection-handlers";
@@ -623,6 +651,7 @@ gtk_selection_convert (GtkWidget *widget,
   info->selection = selection;
   info->target = target;
   info->buffer = NULL;
+  info->buffer_size = 0;
   info->offset = -1;
   
   /* Check if this process has current owner. If so, call handler
@@ -644,9 +673,18 @@ gtk_selection_convert (GtkWidget *widget,
       
       if (owner_widget != NULL)
 	{
-	  gtk_selection_invoke_handler (owner_widget, 
-					&selection_data,
-					time);
+	  GtkSelectionStream *stream;
+
+	  stream = gtk_selection_invoke_handler (owner_widget, 
+						 &selection_data,
+						 time);
+
+	  /* No need to stream within the process; collect it all */
+	  if (stream)
+	    {
+	      gtk_selection_stream_read_all (&selection_data, stream);
+	      gtk_selection_stream_free (stream);
+	    }
 	  
 	  gtk_selection_retrieval_report (info,
 					  selection_data.type, 
@@ -716,6 +754,145 @@ gtk_selection_data_set (GtkSelectionData *selection_data,
   selection_data->length = length;
 }
 
+/*************************************************************
+ * gtk_selection_data_set_stream:
+ *     Like gtk_selection_data_set(), but rather than supplying
+ *     all of the data at once, func is called to produce it
+ *     one chunk at a time while it is being sent, so the data
+ *     never has to be held in memory as a whole. Should _only_
+ *     be called from a selection handler callback.
+ *   arguments:
+ *     type:	    the type of selection data
+ *     format:	    format (number of bits in a unit)
+ *     length_hint: lower bound for the length of the data,
+ *		    announced to the requestor
+ *     func:	    function producing the data
+ *     data:	    user data for func
+ *     destroy:	    called on data once the transfer is over
+ *   results:
+ *************************************************************/
+
+void
+gtk_selection_data_set_stream (GtkSelectionData       *selection_data,
+			       GdkAtom                 type,
+			       gint                    format,
+			       gint                    length_hint,
+			       GtkSelectionStreamFunc  func,
+			       gpointer                data,
+			       GtkDestroyNotify        destroy)
+{
+  GtkSelectionStream *stream;
+
+  g_return_if_fail (selection_data != NULL);
+  g_return_if_fail (func != NULL);
+
+  /* The stream of the innermost handler being invoked */
+  stream = pending_streams ? pending_streams->data : NULL;
+  if (!stream || stream->selection_data != selection_data)
+    {
+      g_warning ("gtk_selection_data_set_stream(): not called from the selection handler");
+      if (destroy)
+	destroy (data);
+      return;
+    }
+
+  gtk_selection_data_set (selection_data, type, format, NULL, 0);
+  g_free (selection_data->data);
+  selection_data->data = NULL;
+  selection_data->length = MAX (length_hint, 0);
+
+  /* Replace a stream set earlier by the same handler */
+  if (stream->func && stream->destroy)
+    stream->destroy (stream->data);
+
+  stream->func = func;
+  stream->data = data;
+  stream->destroy = destroy;
+  stream->n_pending = 0;
+}
+
+static void
+gtk_selection_stream_free (GtkSelectionStream *stream)
+{
+  if (stream->destroy)
+    stream->destroy (stream->data);
+  g_free (stream);
+}
+
+/* Collects all of the streamed data into data->data */
+static void
+gtk_selection_stream_read_all (GtkSelectionData   *data,
+			       GtkSelectionStream *stream)
+{
+  gint chunk_size = gtk_selection_chunk_size ();
+  gint buffer_size;
+  gint length = 0;
+  gint n_bytes;
+
+  buffer_size = MAX (data->length, chunk_size) + 1;
+  data->data = g_malloc (buffer_size);
+
+  do
+    {
+      if (buffer_size - length - 1 < chunk_size)
+	{
+	  if (length > G_MAXINT - chunk_size - 1)
+	    {
+	      g_warning ("gtk_selection_stream_read_all(): selection data too large");
+	      break;
+	    }
+	  buffer_size = MAX (MIN (buffer_size, G_MAXINT / 2) * 2,
+			     length + chunk_size + 1);
+	  data->data = g_realloc (data->data, buffer_size);
+	}
+
+      n_bytes = stream->func (data, data->data + length, chunk_size, stream->data);
+      if (n_bytes > 0)
+	length += n_bytes;
+    }
+  while (n_bytes > 0);
+
+  data->data[length] = 0;
+  data->length = length;
+}
+
+/*************************************************************
+ * gtk_selection_chunk_size:
+ *     Size of the portions in which INCR transfers are sent.
+ *     As large as the server lets a single ChangeProperty
+ *     request be, within GTK_SELECTION_MAX_CHUNK.
+ *   arguments:
+ *   results:
+ *     the chunk size in bytes
+ *************************************************************/
+
+static gint
+gtk_selection_chunk_size (void)
+{
+  static gint chunk_size = 0;
+
+  if (!chunk_size)
+    {
+      glong request_size;
+
+      request_size = XExtendedMaxRequestSize (gdk_display);
+      if (request_size == 0)
+	request_size = XMaxRequestSize (gdk_display);
+
+      /* Request sizes are in 4 byte units; leave room for the
+       * request header, and keep whole items of any format */
+      request_size = MIN (request_size, GTK_SELECTION_MAX_CHUNK / 4);
+      chunk_size = (request_size * 4 - 100) & ~7;
+      chunk_size = MAX (chunk_size, GTK_SELECTION_MAX_SIZE);
+
+#ifdef DEBUG_SELECTION
+      g_message ("Sending INCR in chunks of %d bytes", chunk_size);
+#endif
+    }
+
+  return chunk_size;
+}
+
 /*************************************************************
  * gtk_selection_init:
  *     Initialize local variables
@@ -896,7 +1073,8 @@ gtk_selection_request (GtkWidget *widget,
 		 event->requestor, event->property);
 #endif
       
-      gtk_selection_invoke_handler (widget, &data, event->time);
+      info->conversions[i].stream =
+	gtk_selection_invoke_handler (widget, &data, event->time);
       
       if (data.length < 0)
 	{
@@ -909,13 +1087,18 @@ gtk_selection_request (GtkWidget *widget,
       
       items = data.length / gtk_selection_bytes_per_item (data.format);
       
-      if (data.length > GTK_SELECTION_MAX_SIZE)
+      if (info->conversions[i].stream ||
+	  data.length > gtk_selection_chunk_size ())
 	{
-	  /* Sending via INCR */
+	  /* Sending via INCR; streamed data always is, since we don't
+	     know how much there is going to be */
 	  
 	  info->conversions[i].offset = 0;
 	  info->conversions[i].data = data;
 	  info->num_incrs++;
+
+	  if (info->conversions[i].stream)
+	    info->conversions[i].data.data = g_malloc (gtk_selection_chunk_size ());
 	  
 	  gdk_property_change (info->requestor, 
 			       info->conversions[i].property,
@@ -1054,6 +1237,43 @@ gtk_selection_incr_event (GdkWindow	   *window,
 	      num_bytes = 0;
 	      buffer = NULL;
 	    }
+	  else if (info->conversions[i].stream)
+	    {
+	      GtkSelectionStream *stream = info->conversions[i].stream;
+	      gint chunk_size = gtk_selection_chunk_size ();
+	      gint n_bytes;
+
+	      bytes_per_item = gtk_selection_bytes_per_item (info->conversions[i].data.format);
+	      buffer = info->conversions[i].data.data;
+
+	      /* Only whole items can be sent; read until there is at
+	       * least one, and hold an incomplete item at the end over
+	       * for the next chunk */
+	      num_bytes = stream->n_pending;
+	      do
+		{
+		  n_bytes = stream->func (&info->conversions[i].data,
+					  buffer + num_bytes,
+					  chunk_size - num_bytes,
+					  stream->data);
+		  if (n_bytes > 0)
+		    num_bytes += n_bytes;
+		}
+	      while (n_bytes > 0 && num_bytes < bytes_per_item);
+
+	      stream->n_pending = num_bytes % bytes_per_item;
+	      num_bytes -= stream->n_pending;
+
+	      if (num_bytes > 0)
+		info->conversions[i].offset += num_bytes;
+	      else
+		{
+		  /* End of the stream; this is the final 0-length piece */
+		  if (stream->n_pending)
+		    g_warning ("gtk_selection_incr_event(): streamed selection data ends within an item");
+		  info->conversions[i].offset = -2;
+		}
+	    }
 	  else
 	    {
 	      num_bytes = info->conversions[i].data.length -
@@ -1061,10 +1281,10 @@ gtk_selection_incr_event (GdkWindow	   *window,
 	      buffer = info->conversions[i].data.data + 
 		info->conversions[i].offset;
 	      
-	      if (num_bytes > GTK_SELECTION_MAX_SIZE)
+	      if (num_bytes > gtk_selection_chunk_size ())
 		{
-		  num_bytes = GTK_SELECTION_MAX_SIZE;
-		  info->conversions[i].offset += GTK_SELECTION_MAX_SIZE;
+		  num_bytes = gtk_selection_chunk_size ();
+		  info->conversions[i].offset += num_bytes;
 		}
 	      else
 		info->conversions[i].offset = -2;
@@ -1082,8 +1302,14 @@ gtk_selection_incr_event (GdkWindow	   *window,
 			       GDK_PROP_MODE_REPLACE,
 			       buffer,
 			       num_bytes / bytes_per_item);
+
+	  if (info->conversions[i].stream && num_bytes > 0 &&
+	      info->conversions[i].stream->n_pending)
+	    memmove (buffer, buffer + num_bytes,
+		     info->conversions[i].stream->n_pending);
 	  
-	  if (info->conversions[i].offset == -2)
+	  if (info->conversions[i].offset == -2 &&
+	      !info->conversions[i].stream)
 	    {
 	      g_free (info->conversions[i].data.data);
 	      info->conversions[i].data.data = NULL;
@@ -1091,6 +1317,14 @@ gtk_selection_incr_event (GdkWindow	   *window,
 	  
 	  if (num_bytes == 0)
 	    {
+	      if (info->conversions[i].stream)
+		{
+		  gtk_selection_stream_free (info->conversions[i].stream);
+		  info->conversions[i].stream = NULL;
+		  g_free (info->conversions[i].data.data);
+		  info->conversions[i].data.data = NULL;
+		}
+
 	      info->num_incrs--;
 	      info->conversions[i].offset = -1;
 	    }
@@ -1141,11 +1375,20 @@ gtk_selection_incr_timeout (GtkIncrInfo *info)
   /* If retrieval is finished */
   if (!tmp_list || info->idle_time >= 5)
     {
+      gint i;
+
       if (tmp_list && info->idle_time >= 5)
 	{
 	  current_incrs = g_list_remove_link (current_incrs, tmp_list);
 	  g_list_free (tmp_list);
 	}
+
+      for (i = 0; i < info->num_conversions; i++)
+	if (info->conversions[i].stream)
+	  {
+	    gtk_selection_stream_free (info->conversions[i].stream);
+	    g_free (info->conversions[i].data.data);
+	  }
       
       g_free (info->conversions);
       /* FIXME: we should check if requestor window is still in use,
@@ -1231,6 +1474,21 @@ gtk_selection_notify (GtkWidget	       *widget,
       info->notify_time = event->time;
       info->idle_time = 0;
       info->offset = 0;		/* Mark as OK to proceed */
+
+      /* The INCR property holds a lower bound for the size of the
+	 data; use it to size our buffer up front */
+      if (format == 32 && length > 0)
+	{
+	  glong size_hint = 0;
+
+	  memcpy (&size_hint, buffer, MIN (length, sizeof (glong)));
+	  if (size_hint > 0 && size_hint <= GTK_SELECTION_MAX_PREALLOC)
+	    {
+	      info->buffer_size = size_hint + 1;
+	      info->buffer = g_malloc (info->buffer_size);
+	      info->buffer[0] = 0;
+	    }
+	}
       gdk_window_set_events (widget->window,
 			     gdk_window_get_events (widget->window)
 			     | GDK_PROPERTY_CHANGE_MASK);
@@ -1312,10 +1570,9 @@ gtk_selection_property_notify (GtkWidget	*widget,
 				       &type, &format);
   gdk_property_delete (widget->window, event->atom);
   
-  /* We could do a lot better efficiency-wise by paying attention to
-     what length was sent in the initial INCR transaction, instead of
-     doing memory allocation at every step. But its only guaranteed to
-     be a _lower bound_ (pretty useless!) */
+  /* The buffer was sized from the lower bound sent in the initial
+     INCR transaction, if any; beyond that we grow it geometrically
+     so a large transfer doesn't reallocate at every step */
   
   if (length == 0 || type == GDK_NONE)		/* final zero length portion */
     {
@@ -1337,6 +1594,7 @@ gtk_selection_property_notify (GtkWidget	*widget,
 		     length);
 #endif
 	  info->buffer = new_buffer;
+	  info->buffer_size = length + 1;
 	  info->offset = length;
 	}
       else
@@ -1346,8 +1604,25 @@ gtk_selection_property_notify (GtkWidget	*widget,
 	  g_message ("Appending %d bytes at offset %d",
 		     length,info->offset);
 #endif
+	  if (length > G_MAXINT - 1 - info->offset)
+	    {
+	      /* Too large to hold; give up on the transfer */
+	      g_free (new_buffer);
+	      current_retrievals = g_list_remove_link (current_retrievals, tmp_list);
+	      g_list_free (tmp_list);
+	      gtk_selection_retrieval_report (info, GDK_NONE, 0, NULL, -1,
+					      info->notify_time);
+	      return TRUE;
+	    }
+
+	  if (info->offset + length + 1 > info->buffer_size)
+	    {
+	      info->buffer_size = MAX (MIN (info->buffer_size, G_MAXINT / 2) * 2,
+				       info->offset + length + 1);
+	      info->buffer = g_realloc (info->buffer, info->buffer_size);
+	    }
+	  
 	  /* We copy length+1 bytes to preserve guaranteed null termination */
-	  info->buffer = g_realloc (info->buffer, info->offset+length+1);
 	  memcpy (info->buffer + info->offset, new_buffer, length+1);
 	  info->offset += length;
 	  g_free (new_buffer);
@@ -1454,19 +1729,26 @@ gtk_selection_retrieval_report (GtkRetrievalInfo *info,
  *     time:        time from requeset
  *     
  *   results:
- *     Number of bytes written to buffer, -1 if error
+ *     The stream the handler set up with
+ *     gtk_selection_data_set_stream(), or NULL
  *************************************************************/
 
-static void
+static GtkSelectionStream *
 gtk_selection_invoke_handler (GtkWidget	       *widget,
 			      GtkSelectionData *data,
 			      guint             time)
 {
+  GtkSelectionStream *stream;
   GtkTargetList *target_list;
   guint info;
   
 
-  g_return_if_fail (widget != NULL);
+  g_return_val_if_fail (widget != NULL, NULL);
+
+  /* Somewhere for the handler to attach a stream to, while it runs */
+  stream = g_new0 (GtkSelectionStream, 1);
+  stream->selection_data = data;
+  pending_streams = g_slist_prepend (pending_streams, stream);
 
   target_list = gtk_selection_target_list_get (widget, data->selection);
   if (target_list && 
@@ -1479,6 +1761,17 @@ gtk_selection_invoke_handler (GtkWidget	       *widget,
     }
   else
     gtk_selection_default_handler (widget, data);
+
+  pending_streams = g_slist_remove (pending_streams, stream);
+  stream->selection_data = NULL;
+
+  if (!stream->func)
+    {
+      g_free (stream);
+      return NULL;
+    }
+
+  return stream;
 }
 
 /*************************************************************
@@ -1428,6 +1428,9 @@ gtk_signal_real_emit (GtkObject *object,
 	}
     }
   
+  GDK_TRACE_BEGIN ("signal", signal.name,
+		   gtk_type_name (GTK_OBJECT_TYPE (object)));
+  
   gtk_object_ref (object);
   
   gtk_emission_add (&current_emissions, object, signal_id);
@@ -1533,6 +1536,8 @@ gtk_signal_real_emit (GtkObject *object,
   gtk_emission_remove (&current_emissions, object, signal_id);
   
   gtk_object_unref (object);
+  
+  GDK_TRACE_END ();
 }
 
 guint
@@ -177,8 +177,7 @@ gtk_socket_steal (GtkSocket *socket, guint32 id)
   gdk_window_hide (socket->plug_window);
   gdk_window_reparent (socket->plug_window, widget->window, 0, 0);
 
-  gdk_flush ();
-  gdk_error_trap_pop ();
+  gdk_error_trap_pop_async (NULL, NULL);
   
   socket->need_map = TRUE;
 }
@@ -358,8 +357,7 @@ gtk_socket_size_allocate (GtkWidget     *widget,
 	      socket->need_map = FALSE;
 	    }
 
-	  gdk_flush ();
-	  gdk_error_trap_pop ();
+	  gdk_error_trap_pop_async (NULL, NULL);
 	}
     }
 }
@@ -377,8 +375,7 @@ gtk_socket_focus_in_event (GtkWidget *widget, GdkEventFocus *event)
       XSetInputFocus (GDK_DISPLAY (),
 		      GDK_WINDOW_XWINDOW (socket->plug_window),
 		      RevertToParent, GDK_CURRENT_TIME);
-      gdk_flush();
-      gdk_error_trap_pop ();
+      gdk_error_trap_pop_async (NULL, NULL);
     }
   
   return TRUE;
@@ -427,8 +424,7 @@ gtk_socket_claim_focus (GtkSocket *socket)
       XSetInputFocus (GDK_DISPLAY (),
 		      GDK_WINDOW_XWINDOW (socket->plug_window),
 		      RevertToParent, GDK_CURRENT_TIME);
-      gdk_flush ();
-      gdk_error_trap_pop ();
+      gdk_error_trap_pop_async (NULL, NULL);
     }
 }
 
@@ -489,8 +485,7 @@ gtk_socket_focus (GtkContainer *container, GtkDirectionType direction)
       XSendEvent (gdk_display,
 		  GDK_WINDOW_XWINDOW (socket->plug_window),
 		  False, NoEventMask, &xevent);
-      gdk_flush();
-      gdk_error_trap_pop ();
+      gdk_error_trap_pop_async (NULL, NULL);
       
       return TRUE;
     }
@@ -526,8 +521,7 @@ gtk_socket_send_configure_event (GtkSocket *socket)
   XSendEvent (gdk_display,
 	      GDK_WINDOW_XWINDOW (socket->plug_window),
 	      False, NoEventMask, &event);
-  gdk_flush ();
-  gdk_error_trap_pop ();
+  gdk_error_trap_pop_async (NULL, NULL);
 }
 
 static void
@@ -555,8 +549,7 @@ gtk_socket_add_window (GtkSocket *socket, guint32 xid)
       if (gdk_drag_get_protocol (xid, &protocol))
 	gtk_drag_dest_set_proxy (GTK_WIDGET (socket), socket->plug_window, 
 				 protocol, TRUE);
-      gdk_flush ();
-      gdk_error_trap_pop ();
+      gdk_error_trap_pop_async (NULL, NULL);
 
       gdk_window_add_filter (socket->plug_window, 
 			     gtk_socket_filter_func, socket);
@@ -603,8 +596,7 @@ gtk_socket_filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 				   0, 0,
 				   widget->allocation.width, 
 				   widget->allocation.height);
-	    gdk_flush ();
-	    gdk_error_trap_pop ();
+	    gdk_error_trap_pop_async (NULL, NULL);
 	
 	    socket->request_width = xcwe->width;
 	    socket->request_height = xcwe->height;
@@ -723,8 +715,7 @@ gtk_socket_filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 
 	  gdk_error_trap_push ();
 	  gdk_window_show (socket->plug_window);
-	  gdk_flush ();
-	  gdk_error_trap_pop ();
+	  gdk_error_trap_pop_async (NULL, NULL);
 
 	  return_val = GDK_FILTER_REMOVE;
 	}
@@ -746,8 +737,7 @@ gtk_socket_filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 		gtk_drag_dest_set_proxy (GTK_WIDGET (socket),
 					 socket->plug_window,
 					 protocol, TRUE);
-	      gdk_flush ();
-	      gdk_error_trap_pop ();
+	      gdk_error_trap_pop_async (NULL, NULL);
 	    }
 	  return_val = GDK_FILTER_REMOVE;
 	}
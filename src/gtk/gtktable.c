@@ -25,6 +25,7 @@
  */
 
 #include "gtktable.h"
+#include "gtkchildindex.h"
 
 enum
 {
@@ -252,16 +253,10 @@ gtk_table_set_child_arg (GtkContainer   *container,
   GList *list;
 
   table = GTK_TABLE (container);
-  table_child = NULL;
-  for (list = table->children; list; list = list->next)
-    {
-      table_child = list->data;
-
-      if (table_child->widget == child)
-	break;
-    }
+  list = gtk_child_index_find (GTK_WIDGET (table), table->children, child);
   if (!list)
     return;
+  table_child = list->data;
 
   switch (arg_id)
     {
@@ -333,16 +328,10 @@ gtk_table_get_child_arg (GtkContainer   *container,
   GList *list;
 
   table = GTK_TABLE (container);
-  table_child = NULL;
-  for (list = table->children; list; list = list->next)
-    {
-      table_child = list->data;
-
-      if (table_child->widget == child)
-	break;
-    }
+  list = gtk_child_index_find (GTK_WIDGET (table), table->children, child);
   if (!list)
     return;
+  table_child = list->data;
 
   switch (arg_id)
     {
@@ -533,6 +522,7 @@ gtk_table_attach (GtkTable	  *table,
   table_child->ypadding = ypadding;
   
   table->children = g_list_prepend (table->children, table_child);
+  gtk_child_index_add (GTK_WIDGET (table), table->children);
   
   gtk_widget_set_parent (child, GTK_WIDGET (table));
   
@@ -718,62 +708,54 @@ gtk_table_unmap (GtkWidget *widget)
 }
 
 static void
-gtk_table_draw (GtkWidget    *widget,
-		GdkRectangle *area)
+gtk_table_draw_child (gpointer data,
+		      gpointer user_data)
 {
-  GtkTable *table;
-  GtkTableChild *child;
-  GList *children;
+  GtkTableChild *child = data;
+  GdkRectangle *area = user_data;
   GdkRectangle child_area;
   
+  if (gtk_widget_intersect (child->widget, area, &child_area))
+    gtk_widget_draw (child->widget, &child_area);
+}
+
+static void
+gtk_table_draw (GtkWidget    *widget,
+		GdkRectangle *area)
+{
   g_return_if_fail (widget != NULL);
   g_return_if_fail (GTK_IS_TABLE (widget));
   
   if (GTK_WIDGET_VISIBLE (widget) && GTK_WIDGET_MAPPED (widget))
-    {
-      table = GTK_TABLE (widget);
-      
-      children = table->children;
-      while (children)
-	{
-	  child = children->data;
-	  children = children->next;
-	  
-	  if (gtk_widget_intersect (child->widget, area, &child_area))
-	    gtk_widget_draw (child->widget, &child_area);
-	}
-    }
+    gtk_child_index_foreach (widget, GTK_TABLE (widget)->children, area,
+			     gtk_table_draw_child, area);
+}
+
+static void
+gtk_table_expose_child (gpointer data,
+			gpointer user_data)
+{
+  GtkTableChild *child = data;
+  GdkEventExpose *event = user_data;
+  GdkEventExpose child_event;
+  
+  child_event = *event;
+  
+  if (GTK_WIDGET_NO_WINDOW (child->widget) &&
+      gtk_widget_intersect (child->widget, &event->area, &child_event.area))
+    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
 }
 
 static gint
 gtk_table_expose (GtkWidget	 *widget,
 		  GdkEventExpose *event)
 {
-  GtkTable *table;
-  GtkTableChild *child;
-  GList *children;
-  GdkEventExpose child_event;
-  
   g_return_val_if_fail (widget != NULL, FALSE);
   g_return_val_if_fail (GTK_IS_TABLE (widget), FALSE);
   
   if (GTK_WIDGET_VISIBLE (widget) && GTK_WIDGET_MAPPED (widget))
-    {
-      table = GTK_TABLE (widget);
-      
-      child_event = *event;
-      
-      children = table->children;
-      while (children)
-	{
-	  child = children->data;
-	  children = children->next;
-	  
-	  if (GTK_WIDGET_NO_WINDOW (child->widget) &&
-	      gtk_widget_intersect (child->widget, &event->area, &child_event.area))
-	    gtk_widget_event (child->widget, (GdkEvent*) &child_event);
-	}
-    }
+    gtk_child_index_foreach (widget, GTK_TABLE (widget)->children, &event->area,
+			     gtk_table_expose_child, event);
   
   return FALSE;
 }
@@ -856,26 +838,22 @@ gtk_table_remove (GtkContainer *container,
   g_return_if_fail (widget != NULL);
   
   table = GTK_TABLE (container);
-  children = table->children;
+  children = gtk_child_index_find (GTK_WIDGET (table), table->children, widget);
   
-  while (children)
+  if (children)
     {
+      gboolean was_visible = GTK_WIDGET_VISIBLE (widget);
+      
       child = children->data;
-      children = children->next;
+      gtk_widget_unparent (widget);
       
-      if (child->widget == widget)
-	{
-	  gboolean was_visible = GTK_WIDGET_VISIBLE (widget);
-	  
-	  gtk_widget_unparent (widget);
-	  
-	  table->children = g_list_remove (table->children, child);
-	  g_free (child);
-	  
-	  if (was_visible && GTK_WIDGET_VISIBLE (container))
-	    gtk_widget_queue_resize (GTK_WIDGET (container));
-	  break;
-	}
+      gtk_child_index_remove (GTK_WIDGET (table), widget);
+      table->children = g_list_remove_link (table->children, children);
+      g_list_free (children);
+      g_free (child);
+      
+      if (was_visible && GTK_WIDGET_VISIBLE (container))
+	gtk_widget_queue_resize (GTK_WIDGET (container));
     }
 }
 
@@ -50,6 +50,7 @@
 #define SCROLL_TIME              100
 #define FREEZE_LENGTH            1024        
 /* Freeze text when inserting or deleting more than this many characters */
+#define LINE_INDEX_CHUNK         32768       /* Characters measured per idle */
 
 #define SET_PROPERTY_MARK(m, p, o)  do {                   \
                                       (m)->property = (p); \
@@ -114,6 +115,7 @@ typedef struct _PrevTabCont           PrevTabCont;
 typedef struct _FetchLinesData        FetchLinesData;
 typedef struct _LineParams            LineParams;
 typedef struct _SetVerticalScrollData SetVerticalScrollData;
+typedef struct _LineIndex             LineIndex;
 
 typedef gint (*LineIteratorFunction) (GtkText* text, LineParams* lp, void* data);
 
@@ -130,6 +132,33 @@ struct _SetVerticalScrollData {
   GtkPropertyMark mark;
 };
 
+/* The height in pixels of every logical line, wrapped, and its length
+ * in characters (including the delimiter), with Fenwick trees over
+ * both so that the line at a given pixel or index, and the position
+ * of a line, are found in O(log n). Lines that changed and haven't
+ * been measured yet carry an estimate and are flagged dirty; an idle
+ * handler measures them a chunk at a time.
+ */
+struct _LineIndex
+{
+  guint n_lines;
+  guint n_alloc;
+  gint *chars;
+  gint *heights;
+  guint8 *dirty;
+  gint *chars_tree;		/* 1-based */
+  gint *heights_tree;
+  guint n_dirty;
+  guint scan;			/* Where the idle handler continues */
+  guint idle_id;
+
+  /* What the heights were measured for */
+  gint wrap_width;
+  GdkFont *font;
+  guint line_wrap : 1;
+  guint word_wrap : 1;
+};
+
 struct _GtkTextFont
 {
   /* The actual font. */
@@ -309,6 +338,7 @@ static LineParams find_line_params (GtkText* text,
 				    PrevTabCont *next_cont);
 static void find_word_wrap_position (GtkText* text, LineParams *lp);
 static CharClass char_class (GtkText* text, guint index);
+static void fetch_visible_lines (GtkText* text, GtkPropertyMark start_mark);
 static void recompute_geometry (GtkText* text);
 static void insert_expose (GtkText* text, guint old_pixels, gint nchars, guint new_line_count);
 static void delete_expose (GtkText* text,
@@ -341,6 +371,7 @@ static void adjust_adj  (GtkText* text, GtkAdjustment* adj);
 static void scroll_up   (GtkText* text, gint diff);
 static void scroll_down (GtkText* text, gint diff);
 static void scroll_int  (GtkText* text, gint diff);
+static void scroll_jump (GtkText* text, gint diff);
 
 static void process_exposes (GtkText *text);
 
@@ -348,6 +379,13 @@ static void process_exposes (GtkText *text);
 static void   free_cache        (GtkText* text);
 static GList* remove_cache_line (GtkText* text, GList* list);
 
+/* Line Index. */
+static LineIndex* line_index_get    (GtkText* text);
+static void       line_index_free   (GtkText* text);
+static void       line_index_insert (GtkText* text, guint index, guint nchars);
+static void       line_index_delete (GtkText* text, guint index, guint nchars);
+static guint      line_index_find_pixel (GtkText* text, LineIndex* li, gint y);
+
 /* Key Motion. */
 static void move_cursor_buffer_ver (GtkText *text, int dir);
 static void move_cursor_page_ver (GtkText *text, int dir);
@@ -716,6 +754,7 @@ gtk_text_init (GtkText *text)
   text->tab_stops = g_list_prepend (text->tab_stops, (void*)8);
   
   text->line_start_cache = NULL;
+  text->line_index = NULL;
   text->first_cut_pixels = 0;
   
   text->line_wrap = TRUE;
@@ -1039,6 +1078,8 @@ gtk_text_insert (GtkText    *text,
    
       text->gap_size -= numwcs;
       text->gap_position += numwcs;
+      
+      line_index_insert (text, text->point.index, numwcs);
    
       if (text->point.index < text->first_line_start_index)
  	text->first_line_start_index += numwcs;
@@ -1135,6 +1176,8 @@ gtk_text_forward_delete (GtkText *text,
     move_mark_n (&text->cursor_mark, 
 		 -MIN(nchars, text->cursor_mark.index - text->point.index));
   
+  line_index_delete (text, text->point.index, nchars);
+  
   move_gap (text, text->point.index);
   
   text->gap_size += nchars;
@@ -1511,6 +1554,7 @@ gtk_text_unrealize (GtkWidget *widget)
   unrealize_properties (text);
 
   free_cache (text);
+  line_index_free (text);
 
   if (GTK_WIDGET_CLASS (parent_class)->unrealize)
     (* GTK_WIDGET_CLASS (parent_class)->unrealize) (widget);
@@ -2339,12 +2383,17 @@ gtk_text_adjustment (GtkAdjustment *adjustment,
   else
     {
       gint diff = ((gint)adjustment->value) - text->last_ver_value;
+      gint height;
+      
+      gdk_window_get_size (text->text_area, NULL, &height);
       
       if (diff != 0)
 	{
 	  undraw_cursor (text, FALSE);
 	  
-	  if (diff > 0)
+	  if (ABS (diff) > height)
+	    scroll_jump (text, diff);
+	  else if (diff > 0)
 	    scroll_down (text, diff);
 	  else /* if (diff < 0) */
 	    scroll_up (text, diff);
@@ -3896,6 +3945,614 @@ find_mouse_cursor (GtkText* text, gint x, gint y)
     }
 }
 
+/**********************************************************************/
+/*			      Line Index                              */
+/**********************************************************************/
+
+static void
+fenwick_add (gint *tree, guint n, guint i, gint delta)
+{
+  for (i++; i <= n; i += i & -i)
+    tree[i] += delta;
+}
+
+/* Sum of the first I values */
+static gint
+fenwick_sum (const gint *tree, guint i)
+{
+  gint sum = 0;
+  
+  for (; i > 0; i -= i & -i)
+    sum += tree[i];
+  
+  return sum;
+}
+
+/* The largest I such that the first I values add up to at most
+ * TARGET, which for non-negative values is the entry TARGET falls in.
+ */
+static guint
+fenwick_find (const gint *tree, guint n, gint target)
+{
+  guint pos = 0;
+  guint step = 1;
+  
+  while (step * 2 <= n)
+    step *= 2;
+  
+  for (; step > 0; step /= 2)
+    if (pos + step <= n && tree[pos + step] <= target)
+      {
+	pos += step;
+	target -= tree[pos];
+      }
+  
+  return MIN (pos, n - 1);
+}
+
+static void
+fenwick_build (gint *tree, const gint *values, guint n)
+{
+  guint i, j;
+  
+  for (i = 1; i <= n; i++)
+    tree[i] = values[i - 1];
+  
+  for (i = 1; i <= n; i++)
+    {
+      j = i + (i & -i);
+      if (j <= n)
+	tree[j] += tree[i];
+    }
+}
+
+/* Makes VALUES[N - 1] part of the tree, which covers N - 1 values */
+static void
+fenwick_append (gint *tree, const gint *values, guint n)
+{
+  tree[n] = values[n - 1] + fenwick_sum (tree, n - 1) - fenwick_sum (tree, n - (n & -n));
+}
+
+/* Index of the next line delimiter in [INDEX, END), or END */
+static guint
+line_index_next_delim (GtkText *text, guint index, guint end)
+{
+  if (text->use_wchar)
+    {
+      while (index < end && GTK_TEXT_INDEX (text, index) != LINE_DELIM)
+	index++;
+    }
+  else
+    {
+      while (index < end)
+	{
+	  guint offset = index < text->gap_position ? 0 : text->gap_size;
+	  guint seg_end = index < text->gap_position ? MIN (end, text->gap_position) : end;
+	  guchar *seg = text->text.ch + offset;
+	  guchar *delim = memchr (seg + index, LINE_DELIM, seg_end - index);
+	  
+	  if (delim)
+	    return delim - seg;
+	  index = seg_end;
+	}
+    }
+  
+  return index;
+}
+
+static gint
+line_index_wrap_width (GtkText *text)
+{
+  gint width;
+  
+  gdk_window_get_size (text->text_area, &width, NULL);
+  if (GTK_EDITABLE (text)->editable || !text->word_wrap)
+    width -= LINE_WRAP_ROOM;
+  
+  return MAX (width, 1);
+}
+
+/* A guess at the height of a line of CHARS characters, in the
+ * default font.
+ */
+static gint
+line_index_estimate (GtkText *text, LineIndex *li, gint chars)
+{
+  gint rows = 1;
+  
+  if (li->line_wrap && text->current_font)
+    rows += (chars * text->current_font->char_widths['n']) / li->wrap_width;
+  
+  return rows * FONT_HEIGHT (GTK_WIDGET (text)->style->font);
+}
+
+static gint
+line_index_idle (gpointer data);
+
+static void
+line_index_set_dirty (GtkText *text, LineIndex *li, guint line)
+{
+  if (!li->dirty[line])
+    {
+      li->dirty[line] = TRUE;
+      li->n_dirty++;
+    }
+  
+  if (!li->idle_id)
+    li->idle_id = gtk_idle_add_priority (G_PRIORITY_LOW, line_index_idle, text);
+}
+
+static void
+line_index_set_height (LineIndex *li, guint line, gint height)
+{
+  fenwick_add (li->heights_tree, li->n_lines, line, height - li->heights[line]);
+  li->heights[line] = height;
+  
+  if (li->dirty[line])
+    {
+      li->dirty[line] = FALSE;
+      li->n_dirty--;
+    }
+}
+
+static void
+line_index_resize (LineIndex *li, guint n_lines)
+{
+  if (n_lines <= li->n_alloc)
+    return;
+  
+  li->n_alloc = MAX (n_lines, li->n_alloc * 2);
+  li->chars = g_renew (gint, li->chars, li->n_alloc);
+  li->heights = g_renew (gint, li->heights, li->n_alloc);
+  li->dirty = g_renew (guint8, li->dirty, li->n_alloc);
+  li->chars_tree = g_renew (gint, li->chars_tree, li->n_alloc + 1);
+  li->heights_tree = g_renew (gint, li->heights_tree, li->n_alloc + 1);
+}
+
+/* Replaces N_REMOVE lines starting at FIRST with N_INSERT unmeasured
+ * lines of the given lengths. Changes at the end, such as appending
+ * to a log, leave the trees in place; anything else rebuilds them.
+ */
+static void
+line_index_splice (GtkText   *text,
+		   LineIndex *li,
+		   guint      first,
+		   guint      n_remove,
+		   const gint *chars,
+		   guint      n_insert)
+{
+  guint n_lines = li->n_lines - n_remove + n_insert;
+  guint i;
+  
+  for (i = first; i < first + n_remove; i++)
+    if (li->dirty[i])
+      li->n_dirty--;
+  
+  line_index_resize (li, n_lines);
+  
+  if (first + n_remove == li->n_lines)
+    {
+      /* Tree nodes only cover entries before them */
+      for (i = 0; i < n_insert; i++)
+	{
+	  li->n_lines = first + i + 1;
+	  li->chars[first + i] = chars[i];
+	  li->heights[first + i] = line_index_estimate (text, li, chars[i]);
+	  li->dirty[first + i] = FALSE;
+	  fenwick_append (li->chars_tree, li->chars, li->n_lines);
+	  fenwick_append (li->heights_tree, li->heights, li->n_lines);
+	}
+      li->n_lines = n_lines;
+    }
+  else
+    {
+      g_memmove (li->chars + first + n_insert, li->chars + first + n_remove,
+		 (li->n_lines - first - n_remove) * sizeof (gint));
+      g_memmove (li->heights + first + n_insert, li->heights + first + n_remove,
+		 (li->n_lines - first - n_remove) * sizeof (gint));
+      g_memmove (li->dirty + first + n_insert, li->dirty + first + n_remove,
+		 (li->n_lines - first - n_remove) * sizeof (guint8));
+      
+      for (i = 0; i < n_insert; i++)
+	{
+	  li->chars[first + i] = chars[i];
+	  li->heights[first + i] = line_index_estimate (text, li, chars[i]);
+	  li->dirty[first + i] = FALSE;
+	}
+      
+      li->n_lines = n_lines;
+      fenwick_build (li->chars_tree, li->chars, n_lines);
+      fenwick_build (li->heights_tree, li->heights, n_lines);
+    }
+  
+  for (i = first; i < first + n_insert; i++)
+    line_index_set_dirty (text, li, i);
+}
+
+/* Guesses all heights again, after something that changes them all */
+static void
+line_index_invalidate (GtkText *text, LineIndex *li)
+{
+  guint i;
+  
+  li->wrap_width = line_index_wrap_width (text);
+  li->font = GTK_WIDGET (text)->style->font;
+  li->line_wrap = text->line_wrap;
+  li->word_wrap = text->word_wrap;
+  
+  for (i = 0; i < li->n_lines; i++)
+    {
+      li->heights[i] = line_index_estimate (text, li, li->chars[i]);
+      li->dirty[i] = FALSE;
+      line_index_set_dirty (text, li, i);
+    }
+  
+  fenwick_build (li->heights_tree, li->heights, li->n_lines);
+  li->scan = 0;
+}
+
+/* Returns the index, building it on first use and guessing the
+ * heights again if the wrap width or default font changed.
+ */
+static LineIndex*
+line_index_get (GtkText *text)
+{
+  LineIndex *li = text->line_index;
+  guint length = TEXT_LENGTH (text);
+  guint index, delim;
+  
+  if (!li)
+    {
+      GArray *chars = g_array_new (FALSE, FALSE, sizeof (gint));
+      gint n;
+      
+      li = g_new0 (LineIndex, 1);
+      text->line_index = li;
+      
+      for (index = 0; ; index = delim + 1)
+	{
+	  delim = line_index_next_delim (text, index, length);
+	  n = MIN (delim + 1, length) - index;
+	  g_array_append_val (chars, n);
+	  if (delim == length)
+	    break;
+	}
+      
+      line_index_resize (li, chars->len);
+      li->n_lines = chars->len;
+      memcpy (li->chars, chars->data, chars->len * sizeof (gint));
+      fenwick_build (li->chars_tree, li->chars, li->n_lines);
+      g_array_free (chars, TRUE);
+      
+      line_index_invalidate (text, li);
+    }
+  else if (li->font != GTK_WIDGET (text)->style->font ||
+	   li->line_wrap != text->line_wrap ||
+	   li->word_wrap != text->word_wrap ||
+	   (text->line_wrap && li->wrap_width != line_index_wrap_width (text)))
+    line_index_invalidate (text, li);
+  else if (li->n_dirty > 0 && !li->idle_id)
+    li->idle_id = gtk_idle_add_priority (G_PRIORITY_LOW, line_index_idle, text);
+  
+  return li;
+}
+
+static void
+line_index_free (GtkText *text)
+{
+  LineIndex *li = text->line_index;
+  
+  if (!li)
+    return;
+  
+  if (li->idle_id)
+    gtk_idle_remove (li->idle_id);
+  
+  g_free (li->chars);
+  g_free (li->heights);
+  g_free (li->dirty);
+  g_free (li->chars_tree);
+  g_free (li->heights_tree);
+  g_free (li);
+  
+  text->line_index = NULL;
+}
+
+static guint
+line_index_find_char (LineIndex *li, guint index)
+{
+  return fenwick_find (li->chars_tree, li->n_lines, index);
+}
+
+static guint
+line_index_line_start (LineIndex *li, guint line)
+{
+  return fenwick_sum (li->chars_tree, line);
+}
+
+static gint
+line_index_line_top (LineIndex *li, guint line)
+{
+  return fenwick_sum (li->heights_tree, line);
+}
+
+static gint
+line_index_total_height (LineIndex *li)
+{
+  return fenwick_sum (li->heights_tree, li->n_lines);
+}
+
+static gint
+line_index_measure_iterator (GtkText* text, LineParams* lp, void* data)
+{
+  SetVerticalScrollData *svdata = (SetVerticalScrollData *) data;
+  
+  svdata->pixel_height += LINE_HEIGHT (*lp);
+  svdata->mark = lp->end;
+  
+  return !text->line_wrap || !lp->wraps;
+}
+
+/* Measures LINE, which starts at MARK, and moves MARK to the start of
+ * the next line.
+ */
+static void
+line_index_measure (GtkText         *text,
+		    LineIndex       *li,
+		    guint            line,
+		    GtkPropertyMark *mark)
+{
+  SetVerticalScrollData data;
+  
+  data.pixel_height = 0;
+  line_params_iterate (text, mark, NULL, FALSE, &data, line_index_measure_iterator);
+  
+  line_index_set_height (li, line, data.pixel_height);
+  
+  *mark = data.mark;
+  if (!LAST_INDEX (text, *mark))
+    advance_mark (mark);
+}
+
+/* Measures the dirty lines from the one containing INDEX on, until
+ * HEIGHT pixels are known exactly.
+ */
+static void
+line_index_measure_range (GtkText   *text,
+			  LineIndex *li,
+			  guint      index,
+			  gint       height)
+{
+  GtkPropertyMark mark;
+  gboolean have_mark = FALSE;
+  guint line;
+  
+  for (line = line_index_find_char (li, index);
+       line < li->n_lines && height > 0;
+       line++)
+    {
+      if (li->dirty[line])
+	{
+	  if (!have_mark)
+	    mark = find_mark (text, line_index_line_start (li, line));
+	  line_index_measure (text, li, line, &mark);
+	  have_mark = TRUE;
+	}
+      else
+	have_mark = FALSE;
+      
+      height -= li->heights[line];
+    }
+}
+
+/* Returns the line containing pixel Y, measuring it if needed */
+static guint
+line_index_find_pixel (GtkText *text, LineIndex *li, gint y)
+{
+  GtkPropertyMark mark;
+  guint line;
+  
+  for (;;)
+    {
+      line = fenwick_find (li->heights_tree, li->n_lines, y);
+      if (!li->dirty[line])
+	return line;
+      
+      mark = find_mark (text, line_index_line_start (li, line));
+      line_index_measure (text, li, line, &mark);
+    }
+}
+
+/* Called after NCHARS characters were inserted at INDEX */
+static void
+line_index_insert (GtkText *text, guint index, guint nchars)
+{
+  LineIndex *li = text->line_index;
+  GArray *chars;
+  guint line, offset, end, delim;
+  gint n;
+  
+  if (!li || !nchars)
+    return;
+  
+  line = line_index_find_char (li, index);
+  offset = index - line_index_line_start (li, line);
+  end = index + nchars;
+  
+  delim = line_index_next_delim (text, index, end);
+  if (delim == end)
+    {
+      li->chars[line] += nchars;
+      fenwick_add (li->chars_tree, li->n_lines, line, nchars);
+      line_index_set_dirty (text, li, line);
+      return;
+    }
+  
+  /* The line is split at each delimiter inserted */
+  chars = g_array_new (FALSE, FALSE, sizeof (gint));
+  n = offset + delim + 1 - index;
+  g_array_append_val (chars, n);
+  
+  for (index = delim + 1; ; index = delim + 1)
+    {
+      delim = line_index_next_delim (text, index, end);
+      if (delim == end)
+	break;
+      n = delim + 1 - index;
+      g_array_append_val (chars, n);
+    }
+  
+  n = end - index + li->chars[line] - offset;
+  g_array_append_val (chars, n);
+  
+  line_index_splice (text, li, line, 1, (gint *) chars->data, chars->len);
+  g_array_free (chars, TRUE);
+}
+
+/* Called before NCHARS characters at INDEX are deleted */
+static void
+line_index_delete (GtkText *text, guint index, guint nchars)
+{
+  LineIndex *li = text->line_index;
+  guint first, last;
+  gint n;
+  
+  if (!li || !nchars)
+    return;
+  
+  first = line_index_find_char (li, index);
+  last = line_index_find_char (li, index + nchars);
+  
+  if (first == last)
+    {
+      li->chars[first] -= nchars;
+      fenwick_add (li->chars_tree, li->n_lines, first, - (gint) nchars);
+      line_index_set_dirty (text, li, first);
+    }
+  else
+    {
+      /* Everything from FIRST to LAST becomes one line */
+      n = (line_index_line_start (li, last) + li->chars[last] -
+	   line_index_line_start (li, first) - nchars);
+      line_index_splice (text, li, first, last - first + 1, &n, 1);
+    }
+}
+
+/* Pixel offset of the display line starting at INDEX */
+static gint
+line_index_pixel_of (GtkText *text, LineIndex *li, guint index)
+{
+  GtkPropertyMark mark;
+  LineParams lp;
+  PrevTabCont tab_conts[2];
+  gint tab_cont_index = 0;
+  guint line;
+  gint pixels;
+  
+  line = line_index_find_char (li, index);
+  mark = find_mark (text, line_index_line_start (li, line));
+  pixels = line_index_line_top (li, line);
+  
+  init_tab_cont (text, tab_conts);
+  
+  while (mark.index < index)
+    {
+      lp = find_line_params (text, &mark, tab_conts + tab_cont_index,
+			     tab_conts + (tab_cont_index + 1) % 2);
+      if (lp.end.index >= index || LAST_INDEX (text, lp.end))
+	break;
+      
+      pixels += LINE_HEIGHT (lp);
+      mark = lp.end;
+      advance_mark (&mark);
+      tab_cont_index = (tab_cont_index + 1) % 2;
+    }
+  
+  return pixels;
+}
+
+/* Once everything is measured, puts the adjustment where the index
+ * says the top of the screen is.
+ */
+static void
+line_index_sync_adjustment (GtkText *text)
+{
+  LineIndex *li = text->line_index;
+  gint value, upper;
+  
+  if (text->freeze_count || !text->line_start_cache)
+    return;
+  
+  value = (line_index_pixel_of (text, li, text->first_line_start_index) +
+	   text->first_cut_pixels);
+  upper = line_index_total_height (li);
+  
+  if (value == (gint) text->vadj->value && upper == (gint) text->vadj->upper)
+    return;
+  
+  text->vadj->upper = upper;
+  text->vadj->value = value;
+  text->first_onscreen_ver_pixel = value;
+  text->last_ver_value = value;
+  
+  adjust_adj (text, text->vadj);
+}
+
+static gint
+line_index_idle (gpointer data)
+{
+  GtkText *text;
+  LineIndex *li;
+  GtkPropertyMark mark;
+  gboolean have_mark = FALSE;
+  gint budget = LINE_INDEX_CHUNK;
+  gint return_val;
+  
+  GDK_THREADS_ENTER ();
+  
+  text = GTK_TEXT (data);
+  li = text->line_index;
+  
+  if (text->freeze_count)
+    budget = 0;
+  
+  while (li->n_dirty > 0 && budget > 0)
+    {
+      if (li->scan >= li->n_lines)
+	{
+	  li->scan = 0;
+	  have_mark = FALSE;
+	}
+      
+      if (li->dirty[li->scan])
+	{
+	  if (!have_mark)
+	    mark = find_mark (text, line_index_line_start (li, li->scan));
+	  line_index_measure (text, li, li->scan, &mark);
+	  have_mark = TRUE;
+	  budget -= li->chars[li->scan];
+	}
+      else
+	have_mark = FALSE;
+      
+      li->scan++;
+    }
+  
+  if (li->n_dirty > 0 && !text->freeze_count)
+    return_val = TRUE;
+  else
+    {
+      li->idle_id = 0;
+      if (li->n_dirty == 0)
+	line_index_sync_adjustment (text);
+      return_val = FALSE;
+    }
+  
+  GDK_THREADS_LEAVE ();
+  
+  return return_val;
+}
+
 /**********************************************************************/
 /*			    Cache Manager                             */
 /**********************************************************************/
@@ -4412,11 +5069,13 @@ set_vertical_scroll_iterator (GtkText* text, LineParams* lp, void* data)
 	}
       
       text->vadj->value = (float) text->first_onscreen_ver_pixel;
+      
+      return TRUE;
     }
   
   svdata->pixel_height += LINE_HEIGHT (*lp);
   
-  return FALSE;
+  return !text->line_wrap || !lp->wraps;
 }
 
 static gint
@@ -4425,12 +5084,17 @@ set_vertical_scroll_find_iterator (GtkText* text, LineParams* lp, void* data)
   SetVerticalScrollData *svdata = (SetVerticalScrollData *) data;
   gint return_val;
   
-  if (svdata->pixel_height <= (gint) text->vadj->value &&
-      svdata->pixel_height + LINE_HEIGHT(*lp) > (gint) text->vadj->value)
+  /* The line was measured, so the value falls inside it; stopping at
+   * its end just guards against rounding.
+   */
+  if ((svdata->pixel_height <= (gint) text->vadj->value &&
+       svdata->pixel_height + LINE_HEIGHT(*lp) > (gint) text->vadj->value) ||
+      !text->line_wrap || !lp->wraps)
     {
       svdata->mark = lp->start;
       
-      text->first_cut_pixels = (gint)text->vadj->value - svdata->pixel_height;
+      text->first_cut_pixels = CLAMP ((gint)text->vadj->value - svdata->pixel_height,
+				      0, (gint) LINE_HEIGHT(*lp) - 1);
       text->first_onscreen_ver_pixel = svdata->pixel_height;
       text->first_line_start_index = lp->start.index;
       
@@ -4446,26 +5110,60 @@ set_vertical_scroll_find_iterator (GtkText* text, LineParams* lp, void* data)
   return return_val;
 }
 
+/* Puts the line at the adjustment's value first on screen, and
+ * returns its start.
+ */
+static GtkPropertyMark
+set_vertical_scroll_to_value (GtkText* text)
+{
+  LineIndex *li = line_index_get (text);
+  GtkPropertyMark mark;
+  SetVerticalScrollData data;
+  guint line;
+  
+  line = line_index_find_pixel (text, li, (gint) text->vadj->value);
+  mark = find_mark (text, line_index_line_start (li, line));
+  
+  data.pixel_height = line_index_line_top (li, line);
+  data.last_didnt_wrap = TRUE;
+  data.mark = mark;
+  
+  line_params_iterate (text, &mark, NULL,
+		       FALSE, &data,
+		       set_vertical_scroll_find_iterator);
+  
+  return data.mark;
+}
+
 static GtkPropertyMark
 set_vertical_scroll (GtkText* text)
 {
-  GtkPropertyMark mark = find_mark (text, 0);
+  LineIndex *li = line_index_get (text);
+  GtkPropertyMark mark;
   SetVerticalScrollData data;
   gint height;
   gint orig_value;
+  guint line;
 
-  data.pixel_height = 0;
-  data.mark.index = 0;
-  data.mark.offset = 0;
-  data.mark.property = 0;
+  gdk_window_get_size (text->text_area, NULL, &height);
+  
+  /* What is on screen is measured exactly; the rest of the buffer may
+   * still be estimated, and is fixed up from an idle.
+   */
+  line_index_measure_range (text, li, text->first_line_start_index,
+			    text->first_cut_pixels + height);
+  
+  line = line_index_find_char (li, text->first_line_start_index);
+  mark = find_mark (text, line_index_line_start (li, line));
+  
+  data.pixel_height = line_index_line_top (li, line);
+  data.mark = mark;
 
   line_params_iterate (text, &mark, NULL, FALSE, &data, set_vertical_scroll_iterator);
   
-  text->vadj->upper = (float) data.pixel_height;
+  text->vadj->upper = (float) line_index_total_height (li);
   orig_value = (gint) text->vadj->value;
   
-  gdk_window_get_size (text->text_area, NULL, &height);
-  
   text->vadj->step_increment = MIN (text->vadj->upper, (float) SCROLL_PIXELS);
   text->vadj->page_increment = MIN (text->vadj->upper, height - (float) KEY_SCROLL_PIXELS);
   text->vadj->page_size      = MIN (text->vadj->upper, height);
@@ -4479,12 +5177,7 @@ set_vertical_scroll (GtkText* text)
   if (text->vadj->value != orig_value)
     {
       /* We got clipped, and don't really know which line to put first. */
-      data.pixel_height = 0;
-      data.last_didnt_wrap = TRUE;
-      
-      line_params_iterate (text, &mark, NULL,
-			   FALSE, &data,
-			   set_vertical_scroll_find_iterator);
+      data.mark = set_vertical_scroll_to_value (text);
     }
 
   return data.mark;
@@ -4549,6 +5242,38 @@ static gint first_visible_line_height (GtkText* text)
     return 1;
 }
 
+/* Scrolling by more than a screenful starts over at the new
+ * position instead of walking every line in between.
+ */
+static void
+scroll_jump (GtkText* text, gint diff)
+{
+  GdkRectangle rect;
+  gint width, height;
+  
+  free_cache (text);
+  text->current_line = NULL;
+  
+  fetch_visible_lines (text, set_vertical_scroll_to_value (text));
+  
+  gdk_window_get_size (text->text_area, &width, &height);
+  rect.x      = 0;
+  rect.y      = 0;
+  rect.width  = width;
+  rect.height = height;
+  
+  expose_text (text, &rect, FALSE);
+  gtk_text_draw_focus ( (GtkWidget *) text);
+  
+  /* The cursor was on the old screen, so drag it along */
+  if (diff > 0)
+    find_mouse_cursor (text, text->cursor_pos_x,
+		       first_visible_line_height (text));
+  else
+    find_mouse_cursor (text, text->cursor_pos_x,
+		       last_visible_line_height (text));
+}
+
 static void
 scroll_down (GtkText* text, gint diff0)
 {
@@ -5455,16 +6180,12 @@ gtk_text_update_text    (GtkEditable       *editable,
 }
 
 static void
-recompute_geometry (GtkText* text)
+fetch_visible_lines (GtkText* text, GtkPropertyMark start_mark)
 {
-  GtkPropertyMark mark, start_mark;
+  GtkPropertyMark mark = start_mark;
   GList *new_lines;
   gint height;
   gint width;
-  
-  free_cache (text);
-  
-  mark = start_mark = set_vertical_scroll (text);
 
   /* We need a real start of a line when calling fetch_lines().
    * not the start of a wrapped line.
@@ -5505,6 +6226,14 @@ recompute_geometry (GtkText* text)
     new_lines = new_lines->next;
   
   text->line_start_cache = new_lines;
+}
+
+static void
+recompute_geometry (GtkText* text)
+{
+  free_cache (text);
+  
+  fetch_visible_lines (text, set_vertical_scroll (text));
   
   find_cursor (text, TRUE);
 }
@@ -43,6 +43,11 @@ struct _GtkTypeNode
   gpointer klass;
   GList *children_types;
   GMemChunk *mem_chunk;
+
+  /* instance allocation statistics */
+  guint n_instances;
+  guint n_peak_instances;
+  guint n_allocations;
 };
 
 #define	LOOKUP_TYPE_NODE(node_var, type)	{ \
@@ -65,6 +70,17 @@ struct _GtkTypeNode
 static void  gtk_type_class_init		(GtkType      node_type);
 static void  gtk_type_init_builtin_types	(void);
 
+/* Instances of types without a memory chunk of their own come from
+ * memory chunks shared by all types in the same size class, which
+ * keeps objects of similar size together instead of fragmenting the
+ * heap. Larger instances are malloced.
+ */
+#define	SIZE_CLASS_STEP		(16)
+#define	SIZE_CLASS_MAX		(1024)
+#define	SIZE_CLASS_AREA_SIZE	(8192)
+
+static GMemChunk *size_class_chunks[SIZE_CLASS_MAX / SIZE_CLASS_STEP];
+
 static GtkTypeNode *type_nodes = NULL;
 static guint	    n_type_nodes = 0;
 static guint	    n_ftype_nodes = 0;
@@ -215,6 +231,9 @@ gtk_type_create (GtkType      parent_type,
   new_node->klass = NULL;
   new_node->children_types = NULL;
   new_node->mem_chunk = NULL;
+  new_node->n_instances = 0;
+  new_node->n_peak_instances = 0;
+  new_node->n_allocations = 0;
   
   if (parent)
     parent->children_types = g_list_append (parent->children_types, GUINT_TO_POINTER (new_node->type));
@@ -346,11 +365,38 @@ gtk_type_class (GtkType type)
   return node->klass;
 }
 
+static GMemChunk*
+gtk_type_node_get_chunk (GtkTypeNode *node)
+{
+  guint size;
+  guint i;
+
+  if (node->mem_chunk)
+    return node->mem_chunk;
+
+  size = node->type_info.object_size;
+  if (size == 0 || size > SIZE_CLASS_MAX)
+    return NULL;
+
+  i = (size - 1) / SIZE_CLASS_STEP;
+  if (!size_class_chunks[i])
+    {
+      size = (i + 1) * SIZE_CLASS_STEP;
+      size_class_chunks[i] = g_mem_chunk_new ("GtkType size class mem chunks",
+					      size,
+					      MAX (SIZE_CLASS_AREA_SIZE, size * 8),
+					      G_ALLOC_AND_FREE);
+    }
+
+  return size_class_chunks[i];
+}
+
 gpointer
 gtk_type_new (GtkType type)
 {
   GtkTypeNode *node;
   GtkTypeObject *tobject;
+  GMemChunk *mem_chunk;
   gpointer klass;
   
   LOOKUP_TYPE_NODE (node, type);
@@ -364,10 +410,16 @@ gtk_type_new (GtkType type)
     }
   node->chunk_alloc_locked = TRUE;
 
-  if (node->mem_chunk)
-    tobject = g_mem_chunk_alloc0 (node->mem_chunk);
+  mem_chunk = gtk_type_node_get_chunk (node);
+  if (mem_chunk)
+    tobject = g_mem_chunk_alloc0 (mem_chunk);
   else
     tobject = g_malloc0 (node->type_info.object_size);
+
+  node->n_allocations++;
+  node->n_instances++;
+  if (node->n_instances > node->n_peak_instances)
+    node->n_peak_instances = node->n_instances;
   
   /* we need to call the base classes' object_init_func for derived
    * objects with the object's ->klass field still pointing to the
@@ -408,15 +460,19 @@ gtk_type_free (GtkType	    type,
 	       gpointer	    mem)
 {
   GtkTypeNode *node;
+  GMemChunk *mem_chunk;
   
   g_return_if_fail (mem != NULL);
   LOOKUP_TYPE_NODE (node, type);
   g_return_if_fail (node != NULL);
   
-  if (node->mem_chunk)
-    g_mem_chunk_free (node->mem_chunk, mem);
+  mem_chunk = gtk_type_node_get_chunk (node);
+  if (mem_chunk)
+    g_mem_chunk_free (mem_chunk, mem);
   else
     g_free (mem);
+
+  node->n_instances--;
 }
 
 GList*
@@ -496,6 +552,29 @@ gtk_type_describe_tree (GtkType	 type,
     }
 }
 
+void
+gtk_type_describe_allocations (GtkType type)
+{
+  GtkTypeNode *node;
+  GList *list;
+  
+  LOOKUP_TYPE_NODE (node, type);
+  if (!node)
+    return;
+
+  if (node->n_allocations)
+    g_message ("%s: %u live, %u peak, %u allocated (%u bytes%s)",
+	       node->type_info.type_name ? node->type_info.type_name : "<unnamed type>",
+	       node->n_instances,
+	       node->n_peak_instances,
+	       node->n_allocations,
+	       node->type_info.object_size,
+	       gtk_type_node_get_chunk (node) ? "" : ", malloced");
+
+  for (list = node->children_types; list; list = list->next)
+    gtk_type_describe_allocations (GPOINTER_TO_UINT (list->data));
+}
+
 gboolean
 gtk_type_is_a (GtkType type,
 	       GtkType is_a_type)
@@ -897,6 +976,9 @@ gtk_type_query (GtkType type)
       query->type_name = node->type_info.type_name;
       query->object_size = node->type_info.object_size;
       query->class_size = node->type_info.class_size;
+      query->n_instances = node->n_instances;
+      query->n_peak_instances = node->n_peak_instances;
+      query->n_allocations = node->n_allocations;
 
       return query;
     }
@@ -34,6 +34,7 @@
 #include "gtkwidget.h"
 #include "gtkwindow.h"
 #include "gtkbindings.h"
+#include "gtkchildindex.h"
 #include "gtkprivate.h"
 #include "gdk/gdk.h"
 #include "gdk/gdkx.h"
@@ -200,6 +201,10 @@ static GSList *style_stack = NULL;
 static guint   composite_child_stack = 0;
 static GSList *gtk_widget_redraw_queue = NULL;
 
+/* Widgets gtk_widget_update_rc_styles() still has to look at */
+static GSList *gtk_widget_rc_update_queue = NULL;
+static guint   gtk_widget_rc_update_idle_id = 0;
+
 static const gchar *aux_info_key = "gtk-aux-info";
 static guint        aux_info_key_id = 0;
 static const gchar *event_key = "gtk-event-mask";
@@ -2066,6 +2071,8 @@ gtk_widget_idle_draw (gpointer cb_data)
     draw_data_tmp_key_id = g_quark_from_static_string (draw_data_tmp_key);
       
   GDK_THREADS_ENTER ();
+  GDK_TRACE_BEGIN ("paint", "idle_draw", NULL);
+  gdk_draw_batch_begin ();
 
   old_queue = gtk_widget_redraw_queue;
   gtk_widget_redraw_queue = NULL;
@@ -2273,6 +2280,8 @@ gtk_widget_idle_draw (gpointer cb_data)
 
   g_slist_free (old_queue);
 
+  gdk_draw_batch_end ();
+  GDK_TRACE_END ();
   GDK_THREADS_LEAVE ();
   
   return FALSE;
@@ -2390,6 +2399,8 @@ gtk_widget_size_request (GtkWidget	*widget,
     g_warning ("gtk_widget_size_request() called on child widget with request equal\n to widget->requisition. gtk_widget_set_usize() may not work properly.");
 #endif /* G_ENABLE_DEBUG */
 
+  GDK_TRACE_BEGIN ("layout", "size_request",
+		   gtk_type_name (GTK_OBJECT_TYPE (widget)));
   gtk_widget_ref (widget);
   gtk_widget_ensure_style (widget);
   gtk_signal_emit (GTK_OBJECT (widget), widget_signals[SIZE_REQUEST],
@@ -2399,6 +2410,7 @@ gtk_widget_size_request (GtkWidget	*widget,
     gtk_widget_get_child_requisition (widget, requisition);
 
   gtk_widget_unref (widget);
+  GDK_TRACE_END ();
 }
 
 /*****************************************
@@ -2493,7 +2505,13 @@ gtk_widget_size_allocate (GtkWidget	*widget,
   if (GTK_IS_RESIZE_CONTAINER (widget))
     gtk_container_clear_resize_widgets (GTK_CONTAINER (widget));
 
+  GDK_TRACE_BEGIN ("layout", "size_allocate",
+		   gtk_type_name (GTK_OBJECT_TYPE (widget)));
   gtk_signal_emit (GTK_OBJECT (widget), widget_signals[SIZE_ALLOCATE], &real_allocation);
+  GDK_TRACE_END ();
+
+  if (widget->parent && GTK_WIDGET_HAS_CHILD_INDEX (widget->parent))
+    gtk_child_index_invalidate (widget->parent);
 
   if (needs_draw)
     {
@@ -3608,6 +3626,102 @@ gtk_widget_reset_rc_styles (GtkWidget *widget)
   gtk_widget_set_style_recurse (widget, NULL);
 }
 
+/* Whether gtk_widget_set_rc_style() would give @widget another style.
+ * A realized widget may have an attached copy of its style.
+ */
+static gboolean
+gtk_widget_rc_style_changed (GtkWidget *widget)
+{
+  GtkStyle *saved_style = NULL;
+  GtkStyle *new_style;
+
+  if (saved_default_style_key_id)
+    saved_style = gtk_object_get_data_by_id (GTK_OBJECT (widget), saved_default_style_key_id);
+  new_style = gtk_rc_get_style (widget);
+
+  if (!new_style)
+    return saved_style != NULL;
+  else if (!saved_style)
+    return TRUE;
+  else
+    return (new_style != widget->style &&
+	    !g_slist_find (new_style->styles, widget->style));
+}
+
+static void
+gtk_widget_rc_update_push (GtkWidget *widget,
+			   gpointer   client_data)
+{
+  gtk_widget_ref (widget);
+  gtk_widget_rc_update_queue = g_slist_prepend (gtk_widget_rc_update_queue, widget);
+}
+
+#define RC_UPDATE_BATCH 64
+
+static gint
+gtk_widget_rc_update_idle (gpointer data)
+{
+  guint n_checked = 0;
+  guint n_restyled = 0;
+  gboolean more;
+
+  GDK_THREADS_ENTER ();
+  GDK_TRACE_BEGIN ("style", "rc_update", NULL);
+
+  /* Each batch ends after a few restyled widgets, so their resizes
+   * and redraws happen before the next batch.
+   */
+  while (gtk_widget_rc_update_queue &&
+	 n_restyled < RC_UPDATE_BATCH &&
+	 n_checked < RC_UPDATE_BATCH * 16)
+    {
+      GSList *tmp = gtk_widget_rc_update_queue;
+      GtkWidget *widget = tmp->data;
+
+      gtk_widget_rc_update_queue = tmp->next;
+      g_slist_free_1 (tmp);
+
+      if (!GTK_OBJECT_DESTROYED (widget))
+	{
+	  if (GTK_WIDGET_RC_STYLE (widget) &&
+	      gtk_widget_rc_style_changed (widget))
+	    {
+	      gtk_widget_set_rc_style (widget);
+	      n_restyled++;
+	    }
+
+	  if (GTK_IS_CONTAINER (widget))
+	    gtk_container_forall (GTK_CONTAINER (widget),
+				  gtk_widget_rc_update_push,
+				  NULL);
+	}
+
+      gtk_widget_unref (widget);
+      n_checked++;
+    }
+
+  more = gtk_widget_rc_update_queue != NULL;
+  if (!more)
+    gtk_widget_rc_update_idle_id = 0;
+
+  GDK_TRACE_END ();
+  GDK_THREADS_LEAVE ();
+
+  return more;
+}
+
+void
+gtk_widget_update_rc_styles (GtkWidget *widget)
+{
+  g_return_if_fail (widget != NULL);
+  g_return_if_fail (GTK_IS_WIDGET (widget));
+
+  gtk_widget_rc_update_push (widget, NULL);
+
+  if (!gtk_widget_rc_update_idle_id)
+    gtk_widget_rc_update_idle_id = gtk_idle_add (gtk_widget_rc_update_idle, NULL);
+}
+
 void
 gtk_widget_set_default_style (GtkStyle *style)
 {
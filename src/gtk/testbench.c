@@ -0,0 +1,777 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/* Benchmarks for the widget and GDK hot paths. Normally run through the
+ * gtk-bench target, which starts a private Xvfb server:
+ *
+ *   testbench [--warmup=N] [--repeat=N] [--filter=STRING]
+ *             [--max-size=N] [--data-dir=DIR] [--list]
+ *
+ * Each benchmark prints one line of JSON with the time taken per run,
+ * and the X requests and round trips made per run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtk.h"
+#include "gdk/gdkx.h"
+#include "gdk/gdkprivate.h"
+
+#ifndef GTK_BENCH_DATA_DIR
+#define GTK_BENCH_DATA_DIR "."
+#endif
+
+#define TEXT_LINE_LENGTH 80
+#define SCROLL_STEPS	 100
+#define RESIZE_STEPS	 100
+
+typedef struct _Bench Bench;
+typedef struct _BenchWindow BenchWindow;
+
+struct _Bench
+{
+  const gchar *name;
+  gint	       size;
+  gpointer   (*setup)	 (gint	   size);
+  void	     (*prepare)	 (gpointer data,
+			  gint	   size);	/* Not timed */
+  void	     (*run)	 (gpointer data,
+			  gint	   size);
+  void	     (*teardown) (gpointer data);
+};
+
+struct _BenchWindow
+{
+  GtkWidget *window;
+  GtkWidget *widget;
+  GtkAdjustment *vadjustment;
+  gchar *text;
+  gint flag;
+};
+
+static gint bench_warmup = 1;
+static gint bench_repeat = 5;
+static gint bench_max_size = G_MAXINT;
+static gchar *bench_filter = NULL;
+static gchar *bench_data_dir = GTK_BENCH_DATA_DIR;
+static gchar bench_visual[64];
+static guint32 bench_seed = 1;
+
+/* A fixed pseudo random sequence, so that every run sorts the same data. */
+static guint32
+bench_random (void)
+{
+  bench_seed = bench_seed * 1103515245 + 12345;
+  return (bench_seed >> 16) & 0x7fff;
+}
+
+/* Handle everything which has been queued, including the redraws, and
+ * wait for the X server to catch up, so that its time is counted.
+ */
+static void
+bench_flush (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  gdk_flush ();
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static BenchWindow*
+bench_window_new (GtkWidget *widget,
+		  gboolean   scrolled)
+{
+  BenchWindow *bw;
+  GtkWidget *scrolled_window;
+
+  bw = g_new0 (BenchWindow, 1);
+  bw->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_set_usize (bw->window, 640, 480);
+  bw->widget = widget;
+
+  if (scrolled)
+    {
+      scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+      gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window),
+				      GTK_POLICY_AUTOMATIC,
+				      GTK_POLICY_ALWAYS);
+      gtk_container_add (GTK_CONTAINER (bw->window), scrolled_window);
+      gtk_container_add (GTK_CONTAINER (scrolled_window), widget);
+      bw->vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scrolled_window));
+    }
+  else
+    gtk_container_add (GTK_CONTAINER (bw->window), widget);
+
+  gtk_widget_show_all (bw->window);
+  bench_flush ();
+
+  return bw;
+}
+
+static void
+bench_window_free (gpointer data)
+{
+  BenchWindow *bw = data;
+
+  gtk_widget_destroy (bw->window);
+  g_free (bw->text);
+  g_free (bw);
+  bench_flush ();
+}
+
+static void
+bench_scroll (BenchWindow *bw)
+{
+  GtkAdjustment *adj = bw->vadjustment;
+  gfloat upper;
+  gint i;
+
+  upper = adj->upper - adj->page_size;
+  for (i = 0; i <= SCROLL_STEPS; i++)
+    {
+      gtk_adjustment_set_value (adj, upper * i / SCROLL_STEPS);
+      bench_flush ();
+    }
+  gtk_adjustment_set_value (adj, 0);
+  bench_flush ();
+}
+
+/* CList */
+
+static void
+clist_fill (BenchWindow *bw,
+	    gint	 size)
+{
+  GtkCList *clist = GTK_CLIST (bw->widget);
+  gchar buffers[3][16];
+  gchar *text[3];
+  gint i;
+
+  bench_seed = 1;
+  text[0] = buffers[0];
+  text[1] = buffers[1];
+  text[2] = buffers[2];
+
+  gtk_clist_freeze (clist);
+  gtk_clist_clear (clist);
+  for (i = 0; i < size; i++)
+    {
+      sprintf (buffers[0], "Row %d", i);
+      sprintf (buffers[1], "%05u", bench_random ());
+      sprintf (buffers[2], "%c%c%c", 'a' + bench_random () % 26,
+	       'a' + bench_random () % 26, 'a' + bench_random () % 26);
+      gtk_clist_append (clist, text);
+    }
+  gtk_clist_thaw (clist);
+}
+
+static gpointer
+clist_setup (gint size)
+{
+  return bench_window_new (gtk_clist_new (3), TRUE);
+}
+
+static gpointer
+clist_setup_filled (gint size)
+{
+  BenchWindow *bw = clist_setup (size);
+
+  clist_fill (bw, size);
+  bench_flush ();
+
+  return bw;
+}
+
+static void
+clist_run_fill (gpointer data,
+		gint	 size)
+{
+  clist_fill (data, size);
+  bench_flush ();
+}
+
+static void
+clist_run_scroll (gpointer data,
+		  gint	   size)
+{
+  bench_scroll (data);
+}
+
+static void
+clist_run_sort (gpointer data,
+		gint	 size)
+{
+  BenchWindow *bw = data;
+  GtkCList *clist = GTK_CLIST (bw->widget);
+
+  /* Alternate the direction, so that every run has to reorder the rows. */
+  bw->flag = !bw->flag;
+  gtk_clist_set_sort_column (clist, 1);
+  gtk_clist_set_sort_type (clist, bw->flag ? GTK_SORT_ASCENDING
+			   : GTK_SORT_DESCENDING);
+  gtk_clist_sort (clist);
+  bench_flush ();
+}
+
+/* GtkText */
+
+static gpointer
+text_setup (gint size)
+{
+  BenchWindow *bw;
+  gint i;
+
+  bw = bench_window_new (gtk_text_new (NULL, NULL), TRUE);
+  bw->vadjustment = GTK_TEXT (bw->widget)->vadj;
+
+  bw->text = g_malloc (size + 1);
+  for (i = 0; i < size; i++)
+    bw->text[i] = (i % TEXT_LINE_LENGTH == TEXT_LINE_LENGTH - 1) ? '\n'
+      : 'a' + i % 26;
+  bw->text[size] = '\0';
+
+  return bw;
+}
+
+static void
+text_fill (BenchWindow *bw,
+	   gint		size)
+{
+  GtkText *text = GTK_TEXT (bw->widget);
+  gint i;
+
+  gtk_text_freeze (text);
+  gtk_editable_delete_text (GTK_EDITABLE (text), 0, -1);
+  gtk_text_set_point (text, 0);
+  for (i = 0; i < size; i += TEXT_LINE_LENGTH)
+    gtk_text_insert (text, NULL, NULL, NULL, bw->text + i,
+		     MIN (TEXT_LINE_LENGTH, size - i));
+  gtk_text_thaw (text);
+}
+
+static gpointer
+text_setup_filled (gint size)
+{
+  BenchWindow *bw = text_setup (size);
+
+  text_fill (bw, size);
+  bench_flush ();
+
+  return bw;
+}
+
+static void
+text_run_insert (gpointer data,
+		 gint	  size)
+{
+  text_fill (data, size);
+  bench_flush ();
+}
+
+static void
+text_prepare_delete (gpointer data,
+		     gint     size)
+{
+  text_fill (data, size);
+  bench_flush ();
+}
+
+/* Deletes the text a line at a time from the middle, without freezing. */
+static void
+text_run_delete (gpointer data,
+		 gint	  size)
+{
+  BenchWindow *bw = data;
+  GtkText *text = GTK_TEXT (bw->widget);
+  gint length, position;
+
+  while ((length = gtk_text_get_length (text)) > 0)
+    {
+      position = (length / 2) / TEXT_LINE_LENGTH * TEXT_LINE_LENGTH;
+      gtk_editable_delete_text (GTK_EDITABLE (text), position,
+				MIN (length, position + TEXT_LINE_LENGTH));
+    }
+  bench_flush ();
+}
+
+static void
+text_run_scroll (gpointer data,
+		 gint	  size)
+{
+  bench_scroll (data);
+}
+
+/* Signals */
+
+static void
+signal_handler (GtkObject *object,
+		gpointer   data)
+{
+  (* (gint *) data)++;
+}
+
+static gpointer
+signal_setup (gint size)
+{
+  GtkObject *object;
+
+  object = gtk_adjustment_new (0, 0, 1, 1, 1, 1);
+  gtk_object_ref (object);
+  gtk_object_sink (object);
+
+  return object;
+}
+
+static void
+signal_teardown (gpointer data)
+{
+  gtk_object_unref (data);
+}
+
+static void
+signal_run_emit (gpointer data,
+		 gint	  size)
+{
+  guint signal_id, handler_id;
+  gint count = 0;
+  gint i;
+
+  signal_id = gtk_signal_lookup ("value_changed", GTK_TYPE_ADJUSTMENT);
+  handler_id = gtk_signal_connect (data, "value_changed",
+				   GTK_SIGNAL_FUNC (signal_handler), &count);
+  for (i = 0; i < size; i++)
+    gtk_signal_emit (data, signal_id);
+  gtk_signal_disconnect (data, handler_id);
+
+  g_assert (count == size);
+}
+
+static void
+signal_run_connect (gpointer data,
+		    gint     size)
+{
+  guint *handler_ids;
+  gint count = 0;
+  gint i;
+
+  handler_ids = g_new (guint, size);
+  for (i = 0; i < size; i++)
+    handler_ids[i] = gtk_signal_connect (data, "value_changed",
+					 GTK_SIGNAL_FUNC (signal_handler),
+					 &count);
+  for (i = 0; i < size; i++)
+    gtk_signal_disconnect (data, handler_ids[i]);
+  g_free (handler_ids);
+}
+
+/* Resizing */
+
+/* A tree of boxes size levels deep, each with a few labels, and a label
+ * at the bottom whose text is changed.
+ */
+static gpointer
+resize_setup (gint size)
+{
+  BenchWindow *bw;
+  GtkWidget *top, *box, *child, *label = NULL;
+  gint i, j;
+
+  top = box = gtk_vbox_new (FALSE, 0);
+  for (i = 0; i < size; i++)
+    {
+      for (j = 0; j < 3; j++)
+	{
+	  label = gtk_label_new ("Label");
+	  gtk_box_pack_start (GTK_BOX (box), label, FALSE, FALSE, 0);
+	}
+      child = (i % 2) ? gtk_vbox_new (FALSE, 0) : gtk_hbox_new (FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (box), child, TRUE, TRUE, 0);
+      box = child;
+    }
+  label = gtk_label_new ("Leaf");
+  gtk_box_pack_start (GTK_BOX (box), label, TRUE, TRUE, 0);
+
+  bw = bench_window_new (top, FALSE);
+  bw->widget = label;
+
+  return bw;
+}
+
+static void
+resize_run (gpointer data,
+	    gint     size)
+{
+  BenchWindow *bw = data;
+  gint i;
+
+  for (i = 0; i < RESIZE_STEPS; i++)
+    {
+      gtk_label_set_text (GTK_LABEL (bw->widget),
+			  (i % 2) ? "Leaf" : "A much longer leaf label");
+      bench_flush ();
+    }
+}
+
+/* GdkRGB */
+
+#define RGB_SIZE 512
+
+static gpointer
+rgb_setup (gint size)
+{
+  BenchWindow *bw;
+  GtkWidget *area;
+  gint i;
+
+  area = gtk_drawing_area_new ();
+  gtk_drawing_area_size (GTK_DRAWING_AREA (area), RGB_SIZE, RGB_SIZE);
+  bw = bench_window_new (area, FALSE);
+
+  bench_seed = 1;
+  bw->text = g_malloc (RGB_SIZE * RGB_SIZE * 4);
+  for (i = 0; i < RGB_SIZE * RGB_SIZE * 4; i++)
+    bw->text[i] = bench_random ();
+
+  return bw;
+}
+
+static void
+rgb_run_rgb (gpointer data,
+	     gint     size)
+{
+  BenchWindow *bw = data;
+  gint i;
+
+  for (i = 0; i < size; i++)
+    gdk_draw_rgb_image (bw->widget->window, bw->widget->style->black_gc,
+			0, 0, RGB_SIZE, RGB_SIZE, GDK_RGB_DITHER_NORMAL,
+			(guchar *) bw->text, RGB_SIZE * 3);
+  gdk_flush ();
+}
+
+static void
+rgb_run_rgb_32 (gpointer data,
+		gint	 size)
+{
+  BenchWindow *bw = data;
+  gint i;
+
+  for (i = 0; i < size; i++)
+    gdk_draw_rgb_32_image (bw->widget->window, bw->widget->style->black_gc,
+			   0, 0, RGB_SIZE, RGB_SIZE, GDK_RGB_DITHER_NORMAL,
+			   (guchar *) bw->text, RGB_SIZE * 4);
+  gdk_flush ();
+}
+
+static void
+rgb_run_gray (gpointer data,
+	      gint     size)
+{
+  BenchWindow *bw = data;
+  gint i;
+
+  for (i = 0; i < size; i++)
+    gdk_draw_gray_image (bw->widget->window, bw->widget->style->black_gc,
+			 0, 0, RGB_SIZE, RGB_SIZE, GDK_RGB_DITHER_NORMAL,
+			 (guchar *) bw->text, RGB_SIZE);
+  gdk_flush ();
+}
+
+/* Shadows, drawn as single lines with a few GCs */
+
+#define SHADOW_COLUMNS 20
+
+static gpointer
+shadow_setup (gint size)
+{
+  GtkWidget *area;
+
+  area = gtk_drawing_area_new ();
+  gtk_drawing_area_size (GTK_DRAWING_AREA (area), 400, 400);
+
+  return bench_window_new (area, FALSE);
+}
+
+static void
+shadow_draw (BenchWindow *bw,
+	     gint         size)
+{
+  gint i;
+
+  for (i = 0; i < size; i++)
+    gtk_draw_shadow (bw->widget->style, bw->widget->window,
+		     GTK_STATE_NORMAL, GTK_SHADOW_IN,
+		     (i % SHADOW_COLUMNS) * 20, (i / SHADOW_COLUMNS % SHADOW_COLUMNS) * 20,
+		     18, 18);
+}
+
+static void
+shadow_run (gpointer data,
+	    gint     size)
+{
+  shadow_draw (data, size);
+  gdk_flush ();
+}
+
+static void
+shadow_run_batched (gpointer data,
+		    gint     size)
+{
+  gdk_draw_set_batching (TRUE);
+  gdk_draw_batch_begin ();
+  shadow_draw (data, size);
+  gdk_draw_batch_end ();
+  gdk_draw_set_batching (FALSE);
+  gdk_flush ();
+}
+
+/* XPM */
+
+static gpointer
+xpm_setup (gint size)
+{
+  BenchWindow *bw;
+
+  bw = bench_window_new (gtk_drawing_area_new (), FALSE);
+  bw->text = g_strconcat (bench_data_dir, "/marble.xpm", NULL);
+
+  return bw;
+}
+
+static void
+xpm_run (gpointer data,
+	 gint	  size)
+{
+  BenchWindow *bw = data;
+  GdkPixmap *pixmap;
+  GdkBitmap *mask;
+  gint i;
+
+  for (i = 0; i < size; i++)
+    {
+      pixmap = gdk_pixmap_create_from_xpm (bw->window->window, &mask,
+					   NULL, bw->text);
+      if (!pixmap)
+	g_error ("Cannot load %s", bw->text);
+      gdk_pixmap_unref (pixmap);
+      if (mask)
+	gdk_bitmap_unref (mask);
+    }
+  gdk_flush ();
+}
+
+/* RC parsing */
+
+static gpointer
+rc_setup (gint size)
+{
+  GString *rc;
+  gchar *result;
+  gint i;
+
+  rc = g_string_new (NULL);
+  for (i = 0; i < size; i++)
+    {
+      g_string_sprintfa (rc,
+			 "style \"bench-%d\"\n"
+			 "{\n"
+			 "  fg[NORMAL] = { %d.0, 0.5, 0.25 }\n"
+			 "  bg[PRELIGHT] = \"#%06x\"\n"
+			 "  base[SELECTED] = { 0, 0, 65535 }\n"
+			 "  text[ACTIVE] = \"white\"\n"
+			 "}\n"
+			 "widget \"*.bench-%d\" style \"bench-%d\"\n"
+			 "class \"GtkBench%d\" style \"bench-%d\"\n",
+			 i, i % 2, (i * 2654435u) & 0xffffff, i, i, i, i);
+    }
+  result = rc->str;
+  g_string_free (rc, FALSE);
+
+  return result;
+}
+
+static void
+rc_run (gpointer data,
+	gint	 size)
+{
+  gtk_rc_parse_string (data);
+}
+
+static Bench benches[] = {
+  { "clist-fill",	10000,	 clist_setup, NULL, clist_run_fill, bench_window_free },
+  { "clist-fill",	100000,	 clist_setup, NULL, clist_run_fill, bench_window_free },
+  { "clist-fill",	1000000, clist_setup, NULL, clist_run_fill, bench_window_free },
+  { "clist-scroll",	10000,	 clist_setup_filled, NULL, clist_run_scroll, bench_window_free },
+  { "clist-scroll",	100000,	 clist_setup_filled, NULL, clist_run_scroll, bench_window_free },
+  { "clist-scroll",	1000000, clist_setup_filled, NULL, clist_run_scroll, bench_window_free },
+  { "clist-sort",	10000,	 clist_setup_filled, NULL, clist_run_sort, bench_window_free },
+  { "clist-sort",	100000,	 clist_setup_filled, NULL, clist_run_sort, bench_window_free },
+  { "clist-sort",	1000000, clist_setup_filled, NULL, clist_run_sort, bench_window_free },
+  { "text-insert",	1 << 20, text_setup, NULL, text_run_insert, bench_window_free },
+  { "text-insert",	4 << 20, text_setup, NULL, text_run_insert, bench_window_free },
+  { "text-delete",	1 << 20, text_setup, text_prepare_delete, text_run_delete, bench_window_free },
+  { "text-scroll",	1 << 20, text_setup_filled, NULL, text_run_scroll, bench_window_free },
+  { "text-scroll",	4 << 20, text_setup_filled, NULL, text_run_scroll, bench_window_free },
+  { "signal-emit",	1000000, signal_setup, NULL, signal_run_emit, signal_teardown },
+  { "signal-connect",	100000,	 signal_setup, NULL, signal_run_connect, signal_teardown },
+  { "resize-storm",	20,	 resize_setup, NULL, resize_run, bench_window_free },
+  { "resize-storm",	100,	 resize_setup, NULL, resize_run, bench_window_free },
+  { "rgb-draw",		20,	 rgb_setup, NULL, rgb_run_rgb, bench_window_free },
+  { "rgb-draw-32",	20,	 rgb_setup, NULL, rgb_run_rgb_32, bench_window_free },
+  { "rgb-draw-gray",	20,	 rgb_setup, NULL, rgb_run_gray, bench_window_free },
+  { "shadow-draw",	10000,	 shadow_setup, NULL, shadow_run, bench_window_free },
+  { "shadow-draw-batched", 10000, shadow_setup, NULL, shadow_run_batched, bench_window_free },
+  { "xpm-load",		100,	 xpm_setup, NULL, xpm_run, bench_window_free },
+  { "rc-parse",		1000,	 rc_setup, NULL, rc_run, g_free },
+};
+
+static gint
+compare_times (const void *a,
+	       const void *b)
+{
+  gdouble diff = *(const gdouble *) a - *(const gdouble *) b;
+
+  return diff < 0 ? -1 : diff > 0 ? 1 : 0;
+}
+
+static void
+bench_run (Bench *bench)
+{
+  GTimer *timer;
+  gpointer data;
+  gdouble *times;
+  gdouble total = 0;
+  gulong requests = 0;
+  gulong request;
+  guint round_trips = 0;
+  guint round_trip;
+  gint i;
+
+  data = bench->setup (bench->size);
+  times = g_new (gdouble, bench_repeat);
+  timer = g_timer_new ();
+
+  for (i = -bench_warmup; i < bench_repeat; i++)
+    {
+      if (bench->prepare)
+	bench->prepare (data, bench->size);
+
+      request = NextRequest (gdk_display);
+      round_trip = gdk_round_trips;
+      g_timer_start (timer);
+
+      bench->run (data, bench->size);
+
+      g_timer_stop (timer);
+      if (i >= 0)
+	{
+	  times[i] = g_timer_elapsed (timer, NULL) * 1000.;
+	  total += times[i];
+	  requests += NextRequest (gdk_display) - request;
+	  round_trips += gdk_round_trips - round_trip;
+	}
+    }
+
+  g_timer_destroy (timer);
+  bench->teardown (data);
+
+  qsort (times, bench_repeat, sizeof (gdouble), compare_times);
+  printf ("{\"name\":\"%s\",\"size\":%d,\"visual\":\"%s\",\"repeat\":%d,"
+	  "\"min_ms\":%.3f,\"median_ms\":%.3f,\"mean_ms\":%.3f,"
+	  "\"x_requests\":%lu,\"round_trips\":%u}\n",
+	  bench->name, bench->size, bench_visual, bench_repeat,
+	  times[0], times[bench_repeat / 2], total / bench_repeat,
+	  requests / bench_repeat, round_trips / bench_repeat);
+  fflush (stdout);
+
+  g_free (times);
+}
+
+static const gchar*
+get_option (const gchar *arg,
+	    const gchar *name)
+{
+  gint length = strlen (name);
+
+  if (strncmp (arg, name, length) == 0 && arg[length] == '=')
+    return arg + length + 1;
+
+  return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const gchar *visual_types[] = {
+    "StaticGray", "Grayscale", "StaticColor",
+    "PseudoColor", "TrueColor", "DirectColor"
+  };
+  GdkVisual *visual;
+  const gchar *value;
+  gboolean list = FALSE;
+  gint i;
+
+  gtk_init (&argc, &argv);
+  gdk_rgb_init ();
+  gtk_widget_set_default_colormap (gdk_rgb_get_cmap ());
+  gtk_widget_set_default_visual (gdk_rgb_get_visual ());
+
+  for (i = 1; i < argc; i++)
+    {
+      if ((value = get_option (argv[i], "--warmup")))
+	bench_warmup = MAX (atoi (value), 0);
+      else if ((value = get_option (argv[i], "--repeat")))
+	bench_repeat = MAX (atoi (value), 1);
+      else if ((value = get_option (argv[i], "--max-size")))
+	bench_max_size = atoi (value);
+      else if ((value = get_option (argv[i], "--filter")))
+	bench_filter = (gchar *) value;
+      else if ((value = get_option (argv[i], "--data-dir")))
+	bench_data_dir = (gchar *) value;
+      else if (strcmp (argv[i], "--list") == 0)
+	list = TRUE;
+      else
+	{
+	  g_print ("usage: %s [--warmup=N] [--repeat=N] [--filter=STRING]\n"
+		   "       [--max-size=N] [--data-dir=DIR] [--list]\n", argv[0]);
+	  return 1;
+	}
+    }
+
+  visual = gdk_rgb_get_visual ();
+  sprintf (bench_visual, "%s/%d", visual_types[visual->type], visual->depth);
+
+  for (i = 0; i < sizeof (benches) / sizeof (benches[0]); i++)
+    {
+      if (bench_filter && !strstr (benches[i].name, bench_filter))
+	continue;
+      if (benches[i].size > bench_max_size)
+	continue;
+
+      if (list)
+	g_print ("%s %d\n", benches[i].name, benches[i].size);
+      else
+	bench_run (&benches[i]);
+    }
+
+  return 0;
+}
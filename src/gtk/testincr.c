@@ -0,0 +1,165 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Measures the throughput of large INCR selection transfers between
+ * two clients. Start the owner first:
+ *
+ *   testincr owner [megabytes] [stream]
+ *
+ * then, in a second process on the same display:
+ *
+ *   testincr paste [times]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtk.h"
+
+static GdkAtom bench_target;
+static gint bench_size;
+static gint pastes_left;
+static GTimer *timer;
+
+static gint
+stream_fill (GtkSelectionData *selection_data,
+	     guchar           *buffer,
+	     gint              length,
+	     gpointer          data)
+{
+  gint *remaining = data;
+  gint i;
+
+  length = MIN (length, *remaining);
+  for (i = 0; i < length; i++)
+    buffer[i] = 'a' + (*remaining - i) % 26;
+  *remaining -= length;
+
+  return length;
+}
+
+static void
+selection_get (GtkWidget        *widget,
+	       GtkSelectionData *selection_data,
+	       guint             info,
+	       guint             time,
+	       gpointer          data)
+{
+  if (GPOINTER_TO_INT (data))
+    {
+      gint *remaining = g_new (gint, 1);
+
+      *remaining = bench_size;
+      gtk_selection_data_set_stream (selection_data, bench_target, 8,
+				     bench_size, stream_fill,
+				     remaining, g_free);
+    }
+  else
+    {
+      guchar *buffer = g_malloc (bench_size);
+
+      memset (buffer, 'a', bench_size);
+      gtk_selection_data_set (selection_data, bench_target, 8,
+			      buffer, bench_size);
+      g_free (buffer);
+    }
+}
+
+static void
+selection_received (GtkWidget        *widget,
+		    GtkSelectionData *data,
+		    gpointer          user_data)
+{
+  gdouble elapsed = g_timer_elapsed (timer, NULL);
+
+  if (data->length < 0)
+    {
+      g_print ("Selection retrieval failed\n");
+      gtk_main_quit ();
+      return;
+    }
+
+  g_print ("%d bytes in %.3f s: %.2f MB/s\n", data->length, elapsed,
+	   data->length / (1024. * 1024.) / MAX (elapsed, 1e-6));
+
+  if (--pastes_left > 0)
+    {
+      g_timer_start (timer);
+      gtk_selection_convert (widget, GDK_SELECTION_PRIMARY, bench_target,
+			     GDK_CURRENT_TIME);
+    }
+  else
+    gtk_main_quit ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  GtkWidget *window;
+  gboolean owner;
+
+  gtk_init (&argc, &argv);
+
+  if (argc < 2 ||
+      (strcmp (argv[1], "owner") != 0 && strcmp (argv[1], "paste") != 0))
+    {
+      g_print ("usage: %s owner [megabytes] [stream] | paste [times]\n", argv[0]);
+      return 1;
+    }
+  owner = strcmp (argv[1], "owner") == 0;
+
+  bench_target = gdk_atom_intern ("application/x-gtk-incr-bench", FALSE);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_realize (window);
+
+  if (owner)
+    {
+      bench_size = (argc > 2 ? atoi (argv[2]) : 64) * 1024 * 1024;
+
+      gtk_selection_add_target (window, GDK_SELECTION_PRIMARY,
+				bench_target, 0);
+      gtk_signal_connect (GTK_OBJECT (window), "selection_get",
+			  GTK_SIGNAL_FUNC (selection_get),
+			  GINT_TO_POINTER (argc > 3 && strcmp (argv[3], "stream") == 0));
+
+      if (!gtk_selection_owner_set (window, GDK_SELECTION_PRIMARY,
+				    GDK_CURRENT_TIME))
+	{
+	  g_print ("Could not claim the selection\n");
+	  return 1;
+	}
+      g_print ("Serving %d bytes; run \"%s paste\"\n", bench_size, argv[0]);
+    }
+  else
+    {
+      pastes_left = argc > 2 ? atoi (argv[2]) : 1;
+
+      gtk_signal_connect (GTK_OBJECT (window), "selection_received",
+			  GTK_SIGNAL_FUNC (selection_received), NULL);
+
+      timer = g_timer_new ();
+      gtk_selection_convert (window, GDK_SELECTION_PRIMARY, bench_target,
+			     GDK_CURRENT_TIME);
+    }
+
+  gtk_main ();
+
+  return 0;
+}